@@ -31,7 +31,9 @@ int main()
   // Sleep for some time to wait for serial uart to setup
   sleep_ms(1500); // ms
 
-  alarm_pool_t *pico_alarm_pool = alarm_pool_get_default();
+  // Frames and telemetry requests get their own alarm pool (see rtpool.h)
+  alarm_pool_t *pico_alarm_pool =
+      rtpool_init(&rtpool, RTPOOL_ALARM_NUM, RTPOOL_CORE);
 
   // --- setup dshot configuration ---
   dshot_config dshot;
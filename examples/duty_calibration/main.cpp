@@ -0,0 +1,139 @@
+/**
+ * @file main.cpp
+ *
+ * Example to find the fastest speed and T1H / T0H an ESC reliably decodes
+ * (see dutycal.h). The motor is not spun: frames carry the command 0, and
+ * the telemetry replies are the acceptance signal.
+ *
+ * Each ESC is calibrated independently, and keeps its result, which is
+ * printed as a grid of valid replies per 1000 requests. Copy it into
+ * `dshot_set_speed` / `dshot_set_duty` calls in your own application.
+ * Speeds and duties the motor refuses (e.g. a packet doesn't fit in the
+ * packet interval) are skipped, and shown as such.
+ *
+ * Keys:
+ *  - c: (re)start the calibration
+ *  - d: restore the default speed and duty
+ */
+
+#include "pico/platform.h"
+#include "stdio.h"
+#include <string.h>
+
+#include "dshot.h"
+#include "dutycal.h"
+#include "onewire.h"
+
+constexpr uint esc_gpio = 14;
+constexpr float dshot_speed = 600.0f;            // khz
+constexpr int64_t packet_interval_us = 1000 / 7; // 7 khz packet frequency
+constexpr uint telem_gpio = 13; // Uart RX gpios are {1, 5, 9, 13, 17, 21}
+// Telemetry requests go round robin, so each ESC gets 1 / ESC_COUNT
+constexpr long int telem_delay_us = ONEWIRE_MIN_INTERVAL_US * 2;
+
+const uint8_t cal_speeds[] = {DSHOT2400, DSHOT1200, DSHOT600, DSHOT300};
+
+// 6 x 5 grid around the nominal 75 % / 37 %
+const dutycal_config_t cal_config = {
+    .speeds = cal_speeds,
+    .speed_count = sizeof(cal_speeds) / sizeof(cal_speeds[0]),
+    .t1h_min = 600,
+    .t1h_max = 850,
+    .t1h_step = 50,
+    .t0h_min = 250,
+    .t0h_max = 450,
+    .t0h_step = 50,
+    .settle_requests = 4,
+    .requests = 50,
+    .accept_permille = 980,
+};
+
+dutycal_t cals[ESC_COUNT];
+bool cal_running[ESC_COUNT];
+
+/**
+ * @brief apply the current point of a calibration, skipping the speeds and
+ * duties the motor refuses, and print the result once it is done
+ *
+ * @param dshot
+ * @param cal
+ * @param esc_idx
+ * @return false once the calibration is done
+ */
+static bool apply(dshot_config *const dshot, dutycal_t *const cal,
+                  const int esc_idx) {
+  while (!dutycal_done(cal)) {
+    // The speed is applied first at the frame boundary, and the duty is
+    // checked against it
+    if (!dshot_set_speed(dshot, dutycal_speed(cal))) {
+      dutycal_skip_speed(cal, dshot->telem_requests);
+    } else if (!dshot_set_duty(dshot, dutycal_duty(cal))) {
+      dutycal_skip_point(cal, dshot->telem_requests);
+    } else {
+      return true;
+    }
+  }
+  dutycal_print(cal, esc_idx);
+  if (!dshot_set_speed(dshot, dutycal_speed(cal)) ||
+      !dshot_set_duty(dshot, dutycal_duty(cal)))
+    printf("ESC %i: the motor refused the result\n", esc_idx);
+  return false;
+}
+
+int main() {
+  stdio_init_all();
+
+  // Sleep for some time to wait for serial uart to setup
+  sleep_ms(1500); // ms
+
+  // Frames and telemetry requests get their own alarm pool (see rtpool.h)
+  alarm_pool_t *pico_alarm_pool =
+      rtpool_init(&rtpool, RTPOOL_ALARM_NUM, RTPOOL_CORE);
+
+  // initialise dshot config
+  dshot_config dshot;
+  dshot_config_init(&dshot, dshot_speed, esc_gpio, packet_interval_us,
+                    pico_alarm_pool);
+  print_dshot_config(&dshot);
+  const enum dshot_speed default_speed = dshot_speed_from_khz(dshot_speed);
+
+  // initialise telemetry
+  dshot_config *dshots[ESC_COUNT] = {&dshot};
+  telem_uart_init(&onewire, uart0, telem_gpio, pico_alarm_pool, telem_delay_us,
+                  dshots, true, true);
+  print_onewire_config(&onewire);
+
+  telem_sample_t sample;
+
+  while (1) {
+    while (telem_queue_pop(&onewire.queue, &sample)) {
+      if (sample.esc_idx < ESC_COUNT && cal_running[sample.esc_idx])
+        dutycal_reply(&cals[sample.esc_idx], &sample);
+    }
+
+    for (int i = 0; i < ESC_COUNT; ++i) {
+      if (!cal_running[i] || !dutycal_poll(&cals[i], dshots[i]->telem_requests))
+        continue;
+      cal_running[i] = apply(dshots[i], &cals[i], i);
+    }
+
+    const int key = getchar_timeout_us(0);
+    if (key == 'c') {
+      for (int i = 0; i < ESC_COUNT; ++i) {
+        cal_running[i] = dutycal_start(&cals[i], &cal_config,
+                                       dshots[i]->speeds,
+                                       dshots[i]->telem_requests) &&
+                         apply(dshots[i], &cals[i], i);
+      }
+      printf("Calibrating %i ESCs\n", ESC_COUNT);
+    } else if (key == 'd') {
+      for (int i = 0; i < ESC_COUNT; ++i) {
+        cal_running[i] = false;
+        dshot_set_speed(dshots[i], default_speed);
+        dshot_set_duty(dshots[i], dshot_duty_default);
+      }
+    }
+
+    dlog_flush(&dlog);
+  }
+}
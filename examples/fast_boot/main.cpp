@@ -0,0 +1,73 @@
+/**
+ * @file main.cpp
+ *
+ * Fast boot: send zero throttle frames straight after reset, from the boot
+ * config in flash (see dshotboot.h), then set up usb and report how long
+ * the first frame took.
+ *
+ * The first boot has no config in flash, so it uses the compiled-in
+ * defaults below. Keys:
+ *  - s: save the running config (speed, duties) to flash for the next boot.
+ *    The frames stop while the flash is written, and then resume
+ *  - p: print the boot report again
+ */
+
+#include "pico/platform.h"
+#include "stdio.h"
+
+#include "dshotboot.h"
+
+constexpr uint8_t esc_gpios[] = {14};
+constexpr uint8_t motors = sizeof(esc_gpios) / sizeof(esc_gpios[0]);
+constexpr enum dshot_speed dshot_speed = DSHOT600;
+constexpr int32_t packet_interval_us = 1000 / 7; // 7 khz packet frequency
+
+dshot_config dshots[BOOTCFG_MAX_MOTORS];
+bootcfg_t fallback;
+dshot_boot_t boot;
+
+int main() {
+  // Frames first: no stdio, sleeps or prints before the escs get them
+  bootcfg_build(&fallback, clock_get_hz(clk_sys) / 1000, dshot_speed,
+                DSHOT_PAUSE_NS_DEFAULT, packet_interval_us, motors, esc_gpios,
+                NULL);
+  alarm_pool_t *const pool =
+      rtpool_init(&rtpool, RTPOOL_ALARM_NUM, RTPOOL_CORE);
+  dshot_boot_init(&boot, dshots, &fallback, pool);
+
+  stdio_init_all();
+  // Sleep for some time to wait for serial uart to setup
+  sleep_ms(1500); // ms
+  dshot_boot_print(&boot);
+
+  while (1) {
+    const int key = getchar_timeout_us(0);
+    if (key == 'p') {
+      dshot_boot_print(&boot);
+    } else if (key == 's' && boot.cfg) {
+      // Persist the running speed and duties
+      uint8_t gpios[BOOTCFG_MAX_MOTORS];
+      dshot_duty_t duties[BOOTCFG_MAX_MOTORS];
+      for (int i = 0; i < boot.cfg->motors; ++i) {
+        gpios[i] = (uint8_t)dshots[i].esc_gpio_pin;
+        duties[i] = dshots[i].duty;
+      }
+      bootcfg_t cfg;
+      const bool built = bootcfg_build(
+          &cfg, boot.sys_khz, dshot_speed_from_khz(dshots[0].dshot_speed_khz),
+          dshots[0].pause_ns, boot.cfg->packet_interval_us, boot.cfg->motors,
+          gpios, duties);
+      // The frames only send zero throttle, so the motors are stopped.
+      // Stop the frames too, rather than stall them for the erase
+      if (!built) {
+        printf("Save boot config: failed\n");
+      } else if (!dshot_boot_stop(&boot, dshots)) {
+        printf("Save boot config: can't stop continuous frames\n");
+      } else {
+        const bool saved = dshot_boot_save(&cfg);
+        dshot_boot_resume(&boot, dshots, pool);
+        printf("Save boot config: %s\n", saved ? "ok" : "failed");
+      }
+    }
+  }
+}
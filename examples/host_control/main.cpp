@@ -0,0 +1,159 @@
+/**
+ * @file main.cpp
+ *
+ * Example to drive the motors from a host script over the binary command
+ * channel (see hostcmd.h), e.g.:
+ *
+ *    tools/hostcmd.py /dev/ttyACM0 ramp --start 48 --stop 548 --rate 1000
+ *
+ * Unlike the keyboard examples, each frame carries a throttle code for every
+ * motor, and is applied at the next dshot frame boundary by a frame hook,
+ * so throttle can be updated at 1 kHz+ with bounded latency.
+ * Telemetry is configured by the host and streamed back in binary
+ * (decode it with tools/telemstream_decode.py). To save bandwidth, the host
+ * can ask for min / max / mean / last records per N samples or per time
+ * window instead (see telemdecim.h), e.g.:
+ *
+ *    tools/hostcmd.py /dev/ttyACM0 decim --samples 10
+ *
+ * (decode those with tools/telemdecim_decode.py). Samples lost because the
+ * telemetry queue overflowed leave a gap in the record sequence numbers, and
+ * their count is streamed as a dlog record (decode it with
+ * tools/dlog_expand.py).
+ */
+
+#include "pico/platform.h"
+#include "stdio.h"
+#include <string.h>
+
+#include "dlog.h"
+#include "dshot.h"
+#include "hostcmd.h"
+#include "onewire.h"
+#include "telemdecim.h"
+#include "telemstream.h"
+
+constexpr uint esc_gpio = 14;
+constexpr float dshot_speed = 1200.0f;           // khz
+constexpr int64_t packet_interval_us = 1000 / 7; // 7 khz packet frequency
+constexpr uint telem_gpio = 13; // Uart RX gpios are {1, 5, 9, 13, 17, 21}
+
+// Real-time alarm pool, created in main
+alarm_pool_t *pico_alarm_pool;
+
+hostcmd_t hostcmd;
+telemdecim_t decim[ESC_COUNT];
+bool decim_enabled[ESC_COUNT];
+
+/**
+ * @brief (re)start or stop requesting telemetry, as requested by the host
+ *
+ * @param config
+ */
+void apply_telem_config(const hostcmd_telem_config_t &config) {
+  if (onewire.send_req_rt_state) {
+    cancel_repeating_timer(&onewire.send_req_rt);
+  }
+  onewire.send_req_rt_state = config.enable;
+  if (onewire.send_req_rt_state) {
+    onewire_rt_configure(&onewire, config.interval_us, pico_alarm_pool);
+  }
+}
+
+/**
+ * @brief change the decimation of one or all ESCs, as requested by the host.
+ * 0 samples and a 0 us window turn decimation off (every sample is streamed)
+ *
+ * @param config
+ */
+void apply_decim_config(const hostcmd_decim_config_t &config) {
+  const telemdecim_config_t decim_config = {.samples = config.samples,
+                                            .window_us = config.window_us};
+  for (size_t i = 0; i < ESC_COUNT; ++i) {
+    if (config.esc == HOSTCMD_ALL_ESCS || config.esc == i) {
+      telemdecim_set_config(&decim[i], &decim_config);
+      decim_enabled[i] = config.samples > 1 || config.window_us;
+    }
+  }
+}
+
+int main() {
+  stdio_init_all();
+
+  // Sleep for some time to wait for serial uart to setup
+  sleep_ms(1500); // ms
+
+  // Frames and telemetry requests get their own alarm pool (see rtpool.h)
+  pico_alarm_pool = rtpool_init(&rtpool, RTPOOL_ALARM_NUM, RTPOOL_CORE);
+
+  // initialise dshot config
+  dshot_config dshot;
+  dshot_config_init(&dshot, dshot_speed, esc_gpio, packet_interval_us,
+                    pico_alarm_pool);
+  print_dshot_config(&dshot);
+  dshot_config *dshots[ESC_COUNT] = {&dshot};
+
+  // Apply host commands at every frame boundary
+  hostcmd_init(&hostcmd);
+  for (size_t i = 0; i < ESC_COUNT; ++i) {
+    dshot_set_frame_hook(dshots[i], hostcmd_frame_hook, &hostcmd.motors[i]);
+  }
+
+  // initialise telemetry (off until the host asks for it)
+  telem_uart_init(&onewire, uart0, telem_gpio, pico_alarm_pool,
+                  ONEWIRE_MIN_INTERVAL_US, dshots, false, true);
+  print_onewire_config(&onewire);
+
+  telemstream_t stream;
+  telemstream_init(&stream);
+  hostcmd_telem_config_t telem_config;
+
+  // Decimation is off until the host asks for it
+  const telemdecim_config_t decim_config = {.samples = 0, .window_us = 0};
+  for (size_t i = 0; i < ESC_COUNT; ++i) {
+    telemdecim_init(&decim[i], i, &decim_config);
+    decim_enabled[i] = false;
+  }
+  hostcmd_decim_config_t host_decim_config;
+  telem_sample_t sample;
+  telemdecim_record_t record;
+  uint16_t decim_seq = 0;
+
+  while (1) {
+    // Parse everything waiting in the stdio rx buffer
+    int c;
+    while ((c = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT) {
+      hostcmd_feed(&hostcmd, (uint8_t)c);
+    }
+    if (hostcmd_take_telem_config(&hostcmd, &telem_config)) {
+      apply_telem_config(telem_config);
+    }
+    if (hostcmd_take_decim_config(&hostcmd, &host_decim_config)) {
+      apply_decim_config(host_decim_config);
+    }
+
+    // Stream all received telemetry back to the host, as raw samples or
+    // as decimated records
+    while (telem_queue_pop(&onewire.queue, &sample)) {
+      const uint8_t i = sample.esc_idx;
+      if (i < ESC_COUNT && decim_enabled[i]) {
+        if (telemdecim_update(&decim[i], &sample, &record))
+          telemdecim_write(&record, decim_seq++);
+        continue;
+      }
+      if (telemstream_is_full(&stream))
+        telemstream_flush(&stream);
+      telemstream_append(&stream, &sample);
+    }
+    if (stream.len)
+      telemstream_flush(&stream);
+
+    // Tell the host how many samples the queue dropped, like dlog does for
+    // its own records
+    const uint32_t dropped = telem_queue_take_dropped(&onewire.queue);
+    if (dropped) {
+      DLOG(DLOG_TELEM_QUEUE_DROPPED, dropped);
+      dlog_flush_binary(&dlog);
+    }
+  }
+}
@@ -4,6 +4,11 @@
  *
  * Example to send a dshot command based on a key press.
  *
+ * Throttle changes go through a setpoint stage (see setpoint.h), so that
+ * each `throttle_increment` is ramped in at the slew rate instead of
+ * stepping the motor.
+ * The `v` key cycles through DShot150 / 300 / 600 / 1200 / 2400 at runtime
+ * (see dshotspeed.h).
  */
 
 #include "pico/platform.h"
@@ -11,12 +16,16 @@
 #include <string.h>
 
 #include "dshot.h"
+#include "setpoint.h"
 
 #define LED_BUILTIN 25
 constexpr uint esc_gpio = 14;
 constexpr float dshot_speed = 1200.0f;
 constexpr int64_t packet_interval_us = 1000 / 7; // 7 kHz packet freq
 constexpr uint16_t throttle_increment = 50;
+constexpr float throttle_slew = 500.0f; // codes per second
+
+setpoint_t setpoint;
 
 /**
  * @brief Flash LED on and off `repeat` times with 1s delay.
@@ -38,7 +47,7 @@ void flash_led(const int &led_pin, uint repeat = 1) {
  *
  * @param key_input keyboard input
  * @param dshot dshot_config to set the throttle code and telemetry
- * depending on the key input
+ * depending on the key input. Throttle codes are published to @ref setpoint
  * @return true
  * @return false Not implemented
  *
@@ -49,24 +58,23 @@ void flash_led(const int &led_pin, uint repeat = 1) {
  */
 bool update_signal(const int &key_input, dshot_config &dshot) {
   printf("Processing key input %i\n", key_input);
+  uint16_t throttle_code = setpoint.pending_code;
 
   switch (key_input) {
   // b - beep
   case 98:
-    dshot.packet.throttle_code = 1;
+    throttle_code = 1;
     dshot.packet.telemetry = 1;
     break;
 
   // r - rise
   case 114:
     // Check if dshot is in throttle mode
-    if (dshot.packet.throttle_code >= DSHOT_ZERO_THROTTLE) {
-      dshot.packet.throttle_code = MIN(
-          dshot.packet.throttle_code + throttle_increment, DSHOT_MAX_THROTTLE);
-      printf("Throttle: %i\n",
-             dshot.packet.throttle_code - DSHOT_ZERO_THROTTLE);
-      dshot.packet.throttle_code ==
-          DSHOT_MAX_THROTTLE &&printf("Max Throttle reached\n");
+    if (throttle_code >= DSHOT_ZERO_THROTTLE) {
+      throttle_code =
+          MIN(throttle_code + throttle_increment, DSHOT_MAX_THROTTLE);
+      printf("Throttle: %i\n", throttle_code - DSHOT_ZERO_THROTTLE);
+      throttle_code == DSHOT_MAX_THROTTLE &&printf("Max Throttle reached\n");
     } else {
       printf("Motor is not in throttle mode\n");
     }
@@ -75,14 +83,12 @@ bool update_signal(const int &key_input, dshot_config &dshot) {
   // f - fall
   case 102:
     // Check if dshot is in throttle mode
-    if (dshot.packet.throttle_code >= DSHOT_ZERO_THROTTLE) {
-      dshot.packet.throttle_code = MAX(
-          dshot.packet.throttle_code - throttle_increment, DSHOT_ZERO_THROTTLE);
-
-      printf("Throttle: %i\n",
-             dshot.packet.throttle_code - DSHOT_ZERO_THROTTLE);
-      dshot.packet.throttle_code ==
-          DSHOT_ZERO_THROTTLE &&printf("Throttle is zero\n");
+    if (throttle_code >= DSHOT_ZERO_THROTTLE) {
+      throttle_code =
+          MAX(throttle_code - throttle_increment, DSHOT_ZERO_THROTTLE);
+
+      printf("Throttle: %i\n", throttle_code - DSHOT_ZERO_THROTTLE);
+      throttle_code == DSHOT_ZERO_THROTTLE &&printf("Throttle is zero\n");
     } else {
       printf("Motor is not in throttle mode\n");
     }
@@ -90,11 +96,26 @@ bool update_signal(const int &key_input, dshot_config &dshot) {
 
   // spacebar - send zero throttle
   case 32:
-    dshot.packet.throttle_code = DSHOT_ZERO_THROTTLE;
+    throttle_code = DSHOT_ZERO_THROTTLE;
     dshot.packet.telemetry = 0;
     printf("Throttle: 0\n");
     break;
 
+  // v - velocity: switch to the next dshot speed at the next frame
+  case 118: {
+    const enum dshot_speed current =
+        dshot_speed_from_khz(dshot.dshot_speed_khz);
+    const enum dshot_speed next =
+        (enum dshot_speed)((current + 1) % DSHOT_SPEEDS);
+    if (dshot_set_speed(&dshot, next)) {
+      printf("Dshot speed: %u khz\n", dshot_speed_khz_table[next]);
+    } else {
+      printf("Packet interval too short for %u khz\n",
+             dshot_speed_khz_table[next]);
+    }
+    break;
+  }
+
   // l - led: flash led on pico to check it is responsive
   // ironically, this is a blocking process
   case 108:
@@ -105,6 +126,7 @@ bool update_signal(const int &key_input, dshot_config &dshot) {
     printf("Key is not registered with a command\n");
   }
 
+  setpoint_set(&setpoint, throttle_code);
   printf("Finished processing key input\n");
 
   return true;
@@ -117,20 +139,31 @@ int main() {
   gpio_init(LED_BUILTIN);
   gpio_set_dir(LED_BUILTIN, GPIO_OUT);
 
-  // flash led to wait a few seconds for serial uart to setup
-  // also to check if the pico is responsive
-  flash_led(LED_BUILTIN, 2);
-
-  // Get the default alarm pool. This is passed in to the dshot init,
-  // so that we can setup a repeating timer to send dshot packets
-  alarm_pool_t *pico_alarm_pool = alarm_pool_get_default();
+  // Frames and telemetry requests get their own alarm pool (see rtpool.h).
+  // This is passed in to the dshot init, so that it can setup a repeating
+  // timer to send dshot packets
+  alarm_pool_t *pico_alarm_pool =
+      rtpool_init(&rtpool, RTPOOL_ALARM_NUM, RTPOOL_CORE);
 
-  // initialise dshot config
+  // initialise dshot config first, so that the esc gets frames during the
+  // wait below (see fast_boot/ for the quickest path)
   dshot_config dshot;
   dshot_config_init(&dshot, dshot_speed, esc_gpio, packet_interval_us,
                     pico_alarm_pool);
+
+  // flash led to wait a few seconds for serial uart to setup
+  // also to check if the pico is responsive
+  flash_led(LED_BUILTIN, 2);
+
   print_dshot_config(&dshot);
 
+  // Ramp throttle changes in at the frame rate
+  setpoint_init(
+      &setpoint, dshot.packet.throttle_code,
+      setpoint_slew_per_frame(throttle_slew, 1e6f / packet_interval_us), 1,
+      SETPOINT_MAX_INTERP_FRAMES);
+  dshot_set_frame_hook(&dshot, setpoint_frame_hook, &setpoint);
+
   int key_input = 0;
   while (1) {
     // Read key input from keyboard
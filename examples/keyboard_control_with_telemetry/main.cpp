@@ -23,9 +23,9 @@ constexpr uint16_t throttle_increment = 50;
 constexpr uint onewire_gpio = 13;
 constexpr long int onewire_delay_us = 1e6;
 
-// Get the default alarm pool. This is passed in to the dshot init,
-// so that we can setup a repeating timer to send dshot packets
-alarm_pool_t *pico_alarm_pool = alarm_pool_get_default();
+// Real-time alarm pool for the frame and telemetry request timers (see
+// rtpool.h), created in main
+alarm_pool_t *pico_alarm_pool;
 
 /**
  * @brief Flash LED on and off `repeat` times with 1s delay.
@@ -150,7 +150,7 @@ bool update_signal(const int &key_input, dshot_config &dshot) {
     onewire.send_req_rt_state = !onewire.send_req_rt_state;
     if (onewire.send_req_rt_state) {
       onewire_rt_configure(&onewire, onewire_delay_us, pico_alarm_pool);
-      onewire.buffer_idx = 0;
+      onewire.parser.buffer_idx = 0;
       printf("Onewire Telem ON\n");
     } else {
       printf("Onewire Telem OFF\n");
@@ -174,14 +174,19 @@ int main() {
   gpio_init(LED_BUILTIN);
   gpio_set_dir(LED_BUILTIN, GPIO_OUT);
 
-  // flash led to wait a few seconds for serial uart to setup
-  // also to check if the pico is responsive
-  flash_led(LED_BUILTIN, 2);
+  // Frames and telemetry requests get their own alarm pool (see rtpool.h)
+  pico_alarm_pool = rtpool_init(&rtpool, RTPOOL_ALARM_NUM, RTPOOL_CORE);
 
-  // initialise dshot config
+  // initialise dshot config first, so that the esc gets frames during the
+  // wait below (see fast_boot/ for the quickest path)
   dshot_config dshot;
   dshot_config_init(&dshot, dshot_speed, esc_gpio, packet_interval_us,
                     pico_alarm_pool);
+
+  // flash led to wait a few seconds for serial uart to setup
+  // also to check if the pico is responsive
+  flash_led(LED_BUILTIN, 2);
+
   print_dshot_config(&dshot);
 
   // Initialise telemetry
@@ -191,7 +196,7 @@ int main() {
   print_onewire_config(&onewire);
   // This may be required due to an intial blip in the uart while the ESC is
   // powering up / first receiving dshot commands
-  onewire.buffer_idx = KISS_ESC_TELEM_BUFFER_SIZE;
+  onewire.parser.buffer_idx = KISS_ESC_TELEM_BUFFER_SIZE;
   // Keep track of which esc to extract telemetry information from
   // This will always be 0 for ESC_COUNT = 1
   size_t esc_idx = 0;
@@ -210,6 +215,9 @@ int main() {
       kissesc_print_telem(&onewire.escs[esc_idx].telem_data);
     }
 
+    // Print any messages logged by the isrs
+    dlog_flush(&dlog);
+
     // sleep_ms(100);
   }
 }
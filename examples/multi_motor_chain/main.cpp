@@ -0,0 +1,78 @@
+/**
+ * @file main.cpp
+ *
+ * Example to drive four escs with two dma channels (see dshotchain.h).
+ *
+ * Each motor has its own setpoint stage, applied by its frame hook when the
+ * chain composes a round of packets. Keys:
+ *  - 0 - 3: select a motor
+ *  - w / s: raise / lower its throttle
+ *  - space: zero throttle on every motor
+ */
+
+#include "pico/platform.h"
+#include "stdio.h"
+
+#include "dshotchain.h"
+#include "setpoint.h"
+
+constexpr int motors = 4;
+// One gpio per pwm slice
+constexpr uint esc_gpios[motors] = {14, 16, 18, 20};
+constexpr float dshot_speed = 600.0f;            // khz
+constexpr int64_t packet_interval_us = 1000 / 4; // 4 khz rounds
+constexpr uint16_t throttle_increment = 50;
+constexpr float throttle_slew = 500.0f; // codes per second
+
+dshot_config dshots[motors];
+setpoint_t setpoints[motors];
+dshot_chain_t chain;
+
+int main() {
+  stdio_init_all();
+
+  // Sleep for some time to wait for serial uart to setup
+  sleep_ms(1500); // ms
+
+  dshot_chain_init(&chain);
+  for (int i = 0; i < motors; ++i) {
+    dshot_chain_add(&chain, &dshots[i], dshot_speed, esc_gpios[i]);
+    setpoint_init(&setpoints[i], DSHOT_ZERO_THROTTLE,
+                  setpoint_slew_per_frame(throttle_slew,
+                                          1000000 / packet_interval_us),
+                  1, SETPOINT_MAX_INTERP_FRAMES);
+    dshot_set_frame_hook(&dshots[i], setpoint_frame_hook, &setpoints[i]);
+  }
+  dshot_chain_start(&chain, packet_interval_us,
+                    rtpool_init(&rtpool, RTPOOL_ALARM_NUM, RTPOOL_CORE));
+  print_dshot_config(&dshots[0]);
+  printf("%d motors on dma channels %d (data) and %d (control)\n", motors,
+         chain.dma.data_channel, chain.dma.ctrl_channel);
+
+  int selected = 0;
+  uint16_t codes[motors];
+  for (int i = 0; i < motors; ++i)
+    codes[i] = DSHOT_ZERO_THROTTLE;
+
+  while (1) {
+    const int key = getchar_timeout_us(0);
+    if (key >= '0' && key < '0' + motors) {
+      selected = key - '0';
+    } else if (key == 'w') {
+      codes[selected] =
+          MIN(codes[selected] + throttle_increment, DSHOT_MAX_THROTTLE);
+    } else if (key == 's') {
+      codes[selected] =
+          MAX(codes[selected] - throttle_increment, DSHOT_ZERO_THROTTLE);
+    } else if (key == ' ') {
+      for (int i = 0; i < motors; ++i)
+        codes[i] = DSHOT_ZERO_THROTTLE;
+    } else {
+      continue;
+    }
+    for (int i = 0; i < motors; ++i)
+      setpoint_set(&setpoints[i], codes[i]);
+    printf("Motor %d throttle: %d\n", selected,
+           codes[selected] - DSHOT_ZERO_THROTTLE);
+  }
+}
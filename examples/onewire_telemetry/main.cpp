@@ -36,9 +36,11 @@ int main() {
   // Sleep for some time to wait for serial uart to setup
   sleep_ms(1500); // ms
 
-  // Get the default alarm pool. This is passed in to the dshot init,
-  // so that we can setup a repeating timer to send dshot packets
-  alarm_pool_t *pico_alarm_pool = alarm_pool_get_default();
+  // Frames and telemetry requests get their own alarm pool (see rtpool.h).
+  // This is passed in to the dshot init, so that it can setup a repeating
+  // timer to send dshot packets
+  alarm_pool_t *pico_alarm_pool =
+      rtpool_init(&rtpool, RTPOOL_ALARM_NUM, RTPOOL_CORE);
 
   // initialise dshot config
   dshot_config dshot;
@@ -56,7 +58,7 @@ int main() {
 
   // This may be required to an intial blip in the uart while the ESC is
   // powering up / first receiving dshot commands
-  // onewire.buffer_idx = KISS_ESC_TELEM_BUFFER_SIZE;
+  // onewire.parser.buffer_idx = KISS_ESC_TELEM_BUFFER_SIZE;
 
   // Keep track of which esc to extract telemetry information from
   // This will always be 0 for ESC_COUNT = 1
@@ -74,9 +76,12 @@ int main() {
       const float omega = onewire.escs[esc_idx].telem_data.erpm * 2 * 3.14 /
                           60 / motor_magnet_poles / 2;
       printf("Omega:\t\t%.2f\n", omega);
-      kissesc_print_buffer(onewire.buffer, KISS_ESC_TELEM_BUFFER_SIZE);
+      kissesc_print_buffer(onewire.parser.buffer, KISS_ESC_TELEM_BUFFER_SIZE);
     }
 
+    // Print any messages logged by the isrs (e.g. onewire overflow)
+    dlog_flush(&dlog);
+
     // We require some operation here, otherwise the loop hangs:
     sleep_ms(telem_delay_us / 1000);
   }
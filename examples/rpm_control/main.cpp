@@ -0,0 +1,115 @@
+/**
+ * @file main.cpp
+ *
+ * Example to hold a motor at a constant rpm from telemetry feedback
+ * (see rpmctl.h). Every telemetry sample runs the PI loop, which publishes
+ * a throttle code to the setpoint stage of the motor.
+ *
+ * Keys:
+ *  - u / d: raise / lower the target by `rpm_increment`
+ *  - space: disable the loop and return to zero throttle
+ *
+ * The gains and feed-forward map below are placeholders: measure the
+ * throttle -> rpm map of your motor (e.g. with a slow ramp), and check the
+ * gains against the latency budget with the host simulation
+ * (`sim_rpmctl` target in `test/`).
+ */
+
+#include "pico/platform.h"
+#include "stdio.h"
+#include <string.h>
+
+#include "dshot.h"
+#include "onewire.h"
+#include "rpmctl.h"
+#include "setpoint.h"
+
+constexpr uint esc_gpio = 14;
+constexpr float dshot_speed = 1200.0f;           // khz
+constexpr int64_t packet_interval_us = 1000 / 7; // 7 khz packet frequency
+constexpr uint telem_gpio = 13; // Uart RX gpios are {1, 5, 9, 13, 17, 21}
+constexpr long int telem_delay_us = ONEWIRE_MIN_INTERVAL_US;
+constexpr int motor_magnet_poles = 14;
+constexpr int32_t rpm_increment = 1000;
+
+// Steady state throttle code at a few rpms
+const rpmctl_ff_point_t ff_map[] = {
+    {0, 48}, {5000, 400}, {10000, 800}, {20000, 1700}};
+
+const rpmctl_config_t rpmctl_config = {
+    .kp = (int32_t)(0.05 * RPMCTL_GAIN_ONE),
+    .ki = (int32_t)(1.0 * RPMCTL_GAIN_ONE),
+    .kd = 0,
+    .i_band_rpm = 500,
+    .min_code = DSHOT_ZERO_THROTTLE,
+    .max_code = 1500,
+    .poles = motor_magnet_poles,
+    .max_dt_us = 10 * telem_delay_us,
+    .ff = ff_map,
+    .ff_points = sizeof(ff_map) / sizeof(ff_map[0]),
+};
+
+setpoint_t setpoint;
+rpmctl_t rpmctl;
+
+int main() {
+  stdio_init_all();
+
+  // Sleep for some time to wait for serial uart to setup
+  sleep_ms(1500); // ms
+
+  // Frames and telemetry requests get their own alarm pool (see rtpool.h)
+  alarm_pool_t *pico_alarm_pool =
+      rtpool_init(&rtpool, RTPOOL_ALARM_NUM, RTPOOL_CORE);
+
+  // initialise dshot config
+  dshot_config dshot;
+  dshot_config_init(&dshot, dshot_speed, esc_gpio, packet_interval_us,
+                    pico_alarm_pool);
+  print_dshot_config(&dshot);
+
+  // Closed loop output -> setpoint stage -> packet, at the frame boundary
+  setpoint_init(&setpoint, DSHOT_ZERO_THROTTLE, 0, 1,
+                SETPOINT_MAX_INTERP_FRAMES);
+  dshot_set_frame_hook(&dshot, setpoint_frame_hook, &setpoint);
+  rpmctl_init(&rpmctl, &rpmctl_config, &setpoint);
+
+  // initialise telemetry
+  dshot_config *dshots[ESC_COUNT] = {&dshot};
+  telem_uart_init(&onewire, uart0, telem_gpio, pico_alarm_pool, telem_delay_us,
+                  dshots, true, true);
+  print_onewire_config(&onewire);
+
+  telem_sample_t sample;
+  int32_t target_rpm = 0;
+  uint32_t samples = 0;
+
+  while (1) {
+    while (telem_queue_pop(&onewire.queue, &sample)) {
+      if (sample.telem.crc == 0 && sample.esc_idx == 0) {
+        rpmctl_update(&rpmctl, sample.telem.erpm, sample.timestamp_us);
+        // Report about every 0.5 s
+        if (++samples % 500 == 0) {
+          printf("target %i rpm\trpm %i\tthrottle %u%s\n", target_rpm,
+                 rpmctl.last_rpm, rpmctl.output,
+                 rpmctl.saturated ? " (saturated)" : "");
+        }
+      }
+    }
+
+    const int key = getchar_timeout_us(0);
+    if (key == 'u' || key == 'd') {
+      target_rpm += key == 'u' ? rpm_increment : -rpm_increment;
+      target_rpm = MAX(target_rpm, 0);
+      rpmctl_set_target(&rpmctl, target_rpm);
+      printf("Target: %i rpm\n", target_rpm);
+    } else if (key == ' ') {
+      target_rpm = 0;
+      rpmctl_disable(&rpmctl);
+      setpoint_set(&setpoint, DSHOT_ZERO_THROTTLE);
+      printf("Loop disabled\n");
+    }
+
+    dlog_flush(&dlog);
+  }
+}
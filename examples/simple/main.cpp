@@ -22,9 +22,11 @@ int main() {
   // Sleep for some time to wait for serial uart to setup
   sleep_ms(1500); // ms
 
-  // Get the default alarm pool. This is passed in to the dshot init,
-  // so that we can setup a repeating timer to send dshot packets
-  alarm_pool_t *pico_alarm_pool = alarm_pool_get_default();
+  // Frames and telemetry requests get their own alarm pool (see rtpool.h).
+  // This is passed in to the dshot init, so that it can setup a repeating
+  // timer to send dshot packets
+  alarm_pool_t *pico_alarm_pool =
+      rtpool_init(&rtpool, RTPOOL_ALARM_NUM, RTPOOL_CORE);
 
   // initialise dshot config
   dshot_config dshot;
@@ -0,0 +1,112 @@
+/**
+ * @file main.cpp
+ *
+ * Example to capture a bench session for the replay harness
+ * (see replaycap.h). The motors are driven by the host over the binary
+ * command channel, as in host_control, and the slots, request frames, uart
+ * bytes, host command bytes and samples are streamed back as capture
+ * frames, e.g.:
+ *
+ *    cat /dev/ttyACM0 > bench.cap &
+ *    tools/hostcmd.py /dev/ttyACM0 telem on --interval 1000
+ *    tools/hostcmd.py /dev/ttyACM0 ramp --start 48 --stop 548
+ *    replay_capture bench.cap bench.dsrs && telem_replay bench.dsrs
+ *
+ * The capture starts at the first request slot once the host turns the
+ * telemetry on. Turning it off and on again starts a new session.
+ * Nothing else is printed after the configs, so the stream stays binary.
+ */
+
+#include "pico/platform.h"
+#include "stdio.h"
+#include <string.h>
+
+#include "dshot.h"
+#include "hostcmd.h"
+#include "onewire.h"
+#include "replaycap.h"
+
+constexpr uint esc_gpio = 14;
+constexpr float dshot_speed = 1200.0f;           // khz
+constexpr int64_t packet_interval_us = 1000 / 7; // 7 khz packet frequency
+constexpr uint telem_gpio = 13; // Uart RX gpios are {1, 5, 9, 13, 17, 21}
+
+// Real-time alarm pool, created in main
+alarm_pool_t *pico_alarm_pool;
+
+hostcmd_t hostcmd;
+replaycap_t capture;
+
+/**
+ * @brief (re)start or stop requesting telemetry, and the capture with it
+ *
+ * @param config
+ */
+void apply_telem_config(const hostcmd_telem_config_t &config) {
+  if (onewire.send_req_rt_state) {
+    cancel_repeating_timer(&onewire.send_req_rt);
+  }
+  replaycap_stop(&capture);
+  onewire.send_req_rt_state = config.enable;
+  if (onewire.send_req_rt_state) {
+    // The request slots start over, and so does the session
+    replaycap_start(&capture);
+    onewire_rt_configure(&onewire, config.interval_us, pico_alarm_pool);
+  }
+}
+
+int main() {
+  stdio_init_all();
+
+  // Sleep for some time to wait for serial uart to setup
+  sleep_ms(1500); // ms
+
+  // Frames and telemetry requests get their own alarm pool (see rtpool.h)
+  pico_alarm_pool = rtpool_init(&rtpool, RTPOOL_ALARM_NUM, RTPOOL_CORE);
+
+  // initialise dshot config
+  dshot_config dshot;
+  dshot_config_init(&dshot, dshot_speed, esc_gpio, packet_interval_us,
+                    pico_alarm_pool);
+  print_dshot_config(&dshot);
+  dshot_config *dshots[ESC_COUNT] = {&dshot};
+
+  // Apply host commands at every frame boundary
+  hostcmd_init(&hostcmd);
+  for (size_t i = 0; i < ESC_COUNT; ++i) {
+    dshot_set_frame_hook(dshots[i], hostcmd_frame_hook, &hostcmd.motors[i]);
+  }
+
+  // initialise telemetry (off until the host asks for it), and capture it
+  telem_uart_init(&onewire, uart0, telem_gpio, pico_alarm_pool,
+                  ONEWIRE_MIN_INTERVAL_US, dshots, false, true);
+  print_onewire_config(&onewire);
+  replaycap_init(&capture);
+  onewire.capture = &capture;
+
+  hostcmd_telem_config_t telem_config;
+  telem_sample_t sample;
+  uint8_t rx[REPLAYCAP_MAX_PAYLOAD];
+
+  while (1) {
+    // Parse everything waiting in the stdio rx buffer
+    size_t count = 0;
+    int c;
+    while (count < sizeof(rx) &&
+           (c = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT) {
+      rx[count++] = (uint8_t)c;
+      hostcmd_feed(&hostcmd, (uint8_t)c);
+    }
+    if (count)
+      replaycap_hostcmd(&capture, rx, count, time_us_32());
+    if (hostcmd_take_telem_config(&hostcmd, &telem_config)) {
+      apply_telem_config(telem_config);
+    }
+
+    // The samples are the results of the session
+    while (telem_queue_pop(&onewire.queue, &sample)) {
+      replaycap_sample(&capture, &sample, time_us_32());
+    }
+    replaycap_flush(&capture);
+  }
+}
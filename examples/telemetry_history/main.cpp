@@ -0,0 +1,102 @@
+/**
+ * @file main.cpp
+ *
+ * Example to keep the telemetry history of each ESC on the pico (see
+ * telemhistory.h), and dump it after an event rather than streaming it.
+ *
+ * Keys:
+ *  - d: print the last `dump_window_ms` of each ESC as csv, decimated to
+ *       at most `dump_points` rows
+ *  - c: clear the history
+ */
+
+#include "pico/platform.h"
+#include "stdio.h"
+#include <string.h>
+
+#include "dshot.h"
+#include "onewire.h"
+#include "telemhistory.h"
+
+constexpr uint esc_gpio = 14;
+constexpr float dshot_speed = 1200.0f;           // khz
+constexpr int64_t packet_interval_us = 1000 / 7; // 7 khz packet frequency
+constexpr uint telem_gpio = 13; // Uart RX gpios are {1, 5, 9, 13, 17, 21}
+constexpr long int telem_delay_us = ONEWIRE_MIN_INTERVAL_US;
+constexpr uint32_t dump_window_ms = 2000;
+constexpr size_t dump_points = 200;
+
+telemhistory_t history[ESC_COUNT];
+telemhistory_sample_t dump[dump_points];
+
+void dump_history(const size_t esc_idx, const uint32_t now_us) {
+  const telemhistory_t *const hist = &history[esc_idx];
+  uint32_t begin, end;
+  const uint32_t n = telemhistory_range(hist, now_us - dump_window_ms * 1000,
+                                        now_us + 1, &begin, &end);
+  const uint32_t stride = n / dump_points + 1;
+  const size_t rows =
+      telemhistory_read(hist, begin, end, stride, dump, dump_points);
+
+  printf("\n---HISTORY ESC %u (%u samples, every %u)---\n", esc_idx, n, stride);
+  printf("timestamp_us,erpm,voltage_v,current_a,temperature_c\n");
+  for (size_t i = 0; i < rows; ++i) {
+    printf("%u,%u,%.2f,%.2f,%i\n", dump[i].timestamp_us, dump[i].erpm * 100,
+           dump[i].centi_voltage / 100.0f, dump[i].centi_current / 100.0f,
+           dump[i].temperature);
+  }
+}
+
+int main() {
+  stdio_init_all();
+
+  // Sleep for some time to wait for serial uart to setup
+  sleep_ms(1500); // ms
+
+  // Frames and telemetry requests get their own alarm pool (see rtpool.h)
+  alarm_pool_t *pico_alarm_pool =
+      rtpool_init(&rtpool, RTPOOL_ALARM_NUM, RTPOOL_CORE);
+
+  // initialise dshot config
+  dshot_config dshot;
+  dshot_config_init(&dshot, dshot_speed, esc_gpio, packet_interval_us,
+                    pico_alarm_pool);
+  print_dshot_config(&dshot);
+
+  // initialise telemetry
+  dshot_config *dshots[ESC_COUNT] = {&dshot};
+  telem_uart_init(&onewire, uart0, telem_gpio, pico_alarm_pool, telem_delay_us,
+                  dshots, true, true);
+  print_onewire_config(&onewire);
+
+  for (size_t i = 0; i < ESC_COUNT; ++i) {
+    telemhistory_init(&history[i]);
+  }
+  printf("History: %u samples per ESC (%u bytes)\n", TELEMHISTORY_CAPACITY,
+         sizeof(history[0]));
+
+  telem_sample_t sample;
+
+  while (1) {
+    while (telem_queue_pop(&onewire.queue, &sample)) {
+      if (sample.telem.crc == 0 && sample.esc_idx < ESC_COUNT) {
+        telemhistory_push(&history[sample.esc_idx], &sample.telem,
+                          sample.timestamp_us);
+      }
+    }
+
+    const int key = getchar_timeout_us(0);
+    if (key == 'd') {
+      const uint32_t now_us = time_us_32();
+      for (size_t i = 0; i < ESC_COUNT; ++i) {
+        dump_history(i, now_us);
+      }
+    } else if (key == 'c') {
+      for (size_t i = 0; i < ESC_COUNT; ++i) {
+        telemhistory_init(&history[i]);
+      }
+    }
+
+    dlog_flush(&dlog);
+  }
+}
@@ -0,0 +1,68 @@
+/**
+ * @file main.cpp
+ *
+ * Example that logs every onewire telemetry sample to the host in seekable
+ * chunks, for long runs.
+ *
+ * This will send a constant stream of dshot packets with the command 0.
+ * (NOTE: This will "arm" your motor, but will *not* send any throttle commands)
+ *
+ * Telemetry is requested as fast as onewire allows. The uart isr pushes each
+ * sample into onewire.queue, and the main loop packs them into columnar
+ * chunks (see telemlog.h), each written over usb as soon as it is full.
+ * Capture the output on the host, then pack and query it with tools/telemlog:
+ *
+ *    cat /dev/ttyACM0 > capture.bin
+ *    telemlog pack capture.bin run.tlog
+ *    telemlog extract run.tlog --esc 0 --field current --from 60 --to 120
+ *
+ * Nothing else is printed after the configs, so the stream stays binary.
+ */
+
+#include "pico/platform.h"
+#include "stdio.h"
+#include <string.h>
+
+#include "dshot.h"
+#include "onewire.h"
+#include "telemlog.h"
+
+constexpr uint esc_gpio = 14;
+constexpr float dshot_speed = 1200.0f;           // khz
+constexpr int64_t packet_interval_us = 1000 / 7; // 7 khz packet frequency
+constexpr uint telem_gpio = 13; // Uart RX gpios are {1, 5, 9, 13, 17, 21}
+constexpr long int telem_delay_us = ONEWIRE_MIN_INTERVAL_US;
+
+// A chunk is 4 kB: keep it off the stack
+static telemlog_t telem_log;
+
+int main() {
+  stdio_init_all();
+
+  // Sleep for some time to wait for serial uart to setup
+  sleep_ms(1500); // ms
+
+  // Frames and telemetry requests get their own alarm pool (see rtpool.h)
+  alarm_pool_t *pico_alarm_pool =
+      rtpool_init(&rtpool, RTPOOL_ALARM_NUM, RTPOOL_CORE);
+
+  // initialise dshot config
+  dshot_config dshot;
+  dshot_config_init(&dshot, dshot_speed, esc_gpio, packet_interval_us,
+                    pico_alarm_pool);
+  print_dshot_config(&dshot);
+
+  // initialise telemetry
+  dshot_config *dshots[ESC_COUNT] = {&dshot};
+  telem_uart_init(&onewire, uart0, telem_gpio, pico_alarm_pool, telem_delay_us,
+                  dshots, true, true);
+  print_onewire_config(&onewire);
+
+  telemlog_init(&telem_log, time_us_64());
+
+  while (1) {
+    // Append all queued samples, writing out each chunk once full
+    telemlog_drain(&telem_log, &onewire.queue);
+    tight_loop_contents();
+  }
+}
@@ -0,0 +1,112 @@
+/**
+ * @file main.cpp
+ *
+ * Example to reduce telemetry to statistics on the pico (see telemstats.h).
+ * Every valid sample is folded into a per ESC accumulator, and a summary
+ * of the last window (mean, variance, min, max, EWMAs) is printed every
+ * `report_interval_ms`, instead of every sample.
+ * The energy and charge drawn over each window are integrated from the
+ * voltage and current samples (see energy.h), and the request to reply
+ * latency of the telemetry is reported too (see telemlatency.h), along with
+ * the health of each ESC's telemetry (see telemhealth.h).
+ * The entry latency of the frame and request timers is measured on the
+ * real-time alarm pool, and reported per window as well (see rtpool.h).
+ */
+
+#include "pico/platform.h"
+#include "stdio.h"
+#include <string.h>
+
+#include "dshot.h"
+#include "energy.h"
+#include "onewire.h"
+#include "telemlatency.h"
+#include "telemstats.h"
+
+constexpr uint esc_gpio = 14;
+constexpr float dshot_speed = 1200.0f;           // khz
+constexpr int64_t packet_interval_us = 1000 / 7; // 7 khz packet frequency
+constexpr uint telem_gpio = 13; // Uart RX gpios are {1, 5, 9, 13, 17, 21}
+constexpr long int telem_delay_us = ONEWIRE_MIN_INTERVAL_US;
+constexpr uint32_t report_interval_ms = 1000;
+// alpha = 1/8 and 1/128
+constexpr uint8_t ewma_shift[TELEMSTATS_EWMA_COUNT] = {3, 7};
+
+telemstats_t stats[ESC_COUNT];
+energy_integrator_t energy[ESC_COUNT];
+telemlatency_t latency[ESC_COUNT];
+
+int main() {
+  stdio_init_all();
+
+  // Sleep for some time to wait for serial uart to setup
+  sleep_ms(1500); // ms
+
+  // Frames and telemetry requests get their own alarm pool (see rtpool.h)
+  alarm_pool_t *pico_alarm_pool =
+      rtpool_init(&rtpool, RTPOOL_ALARM_NUM, RTPOOL_CORE);
+
+  // initialise dshot config
+  dshot_config dshot;
+  dshot_config_init(&dshot, dshot_speed, esc_gpio, packet_interval_us,
+                    pico_alarm_pool);
+  print_dshot_config(&dshot);
+
+  // initialise telemetry
+  dshot_config *dshots[ESC_COUNT] = {&dshot};
+  telem_uart_init(&onewire, uart0, telem_gpio, pico_alarm_pool, telem_delay_us,
+                  dshots, true, true);
+  print_onewire_config(&onewire);
+
+  // Report the entry latency of the timer callbacks
+  rtpool_measure(&rtpool, true);
+
+  for (size_t i = 0; i < ESC_COUNT; ++i) {
+    telemstats_init(&stats[i], ewma_shift);
+    // Don't integrate across more than a few missed samples
+    energy_init(&energy[i], 4 * telem_delay_us);
+    telemlatency_init(&latency[i]);
+  }
+
+  telem_sample_t sample;
+  telemstats_result_t result;
+  energy_mark_t marks[ESC_COUNT] = {};
+  energy_step_t step;
+  absolute_time_t next_report = make_timeout_time_ms(report_interval_ms);
+
+  while (1) {
+    while (telem_queue_pop(&onewire.queue, &sample)) {
+      if (sample.esc_idx < ESC_COUNT)
+        telemlatency_update(&latency[sample.esc_idx], &sample);
+      if (sample.telem.crc == 0 && sample.esc_idx < ESC_COUNT) {
+        telemstats_update(&stats[sample.esc_idx], &sample.telem,
+                          sample.timestamp_us);
+        energy_update(&energy[sample.esc_idx], &sample.telem,
+                      sample.timestamp_us);
+      }
+    }
+
+    if (time_reached(next_report)) {
+      next_report = delayed_by_ms(next_report, report_interval_ms);
+      for (size_t i = 0; i < ESC_COUNT; ++i) {
+        telemstats_snapshot(&stats[i], &result, true);
+        telemstats_print_result(&result, i);
+
+        energy_since(&energy[i], &marks[i], &step);
+        energy_mark(&energy[i], &marks[i]);
+        printf("Energy:\t\t%llu mJ\t%llu mC\t%lu mW", energy_to_mj(step.energy),
+               charge_to_mc(step.charge), energy_step_mean_power_mw(&step));
+        printf(" (%llu us, %llu us gaps)\n", step.covered_us, step.gap_us);
+
+        telemlatency_print(&latency[i], i);
+        telemlatency_init(&latency[i]);
+        telemhealth_print(&onewire.health[i], i, time_us_32());
+      }
+      rtpool_print(&rtpool);
+      rtpool_measure(&rtpool, true);
+    }
+
+    // Print any messages logged by the isrs (e.g. onewire overflow)
+    dlog_flush(&dlog);
+  }
+}
@@ -0,0 +1,63 @@
+/**
+ * @file main.cpp
+ *
+ * Example that streams every onewire telemetry sample to the host in binary.
+ *
+ * This will send a constant stream of dshot packets with the command 0.
+ * (NOTE: This will "arm" your motor, but will *not* send any throttle commands)
+ *
+ * Telemetry is requested as fast as onewire allows. The uart isr pushes each
+ * sample into onewire.queue, and the main loop packs them into compact
+ * records (see telemstream.h), which are written over usb in blocks.
+ * Decode the output on the host with:
+ *
+ *    tools/telemstream_decode.py /dev/ttyACM0 --csv telem.csv
+ *
+ * Nothing else is printed after the configs, so the stream stays binary.
+ */
+
+#include "pico/platform.h"
+#include "stdio.h"
+#include <string.h>
+
+#include "dshot.h"
+#include "onewire.h"
+#include "telemstream.h"
+
+constexpr uint esc_gpio = 14;
+constexpr float dshot_speed = 1200.0f;           // khz
+constexpr int64_t packet_interval_us = 1000 / 7; // 7 khz packet frequency
+constexpr uint telem_gpio = 13; // Uart RX gpios are {1, 5, 9, 13, 17, 21}
+constexpr long int telem_delay_us = ONEWIRE_MIN_INTERVAL_US;
+
+int main() {
+  stdio_init_all();
+
+  // Sleep for some time to wait for serial uart to setup
+  sleep_ms(1500); // ms
+
+  // Frames and telemetry requests get their own alarm pool (see rtpool.h)
+  alarm_pool_t *pico_alarm_pool =
+      rtpool_init(&rtpool, RTPOOL_ALARM_NUM, RTPOOL_CORE);
+
+  // initialise dshot config
+  dshot_config dshot;
+  dshot_config_init(&dshot, dshot_speed, esc_gpio, packet_interval_us,
+                    pico_alarm_pool);
+  print_dshot_config(&dshot);
+
+  // initialise telemetry
+  dshot_config *dshots[ESC_COUNT] = {&dshot};
+  telem_uart_init(&onewire, uart0, telem_gpio, pico_alarm_pool, telem_delay_us,
+                  dshots, true, true);
+  print_onewire_config(&onewire);
+
+  telemstream_t stream;
+  telemstream_init(&stream);
+
+  while (1) {
+    // Pack all queued samples and write them out
+    telemstream_drain(&stream, &onewire.queue);
+    tight_loop_contents();
+  }
+}
@@ -0,0 +1,85 @@
+/**
+ * @file main.cpp
+ *
+ * Example to play a throttle profile stored in flash (see profile.h).
+ * `step_profile.h` was compiled from `step.csv` with:
+ *
+ *    tools/profile_compile.py examples/throttle_profile/step.csv \
+ *        -o examples/throttle_profile/step_profile.h \
+ *        --name step_profile --frame-rate 7000
+ *
+ * The frame rate passed to the compiler must match the packet interval
+ * below, as the player advances by one sample per dshot frame.
+ * Press 'p' to play the profile, and 's' to stop it.
+ */
+
+#include "pico/platform.h"
+#include "stdio.h"
+
+#include "dshot.h"
+#include "onewire.h"
+#include "profile.h"
+#include "step_profile.h"
+
+constexpr uint esc_gpio = 14;
+constexpr float dshot_speed = 1200.0f;           // khz
+constexpr int64_t packet_interval_us = 1000 / 7; // 7 khz packet frequency
+constexpr uint telem_gpio = 13; // Uart RX gpios are {1, 5, 9, 13, 17, 21}
+
+// Real-time alarm pool, created in main
+alarm_pool_t *pico_alarm_pool;
+
+profile_player_t player;
+
+int main() {
+  stdio_init_all();
+
+  // Sleep for some time to wait for serial uart to setup
+  sleep_ms(1500); // ms
+
+  // Frames and telemetry requests get their own alarm pool (see rtpool.h)
+  pico_alarm_pool = rtpool_init(&rtpool, RTPOOL_ALARM_NUM, RTPOOL_CORE);
+
+  // initialise dshot config
+  dshot_config dshot;
+  dshot_config_init(&dshot, dshot_speed, esc_gpio, packet_interval_us,
+                    pico_alarm_pool);
+  print_dshot_config(&dshot);
+  dshot_config *dshots[ESC_COUNT] = {&dshot};
+
+  if (!profile_player_load(&player, step_profile)) {
+    printf("Invalid profile\n");
+    return 1;
+  }
+  for (size_t i = 0; i < ESC_COUNT; ++i) {
+    dshot_set_frame_hook(dshots[i], profile_frame_hook, &player.tracks[i]);
+  }
+
+  // initialise telemetry
+  telem_uart_init(&onewire, uart0, telem_gpio, pico_alarm_pool,
+                  ONEWIRE_MIN_INTERVAL_US, dshots, true, true);
+  print_onewire_config(&onewire);
+
+  bool playing = false;
+  while (1) {
+    const int c = getchar_timeout_us(0);
+    if (c == 'p') {
+      profile_player_load(&player, step_profile);
+      profile_player_start(&player);
+      playing = true;
+      printf("Playing profile (%u bytes)\n", sizeof(step_profile));
+    } else if (c == 's') {
+      profile_player_stop(&player);
+      // Leave the motors at idle
+      dshot.packet.throttle_code = 0;
+      playing = false;
+      printf("Stopped\n");
+    }
+
+    if (playing && profile_player_done(&player)) {
+      playing = false;
+      printf("Profile done\n");
+    }
+    dlog_flush(&dlog);
+  }
+}
@@ -0,0 +1,95 @@
+// Generated by tools/profile_compile.py from step.csv
+// 21001 frames, 1041 bytes. Do not edit.
+#pragma once
+#include "pico/platform.h"
+#include "stdint.h"
+
+static const uint8_t step_profile[] __in_flash("profile") = {
+    0x54, 0x50, 0x01, 0x01, 0x08, 0x00, 0x00, 0x00, 0x80, 0x30, 0x00, 0x81,
+    0xab, 0x0d, 0x80, 0x2c, 0x01, 0x81, 0xab, 0x0d, 0x80, 0x58, 0x02, 0x81,
+    0xab, 0x0d, 0x80, 0x2c, 0x01, 0x81, 0xb9, 0x0d, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1a, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x1b, 0x00,
+    0x7f, 0x81, 0x1b, 0x00, 0x7f, 0x81, 0x0d, 0x00, 0x85,
+};
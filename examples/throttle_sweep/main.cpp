@@ -0,0 +1,99 @@
+/**
+ * @file main.cpp
+ *
+ * Example to characterise a motor on the pico (see sweep.h). Each step of
+ * the sweep ends as soon as erpm and current have settled, and its
+ * aggregate is written over usb as a binary record. Decode them with:
+ *
+ *     tools/sweep_decode.py /dev/ttyACM0 --csv sweep.csv
+ *
+ * Keys:
+ *  - s: start the sweep
+ *  - space: abort the sweep and return to zero throttle
+ */
+
+#include "pico/platform.h"
+#include "stdio.h"
+#include <string.h>
+
+#include "dshot.h"
+#include "onewire.h"
+#include "setpoint.h"
+#include "sweep.h"
+
+constexpr uint esc_gpio = 14;
+constexpr float dshot_speed = 1200.0f;           // khz
+constexpr int64_t packet_interval_us = 1000 / 7; // 7 khz packet frequency
+constexpr uint telem_gpio = 13; // Uart RX gpios are {1, 5, 9, 13, 17, 21}
+constexpr long int telem_delay_us = ONEWIRE_MIN_INTERVAL_US;
+constexpr uint32_t slew_codes_per_s = 2000;
+
+const uint16_t sweep_codes[] = {148, 348, 548, 748, 948, 1148, 1348, 948, 148};
+
+const sweep_config_t sweep_config = {
+    .codes = sweep_codes,
+    .steps = sizeof(sweep_codes) / sizeof(sweep_codes[0]),
+    .end_code = DSHOT_ZERO_THROTTLE,
+    .min_settle_us = 200 * 1000,
+    .max_settle_us = 5 * 1000 * 1000,
+    .erpm_std_max = 300,
+    .current_std_max = 20,
+    .measure_samples = 500,
+};
+
+setpoint_t setpoint;
+sweep_t sweep;
+
+int main() {
+  stdio_init_all();
+
+  // Sleep for some time to wait for serial uart to setup
+  sleep_ms(1500); // ms
+
+  // Frames and telemetry requests get their own alarm pool (see rtpool.h)
+  alarm_pool_t *pico_alarm_pool =
+      rtpool_init(&rtpool, RTPOOL_ALARM_NUM, RTPOOL_CORE);
+
+  // initialise dshot config
+  dshot_config dshot;
+  dshot_config_init(&dshot, dshot_speed, esc_gpio, packet_interval_us,
+                    pico_alarm_pool);
+  print_dshot_config(&dshot);
+
+  // Sweep -> slew limited setpoint stage -> packet, at the frame boundary
+  setpoint_init(&setpoint, DSHOT_ZERO_THROTTLE,
+                setpoint_slew_per_frame(slew_codes_per_s,
+                                        1000000 / packet_interval_us),
+                1, SETPOINT_MAX_INTERP_FRAMES);
+  dshot_set_frame_hook(&dshot, setpoint_frame_hook, &setpoint);
+  sweep_init(&sweep, &sweep_config, &setpoint);
+
+  // initialise telemetry
+  dshot_config *dshots[ESC_COUNT] = {&dshot};
+  telem_uart_init(&onewire, uart0, telem_gpio, pico_alarm_pool, telem_delay_us,
+                  dshots, true, true);
+  print_onewire_config(&onewire);
+
+  telem_sample_t sample;
+
+  while (1) {
+    while (telem_queue_pop(&onewire.queue, &sample)) {
+      if (sample.telem.crc == 0 && sample.esc_idx == 0 &&
+          sweep_update(&sweep, &sample.telem, sample.timestamp_us)) {
+        sweep_write_result(&sweep.result);
+      }
+    }
+    // Don't stall a step if the esc stops replying
+    sweep_poll(&sweep, time_us_32());
+
+    const int key = getchar_timeout_us(0);
+    if (key == 's') {
+      sweep_start(&sweep, time_us_32());
+    } else if (key == ' ') {
+      sweep_stop(&sweep);
+    }
+
+    // Text from the isrs is skipped by the decoder
+    dlog_flush(&dlog);
+  }
+}
@@ -0,0 +1,203 @@
+/**
+ * @file bootcfg.h
+ * @defgroup bootcfg bootcfg
+ * @brief CRC checked configuration block, persisted in flash for a fast boot
+ *
+ * The default init measures the sys clock, recomputes the pwm settings of
+ * every speed and prints them before the first frame is sent. A boot
+ * config holds all of that precomputed: the speed table at a given sys
+ * clock, the pause, the packet interval, and the gpio and calibrated duty
+ * of each motor (see dutycal.h). dshotboot.h applies it straight from
+ * flash (XIP), and saves it there.
+ *
+ * A block is only used if its magic, version, size and CRC-32 (the zlib
+ * one, over every byte before @ref bootcfg_t::crc) match, it was computed
+ * at the current sys clock, and its fields are in range. Blocks are
+ * zeroed before they are filled, so padding bytes are deterministic.
+ */
+
+#pragma once
+#include "dshotduty.h"
+#include "dshotspeed.h"
+#include "stdbool.h"
+#include "stddef.h"
+#include "stdint.h"
+#include "string.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// "DSBC"
+#define BOOTCFG_MAGIC 0x43425344u
+#define BOOTCFG_VERSION 1
+/// Most motors in a block
+#ifndef BOOTCFG_MAX_MOTORS
+#define BOOTCFG_MAX_MOTORS 8
+#endif
+
+/**
+ * @brief a boot configuration
+ *
+ * @param magic @ref BOOTCFG_MAGIC
+ * @param version @ref BOOTCFG_VERSION
+ * @param size sizeof(bootcfg_t), catches layout changes within a version
+ * @param sys_khz sys clock the speed table was computed at
+ * @param pause_ns pause after each frame
+ * @param packet_interval_us or @ref DSHOT_CONTINUOUS
+ * @param speed @ref dshot_speed to start at
+ * @param motors
+ * @param esc_gpio gpio of each motor
+ * @param duty T1H / T0H of each motor
+ * @param speeds precomputed pwm settings (see dshotspeed.h)
+ * @param crc CRC-32 of the bytes before it
+ */
+typedef struct bootcfg {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t size;
+  uint32_t sys_khz;
+  uint32_t pause_ns;
+  int32_t packet_interval_us;
+  uint8_t speed;
+  uint8_t motors;
+  uint8_t esc_gpio[BOOTCFG_MAX_MOTORS];
+  dshot_duty_t duty[BOOTCFG_MAX_MOTORS];
+  dshot_speed_entry_t speeds[DSHOT_SPEEDS];
+  uint32_t crc;
+} bootcfg_t;
+
+/// Result of @ref bootcfg_check
+enum bootcfg_status {
+  BOOTCFG_OK = 0,
+  BOOTCFG_BAD_MAGIC, ///< e.g. erased flash
+  BOOTCFG_BAD_VERSION,
+  BOOTCFG_BAD_CRC,
+  BOOTCFG_BAD_CLOCK, ///< computed at another sys clock
+  BOOTCFG_BAD_FIELD,
+};
+
+/**
+ * @brief CRC-32 (reflected, poly 0xedb88320, as zlib)
+ *
+ * Bitwise rather than table driven: a block is checked once per boot.
+ *
+ * @param data
+ * @param len
+ */
+static inline uint32_t bootcfg_crc32(const void *const data,
+                                     const size_t len) {
+  const uint8_t *const bytes = (const uint8_t *)data;
+  uint32_t crc = 0xffffffffu;
+  for (size_t i = 0; i < len; ++i) {
+    crc ^= bytes[i];
+    for (int b = 0; b < 8; ++b)
+      crc = (crc >> 1) ^ (0xedb88320u & (0u - (crc & 1)));
+  }
+  return ~crc;
+}
+
+/// @brief set the crc of a filled block
+static inline void bootcfg_seal(bootcfg_t *const cfg) {
+  cfg->crc = bootcfg_crc32(cfg, offsetof(bootcfg_t, crc));
+}
+
+/**
+ * @brief fill a block: compute the speed table and seal it
+ *
+ * @param cfg output, zeroed first
+ * @param sys_khz
+ * @param speed
+ * @param pause_ns
+ * @param packet_interval_us or @ref DSHOT_CONTINUOUS
+ * @param motors
+ * @param esc_gpio gpio of each motor
+ * @param duty duty of each motor, or NULL for @ref dshot_duty_default
+ * @return false if a field is out of range or the starting speed can't
+ * hold the pause (faster speeds may be unavailable, see
+ * @ref dshot_speed_entry_available)
+ */
+static inline bool bootcfg_build(bootcfg_t *const cfg, const uint32_t sys_khz,
+                                 const uint8_t speed, const uint32_t pause_ns,
+                                 const int32_t packet_interval_us,
+                                 const uint8_t motors,
+                                 const uint8_t esc_gpio[],
+                                 const dshot_duty_t duty[]) {
+  memset(cfg, 0, sizeof(*cfg));
+  if (speed >= DSHOT_SPEEDS || !motors || motors > BOOTCFG_MAX_MOTORS)
+    return false;
+  cfg->magic = BOOTCFG_MAGIC;
+  cfg->version = BOOTCFG_VERSION;
+  cfg->size = sizeof(bootcfg_t);
+  cfg->sys_khz = sys_khz;
+  cfg->pause_ns = pause_ns;
+  cfg->packet_interval_us = packet_interval_us;
+  cfg->speed = speed;
+  cfg->motors = motors;
+  for (int i = 0; i < motors; ++i) {
+    cfg->esc_gpio[i] = esc_gpio[i];
+    cfg->duty[i] = duty ? duty[i] : dshot_duty_default;
+  }
+  dshot_speed_table_init(cfg->speeds, sys_khz, pause_ns);
+  if (!dshot_speed_entry_available(&cfg->speeds[speed]))
+    return false;
+  bootcfg_seal(cfg);
+  return true;
+}
+
+/**
+ * @brief check a block before using it
+ *
+ * @param cfg e.g. in flash
+ * @param sys_khz current sys clock
+ */
+static inline enum bootcfg_status bootcfg_check(const bootcfg_t *const cfg,
+                                                const uint32_t sys_khz) {
+  if (cfg->magic != BOOTCFG_MAGIC)
+    return BOOTCFG_BAD_MAGIC;
+  if (cfg->version != BOOTCFG_VERSION || cfg->size != sizeof(bootcfg_t))
+    return BOOTCFG_BAD_VERSION;
+  if (cfg->crc != bootcfg_crc32(cfg, offsetof(bootcfg_t, crc)))
+    return BOOTCFG_BAD_CRC;
+  if (cfg->sys_khz != sys_khz)
+    return BOOTCFG_BAD_CLOCK;
+  if (cfg->speed >= DSHOT_SPEEDS || !cfg->motors ||
+      cfg->motors > BOOTCFG_MAX_MOTORS || cfg->packet_interval_us < 0)
+    return BOOTCFG_BAD_FIELD;
+  for (int s = 0; s < DSHOT_SPEEDS; ++s) {
+    if (cfg->speeds[s].pause_pulses > DSHOT_PAUSE_MAX_PULSES ||
+        !cfg->speeds[s].top)
+      return BOOTCFG_BAD_FIELD;
+  }
+  // The packet must fit the interval at the starting speed
+  if (!dshot_speed_entry_available(&cfg->speeds[cfg->speed]))
+    return BOOTCFG_BAD_FIELD;
+  if (cfg->packet_interval_us &&
+      !dshot_speed_interval_valid(&cfg->speeds[cfg->speed],
+                                  cfg->packet_interval_us))
+    return BOOTCFG_BAD_FIELD;
+  return BOOTCFG_OK;
+}
+
+/// @brief name of a status, for reports
+static inline const char *bootcfg_status_str(const enum bootcfg_status st) {
+  switch (st) {
+  case BOOTCFG_OK:
+    return "ok";
+  case BOOTCFG_BAD_MAGIC:
+    return "no config";
+  case BOOTCFG_BAD_VERSION:
+    return "bad version";
+  case BOOTCFG_BAD_CRC:
+    return "bad crc";
+  case BOOTCFG_BAD_CLOCK:
+    return "other sys clock";
+  case BOOTCFG_BAD_FIELD:
+    return "bad field";
+  }
+  return "?";
+}
+
+#ifdef __cplusplus
+}
+#endif
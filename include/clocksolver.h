@@ -0,0 +1,243 @@
+/**
+ * @file clocksolver.h
+ * @defgroup clocksolver clocksolver
+ * @brief Search sys clock and pwm settings that minimise DShot timing error
+ *
+ * A DShot bit is one pwm period of `(top + 1) x div / f_sys`, and its high
+ * time is `cc x div / f_sys`. Both are quantised to the pwm counter, so at
+ * high bit rates (e.g. DShot2400, ~52 counts per bit at 125 MHz) the
+ * choice of sys clock, divider and wrap matters.
+ *
+ * @ref clocksolver_solve enumerates the sys pll settings
+ * (`f_sys = xosc x fbdiv / (postdiv1 x postdiv2)`) within the vco and sys
+ * clock limits, then the dividers for each clock, and keeps the setting
+ * with the smallest timing error: the largest of the bit period, T1H and
+ * T0H errors, in ns. A fractional divider dithers between two counts, so
+ * its error includes a jitter of one sys clock period, and integer
+ * dividers are preferred.
+ *
+ * This uses doubles: run it on the host (see `tools/clock_solver.cpp`) or
+ * at init, not in an isr. Apply a solution with
+ * `set_sys_clock_pll(vco_hz, postdiv1, postdiv2)` before
+ * @ref dshot_config_init.
+ */
+
+#pragma once
+#include "stdbool.h"
+#include "stdint.h"
+#include <math.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// pwm divider: 8.4 fixed point, 1.0 - 255.9375
+#define CLOCKSOLVER_DIV_FRAC_BITS 4
+#define CLOCKSOLVER_DIV_MIN (1 << CLOCKSOLVER_DIV_FRAC_BITS)
+#define CLOCKSOLVER_DIV_MAX 0xfff
+/// Largest pwm period in counts (top = 0xffff)
+#define CLOCKSOLVER_MAX_COUNTS 0x10000
+
+/**
+ * @brief search space and targets
+ *
+ * @param xosc_hz crystal (pll reference) frequency
+ * @param vco_min_hz, vco_max_hz pll vco limits
+ * @param sys_min_hz, sys_max_hz sys clock limits
+ * @param t1h, t0h high time of a 1 and a 0 bit, as a fraction of a bit
+ * @param frac_div also consider fractional dividers
+ */
+typedef struct clocksolver_params {
+  uint32_t xosc_hz;
+  uint32_t vco_min_hz;
+  uint32_t vco_max_hz;
+  uint32_t sys_min_hz;
+  uint32_t sys_max_hz;
+  double t1h;
+  double t0h;
+  bool frac_div;
+} clocksolver_params_t;
+
+/**
+ * @brief a solution and its timing errors
+ *
+ * @param sys_hz sys clock
+ * @param vco_hz, fbdiv, postdiv1, postdiv2 pll settings (0 if the clock
+ * was given rather than searched)
+ * @param div pwm divider (8.4 fixed point)
+ * @param top pwm wrap
+ * @param cc_high, cc_low counter compare of a 1 and a 0 bit
+ * @param bit_ns, t1h_ns, t0h_ns actual timings
+ * @param bit_err_ns, t1h_err_ns, t0h_err_ns actual - target
+ * @param jitter_ns dither of a fractional divider
+ * @param error_ns largest error (+ jitter), which is minimised
+ */
+typedef struct clocksolver_result {
+  double sys_hz;
+  uint32_t vco_hz;
+  uint16_t fbdiv;
+  uint8_t postdiv1;
+  uint8_t postdiv2;
+  uint16_t div;
+  uint16_t top;
+  uint16_t cc_high;
+  uint16_t cc_low;
+  double bit_ns;
+  double t1h_ns;
+  double t0h_ns;
+  double bit_err_ns;
+  double t1h_err_ns;
+  double t0h_err_ns;
+  double jitter_ns;
+  double error_ns;
+} clocksolver_result_t;
+
+/**
+ * @brief default limits: rp2040 pll (12 MHz crystal, 750 - 1600 MHz vco)
+ * up to the rated 133 MHz, with the duty cycles of @ref
+ * dshot_packet_configure
+ *
+ * @param params output
+ */
+static inline void clocksolver_default_params(clocksolver_params_t *params) {
+  params->xosc_hz = 12000000;
+  params->vco_min_hz = 750000000;
+  params->vco_max_hz = 1600000000;
+  params->sys_min_hz = 100000000;
+  params->sys_max_hz = 133000000;
+  params->t1h = 0.75;
+  params->t0h = 0.37;
+  params->frac_div = false;
+}
+
+/**
+ * @brief timing errors of one setting
+ *
+ * @param sys_hz
+ * @param rate_hz target bit rate
+ * @param div pwm divider (8.4 fixed point)
+ * @param counts pwm period in counts (top + 1)
+ * @param params
+ * @param result output (pll fields are left untouched)
+ */
+static inline void clocksolver_evaluate(const double sys_hz,
+                                        const double rate_hz,
+                                        const uint16_t div,
+                                        const uint32_t counts,
+                                        const clocksolver_params_t *params,
+                                        clocksolver_result_t *const result) {
+  const double count_ns =
+      1e9 * div / (1 << CLOCKSOLVER_DIV_FRAC_BITS) / sys_hz;
+  const double target_ns = 1e9 / rate_hz;
+  result->sys_hz = sys_hz;
+  result->div = div;
+  result->top = (uint16_t)(counts - 1);
+  result->cc_high = (uint16_t)lround(params->t1h * counts);
+  result->cc_low = (uint16_t)lround(params->t0h * counts);
+  result->bit_ns = counts * count_ns;
+  result->t1h_ns = result->cc_high * count_ns;
+  result->t0h_ns = result->cc_low * count_ns;
+  result->bit_err_ns = result->bit_ns - target_ns;
+  result->t1h_err_ns = result->t1h_ns - params->t1h * target_ns;
+  result->t0h_err_ns = result->t0h_ns - params->t0h * target_ns;
+  // A fractional divider alternates between two count lengths
+  result->jitter_ns =
+      div % (1 << CLOCKSOLVER_DIV_FRAC_BITS) ? 1e9 / sys_hz : 0;
+  result->error_ns = fmax(fabs(result->bit_err_ns),
+                          fmax(fabs(result->t1h_err_ns),
+                               fabs(result->t0h_err_ns))) +
+                     result->jitter_ns;
+}
+
+/**
+ * @brief best divider and wrap for a given sys clock
+ *
+ * @param sys_hz
+ * @param rate_hz target bit rate
+ * @param params
+ * @param result output
+ * @return false if no setting reaches the bit rate
+ */
+static inline bool
+clocksolver_solve_divwrap(const double sys_hz, const double rate_hz,
+                          const clocksolver_params_t *const params,
+                          clocksolver_result_t *const result) {
+  bool found = false;
+  const int step = params->frac_div ? 1 : CLOCKSOLVER_DIV_MIN;
+  for (int div = CLOCKSOLVER_DIV_MIN; div <= CLOCKSOLVER_DIV_MAX;
+       div += step) {
+    const double counts =
+        sys_hz * (1 << CLOCKSOLVER_DIV_FRAC_BITS) / div / rate_hz;
+    if (counts > CLOCKSOLVER_MAX_COUNTS + 1)
+      continue;
+    if (counts < 2)
+      break;
+    const uint32_t candidates[2] = {(uint32_t)floor(counts),
+                                    (uint32_t)ceil(counts)};
+    for (int c = 0; c < 2; ++c) {
+      if (candidates[c] < 2 || candidates[c] > CLOCKSOLVER_MAX_COUNTS)
+        continue;
+      clocksolver_result_t trial;
+      clocksolver_evaluate(sys_hz, rate_hz, (uint16_t)div, candidates[c],
+                           params, &trial);
+      if (!found || trial.error_ns < result->error_ns) {
+        *result = trial;
+        found = true;
+      }
+    }
+  }
+  result->vco_hz = 0;
+  result->fbdiv = 0;
+  result->postdiv1 = 0;
+  result->postdiv2 = 0;
+  return found;
+}
+
+/**
+ * @brief best pll, divider and wrap for a bit rate
+ *
+ * Ties go to the fastest sys clock, as it leaves the most cpu time.
+ *
+ * @param rate_hz target bit rate
+ * @param params
+ * @param result output
+ * @return false if no setting reaches the bit rate
+ */
+static inline bool clocksolver_solve(const double rate_hz,
+                                     const clocksolver_params_t *const params,
+                                     clocksolver_result_t *const result) {
+  bool found = false;
+  for (uint32_t fbdiv = 16; fbdiv <= 320; ++fbdiv) {
+    const uint64_t vco = (uint64_t)params->xosc_hz * fbdiv;
+    if (vco < params->vco_min_hz || vco > params->vco_max_hz)
+      continue;
+    for (uint8_t pd1 = 7; pd1 >= 1; --pd1) {
+      // As in the sdk, postdiv1 >= postdiv2
+      for (uint8_t pd2 = pd1; pd2 >= 1; --pd2) {
+        const double sys_hz = (double)vco / (pd1 * pd2);
+        if (sys_hz < params->sys_min_hz || sys_hz > params->sys_max_hz)
+          continue;
+        clocksolver_result_t trial;
+        if (!clocksolver_solve_divwrap(sys_hz, rate_hz, params, &trial))
+          continue;
+        const bool better =
+            !found || trial.error_ns < result->error_ns - 1e-9 ||
+            (trial.error_ns < result->error_ns + 1e-9 &&
+             sys_hz > result->sys_hz);
+        if (better) {
+          *result = trial;
+          result->vco_hz = (uint32_t)vco;
+          result->fbdiv = (uint16_t)fbdiv;
+          result->postdiv1 = pd1;
+          result->postdiv2 = pd2;
+          found = true;
+        }
+      }
+    }
+  }
+  return found;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,331 @@
+/**
+ * @file dlog.h
+ * @defgroup dlog dlog
+ * @brief Deferred binary logger for real-time paths
+ *
+ * `printf` blocks on USB CDC, which can stall an alarm pool for
+ * milliseconds when it is called from an ISR. Instead, ISRs push a format id
+ * and up to @ref DLOG_MAX_ARGS raw integer arguments into a ring of fixed
+ * size records (see @ref DLOG). The main loop (or core 1) later formats the
+ * records with @ref dlog_flush, or streams them in binary with
+ * @ref dlog_flush_binary so that `tools/dlog_expand.py` can turn the ids back
+ * into text on the host.
+ *
+ * A push is a handful of instructions: claim a slot with interrupts disabled,
+ * copy 5 words, then commit the slot by writing its id. Records that don't
+ * fit in the ring are dropped and counted in @ref dlog_t::dropped.
+ *
+ * @attention
+ * Producers must all run on the same core: the slot claim is only protected
+ * against preemption, not against the other core. The consumer may run on
+ * either core.
+ */
+
+#pragma once
+#include "stdint.h"
+#include "stdio.h"
+
+#if PICO_ON_DEVICE
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include "pico/stdio.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Format strings known to the logger.
+ *
+ * Each entry is `X(id, format)`. Arguments are stored as `uint32_t`, so only
+ * integer conversions (`%u`, `%i`, `%x`, ...) may be used.
+ * `tools/dlog_expand.py` parses this table, so keep one entry per line and
+ * append new entries at the end to keep ids stable.
+ */
+#define DLOG_FORMATS(X)                                                        \
+  X(DLOG_DROPPED, "dlog: dropped %u records\n")                                \
+  X(DLOG_ONEWIRE_OVERFLOW, "Onewire overflow: buffer idx %u\n")                \
+  X(DLOG_ONEWIRE_TELEM_BIT_SET, "WARN: Telemetry bit set, ESC %u not sent\n")  \
+  X(DLOG_ONEWIRE_BUFFER_IDX,                                                   \
+    "WARN: Telemetry buffer idx:\t%u\tBuffer:\t%08x%08x\n")                    \
+  X(DLOG_DSHOT_TELEM_REQ, "Throttle Code: %u\nSet telemetry bit\n")            \
+  X(DLOG_TELEMHEALTH_STALE, "WARN: ESC %u telemetry stale after %u slots\n")   \
+  X(DLOG_TELEMHEALTH_RECOVERED, "ESC %u telemetry recovered (%u resyncs)\n")   \
+  X(DLOG_TELEM_QUEUE_DROPPED, "telem queue: dropped %u samples\n")
+
+#define DLOG_ENUM(id, fmt) id,
+#define DLOG_STRING(id, fmt) fmt,
+
+/// @brief format ids. 0 is reserved to mark an uncommitted ring slot
+enum dlog_fmt_id { DLOG_NONE = 0, DLOG_FORMATS(DLOG_ENUM) DLOG_FMT_COUNT };
+
+static const char *const dlog_fmt_strings[DLOG_FMT_COUNT] = {
+    NULL, DLOG_FORMATS(DLOG_STRING)};
+
+/// Number of raw arguments stored per record
+#define DLOG_MAX_ARGS 3
+
+/// Number of records in the ring. Must be a power of 2
+#ifndef DLOG_RING_SIZE
+#define DLOG_RING_SIZE 64
+#endif
+#define DLOG_RING_MASK (DLOG_RING_SIZE - 1)
+
+/// Sync word prefixed to every record in the binary stream
+#define DLOG_WIRE_SYNC 0xD10Cu
+/// Size of an encoded record: sync + id + seq + timestamp + args
+#define DLOG_WIRE_SIZE (2 + 2 + 2 + 4 + 4 * DLOG_MAX_ARGS)
+
+#if PICO_ON_DEVICE
+#define DLOG_TIMESTAMP_US() time_us_32()
+#define DLOG_BARRIER() __dmb()
+#else
+#define DLOG_TIMESTAMP_US() 0u
+#define DLOG_BARRIER() __sync_synchronize()
+#endif
+
+/**
+ * @brief A single log record
+ *
+ * @param id format id (@ref dlog_fmt_id). 0 => slot is not committed
+ * @param seq low 16 bits of the claim index, so that gaps can be spotted
+ * @param timestamp_us time the record was pushed
+ * @param args raw arguments for the format string
+ */
+typedef struct dlog_record {
+  uint16_t id;
+  uint16_t seq;
+  uint32_t timestamp_us;
+  uint32_t args[DLOG_MAX_ARGS];
+} dlog_record_t;
+
+/**
+ * @brief Ring of log records
+ *
+ * @param head next slot to claim (written by producers)
+ * @param tail next slot to read (written by the consumer)
+ * @param dropped total number of records dropped because the ring was full
+ * @param dropped_reported value of @ref dropped at the last flush
+ * @param ring record storage
+ */
+typedef struct dlog {
+  volatile uint32_t head;
+  volatile uint32_t tail;
+  volatile uint32_t dropped;
+  uint32_t dropped_reported;
+  volatile dlog_record_t ring[DLOG_RING_SIZE];
+} dlog_t;
+
+// Global logger used by the library ISRs
+extern dlog_t dlog;
+
+/**
+ * @brief reset the logger. Must not be called while producers are running
+ *
+ * @param log
+ */
+static inline void dlog_init(dlog_t *const log) {
+  log->head = 0;
+  log->tail = 0;
+  log->dropped = 0;
+  log->dropped_reported = 0;
+  for (size_t i = 0; i < DLOG_RING_SIZE; ++i) {
+    log->ring[i].id = DLOG_NONE;
+  }
+}
+
+/**
+ * @brief push a record into the ring. Safe to call from an ISR
+ *
+ * @param log
+ * @param id format id
+ * @param a0 first argument
+ * @param a1 second argument
+ * @param a2 third argument
+ * @return true if the record was queued, false if it was dropped
+ */
+static inline bool dlog_push(dlog_t *const log, const uint16_t id,
+                             const uint32_t a0, const uint32_t a1,
+                             const uint32_t a2) {
+#if PICO_ON_DEVICE
+  const uint32_t irq_state = save_and_disable_interrupts();
+#endif
+  const uint32_t idx = log->head;
+  const bool full = (idx - log->tail) >= DLOG_RING_SIZE;
+  if (full) {
+    log->dropped++;
+  } else {
+    log->head = idx + 1;
+  }
+#if PICO_ON_DEVICE
+  restore_interrupts(irq_state);
+#endif
+  if (full)
+    return false;
+
+  volatile dlog_record_t *const slot = &log->ring[idx & DLOG_RING_MASK];
+  slot->seq = (uint16_t)idx;
+  slot->timestamp_us = DLOG_TIMESTAMP_US();
+  slot->args[0] = a0;
+  slot->args[1] = a1;
+  slot->args[2] = a2;
+  // Commit the slot only once the payload is visible to the consumer
+  DLOG_BARRIER();
+  slot->id = id;
+  return true;
+}
+
+// Pad missing arguments with 0 so that DLOG takes 0 to 3 arguments
+#define DLOG_PUSH_(id, a0, a1, a2, ...)                                        \
+  dlog_push(&dlog, (id), (uint32_t)(a0), (uint32_t)(a1), (uint32_t)(a2))
+
+/**
+ * @brief log a format id with up to 3 integer arguments to the global logger
+ *
+ * e.g. `DLOG(DLOG_ONEWIRE_OVERFLOW, onewire.parser.buffer_idx);`
+ */
+#define DLOG(...) DLOG_PUSH_(__VA_ARGS__, 0, 0, 0)
+
+/**
+ * @brief pop the oldest committed record
+ *
+ * @param log
+ * @param record output
+ * @return true if a record was read. false if the ring is empty or the
+ * oldest slot has been claimed but not yet committed
+ */
+static inline bool dlog_pop(dlog_t *const log, dlog_record_t *const record) {
+  const uint32_t idx = log->tail;
+  if (idx == log->head)
+    return false;
+  volatile dlog_record_t *const slot = &log->ring[idx & DLOG_RING_MASK];
+  const uint16_t id = slot->id;
+  if (id == DLOG_NONE)
+    return false;
+  DLOG_BARRIER();
+
+  record->id = id;
+  record->seq = slot->seq;
+  record->timestamp_us = slot->timestamp_us;
+  for (size_t i = 0; i < DLOG_MAX_ARGS; ++i) {
+    record->args[i] = slot->args[i];
+  }
+  // Release the slot before handing it back to the producers
+  slot->id = DLOG_NONE;
+  DLOG_BARRIER();
+  log->tail = idx + 1;
+  return true;
+}
+
+/**
+ * @brief return the number of records dropped since the last call,
+ * and mark them as reported
+ *
+ * @param log
+ */
+static inline uint32_t dlog_take_dropped(dlog_t *const log) {
+  const uint32_t dropped = log->dropped;
+  const uint32_t unreported = dropped - log->dropped_reported;
+  log->dropped_reported = dropped;
+  return unreported;
+}
+
+/**
+ * @brief encode a record for the binary stream (little endian)
+ *
+ * Layout: sync (2) | id (2) | seq (2) | timestamp_us (4) | args (4 x 3)
+ *
+ * @param record
+ * @param out buffer of @ref DLOG_WIRE_SIZE bytes
+ */
+static inline void dlog_record_encode(const dlog_record_t *const record,
+                                      uint8_t out[DLOG_WIRE_SIZE]) {
+  const uint32_t words[1 + DLOG_MAX_ARGS] = {
+      record->timestamp_us, record->args[0], record->args[1],
+      record->args[2]};
+  out[0] = DLOG_WIRE_SYNC & 0xff;
+  out[1] = DLOG_WIRE_SYNC >> 8;
+  out[2] = record->id & 0xff;
+  out[3] = record->id >> 8;
+  out[4] = record->seq & 0xff;
+  out[5] = record->seq >> 8;
+  for (size_t w = 0; w < 1 + DLOG_MAX_ARGS; ++w) {
+    for (size_t b = 0; b < 4; ++b) {
+      out[6 + 4 * w + b] = (words[w] >> (8 * b)) & 0xff;
+    }
+  }
+}
+
+/**
+ * @brief print a record as text
+ *
+ * @param record
+ */
+static void dlog_print_record(const dlog_record_t *const record) {
+  if (record->id >= DLOG_FMT_COUNT) {
+    printf("dlog: unknown id %u\n", record->id);
+    return;
+  }
+  printf(dlog_fmt_strings[record->id], record->args[0], record->args[1],
+         record->args[2]);
+}
+
+/**
+ * @brief format and print all pending records (and the drop count).
+ * Call this from the main loop, never from an ISR.
+ *
+ * @param log
+ * @return number of records printed
+ */
+static size_t dlog_flush(dlog_t *const log) {
+  size_t count = 0;
+  dlog_record_t record;
+  while (dlog_pop(log, &record)) {
+    dlog_print_record(&record);
+    ++count;
+  }
+  const uint32_t dropped = dlog_take_dropped(log);
+  if (dropped) {
+    printf(dlog_fmt_strings[DLOG_DROPPED], dropped);
+  }
+  return count;
+}
+
+#if PICO_ON_DEVICE
+/**
+ * @brief stream all pending records (and the drop count) in binary.
+ * Decode the output on the host with `tools/dlog_expand.py`.
+ *
+ * @param log
+ * @return number of records written
+ */
+static size_t dlog_flush_binary(dlog_t *const log) {
+  size_t count = 0;
+  dlog_record_t record;
+  uint8_t wire[DLOG_WIRE_SIZE];
+  while (dlog_pop(log, &record)) {
+    dlog_record_encode(&record, wire);
+    for (size_t i = 0; i < DLOG_WIRE_SIZE; ++i) {
+      putchar_raw(wire[i]);
+    }
+    ++count;
+  }
+  const uint32_t dropped = dlog_take_dropped(log);
+  if (dropped) {
+    const dlog_record_t drop_record = {.id = DLOG_DROPPED,
+                                       .seq = 0,
+                                       .timestamp_us = DLOG_TIMESTAMP_US(),
+                                       .args = {dropped, 0, 0}};
+    dlog_record_encode(&drop_record, wire);
+    for (size_t i = 0; i < DLOG_WIRE_SIZE; ++i) {
+      putchar_raw(wire[i]);
+    }
+  }
+  return count;
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
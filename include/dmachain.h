@@ -0,0 +1,217 @@
+/**
+ * @file dmachain.h
+ * @defgroup dmachain dmachain
+ * @brief Control blocks that let two dma channels send every motor's packet
+ *
+ * One dma channel per motor runs out quickly (the rp2040 has 12, shared
+ * with the uart and the application). Instead, a data channel sends the
+ * packets of all motors one after the other, reprogrammed between motors
+ * by a control channel, from a list of precomputed control blocks:
+ *
+ * - each block holds the data channel's alias 1 registers: ctrl (with the
+ *   motor's pwm wrap dreq), read address, write address (pwm counter
+ *   compare) and transfer count, which triggers the channel
+ * - a motor has two blocks: its frame (packet buffer), then its pause,
+ *   read from a zero tail shared by every motor. Only the pause length
+ *   changes with the speed
+ * - the control channel copies one block (4 words) into those registers,
+ *   its write address wrapping around a 16 byte ring
+ * - the data channel chains back to the control channel once a block is
+ *   sent, which loads the next one
+ * - a null block (transfer count 0 written to the trigger register) ends
+ *   the chain, and raises the data channel's irq
+ *   (@ref DMACHAIN_CTRL_IRQ_QUIET)
+ *
+ * Pulses are 16 bit transfers (see packet.h). So per frame, the cpu only
+ * composes the packets, updates the pause lengths if they changed, and
+ * restarts the control channel at the first block. The packets go out in
+ * turn: a round takes the sum of the packet lengths.
+ *
+ * Addresses are 32 bit bus addresses, so the blocks can be checked on the
+ * host against a model of the dma engine (test/dma_model.hpp).
+ */
+
+#pragma once
+#include "stdbool.h"
+#include "stdint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Most motors in a chain: one per pwm slice
+#ifndef DMACHAIN_MAX_MOTORS
+#define DMACHAIN_MAX_MOTORS 8
+#endif
+/// Control blocks of a motor: frame, then pause
+#define DMACHAIN_MOTOR_BLOCKS 2
+
+/// @name CTRL register fields of a dma channel (rp2040 datasheet 2.5.7)
+/// @{
+#define DMACHAIN_CTRL_EN (1u << 0)
+#define DMACHAIN_CTRL_DATA_SIZE_16 (1u << 2)
+#define DMACHAIN_CTRL_DATA_SIZE_32 (2u << 2)
+#define DMACHAIN_CTRL_DATA_SIZE_LSB 2
+#define DMACHAIN_CTRL_INCR_READ (1u << 4)
+#define DMACHAIN_CTRL_INCR_WRITE (1u << 5)
+#define DMACHAIN_CTRL_RING_SIZE_LSB 6
+#define DMACHAIN_CTRL_RING_SEL (1u << 10)
+#define DMACHAIN_CTRL_CHAIN_TO_LSB 11
+#define DMACHAIN_CTRL_TREQ_SEL_LSB 15
+#define DMACHAIN_CTRL_IRQ_QUIET (1u << 21)
+/// @}
+/// Unpaced transfers
+#define DMACHAIN_TREQ_PERMANENT 0x3f
+/// Bytes of a control block, which the control channel's write ring spans
+#define DMACHAIN_BLOCK_BYTES 16
+#define DMACHAIN_BLOCK_RING_BITS 4
+
+/**
+ * @brief one control block: the data channel's alias 1 registers
+ * (CTRL, READ_ADDR, WRITE_ADDR, TRANS_COUNT_TRIG), in that order
+ */
+typedef struct dmachain_block {
+  uint32_t ctrl;
+  uint32_t read_addr;
+  uint32_t write_addr;
+  uint32_t count;
+} dmachain_block_t;
+
+/**
+ * @brief control blocks of a chain
+ *
+ * @param blocks two per motor (frame and pause), then the null block.
+ * Aligned, so that a block never straddles the control channel's write ring
+ * @param motors
+ * @param data_channel
+ * @param ctrl_channel
+ */
+typedef struct dmachain {
+  dmachain_block_t blocks[DMACHAIN_MOTOR_BLOCKS * DMACHAIN_MAX_MOTORS + 1]
+      __attribute__((aligned(DMACHAIN_BLOCK_BYTES)));
+  uint8_t motors;
+  uint8_t data_channel;
+  uint8_t ctrl_channel;
+} dmachain_t;
+
+/**
+ * @brief ctrl of the data channel for one motor: 16 bit pulses from
+ * consecutive addresses to a fixed register, paced by \a dreq, chained
+ * back to the control channel
+ */
+static inline uint32_t dmachain_data_ctrl(const dmachain_t *const chain,
+                                          const uint32_t dreq) {
+  return DMACHAIN_CTRL_EN | DMACHAIN_CTRL_DATA_SIZE_16 |
+         DMACHAIN_CTRL_INCR_READ |
+         (uint32_t)chain->ctrl_channel << DMACHAIN_CTRL_CHAIN_TO_LSB |
+         dreq << DMACHAIN_CTRL_TREQ_SEL_LSB | DMACHAIN_CTRL_IRQ_QUIET;
+}
+
+/**
+ * @brief ctrl of the control channel: unpaced 32 bit copies into the data
+ * channel's alias 1 registers, through a 16 byte write ring, not chained
+ * (a channel chained to itself doesn't chain), without an irq per block
+ */
+static inline uint32_t dmachain_ctrl_ctrl(const dmachain_t *const chain) {
+  return DMACHAIN_CTRL_EN | DMACHAIN_CTRL_DATA_SIZE_32 |
+         DMACHAIN_CTRL_INCR_READ | DMACHAIN_CTRL_INCR_WRITE |
+         DMACHAIN_BLOCK_RING_BITS << DMACHAIN_CTRL_RING_SIZE_LSB |
+         DMACHAIN_CTRL_RING_SEL |
+         (uint32_t)chain->ctrl_channel << DMACHAIN_CTRL_CHAIN_TO_LSB |
+         DMACHAIN_TREQ_PERMANENT << DMACHAIN_CTRL_TREQ_SEL_LSB |
+         DMACHAIN_CTRL_IRQ_QUIET;
+}
+
+/**
+ * @brief the block that ends the chain: a null trigger. It keeps
+ * IRQ_QUIET in the ctrl, as that is what raises the irq
+ */
+static inline dmachain_block_t
+dmachain_null_block(const dmachain_t *const chain) {
+  const dmachain_block_t block = {
+      dmachain_data_ctrl(chain, DMACHAIN_TREQ_PERMANENT), 0, 0, 0};
+  return block;
+}
+
+/**
+ * @brief start an empty chain
+ *
+ * @param chain
+ * @param data_channel
+ * @param ctrl_channel
+ */
+static inline void dmachain_init(dmachain_t *const chain,
+                                 const uint8_t data_channel,
+                                 const uint8_t ctrl_channel) {
+  chain->motors = 0;
+  chain->data_channel = data_channel;
+  chain->ctrl_channel = ctrl_channel;
+  chain->blocks[0] = dmachain_null_block(chain);
+}
+
+/**
+ * @brief append a motor
+ *
+ * @param chain
+ * @param frame_addr bus address of the packet buffer
+ * @param write_addr bus address of the pwm slice counter compare
+ * @param frame_count pulses of the frame
+ * @param tail_addr bus address of the shared zero tail
+ * @param tail_count pulses of the pause
+ * @param dreq pwm wrap dreq of the slice
+ * @return motor index, or -1 if the chain is full or a count is 0 (a null
+ * trigger would end the chain)
+ */
+static inline int dmachain_add(dmachain_t *const chain,
+                               const uint32_t frame_addr,
+                               const uint32_t write_addr,
+                               const uint32_t frame_count,
+                               const uint32_t tail_addr,
+                               const uint32_t tail_count,
+                               const uint32_t dreq) {
+  if (chain->motors >= DMACHAIN_MAX_MOTORS || !frame_count || !tail_count)
+    return -1;
+  const int idx = chain->motors++;
+  const uint32_t ctrl = dmachain_data_ctrl(chain, dreq);
+  dmachain_block_t *const blocks =
+      &chain->blocks[DMACHAIN_MOTOR_BLOCKS * idx];
+  const dmachain_block_t frame = {ctrl, frame_addr, write_addr, frame_count};
+  const dmachain_block_t tail = {ctrl, tail_addr, write_addr, tail_count};
+  blocks[0] = frame;
+  blocks[1] = tail;
+  blocks[2] = dmachain_null_block(chain);
+  return idx;
+}
+
+/**
+ * @brief update the pause of a motor (e.g. after a speed change)
+ *
+ * Only call this while the chain is idle.
+ *
+ * @param chain
+ * @param motor
+ * @param tail_count pulses of the pause, at least 1
+ */
+static inline void dmachain_set_tail(dmachain_t *const chain,
+                                     const int motor,
+                                     const uint32_t tail_count) {
+  chain->blocks[DMACHAIN_MOTOR_BLOCKS * motor + 1].count = tail_count;
+}
+
+/// @brief words the control channel copies per block
+static inline uint32_t dmachain_ctrl_count(void) {
+  return DMACHAIN_BLOCK_BYTES / sizeof(uint32_t);
+}
+
+/// @brief total pulses sent by the data channel in one round
+static inline uint32_t dmachain_pulses(const dmachain_t *const chain) {
+  uint32_t pulses = 0;
+  for (int b = 0; b < DMACHAIN_MOTOR_BLOCKS * chain->motors; ++b) {
+    pulses += chain->blocks[b].count;
+  }
+  return pulses;
+}
+
+#ifdef __cplusplus
+}
+#endif
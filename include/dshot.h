@@ -10,13 +10,24 @@
 #include "pico/stdlib.h"
 #include "stdint.h"
 #include "stdio.h"
+#include "string.h"
 
+#include "dshotduty.h"
+#include "dshotspeed.h"
 #include "packet.h"
+#include "rtpool.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * @brief packet interval that sends packets back to back: the next packet
+ * is composed and sent from the dma completion irq, so the gap between
+ * frames is the pause (see @ref dshot_set_pause) plus the irq latency
+ */
+#define DSHOT_CONTINUOUS 0
+
 enum dshot_code {
   DSHOT_DISARM = 0,
   DSHOT_ZERO_THROTTLE = 48,
@@ -24,35 +35,115 @@ enum dshot_code {
   DSHOT_MAX_THROTTLE = 2047 // 2^11 - 1
 };
 
+/// Speed tables shared between motors (see @ref dshot_speed_table_share):
+/// one per distinct pause in use, plus one to change the pause of a motor
+/// that is alone on its table
+#ifndef DSHOT_SPEED_TABLES
+#define DSHOT_SPEED_TABLES 2
+#endif
+
 /**
  * @brief config used to setup hardware to send dshot packets
  * @ingroup dshot
  *
- * @param dshot_speed_khz
- * @param esc_gpio_pin GPIO pin connected to ESC
- * @param pwm_conf
+ * The fields used at every frame come first, the configuration after.
+ *
+ * @param packet dshot packet config
+ * @param packet_length pulses sent per packet: frame + pause
+ * @param pending_speed speed to switch to at the next frame boundary
+ * (@ref DSHOT_SPEEDS => none, see @ref dshot_set_speed)
  * @param dma_channel
+ * @param esc_gpio_pin GPIO pin connected to ESC
+ * @param frame_hook optional callback run at every frame boundary, before
+ * the packet is composed (see @ref dshot_set_frame_hook)
+ * @param frame_hook_data user data passed to @ref frame_hook
+ * @param pending_duty duty to switch to at the next frame boundary, packed
+ * with @ref dshot_duty_pack (0 => none)
+ * @param telem_requests number of frames sent with the telemetry bit set
+ * @param telem_request_us time the last of those frames was sent
+ * @param telem_request_code throttle code of that frame
+ * @param pwm_top pwm wrap
+ * @param pwm_div pwm divider, 8.4 fixed point
+ * @param duty T1H / T0H of this motor (see @ref dshot_set_duty)
+ * @param speeds pwm settings of the standard speeds, computed at init.
+ * Shared with the motors that have the same pause (see
+ * @ref dshot_speed_table_share), or a table in flash (see dshotboot.h)
+ * @param dshot_speed_khz
+ * @param pause_ns pause after each frame (see @ref dshot_set_pause)
+ * @param packet_interval_us interval of @ref send_packet_rt, or
+ * @ref DSHOT_CONTINUOUS
  * @param dma_config pico dma config
- * @param packet dshot packet config
- * @param send_packet_rt repeating timer config to send dshot packets regularly
  * @param send_packet_rt_state true if repeating timer was setup succesfully
- *
- * TODO: should the configs be pointers?
- * e.g. dshot_packet_t *const dshot_pckt?
+ * @param send_packet_rt repeating timer config to send dshot packets regularly
  */
 typedef struct dshot_config {
+  // Hot: every frame
+  dshot_packet_t packet;
+  volatile uint8_t packet_length;
+  volatile uint8_t pending_speed;
+  int8_t dma_channel;
+  uint8_t esc_gpio_pin;
+  dshot_frame_hook_t frame_hook;
+  void *frame_hook_data;
+  volatile uint32_t pending_duty;
+  volatile uint32_t telem_requests;
+  volatile uint32_t telem_request_us;
+  volatile uint16_t telem_request_code;
+  // Cold: configuration
+  uint16_t pwm_top;
+  uint16_t pwm_div;
+  dshot_duty_t duty;
+  const dshot_speed_entry_t *speeds;
   float dshot_speed_khz;
-  uint esc_gpio_pin;
-  pwm_config pwm_conf;
-  int dma_channel;
+  uint32_t pause_ns;
+  long int packet_interval_us;
   dma_channel_config dma_config;
-  dshot_packet_t packet;
-  repeating_timer_t send_packet_rt;
   bool send_packet_rt_state;
+  repeating_timer_t send_packet_rt;
 } dshot_config;
 
+/**
+ * @brief zero pulses that end every packet, shared by all motors: a
+ * packet buffer only holds the first pause pulse, dma reads the rest from
+ * here (@ref DSHOT_PAUSE_MAX_PULSES at most). In sram, as dma reads it at
+ * every frame
+ */
+extern uint16_t dshot_pause_tail[DSHOT_PAUSE_MAX_PULSES];
+
+/**
+ * @brief find or store a speed table in the shared tables, and take a
+ * reference to it
+ *
+ * Tables are compared by value: there is one per distinct pause (and sys
+ * clock) in use, up to @ref DSHOT_SPEED_TABLES. A table is free again once
+ * its last motor has released it (see @ref dshot_speed_table_release).
+ *
+ * @param table e.g. computed by @ref dshot_speed_table_init
+ * @return the shared copy, or NULL if every table is taken
+ */
+const dshot_speed_entry_t *
+dshot_speed_table_share(const dshot_speed_entry_t table[DSHOT_SPEEDS]);
+
+/**
+ * @brief drop a reference taken by @ref dshot_speed_table_share
+ *
+ * Only once no motor points at the table any more: it may be overwritten
+ * by the next share.
+ *
+ * @param table a shared table. Others (e.g. in flash) are ignored
+ */
+void dshot_speed_table_release(const dshot_speed_entry_t *table);
+
 void dshot_send_packet(dshot_config *dshot, bool debug);
 
+/**
+ * @brief send packets back to back from the dma completion irq
+ * (@ref DSHOT_CONTINUOUS), starting with the first one
+ *
+ * @param dshot
+ */
+void dshot_continuous_configure(dshot_config *dshot);
+
 /**
  * @brief isr to send dshot packet over dma
  *
@@ -61,6 +152,7 @@ void dshot_send_packet(dshot_config *dshot, bool debug);
  * @return \a true, so that timer repeats
  */
 static inline bool dshot_repeating_send_packet(repeating_timer_t *rt) {
+  rtpool_entry(rt, RTPOOL_FRAME);
   dshot_config *dshot = (dshot_config *)(rt->user_data);
   dshot_send_packet(dshot, false);
   return true;
@@ -76,8 +168,8 @@ static inline bool dshot_repeating_send_packet(repeating_timer_t *rt) {
  * The PWM counter will run at clk_sys / div
  * @param max highest value PWM counter will reach before restarting
  * @param required TODO: assert if period is not attainable.
- * Currently we just get close to it, which is good enough for dshot
- * values between 150 and 1200 (incl).
+ * Currently we just get close to it: the nearest wrap at the given clock.
+ * See clocksolver.h to pick a clock that hits it (e.g. DShot2400).
  *
  * @attention
  * The maximum value of period is:
@@ -93,12 +185,13 @@ static inline void pwm_period_to_div_wrap(const float period, float *const div,
           max_div * max_wrap);
   }
 
-  if (period <= max_wrap) {
-    *wrap = period;
+  // The counter counts 0 - wrap, so a period is wrap + 1 counts
+  if (period <= max_wrap + 1) {
+    *wrap = (uint16_t)(period + 0.5f) - 1;
     *div = 1.0f;
   } else {
     *wrap = max_wrap;
-    *div = period / *wrap;
+    *div = period / (max_wrap + 1);
   }
 }
 
@@ -118,10 +211,12 @@ static inline void dshot_pwm_configure(dshot_config *const dshot,
   uint16_t pwm_wrap;
   pwm_period_to_div_wrap(pwm_period, &pwm_div, &pwm_wrap);
 
-  dshot->pwm_conf = pwm_get_default_config();
-  pwm_config_set_wrap(&dshot->pwm_conf, pwm_wrap);
-  pwm_config_set_clkdiv(&dshot->pwm_conf, pwm_div);
-  pwm_init(pwm_gpio_to_slice_num(dshot->esc_gpio_pin), &dshot->pwm_conf, true);
+  pwm_config pwm_conf = pwm_get_default_config();
+  pwm_config_set_wrap(&pwm_conf, pwm_wrap);
+  pwm_config_set_clkdiv(&pwm_conf, pwm_div);
+  pwm_init(pwm_gpio_to_slice_num(dshot->esc_gpio_pin), &pwm_conf, true);
+  dshot->pwm_top = (uint16_t)pwm_conf.top;
+  dshot->pwm_div = (uint16_t)pwm_conf.div;
 
   pwm_set_gpio_level(dshot->esc_gpio_pin, 0); // default 0 duty cycle
 }
@@ -133,18 +228,20 @@ static inline void dshot_pwm_configure(dshot_config *const dshot,
  *
  * @attention
  * counter compare is 32 bits (16 bits for each pwm channel)
- * dma is setup to overwrite all 32 bits of cc,
- * instead of just the cc for the corresponding channel.
+ * dma is setup to write 16 bit pulses, which the rp2040 replicates across
+ * all 32 bits of cc: the motor's channel gets its pulse, and so does the
+ * other channel of the slice (if its gpio is set to pwm, it outputs a
+ * copy of the packet).
  * Unfortunately, this makes one channel redundant.
  * Ideally we want dma to be capable of smth like \a hw_write_masked().
- * The dma read and write addresses are set in @ref dshot_rt_configure
+ * The dma read and write addresses are set in @ref dshot_send_packet
  */
 static inline void dshot_dma_configure(dshot_config *const dshot) {
-  dshot->dma_channel = dma_claim_unused_channel(true);
+  dshot->dma_channel = (int8_t)dma_claim_unused_channel(true);
   dshot->dma_config = dma_channel_get_default_config(dshot->dma_channel);
   // increment read address to read from next element in packet_buffer array
   channel_config_set_read_increment(&dshot->dma_config, true);
-  channel_config_set_transfer_data_size(&dshot->dma_config, DMA_SIZE_32);
+  channel_config_set_transfer_data_size(&dshot->dma_config, DMA_SIZE_16);
   // Writing to same address (pwm slice counter compare register)
   // Note that the address is set later
   channel_config_set_write_increment(&dshot->dma_config, false);
@@ -156,26 +253,25 @@ static inline void dshot_dma_configure(dshot_config *const dshot) {
 /**
  * @brief setup packet config for dshot (see @ref dshot_config::packet)
  *
- * @param dshot ptr to dshot config. must have @ref dshot_config::esc_gpio_pin
- * and @ref dshot_config::pwm_conf configured
+ * @param dshot ptr to dshot config. must have @ref dshot_config::pwm_top
+ * and @ref dshot_config::duty configured
  *
  * @attention
  * There are two 16 bit timers stored in a 32 bit word,
  * corresponding to two separate pwm channels.
- * This fn shifts the packet values based on the pwm channel
+ * The pulses are 16 bit writes, which land in both, so they aren't
+ * shifted to the pwm channel (see @ref dshot_dma_configure)
  */
 static inline void dshot_packet_configure(dshot_config *const dshot) {
-  const uint packet_shift = pwm_gpio_to_channel(dshot->esc_gpio_pin)
-                                ? PWM_CH0_CC_B_LSB
-                                : PWM_CH0_CC_A_LSB;
-  const uint32_t pulse_period = dshot->pwm_conf.top;
-
-  const dshot_packet_t pckt = {
-      .packet_buffer = {0},
-      .throttle_code = 0,
-      .telemetry = 0,
-      .pulse_high = (uint32_t)(0.75 * pulse_period) << packet_shift,
-      .pulse_low = (uint32_t)(0.37 * pulse_period) << packet_shift};
+  uint16_t pulse_high;
+  uint16_t pulse_low;
+  dshot_duty_pulses(&dshot->duty, dshot->pwm_top, &pulse_high, &pulse_low);
+
+  const dshot_packet_t pckt = {.packet_buffer = {0},
+                               .throttle_code = 0,
+                               .telemetry = 0,
+                               .pulse_high = pulse_high,
+                               .pulse_low = pulse_low};
 
   dshot->packet = pckt;
 }
@@ -185,15 +281,24 @@ static inline void dshot_packet_configure(dshot_config *const dshot) {
  * Call this function after configuring pwm, dma, packet
  *
  * @param dshot ptr to dshot config
+ * @param packet_interval in us, or @ref DSHOT_CONTINUOUS
+ * @param pool
  */
 static inline void dshot_rt_configure(dshot_config *const dshot,
                                       const long int packet_interval,
                                       alarm_pool_t *const pool) {
+  dshot->packet_interval_us = packet_interval;
+  if (packet_interval == DSHOT_CONTINUOUS) {
+    dshot->send_packet_rt_state = false;
+    dshot_continuous_configure(dshot);
+    return;
+  }
 
   // Ensure packet_length (bits) < packet_interval (us) x dshot_speed (MHz)
-  if (dshot_packet_length * 1000 > packet_interval * dshot->dshot_speed_khz) {
+  if (dshot->packet_length * 1000 >
+      packet_interval * dshot->dshot_speed_khz) {
     const int64_t min_pckt_interval =
-        dshot_packet_length * 1000 / dshot->dshot_speed_khz;
+        dshot->packet_length * 1000 / dshot->dshot_speed_khz;
     panic("packet_interval of %d is lower than min: %d\n", packet_interval,
           min_pckt_interval);
   }
@@ -203,6 +308,66 @@ static inline void dshot_rt_configure(dshot_config *const dshot,
       &dshot->send_packet_rt);
 }
 
+/**
+ * @brief reset the general config of one motor
+ *
+ * @param dshot ptr to dshot config
+ * @param dshot_speed_khz
+ * @param esc_gpio_pin
+ */
+static inline void dshot_motor_defaults(dshot_config *const dshot,
+                                        const float dshot_speed_khz,
+                                        const uint esc_gpio_pin) {
+  dshot->dshot_speed_khz = dshot_speed_khz;
+  dshot->esc_gpio_pin = (uint8_t)esc_gpio_pin;
+  dshot->dma_channel = -1;
+  dshot->frame_hook = NULL;
+  dshot->frame_hook_data = NULL;
+  dshot->telem_requests = 0;
+  dshot->telem_request_us = 0;
+  dshot->telem_request_code = 0;
+  dshot->duty = dshot_duty_default;
+  dshot->pending_duty = 0;
+  dshot->pause_ns = DSHOT_PAUSE_NS_DEFAULT;
+  dshot->pending_speed = DSHOT_SPEEDS;
+}
+
+/**
+ * @brief configure the pwm and packet of one motor, without a dma channel
+ * or repeating timer (see @ref dshot_config_init, or dshotchain.h to share
+ * them between motors)
+ *
+ * @param dshot ptr to dshot config. All data will be overwritten
+ * @param dshot_speed_khz
+ * @param esc_gpio_pin
+ */
+static void dshot_motor_configure(dshot_config *const dshot,
+                                  const float dshot_speed_khz,
+                                  const uint esc_gpio_pin) {
+  // General config
+  dshot_motor_defaults(dshot, dshot_speed_khz, esc_gpio_pin);
+  const uint32_t pause_pulses =
+      dshot_pause_pulses(dshot->pause_ns, (uint16_t)dshot_speed_khz);
+  dshot->packet_length =
+      DSHOT_FRAME_SIZE + (pause_pulses < DSHOT_PAUSE_MAX_PULSES
+                              ? pause_pulses
+                              : DSHOT_PAUSE_MAX_PULSES);
+
+  const uint32_t mcu_freq_khz =
+      frequency_count_khz(CLOCKS_FC0_SRC_VALUE_CLK_SYS);
+  // Precompute every standard speed, so dshot_set_speed needn't do it
+  dshot_speed_entry_t speeds[DSHOT_SPEEDS];
+  dshot_speed_table_init(speeds, mcu_freq_khz, dshot->pause_ns);
+  dshot->speeds = dshot_speed_table_share(speeds);
+  if (!dshot->speeds)
+    panic("no free speed table, raise DSHOT_SPEED_TABLES\n");
+
+  const float pwm_period = mcu_freq_khz / dshot->dshot_speed_khz;
+
+  dshot_pwm_configure(dshot, pwm_period);
+  dshot_packet_configure(dshot);
+}
+
 /**
  * @brief initialise dshot config
  *
@@ -210,14 +375,14 @@ static inline void dshot_rt_configure(dshot_config *const dshot,
  * @param dshot_speed_khz
  * @param esc_gpio_pin
  * @param packet_interval maximum time between start of sending packets (in
- * micro secs)
+ * micro secs), or @ref DSHOT_CONTINUOUS to send them back to back
  * @param pool alarm pool to add the repeating timer to send dshot packets
  * regularly
  *
  *  @attention
- *  dShot 150 sets a lower limit on @a packet_interval
- *  20 bits / 150 kHz = 2/15 ms > 133 us
- *  Hence we can use a minimum of 7 kHz update rate
+ *  The packet length sets a lower limit on @a packet_interval, e.g.
+ *  DShot150 with the default 2 us pause: 17 bits / 150 kHz = 113 us.
+ *  See @ref dshot_speed_print_table for each speed
  *
  * TODO: check if long int is the correct definition for int64_t
  * for some reason int64_t doesn't work in C
@@ -227,23 +392,226 @@ static void dshot_config_init(dshot_config *const dshot,
                               const uint esc_gpio_pin,
                               const long int packet_interval,
                               alarm_pool_t *const pool) {
-  // General config
-  dshot->dshot_speed_khz = dshot_speed_khz;
-  dshot->esc_gpio_pin = esc_gpio_pin;
+  // configure pwm and packet, then dma and repeating timer
+  dshot_motor_configure(dshot, dshot_speed_khz, esc_gpio_pin);
+  dshot_dma_configure(dshot);
+  dshot_rt_configure(dshot, packet_interval, pool);
+}
 
-  const uint32_t mcu_freq_khz =
-      frequency_count_khz(CLOCKS_FC0_SRC_VALUE_CLK_SYS);
+/**
+ * @brief register a callback to run at every frame boundary
+ * (i.e. once the previous packet has been sent, before the next is composed)
+ *
+ * This is where setpoints should be applied, so that a packet never mixes
+ * two updates. Only one hook is supported per dshot config.
+ *
+ * @param dshot
+ * @param hook callback. NULL removes the hook
+ * @param data user data passed to the hook
+ */
+static inline void dshot_set_frame_hook(dshot_config *const dshot,
+                                        const dshot_frame_hook_t hook,
+                                        void *const data) {
+  dshot->frame_hook = NULL;
+  dshot->frame_hook_data = data;
+  dshot->frame_hook = hook;
+}
 
-  const float pwm_period = mcu_freq_khz / dshot->dshot_speed_khz;
+/**
+ * @brief switch speed at the next frame boundary
+ *
+ * The pwm divider, wrap and pulse widths are swapped in by
+ * @ref dshot_send_packet once the previous packet has been sent, while
+ * the line is low. The packet interval is kept, so it must still fit a
+ * packet at the new speed.
+ *
+ * @param dshot
+ * @param speed
+ * @return false if the speed is invalid, can't hold the pause (see
+ * @ref dshot_set_pause) or a packet doesn't fit in the packet interval (the
+ * speed is left unchanged)
+ */
+static inline bool dshot_set_speed(dshot_config *const dshot,
+                                   const enum dshot_speed speed) {
+  if (speed >= DSHOT_SPEEDS ||
+      !dshot_speed_entry_available(&dshot->speeds[speed]))
+    return false;
+  if (dshot->packet_interval_us != DSHOT_CONTINUOUS &&
+      !dshot_speed_interval_valid(&dshot->speeds[speed],
+                                  dshot->packet_interval_us))
+    return false;
+  dshot->pending_speed = speed;
+  return true;
+}
 
-  // configure pwm, dma, packet, repeating timer
-  dshot_pwm_configure(dshot, pwm_period);
-  dshot_dma_configure(dshot);
+/**
+ * @brief apply a precomputed speed to the pwm slice and packet.
+ * Only call this between packets (see @ref dshot_set_speed)
+ *
+ * @param dshot
+ * @param entry
+ */
+static inline void dshot_apply_speed(dshot_config *const dshot,
+                                     const dshot_speed_entry_t *const entry) {
+  const uint slice = pwm_gpio_to_slice_num(dshot->esc_gpio_pin);
+  pwm_set_clkdiv_int_frac(slice, entry->div >> DSHOT_SPEED_DIV_FRAC_BITS,
+                          entry->div & ((1u << DSHOT_SPEED_DIV_FRAC_BITS) - 1));
+  pwm_set_wrap(slice, entry->top);
+  dshot->pwm_div = entry->div;
+  dshot->pwm_top = entry->top;
+  uint16_t pulse_high;
+  uint16_t pulse_low;
+  // Keep the motor's duty if it still resolves at this speed
+  if (!dshot_duty_pulses(&dshot->duty, entry->top, &pulse_high, &pulse_low)) {
+    dshot->duty = dshot_duty_default;
+    pulse_high = entry->pulse_high;
+    pulse_low = entry->pulse_low;
+  }
+  dshot->packet.pulse_high = pulse_high;
+  dshot->packet.pulse_low = pulse_low;
+  dshot->packet_length = DSHOT_FRAME_SIZE + entry->pause_pulses;
+  dshot->dshot_speed_khz = entry->speed_khz;
+}
+
+/**
+ * @brief configure the pwm and packet of one motor from a precomputed speed
+ * table (e.g. a boot config, see dshotboot.h): no clock measurement or
+ * float maths
+ *
+ * @param dshot ptr to dshot config. All data will be overwritten
+ * @param table speed table computed at the current sys clock. Used in
+ * place, not copied: it must outlive the motor
+ * @param speed
+ * @param pause_ns pause the table was computed with
+ * @param duty T1H / T0H, replaced by the default if it doesn't resolve
+ * @param esc_gpio_pin
+ */
+static inline void
+dshot_motor_configure_table(dshot_config *const dshot,
+                            const dshot_speed_entry_t table[DSHOT_SPEEDS],
+                            const enum dshot_speed speed,
+                            const uint32_t pause_ns,
+                            const dshot_duty_t *const duty,
+                            const uint esc_gpio_pin) {
+  dshot_motor_defaults(dshot, table[speed].speed_khz, esc_gpio_pin);
+  dshot->speeds = table;
+  dshot->pause_ns = pause_ns;
+  dshot->duty = *duty;
+
+  gpio_set_function(esc_gpio_pin, GPIO_FUNC_PWM);
+  pwm_config pwm_conf = pwm_get_default_config();
+  pwm_init(pwm_gpio_to_slice_num(esc_gpio_pin), &pwm_conf, true);
+  pwm_set_gpio_level(esc_gpio_pin, 0);
+  dshot->pwm_top = (uint16_t)pwm_conf.top;
   dshot_packet_configure(dshot);
-  dshot_rt_configure(dshot, packet_interval, pool);
+  // Divider, wrap, pulses and packet length
+  dshot_apply_speed(dshot, &dshot->speeds[speed]);
+}
+
+/**
+ * @brief set the pause after each frame, in time
+ *
+ * The pause is rounded up to whole zero duty pulses at each speed (see
+ * dshotspeed.h). With a repeating timer, it only sets the shortest packet
+ * interval: the line stays low until the next packet anyway. With
+ * @ref DSHOT_CONTINUOUS, it is the gap between frames.
+ *
+ * Only the current speed (and a pending one) must hold the pause. Faster
+ * speeds it needs more than @ref DSHOT_PAUSE_MAX_PULSES at are unavailable
+ * to @ref dshot_set_speed until the pause is shortened again.
+ *
+ * @param dshot
+ * @param pause_ns e.g. @ref DSHOT_PAUSE_NS_DEFAULT
+ * The motor moves to the shared speed table of the new pause (see
+ * @ref dshot_speed_table_share), and releases its old one.
+ *
+ * @return false if the pause needs more than @ref DSHOT_PAUSE_MAX_PULSES
+ * at the current or pending speed, a packet no longer fits in the packet
+ * interval at the current speed, or every shared table is taken (the
+ * pause is left unchanged)
+ */
+static inline bool dshot_set_pause(dshot_config *const dshot,
+                                   const uint32_t pause_ns) {
+  const uint16_t speed_khz = (uint16_t)dshot->dshot_speed_khz;
+  const uint32_t pulses = dshot_pause_pulses(pause_ns, speed_khz);
+  const uint32_t length = DSHOT_FRAME_SIZE + pulses;
+  if (pulses > DSHOT_PAUSE_MAX_PULSES)
+    return false;
+  if (dshot->packet_interval_us != DSHOT_CONTINUOUS &&
+      length * 1000 > dshot->packet_interval_us * speed_khz)
+    return false;
+  dshot_speed_entry_t speeds[DSHOT_SPEEDS];
+  memcpy(speeds, dshot->speeds, sizeof(speeds));
+  for (int s = 0; s < DSHOT_SPEEDS; ++s) {
+    dshot_speed_entry_set_pause(&speeds[s], pause_ns);
+  }
+  // The send isr applies a pending speed from the new table
+  const uint8_t pending = dshot->pending_speed;
+  if (pending < DSHOT_SPEEDS &&
+      !dshot_speed_entry_available(&speeds[pending]))
+    return false;
+  const dshot_speed_entry_t *const shared = dshot_speed_table_share(speeds);
+  if (!shared)
+    return false;
+  const dshot_speed_entry_t *const old = dshot->speeds;
+  // A single word: the send isr sees either table
+  dshot->speeds = shared;
+  dshot->pause_ns = pause_ns;
+  // A single byte: the send isr sees either length
+  dshot->packet_length = (uint8_t)length;
+  // Not before the swap: the table may be overwritten once released
+  dshot_speed_table_release(old);
+  return true;
+}
+
+/**
+ * @brief switch T1H / T0H at the next frame boundary
+ *
+ * The duty is checked against the pwm wrap of the current speed, or of
+ * the pending one (see @ref dshot_set_speed). It is kept across speed
+ * changes, unless it doesn't resolve at the new speed, in which case the
+ * motor falls back to @ref dshot_duty_default.
+ *
+ * @param dshot
+ * @param duty
+ * @return false if the pulses would be indistinguishable at this speed
+ * (the duty is left unchanged)
+ */
+static inline bool dshot_set_duty(dshot_config *const dshot,
+                                  const dshot_duty_t duty) {
+  const uint8_t speed = dshot->pending_speed;
+  const uint16_t top =
+      speed < DSHOT_SPEEDS ? dshot->speeds[speed].top : dshot->pwm_top;
+  uint16_t pulse_high;
+  uint16_t pulse_low;
+  if (!dshot_duty_pulses(&duty, top, &pulse_high, &pulse_low))
+    return false;
+  dshot->pending_duty = dshot_duty_pack(&duty);
+  return true;
+}
+
+/**
+ * @brief apply a duty to the packet. Only call this between packets
+ * (see @ref dshot_set_duty)
+ *
+ * @param dshot
+ * @param duty
+ * @return false if the duty doesn't resolve at the current speed (the
+ * pulses are left unchanged)
+ */
+static inline bool dshot_apply_duty(dshot_config *const dshot,
+                                    const dshot_duty_t *const duty) {
+  uint16_t pulse_high;
+  uint16_t pulse_low;
+  if (!dshot_duty_pulses(duty, dshot->pwm_top, &pulse_high, &pulse_low))
+    return false;
+  dshot->duty = *duty;
+  dshot->packet.pulse_high = pulse_high;
+  dshot->packet.pulse_low = pulse_low;
+  return true;
 }
 
-/// @brief print dshot config
+/// @brief print dshot config, with its size and hot / cold split
 void print_dshot_config(dshot_config *dshot);
 
 #ifdef __cplusplus
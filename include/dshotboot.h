@@ -0,0 +1,202 @@
+/** @file dshotboot.h
+ *  @defgroup dshotboot dshotboot
+ *
+ * Fast boot path: send valid frames as soon as possible after reset, from
+ * a boot config persisted in flash (see bootcfg.h).
+ *
+ * @ref dshot_boot_init checks the block in flash against the sys clock the
+ * sdk set up (`clock_get_hz`, a stored value, rather than a measurement),
+ * falls back to a block built by the application if it doesn't check out,
+ * then configures every motor from the precomputed table and sends its
+ * first packet (code 0) before the repeating timer starts. Call it first
+ * in `main()`, before `stdio_init_all()` and any sleep, and print the
+ * report (@ref dshot_boot_print) once the frames are running.
+ *
+ * Times are read from the 1 us timer, which the runtime takes out of reset
+ * before `main()`, so they are close to the time since reset.
+ *
+ * @ref dshot_boot_save writes a block to the last flash sector (e.g. after
+ * a duty calibration). Flash is unreadable while it is written, so it
+ * disables interrupts on this core; the other core must not be running
+ * from flash. Frames would stall for the sector erase (tens of ms), so only
+ * save with the motors stopped, and the frames stopped
+ * (@ref dshot_boot_stop, then @ref dshot_boot_resume).
+ */
+#pragma once
+#include "hardware/clocks.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+
+#include "bootcfg.h"
+#include "dshot.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Flash offset of the boot config: the last sector by default
+#ifndef DSHOT_BOOT_FLASH_OFFSET
+#define DSHOT_BOOT_FLASH_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+#endif
+
+/**
+ * @brief outcome of the fast boot
+ *
+ * @param status of the block in flash
+ * @param cfg block that was applied (in flash, or the fallback)
+ * @param sys_khz
+ * @param config_us time the motors were configured
+ * @param first_frame_us time the first packet was handed to dma
+ */
+typedef struct dshot_boot {
+  enum bootcfg_status status;
+  const bootcfg_t *cfg;
+  uint32_t sys_khz;
+  uint32_t config_us;
+  uint32_t first_frame_us;
+} dshot_boot_t;
+
+/// @brief the boot config in flash, read in place through XIP
+static inline const bootcfg_t *dshot_boot_flash_cfg(void) {
+  return (const bootcfg_t *)(XIP_BASE + DSHOT_BOOT_FLASH_OFFSET);
+}
+
+/**
+ * @brief configure the motors of a boot config and start sending frames
+ *
+ * @param boot output report
+ * @param dshots one config per motor: @ref BOOTCFG_MAX_MOTORS, or as many
+ * as either block may hold
+ * @param fallback used if the block in flash doesn't check out, e.g. built
+ * with @ref bootcfg_build from compiled-in defaults. The motors use the
+ * speed table of the applied block in place, so it must outlive them
+ * @param pool alarm pool to add the repeating timers to
+ * @return false if neither block checks out (nothing is configured)
+ */
+static inline bool dshot_boot_init(dshot_boot_t *const boot,
+                                   dshot_config dshots[],
+                                   const bootcfg_t *const fallback,
+                                   alarm_pool_t *const pool) {
+  boot->sys_khz = clock_get_hz(clk_sys) / 1000;
+  boot->status = bootcfg_check(dshot_boot_flash_cfg(), boot->sys_khz);
+  boot->cfg = boot->status == BOOTCFG_OK ? dshot_boot_flash_cfg() : fallback;
+  boot->config_us = 0;
+  boot->first_frame_us = 0;
+  if (!boot->cfg || bootcfg_check(boot->cfg, boot->sys_khz) != BOOTCFG_OK) {
+    boot->cfg = NULL;
+    return false;
+  }
+
+  const bootcfg_t *const cfg = boot->cfg;
+  for (int i = 0; i < cfg->motors; ++i) {
+    dshot_motor_configure_table(&dshots[i], cfg->speeds,
+                                (enum dshot_speed)cfg->speed, cfg->pause_ns,
+                                &cfg->duty[i], cfg->esc_gpio[i]);
+    dshot_dma_configure(&dshots[i]);
+  }
+  boot->config_us = time_us_32();
+
+  for (int i = 0; i < cfg->motors; ++i) {
+    if (cfg->packet_interval_us == DSHOT_CONTINUOUS) {
+      // Sends the first packet itself
+      dshot_rt_configure(&dshots[i], DSHOT_CONTINUOUS, pool);
+    } else {
+      // Don't wait a whole interval for the first frame
+      dshot_send_packet(&dshots[i], false);
+      dshot_rt_configure(&dshots[i], cfg->packet_interval_us, pool);
+    }
+    if (i == 0)
+      boot->first_frame_us = time_us_32();
+  }
+  return true;
+}
+
+/**
+ * @brief write a boot config to flash
+ *
+ * Motors configured from the block in flash read their speed table from
+ * it: save a block with the same pause, or configure them again.
+ *
+ * @param cfg a sealed block (see @ref bootcfg_build)
+ * @return false if it doesn't check out at the current sys clock, or reads
+ * back differently
+ */
+static inline bool dshot_boot_save(const bootcfg_t *const cfg) {
+  if (bootcfg_check(cfg, clock_get_hz(clk_sys) / 1000) != BOOTCFG_OK)
+    return false;
+  // Whole pages are programmed
+  static uint8_t page[(sizeof(bootcfg_t) + FLASH_PAGE_SIZE - 1) /
+                      FLASH_PAGE_SIZE * FLASH_PAGE_SIZE];
+  memset(page, 0xff, sizeof(page));
+  memcpy(page, cfg, sizeof(*cfg));
+
+  const uint32_t irq = save_and_disable_interrupts();
+  flash_range_erase(DSHOT_BOOT_FLASH_OFFSET, FLASH_SECTOR_SIZE);
+  flash_range_program(DSHOT_BOOT_FLASH_OFFSET, page, sizeof(page));
+  restore_interrupts(irq);
+  return memcmp(dshot_boot_flash_cfg(), cfg, sizeof(*cfg)) == 0;
+}
+
+/**
+ * @brief stop the frames of the motors of the boot config, e.g. to save a
+ * block (see @ref dshot_boot_save). Returns once the last packet is out
+ *
+ * @param boot
+ * @param dshots
+ * @return false if the frames are sent back to back (@ref DSHOT_CONTINUOUS):
+ * they aren't stopped
+ */
+static inline bool dshot_boot_stop(const dshot_boot_t *const boot,
+                                   dshot_config dshots[]) {
+  if (!boot->cfg || boot->cfg->packet_interval_us == DSHOT_CONTINUOUS)
+    return false;
+  for (int i = 0; i < boot->cfg->motors; ++i) {
+    if (dshots[i].send_packet_rt_state)
+      cancel_repeating_timer(&dshots[i].send_packet_rt);
+    dshots[i].send_packet_rt_state = false;
+  }
+  for (int i = 0; i < boot->cfg->motors; ++i) {
+    dma_channel_wait_for_finish_blocking(dshots[i].dma_channel);
+  }
+  return true;
+}
+
+/**
+ * @brief restart the frames stopped by @ref dshot_boot_stop
+ *
+ * @param boot
+ * @param dshots
+ * @param pool alarm pool to add the repeating timers to
+ */
+static inline void dshot_boot_resume(const dshot_boot_t *const boot,
+                                     dshot_config dshots[],
+                                     alarm_pool_t *const pool) {
+  for (int i = 0; i < boot->cfg->motors; ++i) {
+    dshot_send_packet(&dshots[i], false);
+    dshot_rt_configure(&dshots[i], boot->cfg->packet_interval_us, pool);
+  }
+}
+
+/**
+ * @brief print the boot report
+ *
+ * @param boot
+ */
+static void dshot_boot_print(const dshot_boot_t *const boot) {
+  printf("Boot config: %s (%s)\n", bootcfg_status_str(boot->status),
+         boot->status == BOOTCFG_OK ? "flash" : "fallback");
+  printf("Sys clock: %u kHz\n", boot->sys_khz);
+  if (!boot->cfg) {
+    printf("No valid boot config: no frames sent\n");
+    return;
+  }
+  printf("Motors: %u at DShot%u, packet interval %d us, pause %u ns\n",
+         boot->cfg->motors, dshot_speed_khz_table[boot->cfg->speed],
+         boot->cfg->packet_interval_us, boot->cfg->pause_ns);
+  printf("Configured at %u us, first frame at %u us after reset\n",
+         boot->config_us, boot->first_frame_us);
+}
+
+#ifdef __cplusplus
+}
+#endif
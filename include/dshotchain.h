@@ -0,0 +1,155 @@
+/** @file dshotchain.h
+ *  @defgroup dshotchain dshotchain
+ *
+ * Send the packets of several motors with two dma channels in total,
+ * instead of one per motor (see dmachain.h for the control blocks).
+ *
+ * Usage:
+ * @code
+ * dshot_chain_t chain;
+ * dshot_chain_init(&chain);
+ * dshot_chain_add(&chain, &dshots[0], 300, 14);
+ * dshot_chain_add(&chain, &dshots[1], 300, 16);
+ * dshot_chain_start(&chain, 1000,
+ *                   rtpool_init(&rtpool, RTPOOL_ALARM_NUM, RTPOOL_CORE));
+ * @endcode
+ *
+ * The motors' packets go out one after the other, so a round takes the sum
+ * of their packet lengths, and the packet interval must fit it. Each motor
+ * still has its own pwm slice, speed, duty and frame hook. Their pauses
+ * all come from the shared zero tail (@ref dshot_pause_tail).
+ */
+#pragma once
+#include "dmachain.h"
+#include "dshot.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief motors sharing a pair of dma channels
+ *
+ * @param dma control blocks and channels
+ * @param dshots motor configs, in the order of the blocks
+ * @param send_rt repeating timer that starts a round
+ * @param send_rt_state true if the repeating timer was setup successfully
+ * @param packet_interval_us
+ */
+typedef struct dshot_chain {
+  dmachain_t dma;
+  dshot_config *dshots[DMACHAIN_MAX_MOTORS];
+  repeating_timer_t send_rt;
+  bool send_rt_state;
+  long int packet_interval_us;
+} dshot_chain_t;
+
+/**
+ * @brief compose the packet of every motor and send them all
+ *
+ * @param chain
+ */
+void dshot_chain_send(dshot_chain_t *chain);
+
+/**
+ * @brief isr to send a round of packets
+ *
+ * @param rt ptr to repeating timer (@ref dshot_chain_t::send_rt)
+ * @return \a true, so that timer repeats
+ */
+static inline bool dshot_chain_repeating_send(repeating_timer_t *rt) {
+  rtpool_entry(rt, RTPOOL_FRAME);
+  dshot_chain_send((dshot_chain_t *)(rt->user_data));
+  return true;
+}
+
+/**
+ * @brief claim the data and control dma channels of an empty chain
+ *
+ * @param chain
+ */
+static inline void dshot_chain_init(dshot_chain_t *const chain) {
+  const uint data_channel = dma_claim_unused_channel(true);
+  const uint ctrl_channel = dma_claim_unused_channel(true);
+  dmachain_init(&chain->dma, (uint8_t)data_channel, (uint8_t)ctrl_channel);
+  chain->send_rt_state = false;
+  chain->packet_interval_us = 0;
+
+  // The control channel loads one block into the data channel's alias 1
+  // registers. The last write (transfer count) triggers the data channel
+  dma_channel_hw_t *const ctrl = dma_channel_hw_addr(ctrl_channel);
+  ctrl->write_addr = (uintptr_t)&dma_hw->ch[data_channel].al1_ctrl;
+  ctrl->transfer_count = dmachain_ctrl_count();
+  ctrl->al1_ctrl = dmachain_ctrl_ctrl(&chain->dma);
+}
+
+/**
+ * @brief configure a motor and append it to the chain
+ *
+ * @param chain
+ * @param dshot ptr to dshot config. All data will be overwritten
+ * @param dshot_speed_khz
+ * @param esc_gpio_pin
+ * @return false if the chain is full
+ */
+static inline bool dshot_chain_add(dshot_chain_t *const chain,
+                                   dshot_config *const dshot,
+                                   const float dshot_speed_khz,
+                                   const uint esc_gpio_pin) {
+  if (chain->dma.motors >= DMACHAIN_MAX_MOTORS)
+    return false;
+  dshot_motor_configure(dshot, dshot_speed_khz, esc_gpio_pin);
+  const uint slice = pwm_gpio_to_slice_num(esc_gpio_pin);
+  // The frame, without its zero pulse: the tail block starts the pause
+  const int idx = dmachain_add(
+      &chain->dma, (uintptr_t)dshot->packet.packet_buffer,
+      (uintptr_t)&pwm_hw->slice[slice].cc, DSHOT_FRAME_SIZE,
+      (uintptr_t)dshot_pause_tail, dshot->packet_length - DSHOT_FRAME_SIZE,
+      DREQ_PWM_WRAP0 + slice);
+  chain->dshots[idx] = dshot;
+  return true;
+}
+
+/**
+ * @brief start sending rounds of packets
+ *
+ * Each motor gets an equal share of the interval, which
+ * @ref dshot_set_speed and @ref dshot_set_pause check against.
+ *
+ * @param chain
+ * @param packet_interval in us
+ * @param pool alarm pool to add the repeating timer to
+ *
+ * @attention @ref DSHOT_CONTINUOUS isn't supported: a round is started by
+ * the timer
+ */
+static inline void dshot_chain_start(dshot_chain_t *const chain,
+                                     const long int packet_interval,
+                                     alarm_pool_t *const pool) {
+  if (!chain->dma.motors || packet_interval <= 0)
+    panic("dshot chain needs motors and a packet interval\n");
+  // Ensure the packets of all motors fit in one interval
+  long int round_us = 0;
+  for (int i = 0; i < chain->dma.motors; ++i) {
+    const dshot_config *const dshot = chain->dshots[i];
+    round_us += (long int)(dshot->packet_length * 1000 /
+                               dshot->dshot_speed_khz +
+                           1);
+  }
+  if (round_us > packet_interval)
+    panic("packet_interval of %d is lower than min: %d\n", packet_interval,
+          round_us);
+
+  chain->packet_interval_us = packet_interval;
+  for (int i = 0; i < chain->dma.motors; ++i) {
+    chain->dshots[i]->packet_interval_us =
+        packet_interval / chain->dma.motors;
+  }
+  chain->send_rt_state = alarm_pool_add_repeating_timer_us(
+      pool, packet_interval, dshot_chain_repeating_send, chain,
+      &chain->send_rt);
+}
+
+#ifdef __cplusplus
+}
+#endif
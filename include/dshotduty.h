@@ -0,0 +1,113 @@
+/**
+ * @file dshotduty.h
+ * @defgroup dshotduty dshotduty
+ * @brief Per motor DShot bit timings (T1H / T0H)
+ *
+ * A DShot bit is one pwm period, high for T1H (a 1) or T0H (a 0). The
+ * nominal 75 % / 37 % don't suit every ESC at high speeds, so each
+ * @ref dshot_config keeps its own @ref dshot_duty_t, in permille of a bit
+ * so that it holds across speed changes. Timings given in ns are converted
+ * with @ref dshot_duty_from_ns.
+ *
+ * @ref dshot_duty_pulses rounds a duty to pwm counts, and rejects it if the
+ * two pulses can't be told apart, or either is stuck at 0 or at the full
+ * period.
+ */
+
+#pragma once
+#include "stdbool.h"
+#include "stdint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// A full bit, in the units of @ref dshot_duty_t
+#define DSHOT_DUTY_ONE 1000
+
+/**
+ * @brief high time of a 1 and a 0 bit
+ *
+ * @param t1h permille of a bit
+ * @param t0h permille of a bit
+ */
+typedef struct dshot_duty {
+  uint16_t t1h;
+  uint16_t t0h;
+} dshot_duty_t;
+
+/// @brief nominal DShot timings: 75 % and 37 % of a bit
+static const dshot_duty_t dshot_duty_default = {750, 370};
+
+/**
+ * @brief convert high times in ns to a duty, at a given speed
+ *
+ * @param duty output
+ * @param t1h_ns
+ * @param t0h_ns
+ * @param speed_khz bit rate
+ * @return false if a high time is longer than a bit
+ */
+static inline bool dshot_duty_from_ns(dshot_duty_t *const duty,
+                                      const uint32_t t1h_ns,
+                                      const uint32_t t0h_ns,
+                                      const uint32_t speed_khz) {
+  // ns x khz = 1e-6 of a bit
+  const uint64_t t1h = ((uint64_t)t1h_ns * speed_khz + 500) / 1000;
+  const uint64_t t0h = ((uint64_t)t0h_ns * speed_khz + 500) / 1000;
+  if (t1h > DSHOT_DUTY_ONE || t0h > DSHOT_DUTY_ONE)
+    return false;
+  duty->t1h = (uint16_t)t1h;
+  duty->t0h = (uint16_t)t0h;
+  return true;
+}
+
+/**
+ * @brief high time of a bit in ns, at a given speed
+ *
+ * @param permille @ref dshot_duty_t::t1h or @ref dshot_duty_t::t0h
+ * @param speed_khz
+ */
+static inline uint32_t dshot_duty_to_ns(const uint16_t permille,
+                                        const uint32_t speed_khz) {
+  return (uint32_t)(((uint64_t)permille * 1000 + speed_khz / 2) / speed_khz);
+}
+
+/**
+ * @brief counter compare values of a duty
+ *
+ * @param duty
+ * @param top pwm wrap: a bit is top + 1 counts
+ * @param pulse_high output: counter compare of a 1 bit
+ * @param pulse_low output: counter compare of a 0 bit
+ * @return false if 0 < pulse_low < pulse_high < top + 1 doesn't hold
+ * (the outputs are still written)
+ */
+static inline bool dshot_duty_pulses(const dshot_duty_t *const duty,
+                                     const uint16_t top,
+                                     uint16_t *const pulse_high,
+                                     uint16_t *const pulse_low) {
+  const uint32_t counts = top + 1u;
+  const uint32_t high =
+      (duty->t1h * counts + DSHOT_DUTY_ONE / 2) / DSHOT_DUTY_ONE;
+  const uint32_t low =
+      (duty->t0h * counts + DSHOT_DUTY_ONE / 2) / DSHOT_DUTY_ONE;
+  *pulse_high = (uint16_t)(high < counts ? high : top);
+  *pulse_low = (uint16_t)(low < counts ? low : top);
+  return low > 0 && low < high && high < counts;
+}
+
+/// @brief pack a duty into one word (0 is never a valid duty)
+static inline uint32_t dshot_duty_pack(const dshot_duty_t *const duty) {
+  return (uint32_t)duty->t1h << 16 | duty->t0h;
+}
+
+/// @brief inverse of @ref dshot_duty_pack
+static inline dshot_duty_t dshot_duty_unpack(const uint32_t packed) {
+  const dshot_duty_t duty = {(uint16_t)(packed >> 16), (uint16_t)packed};
+  return duty;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,247 @@
+/**
+ * @file dshotspeed.h
+ * @defgroup dshotspeed dshotspeed
+ * @brief Precomputed pwm settings of the standard DShot speeds
+ *
+ * @ref dshot_config_init measures the system clock, claims a dma channel
+ * and adds a repeating timer, so calling it again to change speed is slow
+ * and leaks hardware. Instead, the pwm divider, wrap and pulse widths of
+ * DShot150 / 300 / 600 / 1200 / 2400 are computed once (from the clock measured
+ * at init), and @ref dshot_set_speed swaps them in at the next frame
+ * boundary: a few register writes in the send isr.
+ *
+ * The values are the same as those computed by @ref dshot_pwm_configure
+ * and @ref dshot_packet_configure, without any hw access, so they can be
+ * checked on the host.
+ *
+ * The pause after a frame is set in time (e.g. the 2 us the ESCs need to
+ * resync), and rounded up to whole zero duty pulses per speed. This gives
+ * the shortest packet, so the shortest packet interval and, with frames
+ * sent back to back (@ref DSHOT_CONTINUOUS), the highest packet rate:
+ *
+ *     rate = speed / (16 + pause pulses)
+ *
+ * A long pause may not fit the packet buffer at the faster speeds: those
+ * are left unavailable (see @ref dshot_speed_entry_available), the others
+ * can still be used.
+ */
+
+#pragma once
+#include "dshotduty.h"
+#include "packet.h"
+#include "stdbool.h"
+#include "stdint.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief standard DShot speeds
+enum dshot_speed {
+  DSHOT150,
+  DSHOT300,
+  DSHOT600,
+  DSHOT1200,
+  DSHOT2400,
+  DSHOT_SPEEDS,
+};
+
+/// @brief bit rate of each @ref dshot_speed (khz)
+static const uint16_t dshot_speed_khz_table[DSHOT_SPEEDS] = {150, 300, 600,
+                                                             1200, 2400};
+
+/// Fractional bits of the pwm divider (as in the pwm DIV register)
+#define DSHOT_SPEED_DIV_FRAC_BITS 4
+
+/// Default pause between frames (ns)
+#define DSHOT_PAUSE_NS_DEFAULT 2000
+
+/**
+ * @brief pwm settings of one speed
+ *
+ * @param speed_khz
+ * @param top pwm wrap
+ * @param div pwm divider, 8.4 fixed point
+ * @param pulse_high counter compare of a 1 bit with @ref dshot_duty_default
+ * (not shifted to a channel)
+ * @param pulse_low counter compare of a 0 bit
+ * @param pause_pulses zero duty pulses after the frame, 0 if the pause
+ * doesn't fit at this speed
+ * @param min_interval_us shortest packet interval that fits a packet
+ * @param max_rate_hz packet rate with packets sent back to back
+ */
+typedef struct dshot_speed_entry {
+  uint16_t speed_khz;
+  uint16_t top;
+  uint16_t div;
+  uint16_t pulse_high;
+  uint16_t pulse_low;
+  uint8_t pause_pulses;
+  uint32_t min_interval_us;
+  uint32_t max_rate_hz;
+} dshot_speed_entry_t;
+
+/**
+ * @brief zero duty pulses that last at least \a pause_ns
+ *
+ * @param pause_ns
+ * @param speed_khz
+ * @return pulses, at least 1 (the line must return low after the frame).
+ * May exceed @ref DSHOT_PAUSE_MAX_PULSES
+ */
+static inline uint32_t dshot_pause_pulses(const uint32_t pause_ns,
+                                          const uint16_t speed_khz) {
+  // ns x khz = 1e-6 bits
+  const uint64_t pulses = ((uint64_t)pause_ns * speed_khz + 999999) / 1000000;
+  return pulses ? (uint32_t)pulses : 1;
+}
+
+/**
+ * @brief set the pause of a speed
+ *
+ * @param entry
+ * @param pause_ns
+ * @return false if the pause needs more than @ref DSHOT_PAUSE_MAX_PULSES:
+ * the speed is then unavailable (see @ref dshot_speed_entry_available)
+ */
+static inline bool dshot_speed_entry_set_pause(dshot_speed_entry_t *const entry,
+                                               const uint32_t pause_ns) {
+  const uint32_t pulses = dshot_pause_pulses(pause_ns, entry->speed_khz);
+  if (pulses > DSHOT_PAUSE_MAX_PULSES) {
+    entry->pause_pulses = 0;
+    entry->min_interval_us = UINT32_MAX;
+    entry->max_rate_hz = 0;
+    return false;
+  }
+  entry->pause_pulses = (uint8_t)pulses;
+  const uint32_t length = DSHOT_FRAME_SIZE + entry->pause_pulses;
+  // Round up, so that a packet always fits in the interval
+  entry->min_interval_us =
+      (length * 1000 + entry->speed_khz - 1) / entry->speed_khz;
+  entry->max_rate_hz = entry->speed_khz * 1000u / length;
+  return true;
+}
+
+/**
+ * @brief true if the pause of the table fits at this speed
+ *
+ * @param entry
+ */
+static inline bool
+dshot_speed_entry_available(const dshot_speed_entry_t *const entry) {
+  return entry->pause_pulses != 0;
+}
+
+/**
+ * @brief compute the pwm settings of a speed
+ *
+ * Same as @ref pwm_period_to_div_wrap: the counter runs undivided if the
+ * period fits in 16 bits, otherwise the wrap is maxed out and the divider
+ * makes up the rest. The wrap and pulse widths are rounded to the nearest
+ * count (a period is top + 1 counts).
+ *
+ * @param entry output
+ * @param mcu_freq_khz system clock
+ * @param speed_khz bit rate
+ * @param pause_ns pause after each frame
+ * @return false if the pause is too long (see
+ * @ref dshot_speed_entry_set_pause)
+ */
+static inline bool dshot_speed_entry_compute(dshot_speed_entry_t *const entry,
+                                             const uint32_t mcu_freq_khz,
+                                             const uint16_t speed_khz,
+                                             const uint32_t pause_ns) {
+  const uint32_t max_counts = 1u << 16;
+  const uint32_t div_one = 1u << DSHOT_SPEED_DIV_FRAC_BITS;
+  // Period in clock counts, 8.4 fixed point
+  const uint64_t period =
+      ((uint64_t)mcu_freq_khz << DSHOT_SPEED_DIV_FRAC_BITS) / speed_khz;
+
+  // Padding too, as shared tables are compared by value
+  memset(entry, 0, sizeof(*entry));
+  entry->speed_khz = speed_khz;
+  if (period <= (uint64_t)max_counts * div_one) {
+    entry->top = (uint16_t)(((period + div_one / 2) >>
+                             DSHOT_SPEED_DIV_FRAC_BITS) -
+                            1);
+    entry->div = div_one;
+  } else {
+    entry->top = (uint16_t)(max_counts - 1);
+    entry->div = (uint16_t)(period / max_counts);
+  }
+  dshot_duty_pulses(&dshot_duty_default, entry->top, &entry->pulse_high,
+                    &entry->pulse_low);
+  return dshot_speed_entry_set_pause(entry, pause_ns);
+}
+
+/**
+ * @brief compute the settings of every @ref dshot_speed
+ *
+ * @param table output
+ * @param mcu_freq_khz system clock
+ * @param pause_ns pause after each frame
+ * @return false if the pause is too long at some speed (that speed is
+ * unavailable, the others are still computed)
+ */
+static inline bool
+dshot_speed_table_init(dshot_speed_entry_t table[DSHOT_SPEEDS],
+                       const uint32_t mcu_freq_khz, const uint32_t pause_ns) {
+  bool valid = true;
+  for (int s = 0; s < DSHOT_SPEEDS; ++s) {
+    valid &= dshot_speed_entry_compute(&table[s], mcu_freq_khz,
+                                       dshot_speed_khz_table[s], pause_ns);
+  }
+  return valid;
+}
+
+/**
+ * @brief print the packet length and achievable packet rates of each speed
+ *
+ * @param table
+ */
+static void dshot_speed_print_table(const dshot_speed_entry_t *const table) {
+  printf("speed	pause	packet	min interval	max rate (back to back)\n");
+  for (int s = 0; s < DSHOT_SPEEDS; ++s) {
+    const dshot_speed_entry_t *const e = &table[s];
+    if (!dshot_speed_entry_available(e)) {
+      printf("%u	-	unavailable: the pause doesn't fit\n", e->speed_khz);
+      continue;
+    }
+    printf("%u	%u	%u	%u us (%u hz)	%u hz\n", e->speed_khz,
+           e->pause_pulses, DSHOT_FRAME_SIZE + e->pause_pulses,
+           e->min_interval_us, 1000000 / e->min_interval_us, e->max_rate_hz);
+  }
+}
+
+/**
+ * @brief look up a speed by its bit rate
+ *
+ * @param speed_khz
+ * @return @ref dshot_speed, or @ref DSHOT_SPEEDS if it isn't a standard
+ * speed
+ */
+static inline enum dshot_speed dshot_speed_from_khz(const float speed_khz) {
+  for (int s = 0; s < DSHOT_SPEEDS; ++s) {
+    if (speed_khz == dshot_speed_khz_table[s])
+      return (enum dshot_speed)s;
+  }
+  return DSHOT_SPEEDS;
+}
+
+/**
+ * @brief true if a packet fits in the packet interval at this speed
+ *
+ * @param entry
+ * @param packet_interval_us
+ */
+static inline bool
+dshot_speed_interval_valid(const dshot_speed_entry_t *const entry,
+                           const uint32_t packet_interval_us) {
+  return packet_interval_us >= entry->min_interval_us;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,469 @@
+/**
+ * @file dutycal.h
+ * @defgroup dutycal dutycal
+ * @brief Find the fastest speed and duty an ESC reliably decodes
+ *
+ * An ESC only answers a telemetry request if it decoded the frame (the
+ * crc matched), so the share of requests that get a valid reply tells
+ * how well it reads a given speed and T1H / T0H (see dshotduty.h).
+ *
+ * A calibration tries each speed of @ref dutycal_config_t::speeds in
+ * order (fastest first). At each speed, it steps through a grid of T1H x
+ * T0H: after a change, the replies to the first
+ * @ref dutycal_config_t::settle_requests requests are ignored, then a
+ * point is accepted if at least @ref dutycal_config_t::accept_permille of
+ * the next @ref dutycal_config_t::requests requests get a valid reply.
+ * Points whose pulses don't resolve at that speed are skipped, and so are
+ * speeds that are unavailable (see @ref dshot_speed_entry_available). The
+ * caller skips a speed or point the motor refuses
+ * (@ref dutycal_skip_speed, @ref dutycal_skip_point) instead of measuring
+ * it.
+ *
+ * The first speed with an accepted point wins. Of its accepted points, the
+ * one with the most accepted neighbours (i.e. the most margin) is picked,
+ * ties going to the one closest to @ref dshot_duty_default.
+ *
+ * One @ref dutycal_t per ESC, all driven from the main loop:
+ *
+ *     dutycal_start(&cal, &config, dshot.speeds, dshot.telem_requests);
+ *     // apply dutycal_speed(&cal) and dutycal_duty(&cal), skipping what
+ *     // the motor refuses
+ *     while (!dutycal_done(&cal)) {
+ *       // for each telemetry sample of this ESC
+ *       dutycal_reply(&cal, &sample);
+ *       if (dutycal_poll(&cal, dshot.telem_requests)) {
+ *         // apply dutycal_speed(&cal) and dutycal_duty(&cal), skipping
+ *         // what the motor refuses
+ *       }
+ *     }
+ */
+
+#pragma once
+#include "dshotduty.h"
+#include "dshotspeed.h"
+#include "stdbool.h"
+#include "stdint.h"
+#include "telemqueue.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Largest T1H x T0H grid
+#define DUTYCAL_MAX_POINTS 64
+/// @ref dutycal_t::rate of a point that was skipped
+#define DUTYCAL_RATE_INVALID 0xffff
+
+/**
+ * @brief calibration settings
+ *
+ * @param speeds @ref dshot_speed to try, fastest first
+ * @param speed_count
+ * @param t1h_min, t1h_max, t1h_step T1H grid (permille of a bit)
+ * @param t0h_min, t0h_max, t0h_step T0H grid (permille of a bit)
+ * @param settle_requests requests ignored after each change
+ * @param requests requests measured per point
+ * @param accept_permille share of valid replies to accept a point
+ */
+typedef struct dutycal_config {
+  const uint8_t *speeds;
+  uint8_t speed_count;
+  uint16_t t1h_min;
+  uint16_t t1h_max;
+  uint16_t t1h_step;
+  uint16_t t0h_min;
+  uint16_t t0h_max;
+  uint16_t t0h_step;
+  uint16_t settle_requests;
+  uint16_t requests;
+  uint16_t accept_permille;
+} dutycal_config_t;
+
+enum dutycal_state {
+  DUTYCAL_IDLE,
+  DUTYCAL_SETTLING,
+  DUTYCAL_MEASURING,
+  DUTYCAL_DONE,
+};
+
+/**
+ * @brief calibration of one ESC
+ *
+ * @param config
+ * @param table pwm settings of each speed (e.g. @ref dshot_config::speeds)
+ * @param state
+ * @param t1h_points, t0h_points grid size
+ * @param speed_idx index in @ref dutycal_config_t::speeds
+ * @param point index in the grid (t1h major)
+ * @param start_requests telemetry requests sent when the phase started
+ * @param valid valid replies in the current point
+ * @param rate valid replies per 1000 requests of each point of the current
+ * speed, or @ref DUTYCAL_RATE_INVALID
+ * @param found a speed and duty were accepted
+ * @param speed result
+ * @param duty result
+ * @param margin accepted neighbours of the result (0 - 8)
+ * @param accepted accepted points at that speed
+ * @param skipped_speeds bit per @ref dshot_speed skipped without a
+ * measurement
+ */
+typedef struct dutycal {
+  const dutycal_config_t *config;
+  const dshot_speed_entry_t *table;
+  enum dutycal_state state;
+  uint8_t t1h_points;
+  uint8_t t0h_points;
+  uint8_t speed_idx;
+  uint8_t point;
+  uint32_t start_requests;
+  uint32_t valid;
+  uint16_t rate[DUTYCAL_MAX_POINTS];
+  bool found;
+  enum dshot_speed speed;
+  dshot_duty_t duty;
+  uint8_t margin;
+  uint8_t accepted;
+  uint16_t skipped_speeds;
+} dutycal_t;
+
+/// @brief number of steps from \a min to \a max (0 if invalid)
+static inline uint32_t dutycal_axis_points(const uint16_t min,
+                                           const uint16_t max,
+                                           const uint16_t step) {
+  if (max < min || (!step && max != min))
+    return 0;
+  return step ? (max - min) / step + 1u : 1u;
+}
+
+/**
+ * @brief check a config
+ *
+ * @param config
+ * @param table pwm settings of each @ref dshot_speed
+ * @return false if a grid axis is empty, the grid has more than
+ * @ref DUTYCAL_MAX_POINTS points, a speed is invalid or none is available
+ */
+static inline bool
+dutycal_config_valid(const dutycal_config_t *const config,
+                     const dshot_speed_entry_t *const table) {
+  const uint32_t t1h = dutycal_axis_points(config->t1h_min, config->t1h_max,
+                                           config->t1h_step);
+  const uint32_t t0h = dutycal_axis_points(config->t0h_min, config->t0h_max,
+                                           config->t0h_step);
+  if (!t1h || !t0h || t1h * t0h > DUTYCAL_MAX_POINTS || !config->requests ||
+      !config->speed_count || config->t1h_max > DSHOT_DUTY_ONE)
+    return false;
+  bool available = false;
+  for (int s = 0; s < config->speed_count; ++s) {
+    if (config->speeds[s] >= DSHOT_SPEEDS)
+      return false;
+    available |= dshot_speed_entry_available(&table[config->speeds[s]]);
+  }
+  return available;
+}
+
+/// @brief speed to run at now
+static inline enum dshot_speed dutycal_speed(const dutycal_t *const cal) {
+  return cal->state == DUTYCAL_DONE
+             ? cal->speed
+             : (enum dshot_speed)cal->config->speeds[cal->speed_idx];
+}
+
+/// @brief duty of a grid point
+static inline dshot_duty_t dutycal_point_duty(const dutycal_t *const cal,
+                                              const uint8_t point) {
+  const dshot_duty_t duty = {
+      (uint16_t)(cal->config->t1h_min +
+                 point / cal->t0h_points * cal->config->t1h_step),
+      (uint16_t)(cal->config->t0h_min +
+                 point % cal->t0h_points * cal->config->t0h_step)};
+  return duty;
+}
+
+/// @brief duty to run at now
+static inline dshot_duty_t dutycal_duty(const dutycal_t *const cal) {
+  return cal->state == DUTYCAL_DONE ? cal->duty
+                                    : dutycal_point_duty(cal, cal->point);
+}
+
+/// @brief true once a result (or the lack of one) is known
+static inline bool dutycal_done(const dutycal_t *const cal) {
+  return cal->state == DUTYCAL_DONE;
+}
+
+/// @brief true if a point of the current speed was accepted
+static inline bool dutycal_point_accepted(const dutycal_t *const cal,
+                                          const int t1h_idx,
+                                          const int t0h_idx) {
+  if (t1h_idx < 0 || t1h_idx >= cal->t1h_points || t0h_idx < 0 ||
+      t0h_idx >= cal->t0h_points)
+    return false;
+  const uint16_t rate = cal->rate[t1h_idx * cal->t0h_points + t0h_idx];
+  return rate != DUTYCAL_RATE_INVALID &&
+         rate >= cal->config->accept_permille;
+}
+
+/**
+ * @brief pick the result among the accepted points of the current speed
+ *
+ * @return false if no point was accepted
+ */
+static inline bool dutycal_pick(dutycal_t *const cal) {
+  bool found = false;
+  uint32_t best_distance = 0;
+  cal->accepted = 0;
+  for (int i1 = 0; i1 < cal->t1h_points; ++i1) {
+    for (int i0 = 0; i0 < cal->t0h_points; ++i0) {
+      if (!dutycal_point_accepted(cal, i1, i0))
+        continue;
+      cal->accepted++;
+      uint8_t margin = 0;
+      for (int d1 = -1; d1 <= 1; ++d1) {
+        for (int d0 = -1; d0 <= 1; ++d0) {
+          margin +=
+              (d1 || d0) && dutycal_point_accepted(cal, i1 + d1, i0 + d0);
+        }
+      }
+      const dshot_duty_t duty =
+          dutycal_point_duty(cal, (uint8_t)(i1 * cal->t0h_points + i0));
+      const uint32_t distance =
+          (uint32_t)abs(duty.t1h - dshot_duty_default.t1h) +
+          (uint32_t)abs(duty.t0h - dshot_duty_default.t0h);
+      if (!found || margin > cal->margin ||
+          (margin == cal->margin && distance < best_distance)) {
+        found = true;
+        cal->margin = margin;
+        cal->duty = duty;
+        best_distance = distance;
+      }
+    }
+  }
+  return found;
+}
+
+/// @brief true if the speed was skipped without a measurement
+static inline bool dutycal_speed_skipped(const dutycal_t *const cal,
+                                         const enum dshot_speed speed) {
+  return cal->skipped_speeds & (1u << speed);
+}
+
+/**
+ * @brief skip to the next grid point that resolves at the current speed
+ *
+ * @return false if none is left, or the speed is unavailable or was skipped
+ * (all of its points are then skipped)
+ */
+static inline bool dutycal_seek(dutycal_t *const cal) {
+  const enum dshot_speed speed = dutycal_speed(cal);
+  const uint8_t points = (uint8_t)(cal->t1h_points * cal->t0h_points);
+  if (!dshot_speed_entry_available(&cal->table[speed]))
+    cal->skipped_speeds |= (uint16_t)(1u << speed);
+  if (dutycal_speed_skipped(cal, speed)) {
+    for (uint8_t p = 0; p < points; ++p) {
+      cal->rate[p] = DUTYCAL_RATE_INVALID;
+    }
+    cal->point = points;
+    return false;
+  }
+  const uint16_t top = cal->table[speed].top;
+  for (; cal->point < points; ++cal->point) {
+    const dshot_duty_t duty = dutycal_point_duty(cal, cal->point);
+    uint16_t pulse_high;
+    uint16_t pulse_low;
+    if (dshot_duty_pulses(&duty, top, &pulse_high, &pulse_low))
+      return true;
+    cal->rate[cal->point] = DUTYCAL_RATE_INVALID;
+  }
+  return false;
+}
+
+/**
+ * @brief move to the next point, or the next speed once the grid is done
+ *
+ * @param cal
+ * @param requests telemetry requests sent so far
+ */
+static inline void dutycal_advance(dutycal_t *const cal,
+                                   const uint32_t requests) {
+  for (;;) {
+    if (dutycal_seek(cal)) {
+      cal->state = DUTYCAL_SETTLING;
+      cal->start_requests = requests;
+      cal->valid = 0;
+      return;
+    }
+    // Grid done: the first speed with an accepted point wins
+    if (dutycal_pick(cal)) {
+      cal->found = true;
+      cal->speed = dutycal_speed(cal);
+      cal->state = DUTYCAL_DONE;
+      return;
+    }
+    if (++cal->speed_idx >= cal->config->speed_count) {
+      cal->speed_idx = cal->config->speed_count - 1;
+      cal->speed = dutycal_speed(cal);
+      cal->duty = dshot_duty_default;
+      cal->state = DUTYCAL_DONE;
+      return;
+    }
+    cal->point = 0;
+  }
+}
+
+/**
+ * @brief start a calibration
+ *
+ * @param cal
+ * @param config must outlive the calibration
+ * @param table pwm settings of each @ref dshot_speed
+ * @param requests telemetry requests sent so far
+ * (@ref dshot_config::telem_requests)
+ * @return false if the config is invalid
+ */
+static inline bool dutycal_start(dutycal_t *const cal,
+                                 const dutycal_config_t *const config,
+                                 const dshot_speed_entry_t *const table,
+                                 const uint32_t requests) {
+  cal->state = DUTYCAL_IDLE;
+  if (!dutycal_config_valid(config, table))
+    return false;
+  cal->config = config;
+  cal->table = table;
+  cal->t1h_points = (uint8_t)dutycal_axis_points(
+      config->t1h_min, config->t1h_max, config->t1h_step);
+  cal->t0h_points = (uint8_t)dutycal_axis_points(
+      config->t0h_min, config->t0h_max, config->t0h_step);
+  cal->speed_idx = 0;
+  cal->point = 0;
+  cal->found = false;
+  cal->margin = 0;
+  cal->accepted = 0;
+  cal->skipped_speeds = 0;
+  dutycal_advance(cal, requests);
+  return true;
+}
+
+/**
+ * @brief skip the current speed instead of measuring it, e.g. because the
+ * motor refused it (@ref dshot_set_speed returned false)
+ *
+ * @param cal
+ * @param requests telemetry requests sent so far
+ */
+static inline void dutycal_skip_speed(dutycal_t *const cal,
+                                      const uint32_t requests) {
+  if (cal->state == DUTYCAL_DONE)
+    return;
+  cal->skipped_speeds |= (uint16_t)(1u << dutycal_speed(cal));
+  dutycal_advance(cal, requests);
+}
+
+/**
+ * @brief skip the current point instead of measuring it, e.g. because the
+ * motor refused its duty (@ref dshot_set_duty returned false)
+ *
+ * @param cal
+ * @param requests telemetry requests sent so far
+ */
+static inline void dutycal_skip_point(dutycal_t *const cal,
+                                      const uint32_t requests) {
+  if (cal->state == DUTYCAL_DONE)
+    return;
+  cal->rate[cal->point] = DUTYCAL_RATE_INVALID;
+  cal->point++;
+  dutycal_advance(cal, requests);
+}
+
+/**
+ * @brief count a telemetry reply of this ESC
+ *
+ * @param cal
+ * @param sample
+ */
+static inline void dutycal_reply(dutycal_t *const cal,
+                                 const telem_sample_t *const sample) {
+  if (cal->state == DUTYCAL_MEASURING && sample->telem.crc == 0)
+    cal->valid++;
+}
+
+/**
+ * @brief advance the calibration as telemetry requests are sent
+ *
+ * @param cal
+ * @param requests telemetry requests sent so far
+ * @return true once a point is done: apply @ref dutycal_speed and
+ * @ref dutycal_duty (the next point, or the result)
+ */
+static inline bool dutycal_poll(dutycal_t *const cal,
+                                const uint32_t requests) {
+  const uint32_t sent = requests - cal->start_requests;
+  if (cal->state == DUTYCAL_SETTLING) {
+    if (sent >= cal->config->settle_requests) {
+      cal->state = DUTYCAL_MEASURING;
+      cal->start_requests = requests;
+      cal->valid = 0;
+    }
+    return false;
+  }
+  if (cal->state != DUTYCAL_MEASURING || sent < cal->config->requests)
+    return false;
+  // A reply to a settling request may land in the window, so clamp
+  const uint32_t rate = cal->valid * DSHOT_DUTY_ONE / sent;
+  cal->rate[cal->point] =
+      (uint16_t)(rate < DSHOT_DUTY_ONE ? rate : DSHOT_DUTY_ONE);
+  cal->point++;
+  dutycal_advance(cal, requests);
+  return true;
+}
+
+/**
+ * @brief print the skipped speeds and the grid of the current (or final)
+ * speed: valid replies per 1000 requests, `-` if skipped
+ */
+static void dutycal_print(const dutycal_t *const cal, const int esc_idx) {
+  const enum dshot_speed speed = dutycal_speed(cal);
+  printf("Duty calibration ESC %i: DShot%u\n", esc_idx,
+         dshot_speed_khz_table[speed]);
+  for (int s = 0; s < cal->config->speed_count; ++s) {
+    const enum dshot_speed skipped = (enum dshot_speed)cal->config->speeds[s];
+    if (dutycal_speed_skipped(cal, skipped))
+      printf("DShot%u skipped\n", dshot_speed_khz_table[skipped]);
+  }
+  printf("T1H\\T0H");
+  for (int i0 = 0; i0 < cal->t0h_points; ++i0) {
+    printf("\t%u", dutycal_point_duty(cal, (uint8_t)i0).t0h);
+  }
+  printf("\n");
+  for (int i1 = 0; i1 < cal->t1h_points; ++i1) {
+    const uint8_t row = (uint8_t)(i1 * cal->t0h_points);
+    printf("%u", dutycal_point_duty(cal, row).t1h);
+    for (int i0 = 0; i0 < cal->t0h_points; ++i0) {
+      const uint8_t p = (uint8_t)(row + i0);
+      if (cal->rate[p] == DUTYCAL_RATE_INVALID) {
+        printf("\t-");
+      } else {
+        printf("\t%u%s", cal->rate[p],
+               dutycal_point_accepted(cal, i1, i0) ? "*" : "");
+      }
+    }
+    printf("\n");
+  }
+  if (cal->state != DUTYCAL_DONE)
+    return;
+  if (cal->found) {
+    printf("=> DShot%u T1H %u T0H %u (%u ns / %u ns), margin %u, %u "
+           "accepted\n",
+           dshot_speed_khz_table[cal->speed], cal->duty.t1h, cal->duty.t0h,
+           dshot_duty_to_ns(cal->duty.t1h, dshot_speed_khz_table[cal->speed]),
+           dshot_duty_to_ns(cal->duty.t0h, dshot_speed_khz_table[cal->speed]),
+           cal->margin, cal->accepted);
+  } else {
+    printf("=> no reliable setting, keep the defaults\n");
+  }
+}
+
+#ifdef __cplusplus
+}
+#endif
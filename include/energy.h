@@ -0,0 +1,222 @@
+/**
+ * @file energy.h
+ * @defgroup energy energy
+ * @brief Per ESC electrical energy and charge integration
+ *
+ * @ref kissesc_telem_t::consumption is reported in whole mAh, which is too
+ * coarse for short test steps. This module integrates
+ * `centi_voltage x centi_current` over the telemetry timestamps with the
+ * trapezoidal rule, which handles irregular sample intervals.
+ *
+ * Integer units (no FPU on the pico):
+ *
+ * - power: 1e-4 W (0.01 V x 0.01 A)
+ * - energy: 1e-10 J (1e-4 W x 1 us), @ref ENERGY_UNITS_PER_MJ per mJ
+ * - charge: 1e-8 C (0.01 A x 1 us), @ref CHARGE_UNITS_PER_MC per mC
+ *
+ * Timestamps are u32 us, and intervals are computed modulo 2^32 so that
+ * the timer wrapping around (every ~71 minutes) is harmless.
+ * Intervals longer than @ref energy_integrator_t::max_gap_us (dropped or
+ * corrupt samples) are not integrated: they are counted, and their time
+ * is excluded from @ref energy_integrator_t::covered_us.
+ *
+ * Energy and charge between two points in time (e.g. one step of a test)
+ * are read with @ref energy_mark and @ref energy_since.
+ */
+
+#pragma once
+#include "kissesctelem.h"
+#include "stdbool.h"
+#include "stdint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ENERGY_UNITS_PER_MJ 10000000ull
+#define CHARGE_UNITS_PER_MC 100000ull
+
+/**
+ * @brief integrator of one ESC
+ *
+ * @param max_gap_us longest interval between samples that is integrated
+ * @param energy total energy (1e-10 J)
+ * @param charge total charge (1e-8 C)
+ * @param covered_us total time integrated over
+ * @param gaps intervals that were too long (or went backwards)
+ * @param gap_us total time of those intervals
+ * @param samples samples received
+ * @param last_us timestamp of the previous sample
+ * @param last_power power of the previous sample (1e-4 W)
+ * @param last_current current of the previous sample (0.01 A)
+ * @param primed a previous sample exists
+ */
+typedef struct energy_integrator {
+  uint32_t max_gap_us;
+  uint64_t energy;
+  uint64_t charge;
+  uint64_t covered_us;
+  uint32_t gaps;
+  uint64_t gap_us;
+  uint32_t samples;
+  uint32_t last_us;
+  uint32_t last_power;
+  uint16_t last_current;
+  bool primed;
+} energy_integrator_t;
+
+/**
+ * @brief totals at a point in time, see @ref energy_mark
+ */
+typedef struct energy_mark {
+  uint64_t energy;
+  uint64_t charge;
+  uint64_t covered_us;
+  uint64_t gap_us;
+} energy_mark_t;
+
+/**
+ * @brief energy and charge between a mark and now
+ *
+ * @param energy 1e-10 J
+ * @param charge 1e-8 C
+ * @param covered_us time integrated over
+ * @param gap_us time not integrated over because of gaps
+ */
+typedef struct energy_step {
+  uint64_t energy;
+  uint64_t charge;
+  uint64_t covered_us;
+  uint64_t gap_us;
+} energy_step_t;
+
+/**
+ * @brief reset the integrator
+ *
+ * @param integ
+ * @param max_gap_us longest interval that is integrated. A few telemetry
+ * request intervals is a good choice
+ */
+static inline void energy_init(energy_integrator_t *const integ,
+                               const uint32_t max_gap_us) {
+  integ->max_gap_us = max_gap_us;
+  integ->energy = 0;
+  integ->charge = 0;
+  integ->covered_us = 0;
+  integ->gaps = 0;
+  integ->gap_us = 0;
+  integ->samples = 0;
+  integ->last_us = 0;
+  integ->last_power = 0;
+  integ->last_current = 0;
+  integ->primed = false;
+}
+
+/**
+ * @brief integrate up to a new sample
+ *
+ * @param integ
+ * @param centi_voltage 0.01 V
+ * @param centi_current 0.01 A
+ * @param timestamp_us time the sample was received
+ */
+static inline void energy_update_raw(energy_integrator_t *const integ,
+                                     const uint16_t centi_voltage,
+                                     const uint16_t centi_current,
+                                     const uint32_t timestamp_us) {
+  const uint32_t power = (uint32_t)centi_voltage * centi_current;
+  integ->samples++;
+
+  if (integ->primed) {
+    // Modulo 2^32, so a timer wrap around still gives the right interval
+    const uint32_t dt = timestamp_us - integ->last_us;
+    if (dt == 0 || dt > integ->max_gap_us) {
+      // Backwards timestamps show up as huge intervals too
+      integ->gaps++;
+      if (dt <= INT32_MAX)
+        integ->gap_us += dt;
+    } else {
+      // Trapezoid: (p0 + p1) / 2 * dt
+      integ->energy += ((uint64_t)integ->last_power + power) * dt / 2;
+      integ->charge +=
+          ((uint64_t)integ->last_current + centi_current) * dt / 2;
+      integ->covered_us += dt;
+    }
+  }
+
+  integ->last_us = timestamp_us;
+  integ->last_power = power;
+  integ->last_current = centi_current;
+  integ->primed = true;
+}
+
+/**
+ * @brief integrate up to a new telemetry sample
+ *
+ * @param integ
+ * @param telem telemetry with a valid crc
+ * @param timestamp_us time the sample was received
+ */
+static inline void energy_update(energy_integrator_t *const integ,
+                                 const kissesc_telem_t *const telem,
+                                 const uint32_t timestamp_us) {
+  energy_update_raw(integ, telem->centi_voltage, telem->centi_current,
+                    timestamp_us);
+}
+
+/**
+ * @brief save the totals, e.g. at the start of a test step
+ *
+ * @param integ
+ * @param mark
+ */
+static inline void energy_mark(const energy_integrator_t *const integ,
+                               energy_mark_t *const mark) {
+  mark->energy = integ->energy;
+  mark->charge = integ->charge;
+  mark->covered_us = integ->covered_us;
+  mark->gap_us = integ->gap_us;
+}
+
+/**
+ * @brief energy and charge since a mark, e.g. at the end of a test step
+ *
+ * @param integ
+ * @param mark
+ * @param step
+ */
+static inline void energy_since(const energy_integrator_t *const integ,
+                                const energy_mark_t *const mark,
+                                energy_step_t *const step) {
+  step->energy = integ->energy - mark->energy;
+  step->charge = integ->charge - mark->charge;
+  step->covered_us = integ->covered_us - mark->covered_us;
+  step->gap_us = integ->gap_us - mark->gap_us;
+}
+
+/// @brief energy in whole mJ
+static inline uint64_t energy_to_mj(const uint64_t energy) {
+  return energy / ENERGY_UNITS_PER_MJ;
+}
+
+/// @brief charge in whole mC
+static inline uint64_t charge_to_mc(const uint64_t charge) {
+  return charge / CHARGE_UNITS_PER_MC;
+}
+
+/**
+ * @brief mean power over a step
+ *
+ * @param step
+ * @return power in mW, 0 if nothing was integrated
+ */
+static inline uint32_t energy_step_mean_power_mw(
+    const energy_step_t *const step) {
+  // 1e-10 J / 1 us = 1e-4 W = 0.1 mW
+  return step->covered_us ? (uint32_t)(step->energy / step->covered_us / 10)
+                          : 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
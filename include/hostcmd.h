@@ -0,0 +1,468 @@
+/**
+ * @file hostcmd.h
+ * @defgroup hostcmd hostcmd
+ * @brief Framed binary command channel from the host
+ *
+ * The keyboard examples map one ASCII key to one action, so queued keys
+ * execute late and only one motor can be changed at a time.
+ * This module parses binary frames incrementally (one byte at a time, as
+ * they are drained from the stdio rx ring) and applies them at the next
+ * dshot frame boundary through @ref hostcmd_frame_hook.
+ *
+ * Frame layout:
+ *
+ * | Byte(s)   | Field                                  |
+ * | :-------: | -------------------------------------- |
+ * | 0 \| 1    | sync 0xA5 0x5A                         |
+ * |    2      | payload length (<= HOSTCMD_MAX_PAYLOAD)|
+ * |    3      | sequence number                        |
+ * |    4      | command type (@ref hostcmd_type)       |
+ * | 5 ...     | payload (little endian)                |
+ * |   last    | CRC8 of bytes 2 to the end of payload  |
+ *
+ * The CRC8 is the same as the KISS telemetry CRC (@ref kissesc_get_crc8).
+ * `tools/hostcmd.py` encodes frames on the host.
+ */
+
+#pragma once
+#include "kissesctelem.h"
+#include "packet.h"
+#include "stdbool.h"
+#include "stdint.h"
+
+#if PICO_ON_DEVICE
+#include "hardware/sync.h"
+#endif
+
+/// @brief number of ESCs (see onewire.h)
+#ifndef ESC_COUNT
+#define ESC_COUNT 1
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HOSTCMD_SYNC0 0xA5
+#define HOSTCMD_SYNC1 0x5A
+#define HOSTCMD_MAX_PAYLOAD 64
+/// sync (2) + length + seq + type + crc
+#define HOSTCMD_OVERHEAD 6
+/// ESC idx used by @ref HOSTCMD_SPECIAL to address every motor
+#define HOSTCMD_ALL_ESCS 0xff
+/// Special commands are below this code (= DSHOT_ZERO_THROTTLE)
+#define HOSTCMD_SPECIAL_CMD_LIMIT 48
+
+#if PICO_ON_DEVICE
+#define HOSTCMD_BARRIER() __dmb()
+#else
+#define HOSTCMD_BARRIER() __sync_synchronize()
+#endif
+
+/**
+ * @brief command types
+ *
+ * - @ref HOSTCMD_THROTTLE: n x u16 throttle codes (n <= ESC_COUNT), for
+ * motors 0 ... n-1. Each motor applies its code at its own next frame
+ * boundary: motors on separate timers may pick up a vector a frame apart
+ * - @ref HOSTCMD_SPECIAL: u8 esc idx (or @ref HOSTCMD_ALL_ESCS),
+ * u8 special command code (< @ref HOSTCMD_SPECIAL_CMD_LIMIT), u8 repeat count.
+ * The command is sent with the telemetry bit set, repeat times,
+ * then the motor resumes its throttle code
+ * - @ref HOSTCMD_TELEM_CONFIG: u8 enable, u32 request interval in us.
+ * Read by the application with @ref hostcmd_take_telem_config
+ * - @ref HOSTCMD_DECIM_CONFIG: u8 esc idx (or @ref HOSTCMD_ALL_ESCS),
+ * u16 samples, u32 window in us (see telemdecim.h).
+ * Read by the application with @ref hostcmd_take_decim_config
+ */
+enum hostcmd_type {
+  HOSTCMD_THROTTLE = 0x01,
+  HOSTCMD_SPECIAL = 0x02,
+  HOSTCMD_TELEM_CONFIG = 0x03,
+  HOSTCMD_DECIM_CONFIG = 0x04,
+};
+
+enum hostcmd_parse_state {
+  HOSTCMD_WAIT_SYNC0,
+  HOSTCMD_WAIT_SYNC1,
+  HOSTCMD_WAIT_LEN,
+  HOSTCMD_WAIT_SEQ,
+  HOSTCMD_WAIT_TYPE,
+  HOSTCMD_WAIT_PAYLOAD,
+  HOSTCMD_WAIT_CRC,
+};
+
+/**
+ * @brief telemetry configuration requested by the host
+ *
+ * @param enable request telemetry
+ * @param interval_us telemetry request interval
+ */
+typedef struct hostcmd_telem_config {
+  bool enable;
+  uint32_t interval_us;
+} hostcmd_telem_config_t;
+
+/**
+ * @brief telemetry decimation requested by the host
+ *
+ * @param esc ESC idx, or @ref HOSTCMD_ALL_ESCS
+ * @param samples samples per record (0 => no limit)
+ * @param window_us window per record (0 => no limit)
+ */
+typedef struct hostcmd_decim_config {
+  uint8_t esc;
+  uint16_t samples;
+  uint32_t window_us;
+} hostcmd_decim_config_t;
+
+struct hostcmd;
+
+/**
+ * @brief per motor state, registered as the frame hook data
+ *
+ * @param cmd owning command channel
+ * @param idx motor idx in the throttle vector
+ * @param special_code pending special command
+ * @param special_repeat frames left to send @ref special_code
+ */
+typedef struct hostcmd_motor {
+  struct hostcmd *cmd;
+  uint8_t idx;
+  volatile uint8_t special_code;
+  volatile uint8_t special_repeat;
+} hostcmd_motor_t;
+
+/**
+ * @brief command channel state
+ *
+ * Throttle vectors are double buffered: the parser fills the inactive
+ * buffer, then flips @ref active. The frame hooks only ever read the
+ * active buffer, so a motor never sees half of a vector.
+ *
+ * @param state parser state
+ * @param len payload length of the current frame
+ * @param seq sequence number of the current frame
+ * @param type command type of the current frame
+ * @param payload_idx bytes of payload received
+ * @param crc running CRC8 of the current frame
+ * @param payload payload of the current frame
+ * @param codes double buffered throttle vector
+ * @param active idx of the buffer read by the frame hooks
+ * @param valid false until the first throttle vector is received.
+ * Until then, the frame hooks leave the packets untouched
+ * @param expected_seq sequence number of the next frame
+ * @param frames number of valid frames
+ * @param crc_errors number of frames dropped because of a bad CRC
+ * @param seq_gaps number of frames missed according to their seq
+ * @param bad_frames number of frames with an invalid length or payload
+ * @param telem_config last telemetry configuration
+ * @param telem_config_pending true until @ref hostcmd_take_telem_config
+ * @param decim_config last telemetry decimation
+ * @param decim_config_pending true until @ref hostcmd_take_decim_config
+ * @param motors per motor state
+ */
+typedef struct hostcmd {
+  enum hostcmd_parse_state state;
+  uint8_t len;
+  uint8_t seq;
+  uint8_t type;
+  uint8_t payload_idx;
+  uint8_t crc;
+  uint8_t payload[HOSTCMD_MAX_PAYLOAD];
+
+  uint16_t codes[2][ESC_COUNT];
+  volatile uint8_t active;
+  volatile bool valid;
+
+  uint8_t expected_seq;
+  uint32_t frames;
+  uint32_t crc_errors;
+  uint32_t seq_gaps;
+  uint32_t bad_frames;
+
+  hostcmd_telem_config_t telem_config;
+  bool telem_config_pending;
+
+  hostcmd_decim_config_t decim_config;
+  bool decim_config_pending;
+
+  hostcmd_motor_t motors[ESC_COUNT];
+} hostcmd_t;
+
+/**
+ * @brief initialise the command channel
+ *
+ * Register the motors with e.g.
+ * `dshot_set_frame_hook(dshots[i], hostcmd_frame_hook, &cmd->motors[i])`
+ *
+ * @param cmd
+ */
+static inline void hostcmd_init(hostcmd_t *const cmd) {
+  cmd->state = HOSTCMD_WAIT_SYNC0;
+  cmd->active = 0;
+  cmd->valid = false;
+  cmd->expected_seq = 0;
+  cmd->frames = 0;
+  cmd->crc_errors = 0;
+  cmd->seq_gaps = 0;
+  cmd->bad_frames = 0;
+  cmd->telem_config_pending = false;
+  cmd->decim_config_pending = false;
+  for (size_t i = 0; i < ESC_COUNT; ++i) {
+    cmd->codes[0][i] = 0;
+    cmd->codes[1][i] = 0;
+    cmd->motors[i].cmd = cmd;
+    cmd->motors[i].idx = i;
+    cmd->motors[i].special_code = 0;
+    cmd->motors[i].special_repeat = 0;
+  }
+}
+
+static inline uint16_t hostcmd_u16(const uint8_t *const bytes) {
+  return bytes[0] | bytes[1] << 8;
+}
+
+static inline uint32_t hostcmd_u32(const uint8_t *const bytes) {
+  return (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 |
+         (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+/**
+ * @brief publish a throttle vector. It is picked up by every motor at its
+ * next frame boundary
+ *
+ * @param cmd
+ * @param codes throttle codes for motors 0 ... count-1
+ * @param count number of codes (<= ESC_COUNT). Other motors keep their code
+ */
+static inline void hostcmd_publish_throttle(hostcmd_t *const cmd,
+                                            const uint16_t codes[],
+                                            const size_t count) {
+  const uint8_t next = !cmd->active;
+  for (size_t i = 0; i < ESC_COUNT; ++i) {
+    cmd->codes[next][i] =
+        i < count ? (codes[i] & 0x7ff) : cmd->codes[cmd->active][i];
+  }
+  // The whole vector must be visible before it becomes active
+  HOSTCMD_BARRIER();
+  cmd->active = next;
+  cmd->valid = true;
+}
+
+/**
+ * @brief apply a complete, CRC checked frame
+ *
+ * @param cmd
+ * @return false if the frame has an unknown type or invalid payload
+ */
+static inline bool hostcmd_dispatch(hostcmd_t *const cmd) {
+  const uint8_t *const payload = cmd->payload;
+  switch (cmd->type) {
+  case HOSTCMD_THROTTLE: {
+    const size_t count = cmd->len / 2;
+    if (cmd->len % 2 || count == 0 || count > ESC_COUNT)
+      return false;
+    uint16_t codes[ESC_COUNT];
+    for (size_t i = 0; i < count; ++i) {
+      codes[i] = hostcmd_u16(&payload[2 * i]);
+    }
+    hostcmd_publish_throttle(cmd, codes, count);
+    return true;
+  }
+
+  case HOSTCMD_SPECIAL: {
+    const uint8_t esc = payload[0], code = payload[1], repeat = payload[2];
+    if (cmd->len != 3 || code >= HOSTCMD_SPECIAL_CMD_LIMIT ||
+        (esc >= ESC_COUNT && esc != HOSTCMD_ALL_ESCS))
+      return false;
+    for (size_t i = 0; i < ESC_COUNT; ++i) {
+      if (esc == HOSTCMD_ALL_ESCS || esc == i) {
+        // Clear repeat first, so the frame hook never sees a mixed update
+        cmd->motors[i].special_repeat = 0;
+        cmd->motors[i].special_code = code;
+        cmd->motors[i].special_repeat = repeat;
+      }
+    }
+    return true;
+  }
+
+  case HOSTCMD_TELEM_CONFIG:
+    if (cmd->len != 5)
+      return false;
+    cmd->telem_config.enable = payload[0];
+    cmd->telem_config.interval_us = hostcmd_u32(&payload[1]);
+    cmd->telem_config_pending = true;
+    return true;
+
+  case HOSTCMD_DECIM_CONFIG:
+    if (cmd->len != 7 || (payload[0] >= ESC_COUNT &&
+                          payload[0] != HOSTCMD_ALL_ESCS))
+      return false;
+    cmd->decim_config.esc = payload[0];
+    cmd->decim_config.samples = hostcmd_u16(&payload[1]);
+    cmd->decim_config.window_us = hostcmd_u32(&payload[3]);
+    cmd->decim_config_pending = true;
+    return true;
+
+  default:
+    return false;
+  }
+}
+
+/**
+ * @brief feed one received byte to the parser
+ *
+ * @param cmd
+ * @param byte
+ * @return true if the byte completed a valid frame (which has been applied)
+ */
+static inline bool hostcmd_feed(hostcmd_t *const cmd, const uint8_t byte) {
+  switch (cmd->state) {
+  case HOSTCMD_WAIT_SYNC0:
+    if (byte == HOSTCMD_SYNC0)
+      cmd->state = HOSTCMD_WAIT_SYNC1;
+    break;
+
+  case HOSTCMD_WAIT_SYNC1:
+    if (byte == HOSTCMD_SYNC1)
+      cmd->state = HOSTCMD_WAIT_LEN;
+    else if (byte != HOSTCMD_SYNC0)
+      cmd->state = HOSTCMD_WAIT_SYNC0;
+    break;
+
+  case HOSTCMD_WAIT_LEN:
+    if (byte > HOSTCMD_MAX_PAYLOAD) {
+      cmd->bad_frames++;
+      cmd->state = HOSTCMD_WAIT_SYNC0;
+      break;
+    }
+    cmd->len = byte;
+    cmd->crc = kissesc_update_crc(byte, 0);
+    cmd->state = HOSTCMD_WAIT_SEQ;
+    break;
+
+  case HOSTCMD_WAIT_SEQ:
+    cmd->seq = byte;
+    cmd->crc = kissesc_update_crc(byte, cmd->crc);
+    cmd->state = HOSTCMD_WAIT_TYPE;
+    break;
+
+  case HOSTCMD_WAIT_TYPE:
+    cmd->type = byte;
+    cmd->crc = kissesc_update_crc(byte, cmd->crc);
+    cmd->payload_idx = 0;
+    cmd->state = cmd->len ? HOSTCMD_WAIT_PAYLOAD : HOSTCMD_WAIT_CRC;
+    break;
+
+  case HOSTCMD_WAIT_PAYLOAD:
+    cmd->payload[cmd->payload_idx++] = byte;
+    cmd->crc = kissesc_update_crc(byte, cmd->crc);
+    if (cmd->payload_idx == cmd->len)
+      cmd->state = HOSTCMD_WAIT_CRC;
+    break;
+
+  case HOSTCMD_WAIT_CRC:
+    cmd->state = HOSTCMD_WAIT_SYNC0;
+    if (kissesc_update_crc(byte, cmd->crc) != 0) {
+      cmd->crc_errors++;
+      return false;
+    }
+    if (cmd->frames && cmd->seq != cmd->expected_seq)
+      cmd->seq_gaps += (uint8_t)(cmd->seq - cmd->expected_seq);
+    cmd->expected_seq = cmd->seq + 1;
+    cmd->frames++;
+    if (!hostcmd_dispatch(cmd)) {
+      cmd->bad_frames++;
+      return false;
+    }
+    return true;
+  }
+  return false;
+}
+
+/**
+ * @brief return the telemetry configuration if the host sent a new one
+ *
+ * @param cmd
+ * @param config output
+ * @return true if @a config was updated
+ */
+static inline bool hostcmd_take_telem_config(hostcmd_t *const cmd,
+                                             hostcmd_telem_config_t *config) {
+  if (!cmd->telem_config_pending)
+    return false;
+  *config = cmd->telem_config;
+  cmd->telem_config_pending = false;
+  return true;
+}
+
+/**
+ * @brief return the decimation configuration if the host sent a new one
+ *
+ * @param cmd
+ * @param config output
+ * @return true if @a config was updated
+ */
+static inline bool hostcmd_take_decim_config(hostcmd_t *const cmd,
+                                             hostcmd_decim_config_t *config) {
+  if (!cmd->decim_config_pending)
+    return false;
+  *config = cmd->decim_config;
+  cmd->decim_config_pending = false;
+  return true;
+}
+
+/**
+ * @brief frame hook (see @ref dshot_set_frame_hook) that applies the host
+ * commands to a motor
+ *
+ * Pending special commands take priority over the throttle vector.
+ *
+ * @param packet
+ * @param data @ref hostcmd_motor_t of this motor
+ */
+static inline void hostcmd_frame_hook(dshot_packet_t *const packet,
+                                      void *const data) {
+  hostcmd_motor_t *const motor = (hostcmd_motor_t *)data;
+  const uint8_t repeat = motor->special_repeat;
+  if (repeat) {
+    packet->throttle_code = motor->special_code;
+    packet->telemetry = 1;
+    motor->special_repeat = repeat - 1;
+    return;
+  }
+  const hostcmd_t *const cmd = motor->cmd;
+  if (cmd->valid) {
+    packet->throttle_code = cmd->codes[cmd->active][motor->idx];
+  }
+}
+
+/**
+ * @brief encode a frame (used by tests and host side tools)
+ *
+ * @param type
+ * @param seq
+ * @param payload
+ * @param len payload length (<= HOSTCMD_MAX_PAYLOAD)
+ * @param out buffer of at least len + @ref HOSTCMD_OVERHEAD bytes
+ * @return number of bytes written
+ */
+static inline size_t hostcmd_encode(const uint8_t type, const uint8_t seq,
+                                    const uint8_t payload[], const uint8_t len,
+                                    uint8_t out[]) {
+  out[0] = HOSTCMD_SYNC0;
+  out[1] = HOSTCMD_SYNC1;
+  out[2] = len;
+  out[3] = seq;
+  out[4] = type;
+  for (size_t i = 0; i < len; ++i) {
+    out[5 + i] = payload[i];
+  }
+  out[5 + len] = kissesc_get_crc8(&out[2], 3 + len);
+  return len + HOSTCMD_OVERHEAD;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -91,6 +91,22 @@ kissesc_buffer_to_telem(const volatile uint8_t buffer[KISS_ESC_TELEM_BUFFER_SIZE
   telem_data->crc = kissesc_get_crc8(buffer, KISS_ESC_TELEM_BUFFER_SIZE);
 }
 
+/**
+ * @brief Copy telemetry data, e.g. into a volatile data store
+ *
+ * @param dst
+ * @param src
+ */
+static inline void kissesc_copy_telem(volatile kissesc_telem_t *const dst,
+                                      const kissesc_telem_t *const src) {
+  dst->temperature = src->temperature;
+  dst->centi_voltage = src->centi_voltage;
+  dst->centi_current = src->centi_current;
+  dst->consumption = src->consumption;
+  dst->erpm = src->erpm;
+  dst->crc = src->crc;
+}
+
 static void kissesc_print_buffer(const volatile uint8_t buffer[],
                                  const size_t buffer_size) {
   printf("Buffer:\t0x");
@@ -8,10 +8,15 @@
  */
 
 #pragma once
+#include "dlog.h"
 #include "dshot.h"
 #include "hardware/uart.h"
 #include "kissesctelem.h"
+#include "onewireparse.h"
+#include "replaycap.h"
 #include "stdint.h"
+#include "telemhealth.h"
+#include "telemqueue.h"
 
 /**
  * @brief set the number of ESCs at compile time
@@ -56,14 +61,19 @@ typedef struct esc_motor {
  * @param gpio NOTE: only one gpio because esc telem is one wire
  * @param send_req_rt Repeating timer config for preodically requesting
  * telemetry
- * @param buffer_size = 10 KISS telemetry protocol outputs 10 bytes
- * Storing uart telemetry output
- * @param buffer_idx Keep track of idx in uart telemetry buffer
- * @param buffer Array to hold telemetry buffer data
+ * @param parser reply buffer and request slot (see onewireparse.h).
+ * @ref onewire_parser_t::esc_idx is the ESC telemetry is requested from
  * @param telem_updated_esc -1 <= telem_updated_esc < ESC_COUNT
  * default -1. If telemetry is received for an ESC, then the ESC idx
  * is stored in this variable. This idx should be reset
  * by a main process (e.g. upon reading the onewire data).
+ * @param queue every decoded telemetry sample is also pushed to this queue,
+ * so that a main process can consume all of them (see @ref telem_queue_pop)
+ * @param health telemetry health of each ESC (see telemhealth.h). Set
+ * @ref telemhealth_t::stale_cycles after @ref telem_uart_init to change
+ * the default of @ref TELEMHEALTH_STALE_CYCLES
+ * @param capture optional capture of the slots, requests and uart bytes
+ * (see replaycap.h). NULL (the default) => off
  */
 typedef struct telem_uart {
   uart_inst_t *uart;
@@ -72,14 +82,16 @@ typedef struct telem_uart {
   repeating_timer_t send_req_rt; // Repeating timer config for periodically
                                  // requesting telemetry
   bool send_req_rt_state;        // Keep track of repeating timer state
-  volatile size_t esc_motor_idx; // Keep track of which esc to request telem
   volatile esc_motor_t escs[ESC_COUNT];
 
-  // variable to store the result from a telemetry read in an irq
-  volatile size_t buffer_idx;
-  volatile uint8_t buffer[KISS_ESC_TELEM_BUFFER_SIZE];
+  // the reply being received, and the slot it belongs to
+  onewire_parser_t parser;
   // flag is updated when esc telemetry has been received
   int telem_updated_esc;
+  // queue of all received telemetry samples
+  telem_queue_t queue;
+  volatile telemhealth_t health[ESC_COUNT];
+  replaycap_t *capture;
 } onewire_t;
 
 // Global variable for onewire
@@ -109,123 +121,158 @@ static inline bool validate_uart_rx_gpio(const uint gpio) {
  *
  * When onewire is receiving data over uart, an interrupt will be raised.
  * This routine is called as an interrupt service routine.
- * This routine stores the telemtry data in onewire->buffer.
+ * This routine stores the telemtry data in the parser's buffer.
  * Once the buffer is full, the buffer is parsed to telemtry data
- * and stored in the relevant ESC's telem_data data store.
- * Also, onewire->telem_updated_esc is set after translation.
+ * (@ref onewire_parse_chunk: timestamped, reported to the ESC's health and
+ * pushed to onewire->queue) and stored in the relevant ESC's telem_data
+ * data store. Also, onewire->telem_updated_esc is set after translation.
  *
  * NOTE: we assume that the uart is automatically cleared in hw
+ * NOTE: this runs in an isr, so log with @ref DLOG instead of printf
  */
 static void onewire_uart_irq(void) {
+  const uint32_t now_us = time_us_32();
+  // The request timer can't preempt this isr (same priority, see rtpool.h),
+  // so the slot doesn't change under it
+  const size_t idx = onewire.parser.esc_idx;
+  // Raised by the rx timeout (rather than the fifo level)? Cleared by reading
+  const bool rx_timeout =
+      uart_get_hw(onewire.uart)->mis & UART_UARTMIS_RTMIS_BITS;
+  const size_t start_idx = onewire.parser.buffer_idx;
+  replaycap_t *const cap = onewire.capture;
+  uint8_t bytes[REPLAYCAP_MAX_PAYLOAD];
+  size_t count = 0;
   // Read uart greedily
   while (uart_is_readable(onewire.uart)) {
-    // Read char from uart
-    const char c = uart_getc(onewire.uart);
-    // Check if reached end of buffer
-    if (onewire.buffer_idx >= KISS_ESC_TELEM_BUFFER_SIZE) {
-      /// NOTE: This printf may not be printed because its long
-      // hence code should handle this elsewhere
-      // for example, take a look at validate_onewire_repeating_req
-      printf("Onewire overflow\n");
-    } else {
-      onewire.buffer[onewire.buffer_idx] = (uint8_t)c;
-      // printf("%x\t", c);
+    const uint8_t byte = (uint8_t)uart_getc(onewire.uart);
+    if (count < REPLAYCAP_MAX_PAYLOAD)
+      bytes[count++] = byte;
+    if (!onewire_parse_byte(&onewire.parser, byte)) {
+      // Deferred log, because printf would block this isr.
+      // The parser is resynced at the end of the request slot
+      // (see onewire_end_slot)
+      DLOG(DLOG_ONEWIRE_OVERFLOW, onewire.parser.buffer_idx - 1);
     }
-    onewire.buffer_idx++;
-    // printf("UART: %x\n", onewire.buffer[onewire.buffer_idx - 1]);
   }
-  if (onewire.buffer_idx == KISS_ESC_TELEM_BUFFER_SIZE) {
-    // Convert buffer to telemetry data and populate the relevant ESC
-    kissesc_buffer_to_telem(onewire.buffer,
-                            &onewire.escs[onewire.esc_motor_idx].telem_data);
+  const dshot_config *const dshot = onewire.escs[idx].dshot;
+  if (cap && replaycap_running(cap)) {
+    // The request frame first, as the parser uses it
+    replaycap_requests(cap, idx, dshot->telem_requests,
+                       dshot->telem_request_us, dshot->telem_request_code);
+    replaycap_push(cap, REPLAYCAP_UART, rx_timeout ? REPLAYCAP_RX_TIMEOUT : 0,
+                   now_us, bytes, count);
+  }
+  const onewire_request_t req = {dshot->telem_requests,
+                                 dshot->telem_request_us,
+                                 dshot->telem_request_code};
+  telem_sample_t sample;
+  if (onewire_parse_chunk(&onewire.parser, start_idx, now_us, rx_timeout,
+                          onewire.baudrate, &req, &onewire.health[idx],
+                          &onewire.queue, &sample)) {
+    // Populate the relevant ESC
+    kissesc_copy_telem(&onewire.escs[idx].telem_data, &sample.telem);
     // Update parameter to let main process know that telemetry data has been
     // receieved
-    onewire.telem_updated_esc = onewire.esc_motor_idx;
-    // Reset buffer idx
-    onewire.buffer_idx = 0;
-    // Debug: Print onewire buffer:
-    // kissesc_print_buffer(onewire.buffer, KISS_ESC_TELEM_BUFFER_SIZE);
+    onewire.telem_updated_esc = idx;
   }
 }
 
 /**
- * @brief Validation checks, else return false
- * This function should be called before sending a uart telemetry request (e.g.
- * in @ref onewire_repeating_req)
+ * @brief drop whatever the parser holds, and the bytes still in the rx fifo
  *
- * 1. All telemtry bits in ESCs should be unset
- * 2. telem->buffer_idx == KISS_ESC_TELEM_BUFFER_SIZE
+ * The next reply then starts at the beginning of the buffer. The fifo is
+ * 32 bytes deep, so this is bounded.
  *
- * @param telem onewire_t
- * @return true  if validation checks pass
- * @return false if validation checks fail
+ * @param telem
  */
-static inline bool validate_onewire_repeating_req(onewire_t *const telem) {
-  // Check if telemetry bit set in any ESC
-  uint telemetry_bit_set = 0;
-  for (size_t i = 0; i < ESC_COUNT; ++i) {
-    telemetry_bit_set += telem->escs[i].dshot->packet.telemetry;
+static inline void onewire_resync(onewire_t *const telem) {
+  // Log the first 8 bytes of the buffer (big endian, as they were received)
+  const size_t idx = telem->parser.buffer_idx;
+  uint32_t words[2] = {0};
+  for (size_t i = 0; i < MIN(idx, 8); ++i) {
+    words[i / 4] |= (uint32_t)telem->parser.buffer[i] << (8 * (3 - i % 4));
   }
-  if (telemetry_bit_set) {
-    printf("WARN: Telemetry bit set:\t%i\n", telemetry_bit_set);
-    return false;
+  DLOG(DLOG_ONEWIRE_BUFFER_IDX, idx, words[0], words[1]);
+  while (uart_is_readable(telem->uart)) {
+    uart_getc(telem->uart);
   }
+  telem->parser.buffer_idx = 0;
+}
 
-  // Check if buffer_idx = buffer size
-  // to verify we have recieved all telemetry data
-  if (telem->buffer_idx != KISS_ESC_TELEM_BUFFER_SIZE) {
-    printf("WARN: Telemetry buffer idx:\t%i\t", telem->buffer_idx);
-    printf("Buffer:\t");
-    // Dump contents of buffer up till buffer_idx
-    for (size_t i = 0; i < MIN(telem->buffer_idx, KISS_ESC_TELEM_BUFFER_SIZE);
-         ++i) {
-      printf("%.2x", telem->buffer[i]);
-    }
-    printf("\n");
-    return false;
+/**
+ * @brief end the request slot of the current ESC, and recover if needed
+ *
+ * O(1): only the ESC of the slot is checked.
+ *
+ * 1. A telemetry bit still set means the request frame was never sent.
+ *    Clear it, so that it can't go out in another ESC's slot
+ * 2. Classify the slot (@ref telemhealth_slot_end). On left over bytes, a
+ *    corrupt reply, or when the ESC goes stale, resync the parser
+ *
+ * @param telem
+ */
+static inline void onewire_end_slot(onewire_t *const telem) {
+  const size_t idx = telem->parser.esc_idx;
+  dshot_config *const dshot = telem->escs[idx].dshot;
+  const bool stuck = dshot->packet.telemetry;
+  dshot->packet.telemetry = 0;
+  const bool sent = onewire_request_sent(&telem->parser, dshot->telem_requests);
+  if (stuck && !sent) {
+    DLOG(DLOG_ONEWIRE_TELEM_BIT_SET, idx);
   }
 
-  return true;
+  volatile telemhealth_t *const health = &telem->health[idx];
+  const bool was_stale = health->stale;
+  if (onewire_slot_end(&telem->parser, health, sent)) {
+    onewire_resync(telem);
+  }
+  if (health->stale != was_stale) {
+    DLOG(health->stale ? DLOG_TELEMHEALTH_STALE : DLOG_TELEMHEALTH_RECOVERED,
+         idx, health->stale ? health->consecutive : health->recoveries);
+  }
 }
 
 /**
  * @brief Function for repeatedly request telemetry
  *
- * Set the telemetry bit in the ESCs in a round-robin fashion.
+ * End the slot of the current ESC (see @ref onewire_end_slot), then set
+ * the telemetry bit of the next ESC, in a round-robin fashion.
  * @attention This assumes that dshot_send_packet resets the telemetry bit after
  * sending the packet. We also assume that this routine will not interrupt
- * dshot_send_packet (which I believe is true if we use the same alarm pool,
- * because alarms on the same pool have the same priority, hence don't interrupt
- * each other)
+ * dshot_send_packet (which is true if we use the same alarm pool, because
+ * alarms on the same pool have the same priority, hence don't interrupt
+ * each other, and the dma irq shares that priority, see rtpool.h), nor be
+ * interrupted by onewire_uart_irq in the middle of the slot switch (the
+ * uart irq shares that priority too, so use the pool of @ref rtpool_init)
  *
  * @param rt
  * @return `telem->send_req_rt_state` (set this to false to stop requesting
  * telemetry)
  */
 static inline bool onewire_repeating_req(repeating_timer_t *rt) {
+  rtpool_entry(rt, RTPOOL_TELEM_REQ);
   onewire_t *telem = (onewire_t *)(rt->user_data);
-
-  // Perform some validation checks (didn't get this working properly)
-  // if (!validate_onewire_repeating_req(telem)) {
-  //   printf("Warn: onewire failed...\n");
-  //   for (size_t i = 0; i < ESC_COUNT; ++i) {
-  //     telem->escs[i].dshot->packet.telemetry = 0;
-  //   }
-  //   telem->send_req_rt_state = false;
-  //   return false;
-  // }
-  // printf("TlmReq\n");
-
-  // --- Reset data:
-  // Reset telemetry bit if not done so
-  telem->escs[telem->esc_motor_idx].dshot->packet.telemetry = 0;
-  // Reset buffer_idx
-  telem->buffer_idx = 0;
-  // No need to reset onewire->buffer, because it will be overwritten anyways
-
+  replaycap_t *const cap = telem->capture;
+
+  if (telem->parser.slot_open) {
+    if (cap && replaycap_running(cap)) {
+      const size_t idx = telem->parser.esc_idx;
+      const dshot_config *const dshot = telem->escs[idx].dshot;
+      replaycap_requests(cap, idx, dshot->telem_requests,
+                         dshot->telem_request_us, dshot->telem_request_code);
+    }
+    onewire_end_slot(telem);
+  }
   // Configure the next ESC to request telemetry over uart
-  telem->esc_motor_idx = (telem->esc_motor_idx + 1) % ESC_COUNT;
-  telem->escs[telem->esc_motor_idx].dshot->packet.telemetry = 1;
+  const size_t idx = (telem->parser.esc_idx + 1) % ESC_COUNT;
+  dshot_config *const dshot = telem->escs[idx].dshot;
+  if (cap) {
+    replaycap_slot(cap, idx, dshot->telem_requests, time_us_32(), ESC_COUNT,
+                   telem->baudrate, telem->health[idx].stale_cycles,
+                   telem->queue.seq);
+  }
+  onewire_slot_start(&telem->parser, idx, dshot->telem_requests);
+  dshot->packet.telemetry = 1;
 
   return telem->send_req_rt_state;
 }
@@ -268,13 +315,16 @@ static inline void onewire_uart_gpio_configure(onewire_t *const telem,
  * @param telem
  */
 static void onewire_setup_irq(onewire_t *const telem, irq_handler_t handler) {
-  // Reset buffer idx
-  telem->buffer_idx = 0;
   // No esc telemetry data has been received, so set update variable to -1
   telem->telem_updated_esc = -1;
+  telem_queue_init(&telem->queue);
   // Add exclusive interrupt handler on RX (for parsing onewire telemetry)
   const int UART_IRQ = telem->uart == uart0 ? UART0_IRQ : UART1_IRQ;
   irq_set_exclusive_handler(UART_IRQ, handler);
+  // With the frame and request timers and the dma, above the application:
+  // the request timer mustn't switch slots in the middle of a parse (see
+  // rtpool.h)
+  irq_set_priority(UART_IRQ, RTPOOL_UART_PRIORITY);
   irq_set_enabled(UART_IRQ, true);
   // Enable uart interrupt on RX
   uart_set_irq_enables(telem->uart, true, false);
@@ -290,6 +340,8 @@ static void onewire_setup_irq(onewire_t *const telem, irq_handler_t handler) {
 static void onewire_rt_configure(onewire_t *const telem,
                                  long int telem_interval, alarm_pool_t *pool) {
   telem_interval = MAX(ONEWIRE_MIN_INTERVAL_US * ESC_COUNT, telem_interval);
+  // Don't blame the ESC for the time the timer was stopped
+  telem->parser.slot_open = false;
   telem->send_req_rt_state = alarm_pool_add_repeating_timer_us(
       pool, telem_interval, onewire_repeating_req, telem, &telem->send_req_rt);
 }
@@ -319,8 +371,10 @@ static void telem_uart_init(onewire_t *const telem, uart_inst_t *const uart,
     panic("Expected more than one ESC");
   for (size_t esc_num = 0; esc_num < ESC_COUNT; ++esc_num) {
     telem->escs[esc_num].dshot = escs[esc_num];
+    telemhealth_init(&telem->health[esc_num], TELEMHEALTH_STALE_CYCLES);
   }
-  telem->esc_motor_idx = 0;
+  onewire_parser_init(&telem->parser);
+  telem->capture = NULL;
 
   // Setup onewire uart IRQ to handle telemetry data
   onewire_setup_irq(telem, onewire_uart_irq);
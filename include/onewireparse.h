@@ -0,0 +1,182 @@
+/**
+ * @file onewireparse.h
+ * @defgroup onewireparse onewireparse
+ * @brief Byte and request slot logic of the onewire telemetry, without the
+ * sdk
+ *
+ * onewire.h owns the uart and the request timer. What they do with the
+ * bytes and the slots is here, so that the replay harness
+ * (test/replay_session.hpp) runs the same code as the pico:
+ *
+ * - the uart isr stores each byte it reads (@ref onewire_parse_byte), then
+ *   ends the chunk (@ref onewire_parse_chunk): the bytes are timed and, once
+ *   the 10 byte KISS reply is complete, decoded to a sample that is
+ *   reported to the ESC's health and queued
+ * - the request timer ends the slot of the current ESC
+ *   (@ref onewire_slot_end) and starts the next one
+ *   (@ref onewire_slot_start)
+ */
+
+#pragma once
+#include "kissesctelem.h"
+#include "stdbool.h"
+#include "stddef.h"
+#include "stdint.h"
+#include "telemhealth.h"
+#include "telemlatency.h"
+#include "telemqueue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief parser of the replies, and the request slot they belong to
+ *
+ * @param buffer_idx bytes received in the slot (may exceed the buffer)
+ * @param buffer the reply
+ * @param first_byte_us arrival of the first byte in the buffer
+ * @param esc_idx ESC of the slot
+ * @param req_armed request frames of that ESC when the slot started. The
+ * request has been sent once its count changes
+ * @param slot_open a request slot is in progress (false until the first
+ * request, so that the first timer call doesn't end a slot)
+ */
+typedef struct onewire_parser {
+  volatile size_t buffer_idx;
+  volatile uint8_t buffer[KISS_ESC_TELEM_BUFFER_SIZE];
+  volatile uint32_t first_byte_us;
+  volatile size_t esc_idx;
+  volatile uint32_t req_armed;
+  volatile bool slot_open;
+} onewire_parser_t;
+
+/**
+ * @brief request frames sent to an ESC (dshot_config::telem_requests,
+ * telem_request_us and telem_request_code)
+ *
+ * @param count frames sent with the telemetry bit set
+ * @param us time the last of those was sent
+ * @param code its throttle code
+ */
+typedef struct onewire_request {
+  uint32_t count;
+  uint32_t us;
+  uint16_t code;
+} onewire_request_t;
+
+static inline void onewire_parser_init(onewire_parser_t *const parser) {
+  parser->buffer_idx = 0;
+  parser->first_byte_us = 0;
+  parser->esc_idx = 0;
+  parser->req_armed = 0;
+  parser->slot_open = false;
+}
+
+/**
+ * @brief store a byte read from the uart
+ *
+ * @param parser
+ * @param byte
+ * @return false if the buffer was already full: the byte is dropped, and
+ * the parser is resynced at the end of the slot
+ */
+static inline bool onewire_parse_byte(onewire_parser_t *const parser,
+                                      const uint8_t byte) {
+  const size_t idx = parser->buffer_idx;
+  parser->buffer_idx = idx + 1;
+  if (idx >= KISS_ESC_TELEM_BUFFER_SIZE)
+    return false;
+  parser->buffer[idx] = byte;
+  return true;
+}
+
+/**
+ * @brief end the chunk of bytes read by one run of the uart isr
+ *
+ * Works back to when the bytes arrived (see telemlatency.h). Once the
+ * reply is complete, it is decoded to a sample stamped with the arrival of
+ * its first and last byte and with the request frame, reported to the
+ * ESC's health and queued, and the buffer starts over.
+ *
+ * @param parser
+ * @param start_idx @ref onewire_parser_t::buffer_idx before the chunk
+ * @param now_us time the isr ran
+ * @param rx_timeout the isr was raised by the rx timeout
+ * @param baudrate
+ * @param req request frames of the ESC of the slot
+ * @param health health of that ESC
+ * @param queue
+ * @param sample output, written when a reply completes
+ * @return true if a reply completed
+ */
+static inline bool
+onewire_parse_chunk(onewire_parser_t *const parser, const size_t start_idx,
+                    const uint32_t now_us, const bool rx_timeout,
+                    const uint32_t baudrate, const onewire_request_t *const req,
+                    volatile telemhealth_t *const health,
+                    telem_queue_t *const queue, telem_sample_t *const sample) {
+  const size_t idx = parser->buffer_idx;
+  uint32_t first_us, last_us;
+  telemlatency_chunk_times(now_us, (uint32_t)(idx - start_idx), rx_timeout,
+                           baudrate, &first_us, &last_us);
+  if (start_idx == 0)
+    parser->first_byte_us = first_us;
+  if (idx != KISS_ESC_TELEM_BUFFER_SIZE)
+    return false;
+  sample->timestamp_us = last_us;
+  sample->esc_idx = (uint8_t)parser->esc_idx;
+  sample->first_byte_us = parser->first_byte_us;
+  sample->request_us = req->us;
+  sample->request_code = req->code;
+  sample->request_valid = req->count != parser->req_armed;
+  kissesc_buffer_to_telem(parser->buffer, &sample->telem);
+  telemhealth_reply(health, sample->telem.crc == 0, last_us);
+  // Queue the sample, so that it isn't lost if the main process is busy
+  telem_queue_push(queue, sample);
+  parser->buffer_idx = 0;
+  return true;
+}
+
+/// @brief true if the request of the slot went out (see
+/// @ref onewire_parser_t::req_armed)
+static inline bool onewire_request_sent(const onewire_parser_t *const parser,
+                                        const uint32_t requests) {
+  return requests != parser->req_armed;
+}
+
+/**
+ * @brief end the request slot of the current ESC
+ *
+ * @param parser
+ * @param health health of the ESC of the slot
+ * @param sent see @ref onewire_request_sent
+ * @return true if the parser should be resynced (see
+ * @ref telemhealth_slot_end): drop the buffer and what is left in the fifo
+ */
+static inline bool onewire_slot_end(const onewire_parser_t *const parser,
+                                    volatile telemhealth_t *const health,
+                                    const bool sent) {
+  return telemhealth_slot_end(health, parser->buffer_idx, sent);
+}
+
+/**
+ * @brief start the request slot of an ESC, before its telemetry bit is set
+ *
+ * @param parser
+ * @param esc_idx
+ * @param requests request frames sent to it so far
+ */
+static inline void onewire_slot_start(onewire_parser_t *const parser,
+                                      const size_t esc_idx,
+                                      const uint32_t requests) {
+  // No need to clear the buffer, it is overwritten
+  parser->buffer_idx = 0;
+  parser->esc_idx = esc_idx;
+  parser->req_armed = requests;
+  parser->slot_open = true;
+}
+
+#ifdef __cplusplus
+}
+#endif
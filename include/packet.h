@@ -14,8 +14,13 @@ extern "C"
    * transmit using a rpi pico PWM hw downstream.
    *
    * The DShot protocol requires a frame of 16 bits.
-   * This is converted to a packet of length 20,
-   * where the last 4 elements are an end of frame signal.
+   * This is converted to a packet of 16 pulses followed by zero duty
+   * pulses: the pause that ends the frame. The pause is set in time (see
+   * dshotspeed.h), so the packet length depends on the speed, up to
+   * @ref DSHOT_PACKET_MAX_LENGTH.
+   * Only the frame and the first zero pulse (which takes the line low)
+   * are stored per motor: the rest of the pause is the same for every
+   * motor, and is read by dma from one shared zero tail (see dshot.h).
    * More info can be found in our readme:
    * https://github.com/Guppy16/pico-dshot
    *
@@ -25,14 +30,19 @@ extern "C"
    * Nevertheless, the functions have been segmented for ctest
    */
 
-  #define dshot_packet_length 20
   const uint DSHOT_FRAME_SIZE = 16;
+  /// Longest pause, in zero duty pulses
+  #define DSHOT_PAUSE_MAX_PULSES 8
+  #define DSHOT_PACKET_MAX_LENGTH (16 + DSHOT_PAUSE_MAX_PULSES)
+  /// Pulses stored per motor: the frame, then the first zero pulse
+  #define DSHOT_PACKET_BUFFER_LENGTH (16 + 1)
 
   /**
    * @brief config used for composing dshot packet
    * @ingroup dshot_packet
    *
-   * @param primary_packet_buffer
+   * @param packet_buffer counter compare of each pulse: the frame, then a
+   * zero pulse
    * @param throttle_code dshot throttle code (11 bit)
    * @param telemetry dshot telemetry flag (1 bit)
    * @param pulse_high duty cycle for a dshot high bit
@@ -41,24 +51,40 @@ extern "C"
    * @attention
    * The pwm duty cycles are set by @ref pulse_high or @ref pulse_low.
    * These duty cycle set the counter compare value used by the internal timers.
-   * These are 16 bits; however the pico uses 32 bits to store the value of two timers,
-   * where each half stores the timer for a different pwm \a channel.
-   * In @ref dshot.h, @ref pulse_high and @ref pulse_low are set as follows:
+   * These are 16 bits; the pico stores the values of both channels of a
+   * slice in one 32 bit register, each half for a different pwm \a channel.
+   * The buffer holds 16 bit values, sent by dma as 16 bit writes: the
+   * rp2040 replicates a narrow write across the 32 bit bus, so the value
+   * lands in the motor's half of the register whichever its channel is
+   * (and in the other half too, see dshot.h). So no shift is needed:
    * ```
-   *  pulse_high = (uint32_t)(0.75 * pwm_wrap) << (16 * pwm_channel)
-   *  pulse_low  = (uint32_t)(0.37 * pwm_wrap) << (16 * pwm_channel)
+   *  pulse_high = round(t1h * (pwm_wrap + 1))
+   *  pulse_low  = round(t0h * (pwm_wrap + 1))
    * ```
-   * More details about this shift for pwm_channel can be found in pico hardware/pwm
+   * where t1h and t0h default to 0.75 and 0.37 (see dshotduty.h).
+   * More details about the narrow writes can be found in the rp2040
+   * datasheet, 2.1.4
    */
   typedef struct dshot_packet
   {
-    uint32_t volatile packet_buffer[dshot_packet_length];
+    uint16_t volatile packet_buffer[DSHOT_PACKET_BUFFER_LENGTH];
     uint16_t throttle_code;
     uint16_t telemetry;
-    uint32_t pulse_high;
-    uint32_t pulse_low;
+    uint16_t pulse_high;
+    uint16_t pulse_low;
   } dshot_packet_t;
 
+  /**
+   * @brief callback run at every frame boundary,
+   * just before the packet is composed and sent
+   * @ingroup dshot_packet
+   *
+   * @param packet packet about to be sent.
+   * The hook may update \a throttle_code and \a telemetry
+   * @param data user data registered with the hook
+   */
+  typedef void (*dshot_frame_hook_t)(dshot_packet_t *packet, void *data);
+
   /**
    * @brief Convert a dshot code and telemetry flag to a command
    *
@@ -118,7 +144,7 @@ extern "C"
    * Potentially, further optimisations can be done to this:
    * https://stackoverflow.com/questions/2249731/how-do-i-get-bit-by-bit-data-from-an-integer-value-in-c
    */
-  static inline void dshot_frame_to_packet(uint16_t frame, uint32_t volatile packet_buffer[], const uint32_t pulse_high, const uint32_t pulse_low)
+  static inline void dshot_frame_to_packet(uint16_t frame, uint16_t volatile packet_buffer[], const uint16_t pulse_high, const uint16_t pulse_low)
   {
     // Convert each bit in the frame to a high / low duty cycles in the packet
     for (uint32_t b = 0; b < DSHOT_FRAME_SIZE; ++b, frame <<= 1)
@@ -138,6 +164,8 @@ extern "C"
     uint16_t cmd = dshot_code_telemetry_to_cmd(dshot_pckt->throttle_code, dshot_pckt->telemetry);
     uint16_t frame = dshot_cmd_to_frame(cmd);
     dshot_frame_to_packet(frame, dshot_pckt->packet_buffer, dshot_pckt->pulse_high, dshot_pckt->pulse_low);
+    // Take the line low: the shared tail sends the rest of the pause
+    dshot_pckt->packet_buffer[DSHOT_FRAME_SIZE] = 0;
   }
 
 #ifdef __cplusplus
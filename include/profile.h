@@ -0,0 +1,277 @@
+/**
+ * @file profile.h
+ * @defgroup profile profile
+ * @brief Flash resident throttle profiles, played back at the frame rate
+ *
+ * Driving step / ramp / chirp sequences from the host means that USB
+ * latency distorts the profile. Instead, a profile is compiled on the host
+ * (`tools/profile_compile.py`) into a compact byte stream, stored as a
+ * `const` array in flash and read in place through XIP.
+ * @ref profile_frame_hook advances a motor's track by one sample at every
+ * dshot frame boundary, so profile timing is exact to the frame.
+ *
+ * Profile layout (little endian):
+ *
+ * | Byte(s)          | Field                                    |
+ * | :--------------: | ---------------------------------------- |
+ * | 0 \| 1           | magic 0x5054 ("TP")                      |
+ * | 2                | version (@ref PROFILE_VERSION)           |
+ * | 3                | track count                              |
+ * | 4 ... 4 + 4n - 1 | u32 offset of each track from byte 0     |
+ *
+ * Each track is a stream of opcodes. Every opcode except the loop markers
+ * produces one or more frames:
+ *
+ * | Opcode          | Bytes | Meaning                                       |
+ * | --------------- | ----- | --------------------------------------------- |
+ * | 0x00 - 0x7f     | 1     | 7 bit signed delta, one frame                 |
+ * | PROFILE_ABS     | 3     | u16 absolute throttle code, one frame         |
+ * | PROFILE_HOLD    | 3     | hold the code for u16 frames                  |
+ * | PROFILE_RAMP    | 4     | add i8 delta every frame, for u16 frames      |
+ * | PROFILE_LOOP    | 3     | loop start, u16 iterations (0 => forever)     |
+ * | PROFILE_LOOP_END| 1     | jump back to the loop start                   |
+ * | PROFILE_END     | 1     | hold the last code until the player stops     |
+ *
+ * Loops don't nest.
+ */
+
+#pragma once
+#include "packet.h"
+#include "stdbool.h"
+#include "stddef.h"
+#include "stdint.h"
+
+/// @brief number of ESCs (see onewire.h)
+#ifndef ESC_COUNT
+#define ESC_COUNT 1
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PROFILE_MAGIC 0x5054u
+#define PROFILE_VERSION 1
+#define PROFILE_HEADER_SIZE 4
+
+enum profile_opcode {
+  PROFILE_ABS = 0x80,
+  PROFILE_HOLD = 0x81,
+  PROFILE_RAMP = 0x82,
+  PROFILE_LOOP = 0x83,
+  PROFILE_LOOP_END = 0x84,
+  PROFILE_END = 0x85,
+};
+
+/// Loop markers processed in one step before a track is considered corrupt
+#define PROFILE_MAX_MARKERS_PER_STEP 4
+
+/**
+ * @brief playback state of one track
+ *
+ * @param pc next opcode (points into flash)
+ * @param loop_start first opcode of the current loop
+ * @param loop_left iterations left of the current loop
+ * @param loop_forever current loop has no iteration count
+ * @param run_left frames left of the current HOLD / RAMP
+ * @param run_delta delta added every frame of the current run
+ * @param code current throttle code
+ * @param done the track reached PROFILE_END (or is corrupt)
+ * @param active the frame hook only updates the packet while this is set
+ */
+typedef struct profile_track {
+  const uint8_t *pc;
+  const uint8_t *loop_start;
+  uint16_t loop_left;
+  bool loop_forever;
+  uint16_t run_left;
+  int16_t run_delta;
+  uint16_t code;
+  bool done;
+  volatile bool active;
+} profile_track_t;
+
+/**
+ * @brief player for every track of a profile
+ *
+ * @param profile start of the profile (in flash)
+ * @param tracks one track per motor. Motors without a track are idle
+ */
+typedef struct profile_player {
+  const uint8_t *profile;
+  profile_track_t tracks[ESC_COUNT];
+} profile_player_t;
+
+static inline uint16_t profile_u16(const uint8_t *const bytes) {
+  return bytes[0] | bytes[1] << 8;
+}
+
+static inline uint32_t profile_u32(const uint8_t *const bytes) {
+  return (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 |
+         (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+/**
+ * @brief check the profile header
+ *
+ * @param profile
+ * @return number of tracks, or -1 if the header is invalid
+ */
+static inline int profile_track_count(const uint8_t *const profile) {
+  if (profile_u16(profile) != PROFILE_MAGIC || profile[2] != PROFILE_VERSION)
+    return -1;
+  return profile[3];
+}
+
+/**
+ * @brief load a profile and rewind every track. Tracks are inactive until
+ * @ref profile_player_start
+ *
+ * @param player
+ * @param profile
+ * @return false if the profile header is invalid
+ */
+static inline bool profile_player_load(profile_player_t *const player,
+                                       const uint8_t *const profile) {
+  const int track_count = profile_track_count(profile);
+  if (track_count < 0)
+    return false;
+  player->profile = profile;
+  for (int i = 0; i < ESC_COUNT; ++i) {
+    profile_track_t *const track = &player->tracks[i];
+    track->active = false;
+    track->loop_start = NULL;
+    track->loop_left = 0;
+    track->loop_forever = false;
+    track->run_left = 0;
+    track->run_delta = 0;
+    track->code = 0;
+    track->done = i >= track_count;
+    track->pc = track->done
+                    ? NULL
+                    : profile + profile_u32(&profile[PROFILE_HEADER_SIZE +
+                                                     4 * i]);
+  }
+  return true;
+}
+
+/// @brief start (or resume) playing every track
+static inline void profile_player_start(profile_player_t *const player) {
+  for (size_t i = 0; i < ESC_COUNT; ++i) {
+    player->tracks[i].active = !player->tracks[i].done;
+  }
+}
+
+/// @brief stop updating the packets. The last codes are left in place
+static inline void profile_player_stop(profile_player_t *const player) {
+  for (size_t i = 0; i < ESC_COUNT; ++i) {
+    player->tracks[i].active = false;
+  }
+}
+
+/// @brief true once every track has reached its end
+static inline bool profile_player_done(const profile_player_t *const player) {
+  for (size_t i = 0; i < ESC_COUNT; ++i) {
+    if (!player->tracks[i].done)
+      return false;
+  }
+  return true;
+}
+
+/**
+ * @brief advance a track by one frame
+ *
+ * This is O(1): at most @ref PROFILE_MAX_MARKERS_PER_STEP loop markers are
+ * processed before the frame's opcode.
+ *
+ * @param track
+ * @return throttle code for this frame
+ */
+static inline uint16_t profile_track_step(profile_track_t *const track) {
+  if (track->done)
+    return track->code;
+
+  if (track->run_left) {
+    track->run_left--;
+    track->code += track->run_delta;
+    return track->code;
+  }
+
+  for (int markers = 0; markers <= PROFILE_MAX_MARKERS_PER_STEP; ++markers) {
+    const uint8_t *const pc = track->pc;
+    const uint8_t op = pc[0];
+
+    if (op < PROFILE_ABS) {
+      // Sign extend the 7 bit delta
+      track->code += (int8_t)(op << 1) >> 1;
+      track->pc = pc + 1;
+      return track->code;
+    }
+
+    switch (op) {
+    case PROFILE_ABS:
+      track->code = profile_u16(&pc[1]);
+      track->pc = pc + 3;
+      return track->code;
+
+    case PROFILE_HOLD:
+    case PROFILE_RAMP: {
+      const bool ramp = op == PROFILE_RAMP;
+      const uint16_t frames = profile_u16(&pc[ramp ? 2 : 1]);
+      track->run_delta = ramp ? (int8_t)pc[1] : 0;
+      track->pc = pc + (ramp ? 4 : 3);
+      if (!frames)
+        continue;
+      track->run_left = frames - 1;
+      track->code += track->run_delta;
+      return track->code;
+    }
+
+    case PROFILE_LOOP:
+      track->loop_left = profile_u16(&pc[1]);
+      track->loop_forever = track->loop_left == 0;
+      track->pc = pc + 3;
+      track->loop_start = track->pc;
+      continue;
+
+    case PROFILE_LOOP_END:
+      if (track->loop_start &&
+          (track->loop_forever || --track->loop_left > 0)) {
+        track->pc = track->loop_start;
+      } else {
+        track->loop_start = NULL;
+        track->pc = pc + 1;
+      }
+      continue;
+
+    case PROFILE_END:
+    default:
+      break;
+    }
+    break;
+  }
+
+  // PROFILE_END, an unknown opcode, or too many markers in a row
+  track->done = true;
+  return track->code;
+}
+
+/**
+ * @brief frame hook (see @ref dshot_set_frame_hook) that plays a track
+ *
+ * @param packet
+ * @param data @ref profile_track_t of this motor
+ */
+static inline void profile_frame_hook(dshot_packet_t *const packet,
+                                      void *const data) {
+  profile_track_t *const track = (profile_track_t *)data;
+  if (!track->active)
+    return;
+  packet->throttle_code = profile_track_step(track) & 0x7ff;
+  if (track->done)
+    track->active = false;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,465 @@
+/**
+ * @file replaycap.h
+ * @defgroup replaycap replaycap
+ * @brief Capture of the telemetry data path on the bench, for the replay
+ * harness
+ *
+ * The inputs of a session (see test/replay_session.hpp) are recorded on the
+ * pico as they happen: the request slots, the frames that carried the
+ * telemetry bit, the bytes each run of the uart isr read, and the host
+ * command bytes, along with the samples the main loop popped from the
+ * queue. The onewire isr and request timer (@ref onewire_t::capture) push
+ * events into a ring, and the main loop streams them over stdio as frames:
+ *
+ * | Byte(s) | Field                                       |
+ * | :-----: | ------------------------------------------- |
+ * | 0 \| 1  | sync word 0x5A7C                            |
+ * |    2    | type (@ref replaycap_type)                  |
+ * |    3    | ESC idx, or flags                           |
+ * |    4    | payload length                              |
+ * | 5 - 8   | time (us, as time_us_32)                    |
+ * | 9 ...   | payload                                     |
+ * |  last   | CRC8 of the bytes after the sync word       |
+ *
+ * Multi byte fields are little endian, and payloads are at most
+ * @ref REPLAYCAP_MAX_PAYLOAD bytes. The request frames are sent by the
+ * frame timer, which doesn't know which ESC it drives, so they are picked
+ * up from @ref dshot_config::telem_requests by the request timer and the
+ * uart isr, before they use them (@ref replaycap_requests).
+ *
+ * Capture the stream (e.g. `cat /dev/ttyACM0 > bench.cap` while
+ * `tools/hostcmd.py` drives the motors), then turn it into a session with
+ * `tools/replay_capture.cpp`.
+ */
+
+#pragma once
+#include "kissesctelem.h"
+#include "stdbool.h"
+#include "stddef.h"
+#include "stdint.h"
+#include "string.h"
+#include "telemqueue.h"
+#include "telemstream.h"
+
+#if PICO_ON_DEVICE
+#include "hardware/sync.h"
+#include "pico/stdio.h"
+#include "pico/time.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define REPLAYCAP_SYNC 0x5A7Cu
+/// Largest payload: one uart fifo
+#define REPLAYCAP_MAX_PAYLOAD 32
+#define REPLAYCAP_FRAME_HEADER_SIZE 9
+#define REPLAYCAP_FRAME_MAX_SIZE                                               \
+  (REPLAYCAP_FRAME_HEADER_SIZE + REPLAYCAP_MAX_PAYLOAD + 1)
+/// UART event flag: the isr was raised by the rx timeout
+#define REPLAYCAP_RX_TIMEOUT 0x01
+
+/// Number of events held by the ring. Must be a power of 2
+#ifndef REPLAYCAP_RING_SIZE
+#define REPLAYCAP_RING_SIZE 64
+#endif
+#define REPLAYCAP_RING_MASK (REPLAYCAP_RING_SIZE - 1)
+
+/// Most ESCs whose request frames are tracked
+#ifndef REPLAYCAP_MAX_ESCS
+#define REPLAYCAP_MAX_ESCS 8
+#endif
+
+#if PICO_ON_DEVICE
+#define REPLAYCAP_BARRIER() __dmb()
+#else
+#define REPLAYCAP_BARRIER() __sync_synchronize()
+#endif
+
+/**
+ * @brief event types. The inputs and samples have the values of
+ * `replay_record_type` (test/replay_session.hpp)
+ *
+ * - @ref REPLAYCAP_SLOT: the request timer armed ESC idx
+ * - @ref REPLAYCAP_REQUEST: ESC idx sent a frame with the telemetry bit.
+ *   u16 throttle code
+ * - @ref REPLAYCAP_UART: one run of the uart isr. Flags
+ *   (@ref REPLAYCAP_RX_TIMEOUT), the bytes it read
+ * - @ref REPLAYCAP_HOSTCMD: bytes received from the host
+ * - @ref REPLAYCAP_SAMPLE: a sample popped from the queue by the main loop,
+ *   as a telemstream.h record
+ * - @ref REPLAYCAP_START: the capture started. ESC idx is the ESC count.
+ *   u32 uart baudrate, u8 telemhealth stale cycles, u16 sequence number of
+ *   the next queued sample
+ * - @ref REPLAYCAP_DROPPED: u32 events lost because the ring was full
+ */
+enum replaycap_type {
+  REPLAYCAP_SLOT = 1,
+  REPLAYCAP_REQUEST = 2,
+  REPLAYCAP_UART = 3,
+  REPLAYCAP_HOSTCMD = 4,
+  REPLAYCAP_SAMPLE = 5,
+  REPLAYCAP_START = 0x40,
+  REPLAYCAP_DROPPED = 0x41,
+};
+
+enum replaycap_state {
+  REPLAYCAP_OFF,
+  REPLAYCAP_ARMED,
+  REPLAYCAP_RUNNING,
+};
+
+typedef struct replaycap_event {
+  uint8_t type;
+  uint8_t esc;
+  uint8_t length;
+  uint32_t time_us;
+  uint8_t payload[REPLAYCAP_MAX_PAYLOAD];
+} replaycap_event_t;
+
+/**
+ * @brief ring of captured events
+ *
+ * @param head next slot to write (only written by the producers)
+ * @param tail next slot to read (only written by the consumer)
+ * @param dropped events dropped because the ring was full
+ * @param dropped_reported value of @ref dropped at the last flush
+ * @param state see @ref replaycap_start. The capture starts at the next
+ * request slot, so that the session starts with one
+ * @param requests_seen bit per ESC whose request frames are tracked
+ * @param requests request frames of each ESC recorded so far
+ * @param ring event storage
+ */
+typedef struct replaycap {
+  volatile uint32_t head;
+  volatile uint32_t tail;
+  volatile uint32_t dropped;
+  uint32_t dropped_reported;
+  volatile uint8_t state;
+  uint32_t requests_seen;
+  uint32_t requests[REPLAYCAP_MAX_ESCS];
+  replaycap_event_t ring[REPLAYCAP_RING_SIZE];
+} replaycap_t;
+
+static inline void replaycap_init(replaycap_t *const cap) {
+  cap->head = 0;
+  cap->tail = 0;
+  cap->dropped = 0;
+  cap->dropped_reported = 0;
+  cap->state = REPLAYCAP_OFF;
+  cap->requests_seen = 0;
+}
+
+/**
+ * @brief start capturing at the next request slot (main loop)
+ *
+ * @param cap
+ */
+static inline void replaycap_start(replaycap_t *const cap) {
+  cap->requests_seen = 0;
+  cap->state = REPLAYCAP_ARMED;
+}
+
+/// @brief stop capturing (main loop)
+static inline void replaycap_stop(replaycap_t *const cap) {
+  cap->state = REPLAYCAP_OFF;
+}
+
+/// @brief true once the first request slot has been captured
+static inline bool replaycap_running(const replaycap_t *const cap) {
+  return cap->state == REPLAYCAP_RUNNING;
+}
+
+/**
+ * @brief push an event (producer side: the isrs of the real-time path,
+ * which don't preempt each other, see rtpool.h)
+ *
+ * @param cap
+ * @param type @ref replaycap_type
+ * @param esc ESC idx, or flags
+ * @param time_us
+ * @param payload
+ * @param length truncated to @ref REPLAYCAP_MAX_PAYLOAD
+ * @return false if the ring is full and the event was dropped
+ */
+static inline bool replaycap_push(replaycap_t *const cap, const uint8_t type,
+                                  const uint8_t esc, const uint32_t time_us,
+                                  const uint8_t *const payload,
+                                  const size_t length) {
+  const uint32_t head = cap->head;
+  if (head - cap->tail >= REPLAYCAP_RING_SIZE) {
+    cap->dropped++;
+    return false;
+  }
+  replaycap_event_t *const event = &cap->ring[head & REPLAYCAP_RING_MASK];
+  event->type = type;
+  event->esc = esc;
+  event->length = (uint8_t)(length < REPLAYCAP_MAX_PAYLOAD
+                                ? length
+                                : REPLAYCAP_MAX_PAYLOAD);
+  event->time_us = time_us;
+  if (event->length)
+    memcpy(event->payload, payload, event->length);
+  // Publish the event before moving the head
+  REPLAYCAP_BARRIER();
+  cap->head = head + 1;
+  return true;
+}
+
+/**
+ * @brief push an event from the main loop, which the isrs can preempt
+ *
+ * See @ref replaycap_push
+ */
+static inline bool replaycap_push_main(replaycap_t *const cap,
+                                       const uint8_t type, const uint8_t esc,
+                                       const uint32_t time_us,
+                                       const uint8_t *const payload,
+                                       const size_t length) {
+#if PICO_ON_DEVICE
+  const uint32_t irq = save_and_disable_interrupts();
+#endif
+  const bool pushed = replaycap_push(cap, type, esc, time_us, payload, length);
+#if PICO_ON_DEVICE
+  restore_interrupts(irq);
+#endif
+  return pushed;
+}
+
+/**
+ * @brief pop the oldest event (consumer side, e.g. the main loop)
+ *
+ * @param cap
+ * @param event output
+ * @return false if the ring is empty
+ */
+static inline bool replaycap_pop(replaycap_t *const cap,
+                                 replaycap_event_t *const event) {
+  const uint32_t tail = cap->tail;
+  if (tail == cap->head)
+    return false;
+  REPLAYCAP_BARRIER();
+  *event = cap->ring[tail & REPLAYCAP_RING_MASK];
+  // Finish reading the slot before handing it back to the producers
+  REPLAYCAP_BARRIER();
+  cap->tail = tail + 1;
+  return true;
+}
+
+/**
+ * @brief record the request frames an ESC sent since the last call
+ * (request timer and uart isr)
+ *
+ * The first call for an ESC only takes its count (see
+ * @ref replaycap_slot).
+ *
+ * @param cap
+ * @param esc_idx
+ * @param requests @ref dshot_config::telem_requests
+ * @param request_us @ref dshot_config::telem_request_us
+ * @param request_code @ref dshot_config::telem_request_code
+ */
+static inline void replaycap_requests(replaycap_t *const cap,
+                                      const size_t esc_idx,
+                                      const uint32_t requests,
+                                      const uint32_t request_us,
+                                      const uint16_t request_code) {
+  if (esc_idx >= REPLAYCAP_MAX_ESCS)
+    return;
+  const uint32_t bit = 1u << esc_idx;
+  if (!(cap->requests_seen & bit)) {
+    cap->requests_seen |= bit;
+    cap->requests[esc_idx] = requests;
+    return;
+  }
+  // At most one per slot: the telemetry bit is cleared once it is sent
+  const uint8_t code[2] = {(uint8_t)request_code,
+                           (uint8_t)(request_code >> 8)};
+  for (; cap->requests[esc_idx] != requests; ++cap->requests[esc_idx]) {
+    replaycap_push(cap, REPLAYCAP_REQUEST, (uint8_t)esc_idx, request_us, code,
+                   sizeof(code));
+  }
+}
+
+/**
+ * @brief record the start of the request slot of an ESC (request timer).
+ * Starts an armed capture
+ *
+ * @param cap
+ * @param esc_idx
+ * @param requests request frames sent to it so far
+ * @param now_us
+ * @param escs ESC count
+ * @param baudrate of the onewire uart
+ * @param stale_cycles @ref telemhealth_t::stale_cycles
+ * @param queue_seq @ref telem_queue_t::seq, so that the samples can be
+ * numbered from the start of the session
+ */
+static inline void replaycap_slot(replaycap_t *const cap,
+                                  const size_t esc_idx,
+                                  const uint32_t requests,
+                                  const uint32_t now_us, const uint8_t escs,
+                                  const uint32_t baudrate,
+                                  const uint8_t stale_cycles,
+                                  const uint16_t queue_seq) {
+  if (cap->state == REPLAYCAP_ARMED) {
+    const uint8_t start[7] = {(uint8_t)baudrate,
+                              (uint8_t)(baudrate >> 8),
+                              (uint8_t)(baudrate >> 16),
+                              (uint8_t)(baudrate >> 24),
+                              stale_cycles,
+                              (uint8_t)queue_seq,
+                              (uint8_t)(queue_seq >> 8)};
+    replaycap_push(cap, REPLAYCAP_START, escs, now_us, start, sizeof(start));
+    cap->state = REPLAYCAP_RUNNING;
+  }
+  if (cap->state != REPLAYCAP_RUNNING)
+    return;
+  replaycap_push(cap, REPLAYCAP_SLOT, (uint8_t)esc_idx, now_us, NULL, 0);
+  // The frames of the last slot of this ESC were recorded when it ended:
+  // only take the count of an ESC seen for the first time
+  const uint32_t bit = 1u << esc_idx;
+  if (esc_idx < REPLAYCAP_MAX_ESCS && !(cap->requests_seen & bit)) {
+    cap->requests_seen |= bit;
+    cap->requests[esc_idx] = requests;
+  }
+}
+
+/**
+ * @brief record a sample popped from the telemetry queue (main loop)
+ *
+ * @param cap
+ * @param sample
+ * @param now_us
+ */
+static inline void replaycap_sample(replaycap_t *const cap,
+                                    const telem_sample_t *const sample,
+                                    const uint32_t now_us) {
+  if (!replaycap_running(cap))
+    return;
+  uint8_t record[TELEMSTREAM_RECORD_SIZE];
+  telemstream_encode(sample, sample->seq, record);
+  replaycap_push_main(cap, REPLAYCAP_SAMPLE, sample->esc_idx, now_us, record,
+                      sizeof(record));
+}
+
+/**
+ * @brief record bytes received from the host (main loop)
+ *
+ * @param cap
+ * @param bytes
+ * @param count
+ * @param now_us
+ */
+static inline void replaycap_hostcmd(replaycap_t *const cap,
+                                     const uint8_t *const bytes,
+                                     const size_t count,
+                                     const uint32_t now_us) {
+  if (!replaycap_running(cap))
+    return;
+  for (size_t b = 0; b < count; b += REPLAYCAP_MAX_PAYLOAD) {
+    replaycap_push_main(cap, REPLAYCAP_HOSTCMD, 0, now_us, bytes + b,
+                        count - b);
+  }
+}
+
+/**
+ * @brief encode an event as a frame
+ *
+ * @param event
+ * @param out buffer of @ref REPLAYCAP_FRAME_MAX_SIZE bytes
+ * @return size of the frame
+ */
+static inline size_t replaycap_encode(const replaycap_event_t *const event,
+                                      uint8_t out[]) {
+  out[0] = REPLAYCAP_SYNC & 0xff;
+  out[1] = REPLAYCAP_SYNC >> 8;
+  out[2] = event->type;
+  out[3] = event->esc;
+  out[4] = event->length;
+  for (size_t b = 0; b < 4; ++b) {
+    out[5 + b] = (event->time_us >> (8 * b)) & 0xff;
+  }
+  memcpy(&out[REPLAYCAP_FRAME_HEADER_SIZE], event->payload, event->length);
+  const size_t size = REPLAYCAP_FRAME_HEADER_SIZE + event->length;
+  out[size] = kissesc_get_crc8(&out[2], size - 2);
+  return size + 1;
+}
+
+/**
+ * @brief size of the frame that starts with \a header
+ *
+ * @param header @ref REPLAYCAP_FRAME_HEADER_SIZE bytes
+ * @return 0 if this isn't the start of a frame
+ */
+static inline size_t replaycap_frame_size(const uint8_t header[]) {
+  const uint16_t sync = header[0] | header[1] << 8;
+  if (sync != REPLAYCAP_SYNC || header[4] > REPLAYCAP_MAX_PAYLOAD)
+    return 0;
+  return REPLAYCAP_FRAME_HEADER_SIZE + header[4] + 1u;
+}
+
+/**
+ * @brief decode a frame (used by host side tools and tests)
+ *
+ * @param frame @ref replaycap_frame_size bytes
+ * @param event output
+ * @return false if it isn't a frame, or its CRC is wrong
+ */
+static inline bool replaycap_decode(const uint8_t frame[],
+                                    replaycap_event_t *const event) {
+  const size_t size = replaycap_frame_size(frame);
+  if (!size || kissesc_get_crc8(&frame[2], size - 2) != 0)
+    return false;
+  event->type = frame[2];
+  event->esc = frame[3];
+  event->length = frame[4];
+  event->time_us = (uint32_t)frame[5] | (uint32_t)frame[6] << 8 |
+                   (uint32_t)frame[7] << 16 | (uint32_t)frame[8] << 24;
+  memcpy(event->payload, &frame[REPLAYCAP_FRAME_HEADER_SIZE], event->length);
+  return true;
+}
+
+#if PICO_ON_DEVICE
+/**
+ * @brief stream every pending event (and the drop count) over stdio.
+ * Call this from the main loop
+ *
+ * @param cap
+ * @return number of events written
+ */
+static size_t replaycap_flush(replaycap_t *const cap) {
+  size_t count = 0;
+  replaycap_event_t event;
+  uint8_t frame[REPLAYCAP_FRAME_MAX_SIZE];
+  while (replaycap_pop(cap, &event)) {
+    const size_t size = replaycap_encode(&event, frame);
+    for (size_t i = 0; i < size; ++i) {
+      putchar_raw(frame[i]);
+    }
+    ++count;
+  }
+  const uint32_t dropped = cap->dropped;
+  if (dropped != cap->dropped_reported) {
+    const uint32_t unreported = dropped - cap->dropped_reported;
+    cap->dropped_reported = dropped;
+    event.type = REPLAYCAP_DROPPED;
+    event.esc = 0;
+    event.length = 4;
+    event.time_us = time_us_32();
+    for (size_t b = 0; b < 4; ++b) {
+      event.payload[b] = (unreported >> (8 * b)) & 0xff;
+    }
+    const size_t size = replaycap_encode(&event, frame);
+    for (size_t i = 0; i < size; ++i) {
+      putchar_raw(frame[i]);
+    }
+  }
+  return count;
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
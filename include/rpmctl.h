@@ -0,0 +1,257 @@
+/**
+ * @file rpmctl.h
+ * @defgroup rpmctl rpmctl
+ * @brief Optional closed loop RPM control from telemetry feedback
+ *
+ * The library is open loop: the application picks a throttle code.
+ * For constant RPM tests, @ref rpmctl_update runs a fixed point PID loop
+ * on every telemetry sample of a motor:
+ *
+ * - feed-forward from a throttle -> RPM map (@ref rpmctl_ff_point_t),
+ *   so the PID only has to correct the model error
+ * - PI on the RPM error, with the integral scaled by the actual interval
+ *   between samples (which is irregular)
+ * - D on the measurement rather than the error, so that target changes
+ *   don't kick the output
+ * - anti-windup by conditional integration: the integral isn't updated
+ *   while the output is saturated in the direction of the error, nor
+ *   while the error is outside @ref rpmctl_config_t::i_band_rpm. With a
+ *   feed-forward term, integrating the large errors of a step response
+ *   only adds overshoot
+ *
+ * The output is published to the motor's @ref setpoint_t, which applies
+ * it at the next frame boundary (and may slew limit it).
+ *
+ * Gains are Q16 throttle codes per RPM (per RPM s for ki, per RPM / s for
+ * kd). Keep them below 2^24 so the int64 intermediates can't overflow.
+ */
+
+#pragma once
+#include "setpoint.h"
+#include "stdbool.h"
+#include "stddef.h"
+#include "stdint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RPMCTL_GAIN_FRAC_BITS 16
+#define RPMCTL_GAIN_ONE (1 << RPMCTL_GAIN_FRAC_BITS)
+
+/**
+ * @brief point of the feed-forward map: the throttle code at which the
+ * motor settles at \a rpm. Points are sorted by rpm
+ */
+typedef struct rpmctl_ff_point {
+  uint32_t rpm;
+  uint16_t code;
+} rpmctl_ff_point_t;
+
+/**
+ * @brief controller configuration
+ *
+ * @param kp Q16 codes per RPM of error
+ * @param ki Q16 codes per RPM of error per second
+ * @param kd Q16 codes per RPM/s of measured acceleration (0 => PI)
+ * @param i_band_rpm only integrate errors up to this size (0 => always)
+ * @param min_code lowest output throttle code (>= 48)
+ * @param max_code highest output throttle code (<= 2047)
+ * @param poles motor magnet poles, to convert erpm to rpm
+ * @param max_dt_us samples further apart than this (e.g. dropped
+ * telemetry) skip the integral and derivative terms
+ * @param ff feed-forward map (may be NULL)
+ * @param ff_points number of points in \a ff
+ */
+typedef struct rpmctl_config {
+  int32_t kp;
+  int32_t ki;
+  int32_t kd;
+  int32_t i_band_rpm;
+  uint16_t min_code;
+  uint16_t max_code;
+  uint8_t poles;
+  uint32_t max_dt_us;
+  const rpmctl_ff_point_t *ff;
+  size_t ff_points;
+} rpmctl_config_t;
+
+/**
+ * @brief controller state of one motor
+ *
+ * @param config
+ * @param setpoint stage the output is published to (may be NULL)
+ * @param enabled the loop only publishes while enabled
+ * @param target_rpm
+ * @param integral Q16 codes
+ * @param last_rpm rpm of the previous sample
+ * @param last_us timestamp of the previous sample
+ * @param primed a previous sample exists
+ * @param output last throttle code computed
+ * @param saturated the last output was clamped
+ * @param updates samples processed while enabled
+ */
+typedef struct rpmctl {
+  rpmctl_config_t config;
+  setpoint_t *setpoint;
+  bool enabled;
+  int32_t target_rpm;
+  int64_t integral;
+  int32_t last_rpm;
+  uint32_t last_us;
+  bool primed;
+  uint16_t output;
+  bool saturated;
+  uint32_t updates;
+} rpmctl_t;
+
+/**
+ * @brief mechanical rpm from electrical rpm
+ *
+ * @param erpm
+ * @param poles motor magnet poles
+ * @return rpm
+ */
+static inline int32_t rpmctl_erpm_to_rpm(const uint32_t erpm,
+                                         const uint8_t poles) {
+  return poles ? (int32_t)(erpm * 2 / poles) : (int32_t)erpm;
+}
+
+/**
+ * @brief initialise a controller. It starts disabled
+ *
+ * @param ctl
+ * @param config copied
+ * @param setpoint stage to publish the output to (may be NULL, in which
+ * case the caller applies @ref rpmctl_t::output)
+ */
+static inline void rpmctl_init(rpmctl_t *const ctl,
+                               const rpmctl_config_t *const config,
+                               setpoint_t *const setpoint) {
+  ctl->config = *config;
+  ctl->setpoint = setpoint;
+  ctl->enabled = false;
+  ctl->target_rpm = 0;
+  ctl->integral = 0;
+  ctl->last_rpm = 0;
+  ctl->last_us = 0;
+  ctl->primed = false;
+  ctl->output = config->min_code;
+  ctl->saturated = false;
+  ctl->updates = 0;
+}
+
+/**
+ * @brief throttle code expected to hold \a rpm, from the feed-forward map
+ *
+ * Linear interpolation between points, clamped to the ends of the map.
+ *
+ * @param config
+ * @param rpm
+ * @return throttle code, or 0 without a map
+ */
+static inline uint16_t rpmctl_feedforward(const rpmctl_config_t *const config,
+                                          const int32_t rpm) {
+  const rpmctl_ff_point_t *const ff = config->ff;
+  const size_t n = config->ff_points;
+  if (!ff || !n)
+    return 0;
+  if (rpm <= (int32_t)ff[0].rpm)
+    return ff[0].code;
+  for (size_t i = 1; i < n; ++i) {
+    if (rpm <= (int32_t)ff[i].rpm) {
+      const int32_t span = ff[i].rpm - ff[i - 1].rpm;
+      const int32_t dcode = (int32_t)ff[i].code - ff[i - 1].code;
+      return ff[i - 1].code +
+             (span ? dcode * (rpm - (int32_t)ff[i - 1].rpm) / span : 0);
+    }
+  }
+  return ff[n - 1].code;
+}
+
+/**
+ * @brief enable the loop (or change its target)
+ *
+ * The integral is reset when the loop is enabled, so that the output
+ * starts from the feed-forward term.
+ *
+ * @param ctl
+ * @param target_rpm
+ */
+static inline void rpmctl_set_target(rpmctl_t *const ctl,
+                                     const int32_t target_rpm) {
+  if (!ctl->enabled)
+    ctl->integral = 0;
+  ctl->target_rpm = target_rpm;
+  ctl->enabled = true;
+}
+
+/**
+ * @brief disable the loop. The last output stays in the setpoint stage
+ * until the application sets another one
+ *
+ * @param ctl
+ */
+static inline void rpmctl_disable(rpmctl_t *const ctl) {
+  ctl->enabled = false;
+}
+
+/**
+ * @brief run the loop on a new telemetry sample
+ *
+ * @param ctl
+ * @param erpm measured erpm (e.g. @ref kissesc_telem_t::erpm)
+ * @param timestamp_us time the sample was received
+ * @return throttle code published to the setpoint stage
+ */
+static inline uint16_t rpmctl_update(rpmctl_t *const ctl, const uint32_t erpm,
+                                     const uint32_t timestamp_us) {
+  const rpmctl_config_t *const cfg = &ctl->config;
+  const int32_t rpm = rpmctl_erpm_to_rpm(erpm, cfg->poles);
+  const uint32_t dt = timestamp_us - ctl->last_us;
+  const bool dt_valid = ctl->primed && dt && dt <= cfg->max_dt_us;
+  const int32_t last_rpm = ctl->last_rpm;
+  ctl->last_rpm = rpm;
+  ctl->last_us = timestamp_us;
+  ctl->primed = true;
+
+  if (!ctl->enabled)
+    return ctl->output;
+  ctl->updates++;
+
+  const int32_t error = ctl->target_rpm - rpm;
+  const int64_t ff = (int64_t)rpmctl_feedforward(cfg, ctl->target_rpm)
+                     << RPMCTL_GAIN_FRAC_BITS;
+  const int64_t p = (int64_t)cfg->kp * error;
+  const int64_t d =
+      dt_valid ? -(int64_t)cfg->kd * (rpm - last_rpm) * 1000000 / dt : 0;
+  const bool in_band = !cfg->i_band_rpm || (error <= cfg->i_band_rpm &&
+                                            error >= -cfg->i_band_rpm);
+  const int64_t integral =
+      ctl->integral +
+      (dt_valid && in_band ? (int64_t)cfg->ki * error * dt / 1000000 : 0);
+
+  const int64_t lo = (int64_t)cfg->min_code << RPMCTL_GAIN_FRAC_BITS;
+  const int64_t hi = (int64_t)cfg->max_code << RPMCTL_GAIN_FRAC_BITS;
+  int64_t u = ff + p + d + integral;
+
+  // Anti-windup: only integrate if it doesn't push further into saturation
+  if (!((u > hi && error > 0) || (u < lo && error < 0))) {
+    ctl->integral = integral;
+  } else {
+    u = ff + p + d + ctl->integral;
+  }
+
+  ctl->saturated = u > hi || u < lo;
+  u = u > hi ? hi : (u < lo ? lo : u);
+  ctl->output =
+      (uint16_t)((u + (RPMCTL_GAIN_ONE >> 1)) >> RPMCTL_GAIN_FRAC_BITS);
+
+  if (ctl->setpoint)
+    setpoint_set(ctl->setpoint, ctl->output);
+  return ctl->output;
+}
+
+#ifdef __cplusplus
+}
+#endif
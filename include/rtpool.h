@@ -0,0 +1,278 @@
+/**
+ * @file rtpool.h
+ * @defgroup rtpool rtpool
+ * @brief Dedicated alarm pool and irq priorities for the real-time path
+ *
+ * The default alarm pool is shared with sleep_ms, add_alarm_in_ms and
+ * every other timer user of the application, at the default irq priority,
+ * so a slow callback there delays the next dshot frame. Instead,
+ * @ref rtpool_init creates an alarm pool for the frame and telemetry
+ * request timers only, on a hardware alarm of its own
+ * (@ref RTPOOL_ALARM_NUM, the default pool uses alarm 3), with its irq on
+ * the core that sets up the dma and uart irqs too.
+ *
+ * The irqs of the real-time path get an explicit priority order (lower is
+ * more urgent, and the M0+ only has the levels 0x00, 0x40, 0x80, 0xc0):
+ *
+ * | irq                            | priority                         |
+ * | ------------------------------ | -------------------------------- |
+ * | timer of the pool (frames)     | @ref RTPOOL_TIMER_PRIORITY, 0x00 |
+ * | dma (@ref DSHOT_CONTINUOUS)    | @ref RTPOOL_DMA_PRIORITY, 0x00   |
+ * | uart (onewire telemetry)       | @ref RTPOOL_UART_PRIORITY, 0x00  |
+ * | the rest of the application    | PICO_DEFAULT_IRQ_PRIORITY, 0x80  |
+ *
+ * The timer and dma irqs both send packets, and dshot_send_packet isn't
+ * reentrant. The uart isr parses a reply into the request slot that the
+ * telemetry request timer ends and starts (see onewireparse.h). So all
+ * three share a level and never preempt each other: when several are
+ * pending, they run in irq number order (timer, dma, then uart). The uart
+ * isr is short, as the fifo holds at most 32 bytes. Priorities are per
+ * core: each is set by the code that enables the irq, on that core.
+ *
+ * With @ref rtpool_t::measure set, the timer callbacks record their entry
+ * latency (@ref rtpool_entry): the time from the hardware alarm firing to
+ * the callback starting, i.e. timerawl - alarm[num], including the alarm
+ * pool's own irq handler.
+ */
+
+#pragma once
+#include "stdbool.h"
+#include "stdint.h"
+#include <stdio.h>
+
+#if PICO_ON_DEVICE
+#include "hardware/irq.h"
+#include "hardware/structs/timer.h"
+#include "pico/time.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Hardware alarm of the pool (0 - 3, not the default pool's)
+#ifndef RTPOOL_ALARM_NUM
+#define RTPOOL_ALARM_NUM 2
+#endif
+
+/// Core the pool's irq runs on: the one calling @ref rtpool_init
+#ifndef RTPOOL_CORE
+#define RTPOOL_CORE 0
+#endif
+
+/// Repeating timers the pool can hold (frames, telemetry requests, ...)
+#ifndef RTPOOL_MAX_TIMERS
+#define RTPOOL_MAX_TIMERS 16
+#endif
+
+#ifndef RTPOOL_TIMER_PRIORITY
+#define RTPOOL_TIMER_PRIORITY 0x00
+#endif
+#ifndef RTPOOL_DMA_PRIORITY
+#define RTPOOL_DMA_PRIORITY 0x00
+#endif
+#ifndef RTPOOL_UART_PRIORITY
+#define RTPOOL_UART_PRIORITY 0x00
+#endif
+
+/// Entry latency histogram: 0, 1, 2 - 3, 4 - 7, ... and 64+ us
+#define RTPOOL_LATENCY_BINS 8
+
+/// @brief timer callbacks of the real-time path
+enum rtpool_source {
+  RTPOOL_FRAME,     ///< dshot frame (single motor or chain)
+  RTPOOL_TELEM_REQ, ///< onewire telemetry request
+  RTPOOL_SOURCES,
+};
+
+/**
+ * @brief entry latency of one timer callback
+ *
+ * @param count
+ * @param rearmed callbacks that ran after the alarm was re-armed for a
+ * later timer, so without a measure
+ * @param min_us
+ * @param max_us
+ * @param sum_us for the mean
+ * @param bins histogram (see @ref rtpool_latency_bin)
+ */
+typedef struct rtpool_latency {
+  uint32_t count;
+  uint32_t rearmed;
+  uint32_t min_us;
+  uint32_t max_us;
+  uint64_t sum_us;
+  uint32_t bins[RTPOOL_LATENCY_BINS];
+} rtpool_latency_t;
+
+/**
+ * @brief the real-time alarm pool
+ *
+ * @param pool NULL until @ref rtpool_init
+ * @param alarm_num
+ * @param core
+ * @param measure record the entry latency of the callbacks
+ * @param latency per @ref rtpool_source
+ */
+typedef struct rtpool {
+#if PICO_ON_DEVICE
+  alarm_pool_t *pool;
+#endif
+  uint8_t alarm_num;
+  uint8_t core;
+  volatile bool measure;
+  volatile rtpool_latency_t latency[RTPOOL_SOURCES];
+} rtpool_t;
+
+extern rtpool_t rtpool;
+
+static inline void rtpool_latency_init(volatile rtpool_latency_t *const lat) {
+  lat->count = 0;
+  lat->rearmed = 0;
+  lat->min_us = UINT32_MAX;
+  lat->max_us = 0;
+  lat->sum_us = 0;
+  for (int i = 0; i < RTPOOL_LATENCY_BINS; ++i)
+    lat->bins[i] = 0;
+}
+
+/// @brief histogram bin of a latency: floor(log2(us)) + 1, 0 for 0
+static inline int rtpool_latency_bin(const uint32_t us) {
+  int bin = 0;
+  for (uint32_t v = us; v && bin < RTPOOL_LATENCY_BINS - 1; v >>= 1)
+    bin++;
+  return bin;
+}
+
+/**
+ * @brief record one callback entry
+ *
+ * @param lat
+ * @param delta_us now - alarm target, modulo 2^32. Negative if the alarm
+ * has already been re-armed for a later timer
+ */
+static inline void rtpool_latency_record(volatile rtpool_latency_t *const lat,
+                                         const int32_t delta_us) {
+  if (delta_us < 0) {
+    lat->rearmed++;
+    return;
+  }
+  const uint32_t us = (uint32_t)delta_us;
+  lat->count++;
+  if (us < lat->min_us)
+    lat->min_us = us;
+  if (us > lat->max_us)
+    lat->max_us = us;
+  lat->sum_us += us;
+  lat->bins[rtpool_latency_bin(us)]++;
+}
+
+/// @brief mean entry latency in us, 0 without samples
+static inline uint32_t
+rtpool_latency_mean_us(const volatile rtpool_latency_t *const lat) {
+  return lat->count ? (uint32_t)(lat->sum_us / lat->count) : 0;
+}
+
+static void rtpool_latency_print(const volatile rtpool_latency_t *const lat,
+                                 const char *const name) {
+  printf("%s entry:\t%u callbacks (%u after a re-arm)", name, lat->count,
+         lat->rearmed);
+  if (lat->count)
+    printf("\tmean %u us\tmin %u us\tmax %u us",
+           rtpool_latency_mean_us(lat), lat->min_us, lat->max_us);
+  printf("\n  us:");
+  for (int i = 0; i < RTPOOL_LATENCY_BINS; ++i) {
+    if (i == 0)
+      printf("\t0: %u", lat->bins[i]);
+    else if (i == RTPOOL_LATENCY_BINS - 1)
+      printf("\t%u+: %u", 1u << (i - 1), lat->bins[i]);
+    else
+      printf("\t%u-%u: %u", 1u << (i - 1), (1u << i) - 1, lat->bins[i]);
+  }
+  printf("\n");
+}
+
+#if PICO_ON_DEVICE
+/**
+ * @brief record the entry latency of a timer callback of the pool
+ *
+ * Call this first thing in the callback. Does nothing unless
+ * @ref rtpool_t::measure is set, or for timers of other pools.
+ *
+ * @param rt
+ * @param source
+ */
+static inline void rtpool_entry(const repeating_timer_t *const rt,
+                                const enum rtpool_source source) {
+  if (!rtpool.measure || rt->pool != rtpool.pool)
+    return;
+  const int32_t delta_us =
+      (int32_t)(timer_hw->timerawl - timer_hw->alarm[rtpool.alarm_num]);
+  rtpool_latency_record(&rtpool.latency[source], delta_us);
+}
+
+/**
+ * @brief create the real-time alarm pool, on the calling core
+ *
+ * Pass the pool to @ref dshot_config_init, @ref telem_uart_init, etc. in
+ * place of alarm_pool_get_default(), from the same core: the timer
+ * callbacks share the onewire and dma state with the uart and dma isrs,
+ * the priorities that keep them from preempting each other are per core,
+ * and @ref DLOG has a single producer core.
+ *
+ * @param rt usually @ref rtpool
+ * @param alarm_num hardware alarm, not claimed by anything else (the
+ * default pool uses PICO_TIME_DEFAULT_ALARM_POOL_HARDWARE_ALARM_NUM)
+ * @param core core the irq of the pool runs on: must be the calling core
+ * (to run the real-time path on core 1, set it all up from core 1)
+ * @return the pool
+ *
+ * panics if \a core isn't the calling core
+ */
+static alarm_pool_t *rtpool_init(rtpool_t *const rt, const uint alarm_num,
+                                 const uint core) {
+  if (core != get_core_num())
+    panic("rtpool: core %u must be set up from itself, not core %u\n", core,
+          get_core_num());
+  rt->alarm_num = (uint8_t)alarm_num;
+  rt->core = (uint8_t)core;
+  rt->measure = false;
+  for (int i = 0; i < RTPOOL_SOURCES; ++i)
+    rtpool_latency_init(&rt->latency[i]);
+
+  rt->pool = alarm_pool_create(alarm_num, RTPOOL_MAX_TIMERS);
+  irq_set_priority(TIMER_IRQ_0 + alarm_num, RTPOOL_TIMER_PRIORITY);
+  return rt->pool;
+}
+
+/**
+ * @brief start (or restart) measuring the entry latency
+ *
+ * @param rt
+ * @param enable
+ */
+static inline void rtpool_measure(rtpool_t *const rt, const bool enable) {
+  rt->measure = false;
+  for (int i = 0; i < RTPOOL_SOURCES; ++i)
+    rtpool_latency_init(&rt->latency[i]);
+  rt->measure = enable;
+}
+
+static void rtpool_print(const rtpool_t *const rt) {
+  printf("\n--- real-time alarm pool ---\n");
+  printf("alarm num: %u\tcore: %u\tmax timers: %u\n", rt->alarm_num,
+         alarm_pool_core_num(rt->pool), RTPOOL_MAX_TIMERS);
+  printf("irq priorities: timer %u\tdma %u\tuart %u\t(default %u)\n",
+         RTPOOL_TIMER_PRIORITY, RTPOOL_DMA_PRIORITY, RTPOOL_UART_PRIORITY,
+         PICO_DEFAULT_IRQ_PRIORITY);
+  if (rt->measure) {
+    rtpool_latency_print(&rt->latency[RTPOOL_FRAME], "frame");
+    rtpool_latency_print(&rt->latency[RTPOOL_TELEM_REQ], "telem request");
+  }
+  printf("---\n\n");
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
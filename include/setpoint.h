@@ -0,0 +1,245 @@
+/**
+ * @file setpoint.h
+ * @defgroup setpoint setpoint
+ * @brief Per motor setpoint interpolation and slew limiting at frame rate
+ *
+ * Setpoints arrive much slower than dshot frames (e.g. 100 Hz vs 7 kHz),
+ * so writing them straight to `throttle_code` produces steps, and large
+ * jumps cause current spikes. This stage sits between the application and
+ * @ref dshot_packet_compose: the application publishes setpoints with
+ * @ref setpoint_set, and @ref setpoint_frame_hook runs at every frame
+ * boundary to:
+ *
+ * 1. linearly interpolate from the previous setpoint to the new one over
+ *    a fixed number of frames, or over the number of frames that elapsed
+ *    between the last two setpoints (so the reference arrives just as the
+ *    next setpoint is expected)
+ * 2. limit the rate of change of the output to a maximum slew rate
+ *
+ * All state is Q16.16 fixed point; each frame is O(1) with no division.
+ * Special commands (codes below @ref SETPOINT_ZERO_THROTTLE) bypass the
+ * stage and are sent immediately.
+ */
+
+#pragma once
+#include "packet.h"
+#include "stdbool.h"
+#include "stdint.h"
+
+#if PICO_ON_DEVICE
+#include "hardware/sync.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if PICO_ON_DEVICE
+#define SETPOINT_BARRIER() __dmb()
+#else
+#define SETPOINT_BARRIER() __sync_synchronize()
+#endif
+
+#define SETPOINT_FRAC_BITS 16
+#define SETPOINT_ONE (1 << SETPOINT_FRAC_BITS)
+/// Codes below this are special commands (= DSHOT_ZERO_THROTTLE)
+#define SETPOINT_ZERO_THROTTLE 48
+#define SETPOINT_MAX_THROTTLE 2047
+/// Upper bound on the measured interpolation span (frames)
+#define SETPOINT_MAX_INTERP_FRAMES 0xffff
+
+/**
+ * @brief setpoint stage of one motor
+ *
+ * @param slew_per_frame max change of the output per frame (Q16.16 codes).
+ * 0 disables slew limiting
+ * @param interp_frames frames to interpolate over. 0 => use the number of
+ * frames between the last two setpoints
+ * @param max_interp_frames upper bound on the measured span, so that the
+ * first setpoint after a long pause isn't stretched out
+ * @param pending_seq incremented by @ref setpoint_set after
+ * \a pending_code is written
+ * @param pending_code latest setpoint from the application
+ * @param seen_seq last \a pending_seq picked up by the frame hook
+ * @param target setpoint being interpolated towards
+ * @param reference interpolated setpoint (Q16.16)
+ * @param step added to \a reference every frame (Q16.16)
+ * @param frames_left frames until \a reference reaches \a target
+ * @param frames_since_set frames since the last setpoint was picked up
+ * @param output slew limited \a reference (Q16.16)
+ * @param command \a target is a special command, sent as is
+ */
+typedef struct setpoint {
+  uint32_t slew_per_frame;
+  uint16_t interp_frames;
+  uint16_t max_interp_frames;
+
+  volatile uint32_t pending_seq;
+  volatile uint16_t pending_code;
+
+  uint32_t seen_seq;
+  uint16_t target;
+  int32_t reference;
+  int32_t step;
+  uint16_t frames_left;
+  uint16_t frames_since_set;
+  int32_t output;
+  bool command;
+} setpoint_t;
+
+/**
+ * @brief convert a slew rate to the per frame limit used by @ref setpoint_t
+ *
+ * @param codes_per_s max rate of change in throttle codes per second.
+ * <= 0 disables slew limiting
+ * @param frame_rate_hz dshot packet frequency
+ * @return Q16.16 codes per frame (at least 1 lsb when enabled)
+ */
+static inline uint32_t setpoint_slew_per_frame(const float codes_per_s,
+                                               const float frame_rate_hz) {
+  if (codes_per_s <= 0 || frame_rate_hz <= 0)
+    return 0;
+  const float per_frame = codes_per_s / frame_rate_hz * SETPOINT_ONE;
+  if (per_frame >= (float)INT32_MAX)
+    return 0;
+  return per_frame < 1 ? 1 : (uint32_t)per_frame;
+}
+
+/**
+ * @brief initialise a setpoint stage. The motor starts at \a code
+ *
+ * @param sp
+ * @param code initial throttle code (or special command)
+ * @param slew_per_frame see @ref setpoint_slew_per_frame
+ * @param interp_frames frames to interpolate over, 0 => measured
+ * @param max_interp_frames upper bound on the measured span
+ */
+static inline void setpoint_init(setpoint_t *const sp, const uint16_t code,
+                                 const uint32_t slew_per_frame,
+                                 const uint16_t interp_frames,
+                                 const uint16_t max_interp_frames) {
+  sp->slew_per_frame = slew_per_frame;
+  sp->interp_frames = interp_frames;
+  sp->max_interp_frames = max_interp_frames ? max_interp_frames : 1;
+  sp->pending_seq = 0;
+  sp->pending_code = code;
+  sp->seen_seq = 0;
+  sp->target = code;
+  sp->command = code < SETPOINT_ZERO_THROTTLE;
+  sp->reference = (int32_t)(sp->command ? SETPOINT_ZERO_THROTTLE : code)
+                  << SETPOINT_FRAC_BITS;
+  sp->output = sp->reference;
+  sp->step = 0;
+  sp->frames_left = 0;
+  sp->frames_since_set = 0;
+}
+
+/**
+ * @brief publish a new setpoint. It is picked up at the next frame boundary
+ *
+ * Safe to call from thread context while the frame hook runs in an isr.
+ * If several setpoints are published within one frame, only the last one
+ * is used.
+ *
+ * @param sp
+ * @param code throttle code, or special command (sent without slew)
+ */
+static inline void setpoint_set(setpoint_t *const sp, const uint16_t code) {
+  sp->pending_code = code & 0x7ff;
+  // The code must be visible before the frame hook sees the new seq
+  SETPOINT_BARRIER();
+  sp->pending_seq = sp->pending_seq + 1;
+}
+
+/**
+ * @brief start interpolating towards a new setpoint
+ *
+ * @param sp
+ * @param code
+ */
+static inline void setpoint_start(setpoint_t *const sp, const uint16_t code) {
+  const uint16_t span =
+      sp->interp_frames
+          ? sp->interp_frames
+          : (sp->frames_since_set < sp->max_interp_frames
+                 ? sp->frames_since_set
+                 : sp->max_interp_frames);
+  sp->frames_since_set = 0;
+  sp->target = code;
+
+  if (code < SETPOINT_ZERO_THROTTLE) {
+    sp->command = true;
+    sp->frames_left = 0;
+    return;
+  }
+
+  // Leaving command mode (e.g. disarmed): ramp up from zero throttle
+  if (sp->command) {
+    sp->command = false;
+    sp->reference = SETPOINT_ZERO_THROTTLE << SETPOINT_FRAC_BITS;
+    sp->output = sp->reference;
+  }
+
+  const int32_t goal = (int32_t)code << SETPOINT_FRAC_BITS;
+  if (span <= 1) {
+    sp->reference = goal;
+    sp->frames_left = 0;
+    return;
+  }
+  // One division per setpoint, none per frame
+  sp->step = (goal - sp->reference) / span;
+  sp->frames_left = span;
+}
+
+/**
+ * @brief advance the stage by one frame
+ *
+ * @param sp
+ * @return throttle code (or special command) for this frame
+ */
+static inline uint16_t setpoint_step(setpoint_t *const sp) {
+  const uint32_t seq = sp->pending_seq;
+  if (seq != sp->seen_seq) {
+    SETPOINT_BARRIER();
+    sp->seen_seq = seq;
+    setpoint_start(sp, sp->pending_code);
+  }
+  if (sp->frames_since_set < UINT16_MAX)
+    sp->frames_since_set++;
+
+  if (sp->command)
+    return sp->target;
+
+  if (sp->frames_left) {
+    // Land exactly on the target, whatever the rounding of step
+    sp->reference = --sp->frames_left
+                        ? sp->reference + sp->step
+                        : (int32_t)sp->target << SETPOINT_FRAC_BITS;
+  }
+
+  int32_t delta = sp->reference - sp->output;
+  if (sp->slew_per_frame) {
+    const int32_t limit = (int32_t)sp->slew_per_frame;
+    delta = delta > limit ? limit : (delta < -limit ? -limit : delta);
+  }
+  sp->output += delta;
+
+  const int32_t code =
+      (sp->output + (SETPOINT_ONE >> 1)) >> SETPOINT_FRAC_BITS;
+  return code > SETPOINT_MAX_THROTTLE ? SETPOINT_MAX_THROTTLE : (uint16_t)code;
+}
+
+/**
+ * @brief frame hook (see @ref dshot_set_frame_hook) that runs the stage
+ *
+ * @param packet
+ * @param data @ref setpoint_t of this motor
+ */
+static inline void setpoint_frame_hook(dshot_packet_t *const packet,
+                                       void *const data) {
+  packet->throttle_code = setpoint_step((setpoint_t *)data);
+}
+
+#ifdef __cplusplus
+}
+#endif
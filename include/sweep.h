@@ -0,0 +1,498 @@
+/**
+ * @file sweep.h
+ * @defgroup sweep sweep
+ * @brief On device throttle sweep with settle detection
+ *
+ * A host driven sweep sets a throttle, sleeps for a guessed time, then
+ * averages telemetry. Instead, this engine steps through a list of
+ * throttle codes and, for each step:
+ *
+ * 1. publishes the code to the motor's @ref setpoint_t
+ * 2. waits until the motor has settled: over the last
+ *    @ref SWEEP_SETTLE_WINDOW samples, the rolling standard deviation of
+ *    erpm and current is below a threshold, and so is the difference
+ *    between the means of the older and newer half of the window. The
+ *    trend check stops a slow approach from passing as steady. The step
+ *    is measured anyway once @ref sweep_config_t::max_settle_us has passed
+ * 3. aggregates @ref sweep_config_t::measure_samples samples with
+ *    @ref telemstats_t
+ * 4. emits a @ref SWEEP_RECORD_SIZE byte result record
+ *
+ * so each step ends as soon as it has settled.
+ *
+ * Result record (little endian):
+ *
+ * | Byte(s) | Field                                   |
+ * | :-----: | --------------------------------------- |
+ * | 0 \| 1  | sync word 0x5E57                        |
+ * |    2    | step idx                                |
+ * |    3    | flags (@ref sweep_flags)                |
+ * | 4 \| 5  | throttle code                           |
+ * | 6 \| 7  | settle time (ms)                        |
+ * | 8 \| 9  | samples aggregated                      |
+ * | 10 - 13 | mean erpm                               |
+ * | 14 \| 15| erpm standard deviation                 |
+ * | 16 \| 17| mean centi current                      |
+ * | 18 \| 19| centi current standard deviation        |
+ * | 20 \| 21| mean centi voltage                      |
+ * |   22    | max temperature (1 C)                   |
+ * |   23    | record CRC8 of bytes 0-22               |
+ *
+ * `tools/sweep_decode.py` decodes the records to csv.
+ */
+
+#pragma once
+#include "kissesctelem.h"
+#include "setpoint.h"
+#include "stdbool.h"
+#include "stddef.h"
+#include "stdint.h"
+#include "telemstats.h"
+
+#if PICO_ON_DEVICE
+#include "pico/stdio.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SWEEP_SYNC 0x5E57u
+#define SWEEP_RECORD_SIZE 24
+
+/// Samples in the rolling settle window. Must be a power of 2
+#ifndef SWEEP_SETTLE_WINDOW
+#define SWEEP_SETTLE_WINDOW 16
+#endif
+
+enum sweep_flags {
+  /// the step settled before the timeout
+  SWEEP_FLAG_SETTLED = 1 << 0,
+  /// the settle timeout expired, the step was measured anyway
+  SWEEP_FLAG_TIMEOUT = 1 << 1,
+  /// last step of the sweep
+  SWEEP_FLAG_LAST = 1 << 2,
+};
+
+typedef enum sweep_state {
+  SWEEP_IDLE,
+  SWEEP_SETTLING,
+  SWEEP_MEASURING,
+  SWEEP_DONE,
+} sweep_state_t;
+
+/**
+ * @brief sweep configuration
+ *
+ * @param codes throttle code of each step
+ * @param steps number of steps (<= 256)
+ * @param end_code throttle code published after the last step
+ * @param min_settle_us settle detection starts after this (skips samples
+ * from before the step and the setpoint slew)
+ * @param max_settle_us measure anyway after this
+ * @param erpm_std_max settled when the erpm std is below this (erpm,
+ * with a resolution of 100 erpm)
+ * @param current_std_max ... and the current std is below this (0.01 A)
+ * @param measure_samples samples aggregated per step
+ */
+typedef struct sweep_config {
+  const uint16_t *codes;
+  size_t steps;
+  uint16_t end_code;
+  uint32_t min_settle_us;
+  uint32_t max_settle_us;
+  uint32_t erpm_std_max;
+  uint16_t current_std_max;
+  uint32_t measure_samples;
+} sweep_config_t;
+
+/**
+ * @brief rolling sums over the last @ref SWEEP_SETTLE_WINDOW samples
+ *
+ * @param erpm erpm / 100 ring
+ * @param current centi current ring
+ * @param erpm_recent, current_recent sums of the newer half of the window
+ * @param count samples in the window (<= SWEEP_SETTLE_WINDOW)
+ * @param idx next slot to overwrite
+ */
+typedef struct sweep_window {
+  int32_t erpm[SWEEP_SETTLE_WINDOW];
+  int32_t current[SWEEP_SETTLE_WINDOW];
+  int64_t erpm_sum, erpm_sumsq;
+  int64_t current_sum, current_sumsq;
+  int32_t erpm_recent, current_recent;
+  uint32_t count;
+  uint32_t idx;
+} sweep_window_t;
+
+/**
+ * @brief result of one step, see the record layout above
+ */
+typedef struct sweep_result {
+  uint8_t step;
+  uint8_t flags;
+  uint16_t code;
+  uint16_t settle_ms;
+  uint16_t samples;
+  uint32_t erpm_mean;
+  uint16_t erpm_std;
+  uint16_t current_mean;
+  uint16_t current_std;
+  uint16_t voltage_mean;
+  int8_t temperature_max;
+} sweep_result_t;
+
+/**
+ * @brief sweep engine
+ *
+ * @param config
+ * @param setpoint stage the codes are published to
+ * @param state
+ * @param step current step
+ * @param step_start_us time the current step started
+ * @param settle_us time the current step took to settle
+ * @param flags flags of the current step
+ * @param window rolling settle window
+ * @param stats aggregate of the measurement window
+ * @param result last completed step
+ */
+typedef struct sweep {
+  sweep_config_t config;
+  setpoint_t *setpoint;
+  sweep_state_t state;
+  size_t step;
+  uint32_t step_start_us;
+  uint32_t settle_us;
+  uint8_t flags;
+  sweep_window_t window;
+  telemstats_t stats;
+  sweep_result_t result;
+} sweep_t;
+
+/// @brief integer square root, rounded down
+static inline uint32_t sweep_isqrt(uint64_t x) {
+  uint64_t root = 0;
+  uint64_t bit = 1ull << 62;
+  while (bit > x)
+    bit >>= 2;
+  while (bit) {
+    if (x >= root + bit) {
+      x -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (uint32_t)root;
+}
+
+static inline void sweep_window_reset(sweep_window_t *const window) {
+  window->erpm_sum = window->erpm_sumsq = 0;
+  window->current_sum = window->current_sumsq = 0;
+  window->erpm_recent = window->current_recent = 0;
+  window->count = 0;
+  window->idx = 0;
+}
+
+/**
+ * @brief add a sample to the rolling window in O(1)
+ *
+ * @param window
+ * @param erpm_hundreds erpm / 100
+ * @param current centi current
+ */
+static inline void sweep_window_push(sweep_window_t *const window,
+                                     const int32_t erpm_hundreds,
+                                     const int32_t current) {
+  const uint32_t i = window->idx;
+  if (window->count == SWEEP_SETTLE_WINDOW) {
+    const int32_t old_erpm = window->erpm[i], old_current = window->current[i];
+    window->erpm_sum -= old_erpm;
+    window->erpm_sumsq -= (int64_t)old_erpm * old_erpm;
+    window->current_sum -= old_current;
+    window->current_sumsq -= (int64_t)old_current * old_current;
+  } else {
+    window->count++;
+  }
+  window->erpm[i] = erpm_hundreds;
+  window->current[i] = current;
+  window->erpm_sum += erpm_hundreds;
+  window->erpm_sumsq += (int64_t)erpm_hundreds * erpm_hundreds;
+  window->current_sum += current;
+  window->current_sumsq += (int64_t)current * current;
+  window->idx = (i + 1) & (SWEEP_SETTLE_WINDOW - 1);
+
+  // The sample half a window back moves from the newer to the older half
+  window->erpm_recent += erpm_hundreds;
+  window->current_recent += current;
+  if (window->count > SWEEP_SETTLE_WINDOW / 2) {
+    const uint32_t mid =
+        (i - SWEEP_SETTLE_WINDOW / 2) & (SWEEP_SETTLE_WINDOW - 1);
+    window->erpm_recent -= window->erpm[mid];
+    window->current_recent -= window->current[mid];
+  }
+}
+
+/**
+ * @brief true if the population std of a full window is <= std_max,
+ * i.e. n * sumsq - sum^2 <= (n * std_max)^2, in exact integers
+ */
+static inline bool sweep_window_std_below(const int64_t sum,
+                                          const int64_t sumsq,
+                                          const int64_t std_max) {
+  const int64_t n = SWEEP_SETTLE_WINDOW;
+  return n * sumsq - sum * sum <= n * n * std_max * std_max;
+}
+
+/**
+ * @brief true if the means of the two halves of a full window differ by
+ * at most max_diff, i.e. |recent - older| <= n / 2 * max_diff
+ */
+static inline bool sweep_window_flat(const int64_t sum, const int32_t recent,
+                                     const int64_t max_diff) {
+  const int64_t diff = 2 * (int64_t)recent - sum;
+  return (diff < 0 ? -diff : diff) <= SWEEP_SETTLE_WINDOW / 2 * max_diff;
+}
+
+/// @brief true once the rolling window is full, quiet and flat
+static inline bool sweep_window_settled(const sweep_window_t *const window,
+                                        const sweep_config_t *const config) {
+  if (window->count < SWEEP_SETTLE_WINDOW)
+    return false;
+  // erpm is windowed in units of 100 erpm
+  const int64_t erpm_max = config->erpm_std_max / 100;
+  const int64_t current_max = config->current_std_max;
+  return sweep_window_std_below(window->erpm_sum, window->erpm_sumsq,
+                                erpm_max) &&
+         sweep_window_flat(window->erpm_sum, window->erpm_recent, erpm_max) &&
+         sweep_window_std_below(window->current_sum, window->current_sumsq,
+                                current_max) &&
+         sweep_window_flat(window->current_sum, window->current_recent,
+                           current_max);
+}
+
+/**
+ * @brief initialise a sweep. Nothing is published until @ref sweep_start
+ *
+ * @param sweep
+ * @param config copied (the codes are not)
+ * @param setpoint stage of the motor under test
+ */
+static inline void sweep_init(sweep_t *const sweep,
+                              const sweep_config_t *const config,
+                              setpoint_t *const setpoint) {
+  static const uint8_t ewma_shift[TELEMSTATS_EWMA_COUNT] = {0};
+  sweep->config = *config;
+  sweep->setpoint = setpoint;
+  sweep->state = SWEEP_IDLE;
+  sweep->step = 0;
+  sweep->step_start_us = 0;
+  sweep->settle_us = 0;
+  sweep->flags = 0;
+  sweep_window_reset(&sweep->window);
+  telemstats_init(&sweep->stats, ewma_shift);
+}
+
+static inline void sweep_begin_step(sweep_t *const sweep,
+                                    const uint32_t now_us) {
+  sweep->state = SWEEP_SETTLING;
+  sweep->step_start_us = now_us;
+  sweep->settle_us = 0;
+  sweep->flags = 0;
+  sweep_window_reset(&sweep->window);
+  setpoint_set(sweep->setpoint, sweep->config.codes[sweep->step]);
+}
+
+/**
+ * @brief start the sweep from its first step
+ *
+ * @param sweep
+ * @param now_us
+ */
+static inline void sweep_start(sweep_t *const sweep, const uint32_t now_us) {
+  sweep->step = 0;
+  if (!sweep->config.steps) {
+    sweep->state = SWEEP_DONE;
+    return;
+  }
+  sweep_begin_step(sweep, now_us);
+}
+
+/// @brief abort the sweep and publish the end code
+static inline void sweep_stop(sweep_t *const sweep) {
+  sweep->state = SWEEP_DONE;
+  setpoint_set(sweep->setpoint, sweep->config.end_code);
+}
+
+static inline void sweep_begin_measure(sweep_t *const sweep,
+                                       const uint32_t elapsed_us,
+                                       const uint8_t flag) {
+  sweep->state = SWEEP_MEASURING;
+  sweep->settle_us = elapsed_us;
+  sweep->flags |= flag;
+  telemstats_reset_window(&sweep->stats);
+}
+
+/**
+ * @brief check the settle timeout. Call this regularly, so that a step
+ * without any telemetry doesn't stall the sweep
+ *
+ * @param sweep
+ * @param now_us
+ */
+static inline void sweep_poll(sweep_t *const sweep, const uint32_t now_us) {
+  const uint32_t elapsed = now_us - sweep->step_start_us;
+  if (sweep->state == SWEEP_SETTLING && elapsed >= sweep->config.max_settle_us)
+    sweep_begin_measure(sweep, elapsed, SWEEP_FLAG_TIMEOUT);
+}
+
+/// @brief fill @ref sweep_t::result from the measurement window
+static inline void sweep_finish_step(sweep_t *const sweep) {
+  telemstats_result_t stats;
+  telemstats_snapshot(&sweep->stats, &stats, false);
+  const telemstats_channel_result_t *const erpm =
+      &stats.channel[TELEMSTATS_ERPM];
+  const telemstats_channel_result_t *const current =
+      &stats.channel[TELEMSTATS_CURRENT];
+
+  sweep_result_t *const r = &sweep->result;
+  r->step = (uint8_t)sweep->step;
+  r->flags = sweep->flags |
+             (sweep->step + 1 == sweep->config.steps ? SWEEP_FLAG_LAST : 0);
+  r->code = sweep->config.codes[sweep->step];
+  const uint32_t settle_ms = sweep->settle_us / 1000;
+  r->settle_ms = settle_ms > UINT16_MAX ? UINT16_MAX : settle_ms;
+  r->samples = stats.count > UINT16_MAX ? UINT16_MAX : stats.count;
+  // Q16 mean of erpm / 100
+  r->erpm_mean = (uint32_t)((erpm->mean * 100) >> TELEMSTATS_MEAN_FRAC_BITS);
+  // Q8 variance of erpm / 100, to erpm
+  const uint32_t erpm_std =
+      sweep_isqrt((erpm->variance * 10000) >> TELEMSTATS_M2_FRAC_BITS);
+  r->erpm_std = erpm_std > UINT16_MAX ? UINT16_MAX : erpm_std;
+  r->current_mean = (uint16_t)(current->mean >> TELEMSTATS_MEAN_FRAC_BITS);
+  r->current_std =
+      sweep_isqrt(current->variance >> TELEMSTATS_M2_FRAC_BITS);
+  r->voltage_mean = (uint16_t)(stats.channel[TELEMSTATS_VOLTAGE].mean >>
+                               TELEMSTATS_MEAN_FRAC_BITS);
+  r->temperature_max = (int8_t)stats.channel[TELEMSTATS_TEMPERATURE].max;
+}
+
+/**
+ * @brief feed a validated telemetry sample of the motor under test
+ *
+ * @param sweep
+ * @param telem telemetry with a valid crc
+ * @param timestamp_us time the sample was received
+ * @return true if a step completed: its result is in @ref sweep_t::result
+ */
+static inline bool sweep_update(sweep_t *const sweep,
+                                const kissesc_telem_t *const telem,
+                                const uint32_t timestamp_us) {
+  sweep_poll(sweep, timestamp_us);
+
+  if (sweep->state == SWEEP_SETTLING) {
+    const uint32_t elapsed = timestamp_us - sweep->step_start_us;
+    sweep_window_push(&sweep->window, (int32_t)(telem->erpm / 100),
+                      telem->centi_current);
+    if (elapsed >= sweep->config.min_settle_us &&
+        sweep_window_settled(&sweep->window, &sweep->config))
+      sweep_begin_measure(sweep, elapsed, SWEEP_FLAG_SETTLED);
+    return false;
+  }
+
+  if (sweep->state != SWEEP_MEASURING)
+    return false;
+
+  telemstats_update(&sweep->stats, telem, timestamp_us);
+  if (sweep->stats.count < sweep->config.measure_samples)
+    return false;
+
+  sweep_finish_step(sweep);
+  if (++sweep->step < sweep->config.steps) {
+    sweep_begin_step(sweep, timestamp_us);
+  } else {
+    sweep_stop(sweep);
+  }
+  return true;
+}
+
+/**
+ * @brief pack a result into a record
+ *
+ * @param result
+ * @param record output of @ref SWEEP_RECORD_SIZE bytes
+ */
+static inline void sweep_encode(const sweep_result_t *const result,
+                                uint8_t record[]) {
+  record[0] = SWEEP_SYNC & 0xff;
+  record[1] = SWEEP_SYNC >> 8;
+  record[2] = result->step;
+  record[3] = result->flags;
+  record[4] = result->code & 0xff;
+  record[5] = result->code >> 8;
+  record[6] = result->settle_ms & 0xff;
+  record[7] = result->settle_ms >> 8;
+  record[8] = result->samples & 0xff;
+  record[9] = result->samples >> 8;
+  record[10] = result->erpm_mean & 0xff;
+  record[11] = (result->erpm_mean >> 8) & 0xff;
+  record[12] = (result->erpm_mean >> 16) & 0xff;
+  record[13] = result->erpm_mean >> 24;
+  record[14] = result->erpm_std & 0xff;
+  record[15] = result->erpm_std >> 8;
+  record[16] = result->current_mean & 0xff;
+  record[17] = result->current_mean >> 8;
+  record[18] = result->current_std & 0xff;
+  record[19] = result->current_std >> 8;
+  record[20] = result->voltage_mean & 0xff;
+  record[21] = result->voltage_mean >> 8;
+  record[22] = (uint8_t)result->temperature_max;
+  record[23] = kissesc_get_crc8(record, SWEEP_RECORD_SIZE - 1);
+}
+
+/**
+ * @brief unpack a record (used by host side tools and tests)
+ *
+ * @param record @ref SWEEP_RECORD_SIZE bytes
+ * @param result output
+ * @return false if the sync word or record CRC is wrong
+ */
+static inline bool sweep_decode(const uint8_t record[],
+                                sweep_result_t *const result) {
+  const uint16_t sync = record[0] | record[1] << 8;
+  if (sync != SWEEP_SYNC || kissesc_get_crc8(record, SWEEP_RECORD_SIZE) != 0)
+    return false;
+  result->step = record[2];
+  result->flags = record[3];
+  result->code = record[4] | record[5] << 8;
+  result->settle_ms = record[6] | record[7] << 8;
+  result->samples = record[8] | record[9] << 8;
+  result->erpm_mean = (uint32_t)record[10] | (uint32_t)record[11] << 8 |
+                      (uint32_t)record[12] << 16 | (uint32_t)record[13] << 24;
+  result->erpm_std = record[14] | record[15] << 8;
+  result->current_mean = record[16] | record[17] << 8;
+  result->current_std = record[18] | record[19] << 8;
+  result->voltage_mean = record[20] | record[21] << 8;
+  result->temperature_max = (int8_t)record[22];
+  return true;
+}
+
+#if PICO_ON_DEVICE
+/**
+ * @brief write a result record over stdio (without any crlf translation)
+ *
+ * @param result
+ */
+static void sweep_write_result(const sweep_result_t *const result) {
+  uint8_t record[SWEEP_RECORD_SIZE];
+  sweep_encode(result, record);
+  for (size_t i = 0; i < SWEEP_RECORD_SIZE; ++i) {
+    putchar_raw(record[i]);
+  }
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,362 @@
+/**
+ * @file telemdecim.h
+ * @defgroup telemdecim telemdecim
+ * @brief Per ESC telemetry decimation with min / max downsampling
+ *
+ * Streaming every sample (see telemstream.h) costs 20 bytes per sample,
+ * which a busy or slow link can't always keep up with. Dropping samples
+ * would hide the peaks, so instead each ESC folds its validated samples
+ * into one record per @ref telemdecim_config_t::samples samples, or per
+ * @ref telemdecim_config_t::window_us, whichever comes first. The record
+ * holds min, max, mean and last of every field, so peaks survive any
+ * ratio. e.g. 8 ESCs sharing 1 kHz of telemetry, decimated by 10, need
+ * 100 records/s x 53 bytes ~ 5.3 kB/s.
+ *
+ * The ratio can be changed at runtime (see @ref HOSTCMD_DECIM_CONFIG).
+ *
+ * Record (little endian):
+ *
+ * | Byte(s) | Field                                          |
+ * | :-----: | ---------------------------------------------- |
+ * | 0 \| 1  | sync word 0x5A7D                               |
+ * | 2 \| 3  | sequence number                                |
+ * |    4    | ESC idx                                        |
+ * |    5    | corrupt samples in the window (saturates)      |
+ * | 6 \| 7  | samples aggregated                             |
+ * | 8 - 11  | timestamp of the first sample (us)             |
+ * | 12 - 15 | timestamp of the last sample (us)              |
+ * | 16 - 19 | temperature min, max, mean, last (1 C, int8)   |
+ * | 20 - 27 | centi voltage min, max, mean, last             |
+ * | 28 - 35 | centi current min, max, mean, last             |
+ * | 36 - 43 | consumption min, max, mean, last (mAh)         |
+ * | 44 - 51 | erpm / 100 min, max, mean, last                |
+ * |   52    | record CRC8 of bytes 0-51                      |
+ *
+ * `tools/telemdecim_decode.py` decodes the records to csv.
+ */
+
+#pragma once
+#include "kissesctelem.h"
+#include "stdbool.h"
+#include "stddef.h"
+#include "stdint.h"
+#include "telemqueue.h"
+
+#if PICO_ON_DEVICE
+#include "pico/stdio.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TELEMDECIM_SYNC 0x5A7Du
+#define TELEMDECIM_RECORD_SIZE 53
+
+/// @brief fields of a record, in KISS wire units
+enum telemdecim_field {
+  TELEMDECIM_TEMPERATURE,
+  TELEMDECIM_VOLTAGE,
+  TELEMDECIM_CURRENT,
+  TELEMDECIM_CONSUMPTION,
+  TELEMDECIM_ERPM,
+  TELEMDECIM_FIELDS,
+};
+
+/**
+ * @brief decimation ratio
+ *
+ * @param samples emit after this many valid samples (0 => no limit)
+ * @param window_us emit once the window spans this long (0 => no limit).
+ * With both limits 0, every sample is a record
+ */
+typedef struct telemdecim_config {
+  uint16_t samples;
+  uint32_t window_us;
+} telemdecim_config_t;
+
+/**
+ * @brief aggregate of one field over a window
+ */
+typedef struct telemdecim_acc {
+  int32_t min;
+  int32_t max;
+  int32_t last;
+  int64_t sum;
+} telemdecim_acc_t;
+
+/**
+ * @brief one downsampled record
+ *
+ * @param esc_idx
+ * @param bad corrupt samples in the window
+ * @param count valid samples aggregated
+ * @param first_us timestamp of the first sample
+ * @param last_us timestamp of the last sample
+ * @param min, max, mean, last per @ref telemdecim_field
+ */
+typedef struct telemdecim_record {
+  uint8_t esc_idx;
+  uint8_t bad;
+  uint16_t count;
+  uint32_t first_us;
+  uint32_t last_us;
+  int32_t min[TELEMDECIM_FIELDS];
+  int32_t max[TELEMDECIM_FIELDS];
+  int32_t mean[TELEMDECIM_FIELDS];
+  int32_t last[TELEMDECIM_FIELDS];
+} telemdecim_record_t;
+
+/**
+ * @brief decimation stage of one ESC
+ *
+ * @param config
+ * @param esc_idx
+ * @param count valid samples in the window
+ * @param bad corrupt samples in the window
+ * @param first_us timestamp of the first sample in the window
+ * @param last_us timestamp of the last sample
+ * @param acc per field aggregates
+ */
+typedef struct telemdecim {
+  telemdecim_config_t config;
+  uint8_t esc_idx;
+  uint32_t count;
+  uint32_t bad;
+  uint32_t first_us;
+  uint32_t last_us;
+  telemdecim_acc_t acc[TELEMDECIM_FIELDS];
+} telemdecim_t;
+
+/// @brief drop the current window
+static inline void telemdecim_reset(telemdecim_t *const decim) {
+  decim->count = 0;
+  decim->bad = 0;
+  decim->first_us = 0;
+  decim->last_us = 0;
+  for (int f = 0; f < TELEMDECIM_FIELDS; ++f) {
+    decim->acc[f].min = INT32_MAX;
+    decim->acc[f].max = INT32_MIN;
+    decim->acc[f].last = 0;
+    decim->acc[f].sum = 0;
+  }
+}
+
+/**
+ * @brief initialise the decimation stage of one ESC
+ *
+ * @param decim
+ * @param esc_idx
+ * @param config
+ */
+static inline void telemdecim_init(telemdecim_t *const decim,
+                                   const uint8_t esc_idx,
+                                   const telemdecim_config_t *const config) {
+  decim->config = *config;
+  decim->esc_idx = esc_idx;
+  telemdecim_reset(decim);
+}
+
+/**
+ * @brief change the ratio. The current window is dropped, so call
+ * @ref telemdecim_flush first to keep it
+ *
+ * @param decim
+ * @param config
+ */
+static inline void telemdecim_set_config(telemdecim_t *const decim,
+                                         const telemdecim_config_t *config) {
+  decim->config = *config;
+  telemdecim_reset(decim);
+}
+
+/// @brief mean rounded to the nearest integer
+static inline int32_t telemdecim_mean(const int64_t sum,
+                                      const uint32_t count) {
+  if (!count)
+    return 0;
+  const int64_t half = count / 2;
+  return (int32_t)(sum >= 0 ? (sum + half) / count : (sum - half) / count);
+}
+
+/**
+ * @brief emit the current window, if it has any sample
+ *
+ * @param decim
+ * @param record output
+ * @return false if the window is empty
+ */
+static inline bool telemdecim_flush(telemdecim_t *const decim,
+                                    telemdecim_record_t *const record) {
+  if (!decim->count) {
+    // Keep counting corrupt samples until a valid one shows up
+    return false;
+  }
+  record->esc_idx = decim->esc_idx;
+  record->bad = decim->bad > UINT8_MAX ? UINT8_MAX : decim->bad;
+  record->count = decim->count > UINT16_MAX ? UINT16_MAX : decim->count;
+  record->first_us = decim->first_us;
+  record->last_us = decim->last_us;
+  for (int f = 0; f < TELEMDECIM_FIELDS; ++f) {
+    const telemdecim_acc_t *const acc = &decim->acc[f];
+    record->min[f] = acc->min;
+    record->max[f] = acc->max;
+    record->mean[f] = telemdecim_mean(acc->sum, decim->count);
+    record->last[f] = acc->last;
+  }
+  telemdecim_reset(decim);
+  return true;
+}
+
+static inline void telemdecim_acc_update(telemdecim_acc_t *const acc,
+                                         const int32_t x) {
+  if (x < acc->min)
+    acc->min = x;
+  if (x > acc->max)
+    acc->max = x;
+  acc->last = x;
+  acc->sum += x;
+}
+
+/**
+ * @brief fold a sample of this ESC into the window
+ *
+ * Call this from a single context (e.g. the main loop draining
+ * @ref telem_queue_t).
+ *
+ * @param decim
+ * @param sample corrupt samples (`telem.crc != 0`) are only counted
+ * @param record output, written when a window completes
+ * @return true if a window completed
+ */
+static inline bool telemdecim_update(telemdecim_t *const decim,
+                                     const telem_sample_t *const sample,
+                                     telemdecim_record_t *const record) {
+  if (sample->telem.crc != 0) {
+    decim->bad++;
+    return false;
+  }
+  const kissesc_telem_t *const t = &sample->telem;
+  if (!decim->count)
+    decim->first_us = sample->timestamp_us;
+  decim->last_us = sample->timestamp_us;
+  decim->count++;
+  telemdecim_acc_update(&decim->acc[TELEMDECIM_TEMPERATURE], t->temperature);
+  telemdecim_acc_update(&decim->acc[TELEMDECIM_VOLTAGE], t->centi_voltage);
+  telemdecim_acc_update(&decim->acc[TELEMDECIM_CURRENT], t->centi_current);
+  telemdecim_acc_update(&decim->acc[TELEMDECIM_CONSUMPTION], t->consumption);
+  // erpm is decoded from a 16 bit value in units of 100 erpm
+  telemdecim_acc_update(&decim->acc[TELEMDECIM_ERPM],
+                        (int32_t)(t->erpm / 100));
+
+  const telemdecim_config_t *const cfg = &decim->config;
+  const bool unlimited = !cfg->samples && !cfg->window_us;
+  const bool full = cfg->samples && decim->count >= cfg->samples;
+  const bool elapsed =
+      cfg->window_us && decim->last_us - decim->first_us >= cfg->window_us;
+  if (unlimited || full || elapsed)
+    return telemdecim_flush(decim, record);
+  return false;
+}
+
+static inline void telemdecim_put_u16(uint8_t *const out, const int32_t v) {
+  out[0] = (uint16_t)v & 0xff;
+  out[1] = (uint16_t)v >> 8;
+}
+
+static inline void telemdecim_put_u32(uint8_t *const out, const uint32_t v) {
+  out[0] = v & 0xff;
+  out[1] = (v >> 8) & 0xff;
+  out[2] = (v >> 16) & 0xff;
+  out[3] = v >> 24;
+}
+
+/**
+ * @brief pack a record
+ *
+ * @param record
+ * @param seq sequence number
+ * @param out output of @ref TELEMDECIM_RECORD_SIZE bytes
+ */
+static inline void telemdecim_encode(const telemdecim_record_t *const record,
+                                     const uint16_t seq, uint8_t out[]) {
+  telemdecim_put_u16(&out[0], TELEMDECIM_SYNC);
+  telemdecim_put_u16(&out[2], seq);
+  out[4] = record->esc_idx;
+  out[5] = record->bad;
+  telemdecim_put_u16(&out[6], record->count);
+  telemdecim_put_u32(&out[8], record->first_us);
+  telemdecim_put_u32(&out[12], record->last_us);
+  out[16] = (uint8_t)record->min[TELEMDECIM_TEMPERATURE];
+  out[17] = (uint8_t)record->max[TELEMDECIM_TEMPERATURE];
+  out[18] = (uint8_t)record->mean[TELEMDECIM_TEMPERATURE];
+  out[19] = (uint8_t)record->last[TELEMDECIM_TEMPERATURE];
+  uint8_t *p = &out[20];
+  for (int f = TELEMDECIM_VOLTAGE; f < TELEMDECIM_FIELDS; ++f) {
+    telemdecim_put_u16(&p[0], record->min[f]);
+    telemdecim_put_u16(&p[2], record->max[f]);
+    telemdecim_put_u16(&p[4], record->mean[f]);
+    telemdecim_put_u16(&p[6], record->last[f]);
+    p += 8;
+  }
+  out[52] = kissesc_get_crc8(out, TELEMDECIM_RECORD_SIZE - 1);
+}
+
+/**
+ * @brief unpack a record (used by host side tools and tests)
+ *
+ * @param in @ref TELEMDECIM_RECORD_SIZE bytes
+ * @param record output
+ * @param seq output sequence number
+ * @return false if the sync word or record CRC is wrong
+ */
+static inline bool telemdecim_decode(const uint8_t in[],
+                                     telemdecim_record_t *const record,
+                                     uint16_t *const seq) {
+  const uint16_t sync = in[0] | in[1] << 8;
+  if (sync != TELEMDECIM_SYNC ||
+      kissesc_get_crc8(in, TELEMDECIM_RECORD_SIZE) != 0)
+    return false;
+  *seq = in[2] | in[3] << 8;
+  record->esc_idx = in[4];
+  record->bad = in[5];
+  record->count = in[6] | in[7] << 8;
+  record->first_us = (uint32_t)in[8] | (uint32_t)in[9] << 8 |
+                     (uint32_t)in[10] << 16 | (uint32_t)in[11] << 24;
+  record->last_us = (uint32_t)in[12] | (uint32_t)in[13] << 8 |
+                    (uint32_t)in[14] << 16 | (uint32_t)in[15] << 24;
+  record->min[TELEMDECIM_TEMPERATURE] = (int8_t)in[16];
+  record->max[TELEMDECIM_TEMPERATURE] = (int8_t)in[17];
+  record->mean[TELEMDECIM_TEMPERATURE] = (int8_t)in[18];
+  record->last[TELEMDECIM_TEMPERATURE] = (int8_t)in[19];
+  const uint8_t *p = &in[20];
+  for (int f = TELEMDECIM_VOLTAGE; f < TELEMDECIM_FIELDS; ++f) {
+    record->min[f] = p[0] | p[1] << 8;
+    record->max[f] = p[2] | p[3] << 8;
+    record->mean[f] = p[4] | p[5] << 8;
+    record->last[f] = p[6] | p[7] << 8;
+    p += 8;
+  }
+  return true;
+}
+
+#if PICO_ON_DEVICE
+/**
+ * @brief write a record over stdio (without any crlf translation)
+ *
+ * @param record
+ * @param seq sequence number
+ */
+static void telemdecim_write(const telemdecim_record_t *const record,
+                             const uint16_t seq) {
+  uint8_t out[TELEMDECIM_RECORD_SIZE];
+  telemdecim_encode(record, seq, out);
+  for (size_t i = 0; i < TELEMDECIM_RECORD_SIZE; ++i) {
+    putchar_raw(out[i]);
+  }
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,244 @@
+/**
+ * @file telemhealth.h
+ * @defgroup telemhealth telemhealth
+ * @brief Per ESC health of the onewire telemetry
+ *
+ * The onewire requests telemetry from one ESC per timer period (a request
+ * slot), round robin. Without any checks, a dead or desynced ESC just
+ * stops producing samples, and nothing notices. Each ESC therefore keeps:
+ *
+ * - the outcome of its last slot (@ref telemhealth_slot)
+ * - the number of consecutive slots without a valid reply
+ * - the time of its last valid reply, for the age of its telemetry
+ * - a stale flag, raised once @ref telemhealth_t::stale_cycles consecutive
+ *   slots have gone by without a valid reply, and cleared by the next one
+ *
+ * The uart isr reports complete replies with @ref telemhealth_reply. At
+ * the end of the slot, the request timer calls @ref telemhealth_slot_end,
+ * which classifies the slot and tells it when to recover (resync the
+ * parser). Both are O(1), so the cost per request slot doesn't depend on
+ * the number of ESCs.
+ *
+ * An ESC gets a slot every @ref ESC_COUNT timer periods, so a dead ESC is
+ * flagged stale at most stale_cycles * ESC_COUNT periods after its last
+ * valid reply (see @ref telemhealth_detect_us).
+ */
+
+#pragma once
+#include "stdbool.h"
+#include "stdint.h"
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Default number of consecutive slots without a valid reply to go stale
+#ifndef TELEMHEALTH_STALE_CYCLES
+#define TELEMHEALTH_STALE_CYCLES 3
+#endif
+
+/// @brief outcome of a request slot
+enum telemhealth_slot {
+  TELEMHEALTH_SLOT_VALID,   ///< a reply with a valid crc
+  TELEMHEALTH_SLOT_BAD,     ///< a complete reply with a bad crc
+  TELEMHEALTH_SLOT_PARTIAL, ///< bytes of an incomplete reply left over
+  TELEMHEALTH_SLOT_MISSING, ///< the request went out, but no reply came
+  TELEMHEALTH_SLOT_UNSENT,  ///< the request frame was never sent
+};
+
+/**
+ * @brief telemetry health of one ESC
+ *
+ * Totals, by slot outcome:
+ * @param valid
+ * @param bad
+ * @param partial
+ * @param missing
+ * @param unsent
+ * @param recoveries number of times the parser was resynced
+ *
+ * @param last_valid_us arrival of the last valid reply
+ * @param consecutive slots without a valid reply, since the last one
+ * @param stale_cycles raise the stale flag after this many consecutive slots
+ * @param slot_valid valid replies in the current slot (written by the isr)
+ * @param slot_bad bad replies in the current slot (written by the isr)
+ * @param has_valid a valid reply has been received (else last_valid_us is
+ * meaningless)
+ * @param stale
+ * @param last_slot outcome of the last slot (@ref telemhealth_slot)
+ */
+typedef struct telemhealth {
+  uint32_t valid;
+  uint32_t bad;
+  uint32_t partial;
+  uint32_t missing;
+  uint32_t unsent;
+  uint32_t recoveries;
+  uint32_t last_valid_us;
+  uint16_t consecutive;
+  uint16_t stale_cycles;
+  uint8_t slot_valid;
+  uint8_t slot_bad;
+  bool has_valid;
+  bool stale;
+  uint8_t last_slot;
+} telemhealth_t;
+
+/**
+ * @brief reset the health of one ESC
+ *
+ * @param health
+ * @param stale_cycles >= 1 (0 is taken as 1)
+ */
+static inline void telemhealth_init(volatile telemhealth_t *const health,
+                                    const uint16_t stale_cycles) {
+  health->valid = 0;
+  health->bad = 0;
+  health->partial = 0;
+  health->missing = 0;
+  health->unsent = 0;
+  health->recoveries = 0;
+  health->last_valid_us = 0;
+  health->consecutive = 0;
+  health->stale_cycles = stale_cycles ? stale_cycles : 1;
+  health->slot_valid = 0;
+  health->slot_bad = 0;
+  health->has_valid = false;
+  health->stale = false;
+  health->last_slot = TELEMHEALTH_SLOT_MISSING;
+}
+
+/**
+ * @brief a complete reply was parsed in the current slot
+ *
+ * Called by the uart isr.
+ *
+ * @param health
+ * @param crc_valid
+ * @param now_us arrival of the reply
+ */
+static inline void telemhealth_reply(volatile telemhealth_t *const health,
+                                     const bool crc_valid,
+                                     const uint32_t now_us) {
+  if (crc_valid) {
+    health->slot_valid++;
+    health->last_valid_us = now_us;
+    health->has_valid = true;
+  } else {
+    health->slot_bad++;
+  }
+}
+
+/**
+ * @brief end the request slot of one ESC
+ *
+ * Called by the request timer, before the next slot starts.
+ *
+ * @param health
+ * @param leftover bytes of an incomplete reply still in the parser
+ * @param sent the request frame went out during the slot
+ * @return true if the parser should be resynced: bytes were left over, a
+ * reply was corrupt, or the ESC has just gone stale
+ */
+static inline bool telemhealth_slot_end(volatile telemhealth_t *const health,
+                                        const uint32_t leftover,
+                                        const bool sent) {
+  enum telemhealth_slot slot;
+  if (health->slot_valid)
+    slot = TELEMHEALTH_SLOT_VALID;
+  else if (health->slot_bad)
+    slot = TELEMHEALTH_SLOT_BAD;
+  else if (leftover)
+    slot = TELEMHEALTH_SLOT_PARTIAL;
+  else if (sent)
+    slot = TELEMHEALTH_SLOT_MISSING;
+  else
+    slot = TELEMHEALTH_SLOT_UNSENT;
+  health->slot_valid = 0;
+  health->slot_bad = 0;
+  health->last_slot = (uint8_t)slot;
+
+  switch (slot) {
+  case TELEMHEALTH_SLOT_VALID:
+    health->valid++;
+    break;
+  case TELEMHEALTH_SLOT_BAD:
+    health->bad++;
+    break;
+  case TELEMHEALTH_SLOT_PARTIAL:
+    health->partial++;
+    break;
+  case TELEMHEALTH_SLOT_MISSING:
+    health->missing++;
+    break;
+  case TELEMHEALTH_SLOT_UNSENT:
+    health->unsent++;
+    break;
+  }
+
+  bool resync = leftover || slot == TELEMHEALTH_SLOT_BAD;
+  if (slot == TELEMHEALTH_SLOT_VALID) {
+    health->consecutive = 0;
+    health->stale = false;
+  } else {
+    if (health->consecutive < UINT16_MAX)
+      health->consecutive++;
+    if (!health->stale && health->consecutive >= health->stale_cycles) {
+      health->stale = true;
+      resync = true;
+    }
+  }
+  if (resync)
+    health->recoveries++;
+  return resync;
+}
+
+/**
+ * @brief age of the telemetry of one ESC
+ *
+ * @param health
+ * @param now_us
+ * @return time since the last valid reply in us, or UINT32_MAX if there
+ * hasn't been one
+ */
+static inline uint32_t
+telemhealth_age_us(const volatile telemhealth_t *const health,
+                   const uint32_t now_us) {
+  if (!health->has_valid)
+    return UINT32_MAX;
+  return now_us - health->last_valid_us;
+}
+
+/**
+ * @brief worst case time from the last valid reply of a dead ESC to its
+ * stale flag
+ *
+ * @param stale_cycles
+ * @param slot_us request timer period
+ * @param esc_count number of ESCs sharing the onewire
+ * @return detection latency in us
+ */
+static inline uint64_t telemhealth_detect_us(const uint16_t stale_cycles,
+                                             const uint32_t slot_us,
+                                             const uint32_t esc_count) {
+  return (uint64_t)(stale_cycles ? stale_cycles : 1) * esc_count * slot_us;
+}
+
+static void telemhealth_print(const volatile telemhealth_t *const health,
+                              const int esc_idx, const uint32_t now_us) {
+  printf("Health ESC %i:\t%s\t%u consecutive without a valid reply\n",
+         esc_idx, health->stale ? "STALE" : "ok", health->consecutive);
+  if (health->has_valid)
+    printf("  age %u us\t", telemhealth_age_us(health, now_us));
+  else
+    printf("  no valid reply yet\t");
+  printf("valid %u\tbad %u\tpartial %u\tmissing %u\tunsent %u\t"
+         "resyncs %u\n",
+         health->valid, health->bad, health->partial, health->missing,
+         health->unsent, health->recoveries);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,222 @@
+/**
+ * @file telemhistory.h
+ * @defgroup telemhistory telemhistory
+ * @brief Per ESC telemetry history for post-run analysis
+ *
+ * @ref onewire_t only keeps the latest sample of each ESC. This module
+ * keeps the last @ref TELEMHISTORY_CAPACITY samples of one ESC, as a
+ * structure of arrays: one packed array per channel, in KISS wire units.
+ * A sample takes 11 bytes, without the padding (and the unused fields) of
+ * a @ref telem_sample_t, and a scan of one channel only touches that
+ * channel.
+ *
+ * Samples are addressed by their sequence number (the number of samples
+ * pushed before them), which keeps increasing as the ring wraps around.
+ * Range queries by time are a binary search, as timestamps are monotonic
+ * (modulo 2^32).
+ *
+ * Sizing: each ESC gets 1 / ESC_COUNT of the telemetry request rate, so
+ *
+ *     seconds = TELEMHISTORY_CAPACITY x ESC_COUNT x telem_interval_us / 1e6
+ *
+ * e.g. 4096 samples hold 16 s of 4 ESCs at 1 kHz in 4 x 45 kB.
+ */
+
+#pragma once
+#include "kissesctelem.h"
+#include "stdbool.h"
+#include "stddef.h"
+#include "stdint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Samples held per ESC. Must be a power of 2
+#ifndef TELEMHISTORY_CAPACITY
+#define TELEMHISTORY_CAPACITY 4096
+#endif
+#define TELEMHISTORY_MASK (TELEMHISTORY_CAPACITY - 1)
+
+/**
+ * @brief history of one ESC
+ *
+ * @param head sequence number of the next sample
+ * @param timestamp_us time each sample was received
+ * @param erpm 100 erpm
+ * @param centi_voltage 0.01 V
+ * @param centi_current 0.01 A
+ * @param temperature 1 C
+ */
+typedef struct telemhistory {
+  uint32_t head;
+  uint32_t timestamp_us[TELEMHISTORY_CAPACITY];
+  uint16_t erpm[TELEMHISTORY_CAPACITY];
+  uint16_t centi_voltage[TELEMHISTORY_CAPACITY];
+  uint16_t centi_current[TELEMHISTORY_CAPACITY];
+  int8_t temperature[TELEMHISTORY_CAPACITY];
+} telemhistory_t;
+
+/**
+ * @brief one sample read back from the history
+ */
+typedef struct telemhistory_sample {
+  uint32_t timestamp_us;
+  uint16_t erpm;
+  uint16_t centi_voltage;
+  uint16_t centi_current;
+  int8_t temperature;
+} telemhistory_sample_t;
+
+/**
+ * @brief clear the history
+ *
+ * @param hist
+ */
+static inline void telemhistory_init(telemhistory_t *const hist) {
+  hist->head = 0;
+}
+
+/**
+ * @brief append a validated sample, overwriting the oldest once full
+ *
+ * Call this from a single context (e.g. the main loop draining
+ * @ref telem_queue_t), not concurrently with the queries.
+ *
+ * @param hist
+ * @param telem telemetry with a valid crc
+ * @param timestamp_us time the sample was received
+ */
+static inline void telemhistory_push(telemhistory_t *const hist,
+                                     const kissesc_telem_t *const telem,
+                                     const uint32_t timestamp_us) {
+  const uint32_t i = hist->head & TELEMHISTORY_MASK;
+  hist->timestamp_us[i] = timestamp_us;
+  hist->erpm[i] = (uint16_t)(telem->erpm / 100);
+  hist->centi_voltage[i] = telem->centi_voltage;
+  hist->centi_current[i] = telem->centi_current;
+  hist->temperature[i] = (int8_t)telem->temperature;
+  hist->head++;
+}
+
+/// @brief number of samples held
+static inline uint32_t telemhistory_count(const telemhistory_t *const hist) {
+  return hist->head < TELEMHISTORY_CAPACITY ? hist->head
+                                            : TELEMHISTORY_CAPACITY;
+}
+
+/// @brief sequence number of the oldest sample held
+static inline uint32_t telemhistory_oldest(const telemhistory_t *const hist) {
+  return hist->head - telemhistory_count(hist);
+}
+
+/**
+ * @brief read one sample
+ *
+ * @param hist
+ * @param seq sequence number, in [@ref telemhistory_oldest, head)
+ * @param sample output
+ * @return false if the sample isn't held (anymore)
+ */
+static inline bool telemhistory_get(const telemhistory_t *const hist,
+                                    const uint32_t seq,
+                                    telemhistory_sample_t *const sample) {
+  if (seq - telemhistory_oldest(hist) >= telemhistory_count(hist))
+    return false;
+  const uint32_t i = seq & TELEMHISTORY_MASK;
+  sample->timestamp_us = hist->timestamp_us[i];
+  sample->erpm = hist->erpm[i];
+  sample->centi_voltage = hist->centi_voltage[i];
+  sample->centi_current = hist->centi_current[i];
+  sample->temperature = hist->temperature[i];
+  return true;
+}
+
+/**
+ * @brief sequence number of the first sample received at or after a time
+ *
+ * Times are compared modulo 2^32, relative to the oldest sample, so the
+ * search works across the timer wrapping around.
+ *
+ * @param hist
+ * @param time_us
+ * @return sequence number, head if all samples are older
+ */
+static inline uint32_t
+telemhistory_lower_bound(const telemhistory_t *const hist,
+                         const uint32_t time_us) {
+  const uint32_t oldest = telemhistory_oldest(hist);
+  // Search offsets from the oldest sample, so sequence numbers may wrap too
+  uint32_t lo = 0;
+  uint32_t hi = telemhistory_count(hist);
+  if (!hi)
+    return oldest;
+  const uint32_t base = hist->timestamp_us[oldest & TELEMHISTORY_MASK];
+  const int64_t target = (int32_t)(time_us - base);
+  while (lo < hi) {
+    const uint32_t mid = lo + (hi - lo) / 2;
+    const int64_t t =
+        hist->timestamp_us[(oldest + mid) & TELEMHISTORY_MASK] - base;
+    if (t < target) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return oldest + lo;
+}
+
+/**
+ * @brief samples received in [from_us, to_us)
+ *
+ * @param hist
+ * @param from_us
+ * @param to_us
+ * @param begin output: sequence number of the first sample
+ * @param end output: sequence number after the last sample
+ * @return number of samples in the range
+ */
+static inline uint32_t telemhistory_range(const telemhistory_t *const hist,
+                                          const uint32_t from_us,
+                                          const uint32_t to_us,
+                                          uint32_t *const begin,
+                                          uint32_t *const end) {
+  *begin = telemhistory_lower_bound(hist, from_us);
+  *end = telemhistory_lower_bound(hist, to_us);
+  if ((int32_t)(*end - *begin) < 0)
+    *end = *begin;
+  return *end - *begin;
+}
+
+/**
+ * @brief read every \a stride th sample of a range
+ *
+ * @param hist
+ * @param begin first sequence number (clamped to the oldest sample held)
+ * @param end sequence number after the last sample
+ * @param stride 1 => every sample
+ * @param out output
+ * @param max_out capacity of \a out
+ * @return number of samples written to \a out
+ */
+static inline size_t telemhistory_read(const telemhistory_t *const hist,
+                                       uint32_t begin, const uint32_t end,
+                                       const uint32_t stride,
+                                       telemhistory_sample_t *const out,
+                                       const size_t max_out) {
+  const uint32_t oldest = telemhistory_oldest(hist);
+  if ((int32_t)(begin - oldest) < 0)
+    begin = oldest;
+  size_t n = 0;
+  for (uint32_t seq = begin; (int32_t)(end - seq) > 0 && n < max_out;
+       seq += stride ? stride : 1) {
+    if (!telemhistory_get(hist, seq, &out[n]))
+      break;
+    n++;
+  }
+  return n;
+}
+
+#ifdef __cplusplus
+}
+#endif
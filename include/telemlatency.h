@@ -0,0 +1,206 @@
+/**
+ * @file telemlatency.h
+ * @defgroup telemlatency telemlatency
+ * @brief Request to reply latency of the onewire telemetry
+ *
+ * To line telemetry up with the throttle that produced it, each
+ * @ref telem_sample_t carries:
+ *
+ * - the time and throttle code of the dshot frame that had the telemetry
+ *   bit set (@ref dshot_config::telem_request_us)
+ * - the arrival times of the first and last byte of the reply
+ *
+ * The uart isr doesn't run per byte: it fires when the rx fifo reaches
+ * its threshold, or after the line has been idle for
+ * @ref TELEMLATENCY_RX_TIMEOUT_BITS bit periods. @ref
+ * telemlatency_chunk_times works back from the time the isr ran to the
+ * times the bytes in the fifo were received.
+ *
+ * @ref telemlatency_update folds the samples of one ESC into O(1)
+ * min / max / mean / last statistics of:
+ *
+ * - reply latency: request -> first byte (the ESC's response time)
+ * - total latency: request -> last byte (when the sample is usable)
+ */
+
+#pragma once
+#include "stdbool.h"
+#include "stdint.h"
+#include "telemqueue.h"
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Start, 8 data and stop bit
+#define TELEMLATENCY_BITS_PER_BYTE 10
+/// The pl011 rx timeout fires after 32 idle bit periods
+#define TELEMLATENCY_RX_TIMEOUT_BITS 32
+
+/**
+ * @brief latency accumulator
+ *
+ * @param min
+ * @param max
+ * @param last
+ * @param sum for the mean
+ */
+typedef struct telemlatency_acc {
+  uint32_t min;
+  uint32_t max;
+  uint32_t last;
+  uint64_t sum;
+} telemlatency_acc_t;
+
+/**
+ * @brief latency statistics of one ESC
+ *
+ * @param count samples with a matching request
+ * @param unmatched samples without one (e.g. the reply arrived before the
+ * request frame was sent, or the request timestamp was missing)
+ * @param reply request -> first byte (us)
+ * @param total request -> last byte (us)
+ */
+typedef struct telemlatency {
+  uint32_t count;
+  uint32_t unmatched;
+  telemlatency_acc_t reply;
+  telemlatency_acc_t total;
+} telemlatency_t;
+
+/**
+ * @brief time to transfer \a bits at \a baudrate, rounded to the nearest us
+ */
+static inline uint32_t telemlatency_bits_us(const uint32_t bits,
+                                            const uint32_t baudrate) {
+  return (uint32_t)(((uint64_t)bits * 1000000 + baudrate / 2) / baudrate);
+}
+
+/**
+ * @brief estimate when the bytes read by one run of the uart isr arrived
+ *
+ * On a fifo threshold interrupt, the last byte has just been received. On
+ * a timeout interrupt, it was received
+ * @ref TELEMLATENCY_RX_TIMEOUT_BITS bit periods earlier. Earlier bytes
+ * arrived back to back, one byte period apart.
+ *
+ * @param now_us time the isr ran
+ * @param bytes number of bytes read (>= 1)
+ * @param rx_timeout the isr was raised by the rx timeout
+ * @param baudrate
+ * @param first_us output: arrival of the first byte read
+ * @param last_us output: arrival of the last byte read
+ */
+static inline void telemlatency_chunk_times(const uint32_t now_us,
+                                            const uint32_t bytes,
+                                            const bool rx_timeout,
+                                            const uint32_t baudrate,
+                                            uint32_t *const first_us,
+                                            uint32_t *const last_us) {
+  const uint32_t byte_us =
+      telemlatency_bits_us(TELEMLATENCY_BITS_PER_BYTE, baudrate);
+  *last_us = now_us - (rx_timeout ? telemlatency_bits_us(
+                                        TELEMLATENCY_RX_TIMEOUT_BITS, baudrate)
+                                  : 0);
+  *first_us = *last_us - (bytes ? bytes - 1 : 0) * byte_us;
+}
+
+static inline void telemlatency_acc_reset(telemlatency_acc_t *const acc) {
+  acc->min = UINT32_MAX;
+  acc->max = 0;
+  acc->last = 0;
+  acc->sum = 0;
+}
+
+/**
+ * @brief reset the statistics of one ESC
+ *
+ * @param lat
+ */
+static inline void telemlatency_init(telemlatency_t *const lat) {
+  lat->count = 0;
+  lat->unmatched = 0;
+  telemlatency_acc_reset(&lat->reply);
+  telemlatency_acc_reset(&lat->total);
+}
+
+static inline void telemlatency_acc_update(telemlatency_acc_t *const acc,
+                                           const uint32_t us) {
+  if (us < acc->min)
+    acc->min = us;
+  if (us > acc->max)
+    acc->max = us;
+  acc->last = us;
+  acc->sum += us;
+}
+
+/**
+ * @brief request -> first byte latency of a sample
+ *
+ * @param sample
+ * @return latency in us, modulo 2^32 (check @ref
+ * telem_sample_t::request_valid first)
+ */
+static inline uint32_t telem_sample_reply_us(
+    const telem_sample_t *const sample) {
+  return sample->first_byte_us - sample->request_us;
+}
+
+/**
+ * @brief request -> last byte latency of a sample
+ */
+static inline uint32_t telem_sample_total_us(
+    const telem_sample_t *const sample) {
+  return sample->timestamp_us - sample->request_us;
+}
+
+/**
+ * @brief fold a sample into the statistics of its ESC
+ *
+ * Call this from a single context (e.g. the main loop draining
+ * @ref telem_queue_t). Corrupt samples still count: the timing of a reply
+ * doesn't depend on its crc.
+ *
+ * @param lat
+ * @param sample
+ * @return false if the sample has no matching request
+ */
+static inline bool telemlatency_update(telemlatency_t *const lat,
+                                       const telem_sample_t *const sample) {
+  const uint32_t reply = telem_sample_reply_us(sample);
+  const uint32_t total = telem_sample_total_us(sample);
+  // Modulo 2^32, a reply before its request shows up as a huge latency
+  if (!sample->request_valid || reply > INT32_MAX || total < reply) {
+    lat->unmatched++;
+    return false;
+  }
+  lat->count++;
+  telemlatency_acc_update(&lat->reply, reply);
+  telemlatency_acc_update(&lat->total, total);
+  return true;
+}
+
+/// @brief mean latency in us, 0 without samples
+static inline uint32_t telemlatency_mean_us(const telemlatency_t *const lat,
+                                            const telemlatency_acc_t *acc) {
+  return lat->count ? (uint32_t)(acc->sum / lat->count) : 0;
+}
+
+static void telemlatency_print(const telemlatency_t *const lat,
+                               const int esc_idx) {
+  printf("Latency ESC %i:\t%u samples (%u unmatched)\n", esc_idx, lat->count,
+         lat->unmatched);
+  if (!lat->count)
+    return;
+  printf("  reply\tmean %u us\tmin %u us\tmax %u us\tlast %u us\n",
+         telemlatency_mean_us(lat, &lat->reply), lat->reply.min,
+         lat->reply.max, lat->reply.last);
+  printf("  total\tmean %u us\tmin %u us\tmax %u us\tlast %u us\n",
+         telemlatency_mean_us(lat, &lat->total), lat->total.min,
+         lat->total.max, lat->total.last);
+}
+
+#ifdef __cplusplus
+}
+#endif
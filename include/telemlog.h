@@ -0,0 +1,328 @@
+/**
+ * @file telemlog.h
+ * @defgroup telemlog telemlog
+ * @brief Seekable log of telemetry samples, in fixed size columnar chunks
+ *
+ * A telemstream.h record per sample is fine to watch a run, but hours of
+ * it can only be read from the start. Instead, samples are packed into
+ * chunks of @ref TELEMLOG_CHUNK_SIZE bytes, each with a header:
+ *
+ * | Byte(s) | Field                                      |
+ * | :-----: | ------------------------------------------ |
+ * | 0 - 3   | magic "TLCK"                               |
+ * | 4 - 7   | chunk sequence number                      |
+ * | 8 - 15  | time of the first sample (us, 64 bit)      |
+ * | 16 - 23 | time of the last sample (us, 64 bit)       |
+ * | 24 - 27 | mask of the ESCs with samples in the chunk |
+ * | 28 \| 29| number of samples                          |
+ * |   30    | version (@ref TELEMLOG_VERSION)            |
+ * |   31    | CRC8 of bytes 0 - 30                       |
+ *
+ * followed by one array per field (@ref telemlog_field), each
+ * @ref TELEMLOG_CAPACITY entries long, so a scan of one field only reads
+ * that field. Times are stored as u32 offsets from the first sample, so
+ * a log can run for longer than time_us_32() wraps around.
+ *
+ * The pico writes whole chunks back to back. On the host, the capture is
+ * packed (`tools/telemlog.cpp pack`): chunks are realigned, and a trailing
+ * index is appended, with one entry per chunk (first / last time, ESC
+ * mask, count) and a footer:
+ *
+ * | Byte(s) | Footer                                     |
+ * | :-----: | ------------------------------------------ |
+ * | 0 - 3   | magic "TLIX"                               |
+ * | 4 - 7   | number of chunks                           |
+ * | 8 - 15  | offset of the index                        |
+ *
+ * A reader memory maps the file, binary searches the index for a time
+ * range, and reads the columns of the chunks in range only (see
+ * test/telemlog_reader.hpp). Multi byte fields are little endian.
+ */
+
+#pragma once
+#include "kissesctelem.h"
+#include "stdbool.h"
+#include "stdint.h"
+#include "string.h"
+#include "telemqueue.h"
+
+#if PICO_ON_DEVICE
+#include "pico/stdio.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// "TLCK"
+#define TELEMLOG_MAGIC 0x4b434c54u
+/// "TLIX"
+#define TELEMLOG_INDEX_MAGIC 0x58494c54u
+#define TELEMLOG_VERSION 1
+#define TELEMLOG_CHUNK_SIZE 4096
+#define TELEMLOG_HEADER_SIZE 32
+/// Bytes of all the fields of a sample
+#define TELEMLOG_SAMPLE_SIZE 15
+#define TELEMLOG_CAPACITY                                                      \
+  ((TELEMLOG_CHUNK_SIZE - TELEMLOG_HEADER_SIZE) / TELEMLOG_SAMPLE_SIZE)
+#define TELEMLOG_INDEX_ENTRY_SIZE 24
+#define TELEMLOG_FOOTER_SIZE 16
+
+/**
+ * @brief columns of a chunk, in order. The wider ones come first, so that
+ * every column is aligned
+ *
+ * - time: u32 us since the first sample of the chunk
+ * - voltage: u16 0.01 V
+ * - current: u16 0.01 A
+ * - consumption: u16 mAh
+ * - erpm: u16 100 erpm (as transmitted)
+ * - esc: u8 ESC idx
+ * - temperature: i8 1 C
+ * - crc: u8 KISS CRC8 check (0 => ok)
+ */
+enum telemlog_field {
+  TELEMLOG_TIME,
+  TELEMLOG_VOLTAGE,
+  TELEMLOG_CURRENT,
+  TELEMLOG_CONSUMPTION,
+  TELEMLOG_ERPM,
+  TELEMLOG_ESC,
+  TELEMLOG_TEMPERATURE,
+  TELEMLOG_CRC,
+  TELEMLOG_FIELDS,
+};
+
+static const uint8_t telemlog_field_size[TELEMLOG_FIELDS] = {4, 2, 2, 2,
+                                                             2, 1, 1, 1};
+
+/// @brief offset of a column in a chunk
+static inline uint32_t telemlog_column_offset(const enum telemlog_field f) {
+  uint32_t offset = TELEMLOG_HEADER_SIZE;
+  for (int i = 0; i < f; ++i)
+    offset += telemlog_field_size[i] * TELEMLOG_CAPACITY;
+  return offset;
+}
+
+/**
+ * @brief decoded chunk header
+ *
+ * @param seq
+ * @param first_us
+ * @param last_us
+ * @param esc_mask bit i set if ESC i has samples in the chunk (ESCs above
+ * 31 share bit 31)
+ * @param count
+ */
+typedef struct telemlog_header {
+  uint32_t seq;
+  uint64_t first_us;
+  uint64_t last_us;
+  uint32_t esc_mask;
+  uint16_t count;
+} telemlog_header_t;
+
+/**
+ * @brief chunk being filled
+ *
+ * @param header of the chunk in @ref chunk
+ * @param last_us time of the last sample appended, to extend the 32 bit
+ * timestamps of the samples to 64 bit
+ * @param chunk
+ */
+typedef struct telemlog {
+  telemlog_header_t header;
+  uint64_t last_us;
+  uint8_t chunk[TELEMLOG_CHUNK_SIZE];
+} telemlog_t;
+
+static inline void telemlog_put(uint8_t *const out, const uint64_t value,
+                                const int bytes) {
+  for (int i = 0; i < bytes; ++i)
+    out[i] = (uint8_t)(value >> (8 * i));
+}
+
+static inline uint64_t telemlog_get(const uint8_t *const in,
+                                    const int bytes) {
+  uint64_t value = 0;
+  for (int i = 0; i < bytes; ++i)
+    value |= (uint64_t)in[i] << (8 * i);
+  return value;
+}
+
+/**
+ * @brief extend a 32 bit timestamp to 64 bit, from a nearby 64 bit time
+ *
+ * @param near_us e.g. the time of the previous sample
+ * @param timestamp_us within 2^31 us (~36 min) of \a near_us
+ */
+static inline uint64_t telemlog_extend_us(const uint64_t near_us,
+                                          const uint32_t timestamp_us) {
+  return near_us + (int64_t)(int32_t)(timestamp_us - (uint32_t)near_us);
+}
+
+static inline void telemlog_start_chunk(telemlog_t *const log,
+                                        const uint32_t seq) {
+  log->header.seq = seq;
+  log->header.first_us = 0;
+  log->header.last_us = 0;
+  log->header.esc_mask = 0;
+  log->header.count = 0;
+}
+
+/**
+ * @brief start a log
+ *
+ * @param log
+ * @param now_us 64 bit time (e.g. time_us_64()), from which the first
+ * sample's timestamp is extended
+ */
+static inline void telemlog_init(telemlog_t *const log,
+                                 const uint64_t now_us) {
+  telemlog_start_chunk(log, 0);
+  log->last_us = now_us;
+  memset(log->chunk, 0, sizeof(log->chunk));
+}
+
+/**
+ * @brief append a sample to the chunk
+ *
+ * @param log
+ * @param sample
+ * @return false if the chunk is full, or the sample is too far from the
+ * first one. Write the chunk out (@ref telemlog_finish) first
+ */
+static inline bool telemlog_append(telemlog_t *const log,
+                                   const telem_sample_t *const sample) {
+  telemlog_header_t *const h = &log->header;
+  const uint64_t t_us = telemlog_extend_us(log->last_us, sample->timestamp_us);
+  if (h->count >= TELEMLOG_CAPACITY ||
+      (h->count && (t_us < h->first_us || t_us - h->first_us > UINT32_MAX)))
+    return false;
+  if (!h->count)
+    h->first_us = t_us;
+  if (t_us > h->last_us)
+    h->last_us = t_us;
+  log->last_us = t_us;
+  h->esc_mask |= 1u << (sample->esc_idx < 31 ? sample->esc_idx : 31);
+
+  const kissesc_telem_t *const t = &sample->telem;
+  const uint32_t i = h->count++;
+  uint8_t *const c = log->chunk;
+  telemlog_put(c + telemlog_column_offset(TELEMLOG_TIME) + 4 * i,
+               t_us - h->first_us, 4);
+  telemlog_put(c + telemlog_column_offset(TELEMLOG_VOLTAGE) + 2 * i,
+               t->centi_voltage, 2);
+  telemlog_put(c + telemlog_column_offset(TELEMLOG_CURRENT) + 2 * i,
+               t->centi_current, 2);
+  telemlog_put(c + telemlog_column_offset(TELEMLOG_CONSUMPTION) + 2 * i,
+               t->consumption, 2);
+  telemlog_put(c + telemlog_column_offset(TELEMLOG_ERPM) + 2 * i,
+               t->erpm / 100, 2);
+  c[telemlog_column_offset(TELEMLOG_ESC) + i] = sample->esc_idx;
+  c[telemlog_column_offset(TELEMLOG_TEMPERATURE) + i] =
+      (uint8_t)t->temperature;
+  c[telemlog_column_offset(TELEMLOG_CRC) + i] = t->crc;
+  return true;
+}
+
+/**
+ * @brief encode a chunk header
+ *
+ * @param h
+ * @param out @ref TELEMLOG_HEADER_SIZE bytes
+ */
+static inline void telemlog_encode_header(const telemlog_header_t *const h,
+                                          uint8_t *const out) {
+  telemlog_put(out, TELEMLOG_MAGIC, 4);
+  telemlog_put(out + 4, h->seq, 4);
+  telemlog_put(out + 8, h->first_us, 8);
+  telemlog_put(out + 16, h->last_us, 8);
+  telemlog_put(out + 24, h->esc_mask, 4);
+  telemlog_put(out + 28, h->count, 2);
+  out[30] = TELEMLOG_VERSION;
+  out[31] = kissesc_get_crc8(out, TELEMLOG_HEADER_SIZE - 1);
+}
+
+/**
+ * @brief decode and check a chunk header
+ *
+ * @param in @ref TELEMLOG_HEADER_SIZE bytes
+ * @param h output
+ * @return false if this isn't a valid chunk header
+ */
+static inline bool telemlog_decode_header(const uint8_t *const in,
+                                          telemlog_header_t *const h) {
+  if (telemlog_get(in, 4) != TELEMLOG_MAGIC || in[30] != TELEMLOG_VERSION ||
+      kissesc_get_crc8(in, TELEMLOG_HEADER_SIZE) != 0)
+    return false;
+  h->seq = (uint32_t)telemlog_get(in + 4, 4);
+  h->first_us = telemlog_get(in + 8, 8);
+  h->last_us = telemlog_get(in + 16, 8);
+  h->esc_mask = (uint32_t)telemlog_get(in + 24, 4);
+  h->count = (uint16_t)telemlog_get(in + 28, 2);
+  return h->count <= TELEMLOG_CAPACITY && h->last_us >= h->first_us;
+}
+
+/**
+ * @brief complete the chunk header. The chunk is then ready to be written
+ * out, after which @ref telemlog_next starts the next one
+ *
+ * @param log
+ * @return the chunk (@ref TELEMLOG_CHUNK_SIZE bytes)
+ */
+static inline const uint8_t *telemlog_finish(telemlog_t *const log) {
+  telemlog_encode_header(&log->header, log->chunk);
+  return log->chunk;
+}
+
+/// @brief start the next chunk, once the last one has been written out
+static inline void telemlog_next(telemlog_t *const log) {
+  telemlog_start_chunk(log, log->header.seq + 1);
+}
+
+#if PICO_ON_DEVICE
+/**
+ * @brief write the chunk over stdio (without any crlf translation), and
+ * start the next one
+ *
+ * @param log
+ */
+static void telemlog_flush(telemlog_t *const log) {
+  const uint8_t *const chunk = telemlog_finish(log);
+  for (size_t i = 0; i < TELEMLOG_CHUNK_SIZE; ++i) {
+    putchar_raw(chunk[i]);
+  }
+  telemlog_next(log);
+}
+
+/**
+ * @brief drain a telemetry queue into the log, writing out every chunk
+ * as soon as it is full. Call this from the main loop. Call
+ * @ref telemlog_flush to write out a partial chunk (e.g. at the end)
+ *
+ * @param log
+ * @param queue
+ * @return number of samples logged
+ */
+static size_t telemlog_drain(telemlog_t *const log,
+                             telem_queue_t *const queue) {
+  size_t count = 0;
+  telem_sample_t sample;
+  // Queued samples are recent: extend their timestamps from now, which
+  // also covers pauses of the telemetry longer than the 32 bit wrap around
+  log->last_us = time_us_64();
+  while (telem_queue_pop(queue, &sample)) {
+    if (!telemlog_append(log, &sample)) {
+      telemlog_flush(log);
+      telemlog_append(log, &sample);
+    }
+    ++count;
+  }
+  return count;
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,166 @@
+/**
+ * @file telemqueue.h
+ * @defgroup telemqueue telemqueue
+ * @brief Lossless hand over of telemetry samples from the uart isr
+ *
+ * @ref onewire_t::telem_updated_esc only remembers the last ESC that was
+ * updated, so a main loop that is busy (e.g. printing) misses samples.
+ * The onewire isr pushes every decoded sample into this single producer,
+ * single consumer queue instead, and the main loop pops them at its own
+ * pace. Samples are only lost if the queue overflows, which is counted in
+ * @ref telem_queue_t::dropped. Every sample is numbered when it is pushed,
+ * dropped or not, so a gap in @ref telem_sample_t::seq downstream (e.g. in
+ * telemstream.h records) shows where samples were lost.
+ */
+
+#pragma once
+#include "kissesctelem.h"
+#include "stdbool.h"
+#include "stdint.h"
+
+#if PICO_ON_DEVICE
+#include "hardware/sync.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Number of samples held by the queue. Must be a power of 2
+#ifndef TELEM_QUEUE_SIZE
+#define TELEM_QUEUE_SIZE 32
+#endif
+#define TELEM_QUEUE_MASK (TELEM_QUEUE_SIZE - 1)
+
+#if PICO_ON_DEVICE
+#define TELEM_QUEUE_BARRIER() __dmb()
+#else
+#define TELEM_QUEUE_BARRIER() __sync_synchronize()
+#endif
+
+/**
+ * @brief A telemetry sample from one ESC
+ *
+ * @param timestamp_us time the last byte of the transmission was received
+ * @param esc_idx index of the ESC in @ref onewire_t::escs
+ * @param telem decoded telemetry. `telem.crc != 0` => corrupt transmission
+ * @param first_byte_us time the first byte of the transmission was received
+ * @param request_us time the frame requesting the telemetry was sent
+ * @param request_code throttle code of that frame
+ * @param request_valid the request was sent before the reply arrived
+ * (see telemlatency.h)
+ * @param seq sequence number, set by @ref telem_queue_push
+ */
+typedef struct telem_sample {
+  uint32_t timestamp_us;
+  uint8_t esc_idx;
+  kissesc_telem_t telem;
+  uint32_t first_byte_us;
+  uint32_t request_us;
+  uint16_t request_code;
+  bool request_valid;
+  uint16_t seq;
+} telem_sample_t;
+
+/**
+ * @brief single producer, single consumer queue of telemetry samples
+ *
+ * @param head next slot to write (only written by the producer)
+ * @param tail next slot to read (only written by the consumer)
+ * @param dropped number of samples dropped because the queue was full
+ * @param dropped_reported value of @ref dropped at the last
+ * @ref telem_queue_take_dropped (only written by the consumer)
+ * @param seq sequence number of the next sample pushed (only written by the
+ * producer)
+ * @param samples storage
+ */
+typedef struct telem_queue {
+  volatile uint32_t head;
+  volatile uint32_t tail;
+  volatile uint32_t dropped;
+  uint32_t dropped_reported;
+  uint16_t seq;
+  telem_sample_t samples[TELEM_QUEUE_SIZE];
+} telem_queue_t;
+
+/**
+ * @brief reset the queue. Must not be called while the producer is running
+ *
+ * @param queue
+ */
+static inline void telem_queue_init(telem_queue_t *const queue) {
+  queue->head = 0;
+  queue->tail = 0;
+  queue->dropped = 0;
+  queue->dropped_reported = 0;
+  queue->seq = 0;
+}
+
+/**
+ * @brief number of samples waiting in the queue
+ *
+ * @param queue
+ */
+static inline uint32_t telem_queue_count(const telem_queue_t *const queue) {
+  return queue->head - queue->tail;
+}
+
+/**
+ * @brief number and push a sample (producer side, e.g. the onewire isr)
+ *
+ * @param queue
+ * @param sample its @ref telem_sample_t::seq is set, even if it is dropped
+ * @return false if the queue is full and the sample was dropped
+ */
+static inline bool telem_queue_push(telem_queue_t *const queue,
+                                    telem_sample_t *const sample) {
+  // Number the sample first, so that a dropped one leaves a gap
+  sample->seq = queue->seq++;
+  const uint32_t head = queue->head;
+  if (head - queue->tail >= TELEM_QUEUE_SIZE) {
+    queue->dropped++;
+    return false;
+  }
+  queue->samples[head & TELEM_QUEUE_MASK] = *sample;
+  // Publish the sample before moving the head
+  TELEM_QUEUE_BARRIER();
+  queue->head = head + 1;
+  return true;
+}
+
+/**
+ * @brief pop the oldest sample (consumer side, e.g. the main loop)
+ *
+ * @param queue
+ * @param sample output
+ * @return false if the queue is empty
+ */
+static inline bool telem_queue_pop(telem_queue_t *const queue,
+                                   telem_sample_t *const sample) {
+  const uint32_t tail = queue->tail;
+  if (tail == queue->head)
+    return false;
+  TELEM_QUEUE_BARRIER();
+  *sample = queue->samples[tail & TELEM_QUEUE_MASK];
+  // Finish reading the slot before handing it back to the producer
+  TELEM_QUEUE_BARRIER();
+  queue->tail = tail + 1;
+  return true;
+}
+
+/**
+ * @brief return the number of samples dropped since the last call, and mark
+ * them as reported (consumer side)
+ *
+ * @param queue
+ */
+static inline uint32_t telem_queue_take_dropped(telem_queue_t *const queue) {
+  const uint32_t dropped = queue->dropped;
+  const uint32_t unreported = dropped - queue->dropped_reported;
+  queue->dropped_reported = dropped;
+  return unreported;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,295 @@
+/**
+ * @file telemstats.h
+ * @defgroup telemstats telemstats
+ * @brief Incremental per ESC telemetry statistics
+ *
+ * Instead of logging every sample and computing KPIs on the host, each
+ * validated @ref kissesc_telem_t is folded into a small accumulator in O(1):
+ *
+ * - Welford running mean and variance
+ * - min and max
+ * - @ref TELEMSTATS_EWMA_COUNT exponentially weighted moving averages, with
+ *   a configurable smoothing factor of 2^-shift each
+ *
+ * Everything is integer / fixed point, as the pico has no FPU.
+ * Channels are kept in their KISS wire units, so that they all fit in
+ * 16 bits (see @ref telemstats_channel). Means and EWMAs are Q16 and the
+ * sum of squared deviations is Q8, in int64.
+ *
+ * @ref telemstats_snapshot reads the statistics of the current window, and
+ * optionally starts a new one. EWMAs are continuous across windows.
+ */
+
+#pragma once
+#include "kissesctelem.h"
+#include "stdbool.h"
+#include "stdint.h"
+#include <stdio.h>
+
+/// @brief number of ESCs (see onewire.h)
+#ifndef ESC_COUNT
+#define ESC_COUNT 1
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Number of EWMAs per channel
+#ifndef TELEMSTATS_EWMA_COUNT
+#define TELEMSTATS_EWMA_COUNT 2
+#endif
+
+#define TELEMSTATS_MEAN_FRAC_BITS 16
+#define TELEMSTATS_M2_FRAC_BITS 8
+
+/**
+ * @brief channels, in KISS wire units
+ *
+ * - temperature: 1 C
+ * - voltage: 0.01 V
+ * - current: 0.01 A
+ * - erpm: 100 erpm
+ */
+enum telemstats_channel {
+  TELEMSTATS_TEMPERATURE,
+  TELEMSTATS_VOLTAGE,
+  TELEMSTATS_CURRENT,
+  TELEMSTATS_ERPM,
+  TELEMSTATS_CHANNELS,
+};
+
+/// @brief scale from wire units to C, V, A and erpm
+static const float telemstats_channel_scale[TELEMSTATS_CHANNELS] = {
+    1.0f, 0.01f, 0.01f, 100.0f};
+
+/**
+ * @brief accumulator of one channel
+ *
+ * @param mean running mean (Q16)
+ * @param m2 sum of squared deviations from the mean (Q8)
+ * @param min
+ * @param max
+ * @param ewma exponentially weighted moving averages (Q16)
+ */
+typedef struct telemstats_acc {
+  int64_t mean;
+  uint64_t m2;
+  int32_t min;
+  int32_t max;
+  int64_t ewma[TELEMSTATS_EWMA_COUNT];
+} telemstats_acc_t;
+
+/**
+ * @brief statistics of one ESC
+ *
+ * @param count samples in the current window
+ * @param first_us timestamp of the first sample in the window
+ * @param last_us timestamp of the last sample
+ * @param ewma_shift smoothing factor of each EWMA is 2^-shift
+ * @param ewma_valid the EWMAs have been seeded with a first sample
+ * @param acc one accumulator per @ref telemstats_channel
+ */
+typedef struct telemstats {
+  uint32_t count;
+  uint32_t first_us;
+  uint32_t last_us;
+  uint8_t ewma_shift[TELEMSTATS_EWMA_COUNT];
+  bool ewma_valid;
+  telemstats_acc_t acc[TELEMSTATS_CHANNELS];
+} telemstats_t;
+
+/**
+ * @brief statistics of one channel over a window
+ *
+ * @param mean Q16
+ * @param variance sample variance (Q8). 0 if count < 2
+ * @param min
+ * @param max
+ * @param ewma Q16
+ */
+typedef struct telemstats_channel_result {
+  int64_t mean;
+  uint64_t variance;
+  int32_t min;
+  int32_t max;
+  int64_t ewma[TELEMSTATS_EWMA_COUNT];
+} telemstats_channel_result_t;
+
+/**
+ * @brief snapshot of one ESC's statistics
+ */
+typedef struct telemstats_result {
+  uint32_t count;
+  uint32_t first_us;
+  uint32_t last_us;
+  telemstats_channel_result_t channel[TELEMSTATS_CHANNELS];
+} telemstats_result_t;
+
+/**
+ * @brief start a new window. EWMAs are kept
+ *
+ * @param stats
+ */
+static inline void telemstats_reset_window(telemstats_t *const stats) {
+  stats->count = 0;
+  stats->first_us = 0;
+  stats->last_us = 0;
+  for (int c = 0; c < TELEMSTATS_CHANNELS; ++c) {
+    stats->acc[c].mean = 0;
+    stats->acc[c].m2 = 0;
+    stats->acc[c].min = INT32_MAX;
+    stats->acc[c].max = INT32_MIN;
+  }
+}
+
+/**
+ * @brief initialise the statistics of one ESC
+ *
+ * @param stats
+ * @param ewma_shift smoothing factor of each EWMA is 2^-shift (1 - 30).
+ * e.g. 3 => alpha = 1/8
+ */
+static inline void
+telemstats_init(telemstats_t *const stats,
+                const uint8_t ewma_shift[TELEMSTATS_EWMA_COUNT]) {
+  for (int e = 0; e < TELEMSTATS_EWMA_COUNT; ++e) {
+    stats->ewma_shift[e] = ewma_shift[e];
+  }
+  stats->ewma_valid = false;
+  telemstats_reset_window(stats);
+}
+
+/**
+ * @brief fold one value into a channel accumulator
+ *
+ * @param stats
+ * @param acc
+ * @param x value in wire units (|x| < 2^16)
+ */
+static inline void telemstats_acc_update(const telemstats_t *const stats,
+                                         telemstats_acc_t *const acc,
+                                         const int32_t x) {
+  const int64_t x_q = (int64_t)x << TELEMSTATS_MEAN_FRAC_BITS;
+
+  // Welford: mean += d / n, m2 += d * (x - mean')
+  const int64_t delta = x_q - acc->mean;
+  acc->mean += delta / (int64_t)stats->count;
+  const int64_t delta2 = x_q - acc->mean;
+  // Q12 * Q12 >> 16 = Q8. Pre shifting keeps 17 bit deltas from overflowing
+  const int64_t m2_step = ((delta >> 4) * (delta2 >> 4)) >>
+                          (2 * (TELEMSTATS_MEAN_FRAC_BITS - 4) -
+                           TELEMSTATS_M2_FRAC_BITS);
+  // delta and delta2 share a sign, except for rounding near 0
+  if (m2_step > 0)
+    acc->m2 += (uint64_t)m2_step;
+
+  if (x < acc->min)
+    acc->min = x;
+  if (x > acc->max)
+    acc->max = x;
+
+  for (int e = 0; e < TELEMSTATS_EWMA_COUNT; ++e) {
+    acc->ewma[e] = stats->ewma_valid
+                       ? acc->ewma[e] + ((x_q - acc->ewma[e]) >>
+                                         stats->ewma_shift[e])
+                       : x_q;
+  }
+}
+
+/**
+ * @brief fold a validated telemetry sample into the statistics
+ *
+ * Call this from a single context (e.g. the main loop draining
+ * @ref telem_queue_t), not concurrently with @ref telemstats_snapshot.
+ *
+ * @param stats
+ * @param telem telemetry with a valid crc
+ * @param timestamp_us time the sample was received
+ */
+static inline void telemstats_update(telemstats_t *const stats,
+                                     const kissesc_telem_t *const telem,
+                                     const uint32_t timestamp_us) {
+  if (!stats->count)
+    stats->first_us = timestamp_us;
+  stats->last_us = timestamp_us;
+  stats->count++;
+
+  telemstats_acc_update(stats, &stats->acc[TELEMSTATS_TEMPERATURE],
+                        telem->temperature);
+  telemstats_acc_update(stats, &stats->acc[TELEMSTATS_VOLTAGE],
+                        telem->centi_voltage);
+  telemstats_acc_update(stats, &stats->acc[TELEMSTATS_CURRENT],
+                        telem->centi_current);
+  // erpm is decoded from a 16 bit value in units of 100 erpm
+  telemstats_acc_update(stats, &stats->acc[TELEMSTATS_ERPM],
+                        (int32_t)(telem->erpm / 100));
+  stats->ewma_valid = true;
+}
+
+/**
+ * @brief read the statistics of the current window
+ *
+ * @param stats
+ * @param result
+ * @param reset start a new window after the snapshot
+ */
+static inline void telemstats_snapshot(telemstats_t *const stats,
+                                       telemstats_result_t *const result,
+                                       const bool reset) {
+  result->count = stats->count;
+  result->first_us = stats->first_us;
+  result->last_us = stats->last_us;
+  for (int c = 0; c < TELEMSTATS_CHANNELS; ++c) {
+    const telemstats_acc_t *const acc = &stats->acc[c];
+    telemstats_channel_result_t *const out = &result->channel[c];
+    out->mean = acc->mean;
+    out->variance = stats->count > 1 ? acc->m2 / (stats->count - 1) : 0;
+    out->min = stats->count ? acc->min : 0;
+    out->max = stats->count ? acc->max : 0;
+    for (int e = 0; e < TELEMSTATS_EWMA_COUNT; ++e) {
+      out->ewma[e] = acc->ewma[e];
+    }
+  }
+  if (reset)
+    telemstats_reset_window(stats);
+}
+
+/// @brief Q16 mean / EWMA of a channel, in C, V, A or erpm
+static inline float telemstats_q16_to_float(const int64_t value,
+                                            const int channel) {
+  return (float)value / (1 << TELEMSTATS_MEAN_FRAC_BITS) *
+         telemstats_channel_scale[channel];
+}
+
+/// @brief Q8 variance of a channel, in C^2, V^2, A^2 or erpm^2
+static inline float telemstats_variance_to_float(const uint64_t variance,
+                                                 const int channel) {
+  const float scale = telemstats_channel_scale[channel];
+  return (float)variance / (1 << TELEMSTATS_M2_FRAC_BITS) * scale * scale;
+}
+
+static void telemstats_print_result(const telemstats_result_t *const result,
+                                    const int esc_idx) {
+  static const char *const names[TELEMSTATS_CHANNELS] = {
+      "Temperature", "Voltage", "Current", "Erpm"};
+  printf("\n---TELEMETRY STATS ESC %i---\n", esc_idx);
+  printf("Samples:\t%u (%u us)\n", result->count,
+         result->last_us - result->first_us);
+  for (int c = 0; c < TELEMSTATS_CHANNELS; ++c) {
+    const telemstats_channel_result_t *const ch = &result->channel[c];
+    const float scale = telemstats_channel_scale[c];
+    printf("%-12s\tmean %.2f\tstd^2 %.3f\tmin %.2f\tmax %.2f", names[c],
+           telemstats_q16_to_float(ch->mean, c),
+           telemstats_variance_to_float(ch->variance, c), ch->min * scale,
+           ch->max * scale);
+    for (int e = 0; e < TELEMSTATS_EWMA_COUNT; ++e) {
+      printf("\tewma%i %.2f", e, telemstats_q16_to_float(ch->ewma[e], c));
+    }
+    printf("\n");
+  }
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,197 @@
+/**
+ * @file telemstream.h
+ * @defgroup telemstream telemstream
+ * @brief Compact binary telemetry records, batched into USB sized blocks
+ *
+ * @ref kissesc_print_telem formats ~120 bytes of text (with floats) per
+ * sample, which caps logging at a few hundred samples per second.
+ * Instead, each @ref telem_sample_t is packed into a
+ * @ref TELEMSTREAM_RECORD_SIZE byte record:
+ *
+ * | Byte(s) | Field                      |
+ * | :-----: | -------------------------- |
+ * | 0 \| 1  | sync word 0x5A7E           |
+ * | 2 \| 3  | sequence number            |
+ * | 4 - 7   | timestamp (us)             |
+ * |    8    | ESC idx                    |
+ * |    9    | temperature (1 C)          |
+ * | 10 \| 11| centi voltage              |
+ * | 12 \| 13| centi current              |
+ * | 14 \| 15| consumption (mAh)          |
+ * | 16 \| 17| erpm / 100 (as transmitted)|
+ * |   18    | KISS CRC8 check (0 => ok)  |
+ * |   19    | record CRC8 of bytes 0-18  |
+ *
+ * Multi byte fields are little endian. Records are appended to a block of
+ * @ref TELEMSTREAM_BLOCK_SIZE bytes (one USB full speed packet),
+ * which is written out in one go once it is full.
+ * The sequence number is the one the sample got when it was queued
+ * (@ref telem_sample_t::seq), so a gap means the telemetry queue
+ * overflowed (or the samples were sent elsewhere, e.g. decimated).
+ * `tools/telemstream_decode.py` decodes the stream to csv / columnar files.
+ */
+
+#pragma once
+#include "kissesctelem.h"
+#include "stdbool.h"
+#include "stdint.h"
+#include "telemqueue.h"
+
+#if PICO_ON_DEVICE
+#include "pico/stdio.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TELEMSTREAM_SYNC 0x5A7Eu
+#define TELEMSTREAM_RECORD_SIZE 20
+/// USB full speed bulk packet size
+#define TELEMSTREAM_BLOCK_SIZE 64
+
+/**
+ * @brief block of records waiting to be written
+ *
+ * @param len number of bytes used in @ref block
+ * @param block records
+ */
+typedef struct telemstream {
+  size_t len;
+  uint8_t block[TELEMSTREAM_BLOCK_SIZE];
+} telemstream_t;
+
+static inline void telemstream_init(telemstream_t *const stream) {
+  stream->len = 0;
+}
+
+/**
+ * @brief pack a sample into a record
+ *
+ * @param sample
+ * @param seq sequence number
+ * @param record output of @ref TELEMSTREAM_RECORD_SIZE bytes
+ */
+static inline void telemstream_encode(const telem_sample_t *const sample,
+                                      const uint16_t seq, uint8_t record[]) {
+  const kissesc_telem_t *const t = &sample->telem;
+  const uint16_t erpm_hundreds = t->erpm / 100;
+  record[0] = TELEMSTREAM_SYNC & 0xff;
+  record[1] = TELEMSTREAM_SYNC >> 8;
+  record[2] = seq & 0xff;
+  record[3] = seq >> 8;
+  record[4] = sample->timestamp_us & 0xff;
+  record[5] = (sample->timestamp_us >> 8) & 0xff;
+  record[6] = (sample->timestamp_us >> 16) & 0xff;
+  record[7] = sample->timestamp_us >> 24;
+  record[8] = sample->esc_idx;
+  record[9] = (uint8_t)t->temperature;
+  record[10] = t->centi_voltage & 0xff;
+  record[11] = t->centi_voltage >> 8;
+  record[12] = t->centi_current & 0xff;
+  record[13] = t->centi_current >> 8;
+  record[14] = t->consumption & 0xff;
+  record[15] = t->consumption >> 8;
+  record[16] = erpm_hundreds & 0xff;
+  record[17] = erpm_hundreds >> 8;
+  record[18] = t->crc;
+  record[19] = kissesc_get_crc8(record, TELEMSTREAM_RECORD_SIZE - 1);
+}
+
+/**
+ * @brief unpack a record (used by host side tools and tests)
+ *
+ * @param record @ref TELEMSTREAM_RECORD_SIZE bytes
+ * @param sample output, including its sequence number
+ * @param seq output sequence number
+ * @return false if the sync word or record CRC is wrong
+ */
+static inline bool telemstream_decode(const uint8_t record[],
+                                      telem_sample_t *const sample,
+                                      uint16_t *const seq) {
+  const uint16_t sync = record[0] | record[1] << 8;
+  if (sync != TELEMSTREAM_SYNC ||
+      kissesc_get_crc8(record, TELEMSTREAM_RECORD_SIZE) != 0)
+    return false;
+
+  *seq = record[2] | record[3] << 8;
+  sample->seq = *seq;
+  sample->timestamp_us = (uint32_t)record[4] | (uint32_t)record[5] << 8 |
+                         (uint32_t)record[6] << 16 | (uint32_t)record[7] << 24;
+  sample->esc_idx = record[8];
+  sample->telem.temperature = (int8_t)record[9];
+  sample->telem.centi_voltage = record[10] | record[11] << 8;
+  sample->telem.centi_current = record[12] | record[13] << 8;
+  sample->telem.consumption = record[14] | record[15] << 8;
+  sample->telem.erpm = 100 * (uint32_t)(record[16] | record[17] << 8);
+  sample->telem.crc = record[18];
+  return true;
+}
+
+/**
+ * @brief true if another record doesn't fit in the block
+ *
+ * @param stream
+ */
+static inline bool telemstream_is_full(const telemstream_t *const stream) {
+  return stream->len + TELEMSTREAM_RECORD_SIZE > TELEMSTREAM_BLOCK_SIZE;
+}
+
+/**
+ * @brief append a sample to the block
+ *
+ * @param stream
+ * @param sample numbered by @ref telem_queue_push
+ * @return false if the block is full (flush it first)
+ */
+static inline bool telemstream_append(telemstream_t *const stream,
+                                      const telem_sample_t *const sample) {
+  if (telemstream_is_full(stream))
+    return false;
+  telemstream_encode(sample, sample->seq, &stream->block[stream->len]);
+  stream->len += TELEMSTREAM_RECORD_SIZE;
+  return true;
+}
+
+#if PICO_ON_DEVICE
+/**
+ * @brief write the block over stdio (without any crlf translation)
+ *
+ * @param stream
+ */
+static void telemstream_flush(telemstream_t *const stream) {
+  for (size_t i = 0; i < stream->len; ++i) {
+    putchar_raw(stream->block[i]);
+  }
+  stream->len = 0;
+}
+
+/**
+ * @brief drain a telemetry queue into the stream, writing out every
+ * block as soon as it is full. The last (partial) block is also written,
+ * so that samples aren't held back when the telemetry rate is low.
+ * Call this from the main loop.
+ *
+ * @param stream
+ * @param queue
+ * @return number of samples streamed
+ */
+static size_t telemstream_drain(telemstream_t *const stream,
+                                telem_queue_t *const queue) {
+  size_t count = 0;
+  telem_sample_t sample;
+  while (telem_queue_pop(queue, &sample)) {
+    if (telemstream_is_full(stream))
+      telemstream_flush(stream);
+    telemstream_append(stream, &sample);
+    ++count;
+  }
+  if (stream->len)
+    telemstream_flush(stream);
+  return count;
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
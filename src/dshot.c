@@ -1,34 +1,182 @@
 #include "dshot.h"
+#include "dlog.h"
+#include "dshotchain.h"
+#include "hardware/irq.h"
 #include "onewire.h"
 #include "stdio.h"
 
 // Define onewire
 onewire_t onewire;
 
+// Define deferred logger (flushed by the main loop)
+dlog_t dlog;
+
+// Define the real-time alarm pool (created by rtpool_init)
+rtpool_t rtpool;
+
+uint16_t dshot_pause_tail[DSHOT_PAUSE_MAX_PULSES];
+
+// Speed tables shared between motors, and the motors using each (0 =>
+// free)
+static dshot_speed_entry_t dshot_speed_tables[DSHOT_SPEED_TABLES][DSHOT_SPEEDS];
+static uint8_t dshot_speed_table_refs[DSHOT_SPEED_TABLES];
+
+const dshot_speed_entry_t *
+dshot_speed_table_share(const dshot_speed_entry_t table[DSHOT_SPEEDS]) {
+  const size_t bytes = sizeof(dshot_speed_tables[0]);
+  int unused = -1;
+  for (int t = 0; t < DSHOT_SPEED_TABLES; ++t) {
+    if (!dshot_speed_table_refs[t]) {
+      unused = unused < 0 ? t : unused;
+    } else if (!memcmp(dshot_speed_tables[t], table, bytes)) {
+      dshot_speed_table_refs[t]++;
+      return dshot_speed_tables[t];
+    }
+  }
+  if (unused < 0)
+    return NULL;
+  // No motor points at a free table, so the send isr never reads it
+  memcpy(dshot_speed_tables[unused], table, bytes);
+  dshot_speed_table_refs[unused] = 1;
+  return dshot_speed_tables[unused];
+}
+
+void dshot_speed_table_release(const dshot_speed_entry_t *table) {
+  for (int t = 0; t < DSHOT_SPEED_TABLES; ++t) {
+    if (table == dshot_speed_tables[t] && dshot_speed_table_refs[t])
+      dshot_speed_table_refs[t]--;
+  }
+}
+
+/**
+ * @brief frame boundary of one motor: apply pending changes, run the frame
+ * hook and compose the next packet
+ *
+ * @param dshot
+ */
+static void dshot_frame_boundary(dshot_config *dshot) {
+  // The line is low for the rest of the packet, so the pwm can be retimed
+  // without a glitch
+  const uint8_t speed = dshot->pending_speed;
+  if (speed < DSHOT_SPEEDS) {
+    dshot_apply_speed(dshot, &dshot->speeds[speed]);
+    dshot->pending_speed = DSHOT_SPEEDS;
+  }
+  const uint32_t duty = dshot->pending_duty;
+  if (duty) {
+    const dshot_duty_t pending = dshot_duty_unpack(duty);
+    dshot_apply_duty(dshot, &pending);
+    dshot->pending_duty = 0;
+  }
+  // Let the hook apply any pending setpoints
+  if (dshot->frame_hook) {
+    dshot->frame_hook(&dshot->packet, dshot->frame_hook_data);
+  }
+  dshot_packet_compose(&dshot->packet);
+}
+
+/**
+ * @brief bookkeeping once the packet of one motor has been handed to dma
+ *
+ * @param dshot
+ */
+static void dshot_packet_sent(dshot_config *dshot) {
+  // Timestamp the request, so that the reply can be lined up with it
+  if (dshot->packet.telemetry) {
+    dshot->telem_request_us = time_us_32();
+    dshot->telem_request_code = dshot->packet.throttle_code;
+    dshot->telem_requests++;
+  }
+  // Reset telemetry bit (so that the onewire uart isn't overloaded)
+  dshot->packet.telemetry = 0;
+}
+
 /**
  * @brief send a dshot packet
  *
  * @param dshot ptr to dshot config
- * @param debug bool for printing debug information
+ * @param debug bool for logging debug information (deferred, see dlog.h)
  */
 void dshot_send_packet(dshot_config *dshot, bool debug) {
-  if (debug) {
-    if (dshot->packet.telemetry) {
-      printf("Throttle Code: %i\n", dshot->packet.throttle_code);
-      printf("Set telemetry bit\n");
-    }
+  // This is usually called from an isr, so defer the debug log
+  if (debug && dshot->packet.telemetry) {
+    DLOG(DLOG_DSHOT_TELEM_REQ, dshot->packet.throttle_code);
   }
 
   dma_channel_wait_for_finish_blocking(dshot->dma_channel);
-  dshot_packet_compose(&dshot->packet);
-  // Re-configure dma and trigger transfer
+  dshot_frame_boundary(dshot);
+  // Re-configure dma and trigger transfer. The frame ends with one zero
+  // pulse, which holds the line low until the next packet
   dma_channel_configure(
       dshot->dma_channel, &dshot->dma_config,
       // Write to pwm counter compare
       &pwm_hw->slice[pwm_gpio_to_slice_num(dshot->esc_gpio_pin)].cc,
-      dshot->packet.packet_buffer, dshot_packet_length, true);
-  // Reset telemetry bit (so that the onewire uart isn't overloaded)
-  dshot->packet.telemetry = 0;
+      dshot->packet.packet_buffer, DSHOT_PACKET_BUFFER_LENGTH, true);
+  dshot_packet_sent(dshot);
+}
+
+void dshot_chain_send(dshot_chain_t *chain) {
+  // The previous round must be out. The control channel is only busy
+  // while it loads a block, so check both
+  while (dma_channel_is_busy(chain->dma.data_channel) ||
+         dma_channel_is_busy(chain->dma.ctrl_channel)) {
+    tight_loop_contents();
+  }
+  for (int i = 0; i < chain->dma.motors; ++i) {
+    dshot_frame_boundary(chain->dshots[i]);
+    // The pause changes with the speed
+    dmachain_set_tail(&chain->dma, i,
+                      chain->dshots[i]->packet_length - DSHOT_FRAME_SIZE);
+  }
+  // Walk the control blocks from the first one
+  dma_channel_set_read_addr(chain->dma.ctrl_channel, chain->dma.blocks, true);
+  for (int i = 0; i < chain->dma.motors; ++i) {
+    dshot_packet_sent(chain->dshots[i]);
+  }
+}
+
+// Configs sent back to back, by dma channel
+static dshot_config *dshot_continuous_configs[NUM_DMA_CHANNELS];
+// Channels sending the shared tail (the rest of the pause)
+static uint32_t dshot_continuous_tail_mask = 0;
+
+/**
+ * @brief dma completion irq of the continuous mode: once a frame is out,
+ * send the rest of its pause from the shared tail, then the next packet
+ */
+static void dshot_dma_irq_handler(void) {
+  for (uint ch = 0; ch < NUM_DMA_CHANNELS; ++ch) {
+    dshot_config *const dshot = dshot_continuous_configs[ch];
+    if (dshot && dma_channel_get_irq0_status(ch)) {
+      dma_channel_acknowledge_irq0(ch);
+      const uint tail = dshot->packet_length - DSHOT_PACKET_BUFFER_LENGTH;
+      if (tail && !(dshot_continuous_tail_mask & (1u << ch))) {
+        // Same channel config and write address, read from the tail
+        dshot_continuous_tail_mask |= 1u << ch;
+        dma_channel_transfer_from_buffer_now(ch, dshot_pause_tail, tail);
+      } else {
+        dshot_continuous_tail_mask &= ~(1u << ch);
+        dshot_send_packet(dshot, false);
+      }
+    }
+  }
+}
+
+void dshot_continuous_configure(dshot_config *dshot) {
+  static bool handler_added = false;
+  if (!handler_added) {
+    // Shared, in case the application uses the dma irq too
+    irq_add_shared_handler(DMA_IRQ_0, dshot_dma_irq_handler,
+                           PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    // Same level as the frame timer (see rtpool.h)
+    irq_set_priority(DMA_IRQ_0, RTPOOL_DMA_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0, true);
+    handler_added = true;
+  }
+  dshot_continuous_configs[dshot->dma_channel] = dshot;
+  dma_channel_set_irq0_enabled(dshot->dma_channel, true);
+  // The irq sends every packet after this one
+  dshot_send_packet(dshot, false);
 }
 
 void print_dshot_config(dshot_config *dshot) {
@@ -40,36 +188,48 @@ void print_dshot_config(dshot_config *dshot) {
          frequency_count_khz(CLOCKS_FC0_SRC_VALUE_CLK_SYS));
   printf("dshot speed %.3f khz\n", dshot->dshot_speed_khz);
   printf("esc gpio: %u\n", dshot->esc_gpio_pin);
-  printf("dshot config size: %d\n", sizeof(*dshot));
+  // Hot: read or written at every frame, cold: configuration
+  printf("dshot config size: %u bytes (hot %u, cold %u)\n",
+         (uint)sizeof(*dshot), (uint)offsetof(dshot_config, pwm_top),
+         (uint)(sizeof(*dshot) - offsetof(dshot_config, pwm_top)));
+  printf("packet buffer: %u x 16 bit, shared pause tail: %u x 16 bit\n",
+         DSHOT_PACKET_BUFFER_LENGTH, DSHOT_PAUSE_MAX_PULSES);
 
   // packet config
   printf("\ndshot packet config\n");
   printf("throttle code: %u\t", dshot->packet.throttle_code);
   printf("telemetry: %u\n", dshot->packet.telemetry);
 
-  const uint packet_shift = pwm_gpio_to_channel(dshot->esc_gpio_pin)
-                                ? PWM_CH0_CC_B_LSB
-                                : PWM_CH0_CC_A_LSB;
-  printf("pulse high: %u\t(removing shift: %u)\n", dshot->packet.pulse_high,
-         dshot->packet.pulse_high >> packet_shift);
-  printf("pulse low: %u\t(removing shift: %u)\n", dshot->packet.pulse_low,
-         dshot->packet.pulse_low >> packet_shift);
+  printf("pulse high: %u\t", dshot->packet.pulse_high);
+  printf("pulse low: %u\n", dshot->packet.pulse_low);
+  printf("duty: T1H %u / 1000\tT0H %u / 1000\n", dshot->duty.t1h,
+         dshot->duty.t0h);
 
   // pwm config
   printf("\npwm config\n");
   printf("slice: %u\t", pwm_gpio_to_slice_num(dshot->esc_gpio_pin));
   printf("channel: %u\t", pwm_gpio_to_channel(dshot->esc_gpio_pin));
-  printf("pwm wrap: %u\t", dshot->pwm_conf.top);
-  printf("pwm div: %.4f\t",
-         (float)dshot->pwm_conf.div / (1u << PWM_CH0_DIV_INT_LSB));
-  printf("pwm_csr: %u\n", dshot->pwm_conf.csr);
+  printf("pwm wrap: %u\t", dshot->pwm_top);
+  printf("pwm div: %.4f\n",
+         (float)dshot->pwm_div / (1u << PWM_CH0_DIV_INT_LSB));
 
   // dma channel config
   printf("\ndma channel config\n");
   printf("channel: %i\t", dshot->dma_channel);
-  printf("transfer count: %i \n", dshot_packet_length);
+  printf("transfer count: %u + %u from the shared tail\n",
+         DSHOT_PACKET_BUFFER_LENGTH,
+         dshot->packet_length - DSHOT_PACKET_BUFFER_LENGTH);
+
+  // packet rates
+  printf("\npause: %u ns\n", dshot->pause_ns);
+  dshot_speed_print_table(dshot->speeds);
 
   // repeating timer setup
+  if (dshot->packet_interval_us == DSHOT_CONTINUOUS) {
+    printf("\npackets sent back to back from the dma irq\n");
+    printf("---\n\n");
+    return;
+  }
   printf("\nrepeating timer for packet send\n");
   printf("setup success: %d\t", dshot->send_packet_rt_state);
   printf("delay: %lld us\t", dshot->send_packet_rt.delay_us);
@@ -105,5 +265,15 @@ void print_onewire_config(onewire_t *onewire) {
   printf("alarm num: %d\n",
          alarm_pool_hardware_alarm_num(onewire->send_req_rt.pool));
 
+  // health
+  const uint16_t stale_cycles = onewire->health[0].stale_cycles;
+  const int64_t slot_us = onewire->send_req_rt.delay_us;
+  printf("\ntelemetry stale after %u slots without a valid reply "
+         "(<= %llu us)\n",
+         stale_cycles,
+         telemhealth_detect_us(stale_cycles,
+                               (uint32_t)(slot_us < 0 ? -slot_us : slot_us),
+                               ESC_COUNT));
+
   printf("---\n\n");
 }
\ No newline at end of file
@@ -0,0 +1,159 @@
+/**
+ * @file bench.hpp
+ *
+ * Minimal host microbenchmark harness, for bench_dshot.cpp.
+ *
+ * A kernel is a callable `uint32_t (uint32_t i)`: i varies the input, and
+ * the results are summed into a checksum so that the compiler can't drop
+ * the work. @ref bench_run grows the batch until it lasts long enough to
+ * time, then keeps the fastest of several batches (the least disturbed by
+ * the rest of the system).
+ *
+ * Results are written as JSON, and compared with a baseline in the same
+ * format: a kernel regresses if its ns/op exceeds the baseline by more than
+ * the threshold. Only the fields written here are parsed back.
+ */
+
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct bench_result {
+  std::string name;
+  double ns_per_op = 0;
+  double ops_per_s = 0;
+  uint64_t iterations = 0; // per timed batch
+  uint32_t checksum = 0;
+  double baseline_ns_per_op = 0; // 0 => no baseline
+  bool regression = false;
+};
+
+/**
+ * @brief time a kernel
+ *
+ * @param name
+ * @param kernel
+ * @param min_batch_ns shortest batch that is timed
+ * @param batches timed batches, the fastest is kept
+ */
+template <typename Kernel>
+static bench_result bench_run(const char *const name, Kernel &&kernel,
+                              const double min_batch_ns = 20e6,
+                              const int batches = 5) {
+  using clock = std::chrono::steady_clock;
+  bench_result result;
+  result.name = name;
+  uint64_t iterations = 1024;
+  double best_ns = 0;
+  for (int batch = 0; batch < batches;) {
+    uint32_t checksum = 0;
+    const auto start = clock::now();
+    for (uint64_t i = 0; i < iterations; ++i)
+      checksum += kernel((uint32_t)i);
+    const double ns =
+        std::chrono::duration<double, std::nano>(clock::now() - start)
+            .count();
+    result.checksum += checksum;
+    // Calibrate first: grow the batch until it is long enough
+    if (ns < min_batch_ns && !best_ns) {
+      iterations *= ns > 0 ? (uint64_t)(min_batch_ns / ns) + 1 : 16;
+      continue;
+    }
+    if (!best_ns || ns < best_ns)
+      best_ns = ns;
+    batch++;
+  }
+  result.iterations = iterations;
+  result.ns_per_op = best_ns / iterations;
+  result.ops_per_s = 1e9 / result.ns_per_op;
+  return result;
+}
+
+/// @brief write results as JSON (also the baseline format)
+static void bench_write_json(FILE *const out,
+                             const std::vector<bench_result> &results,
+                             const double threshold) {
+  fprintf(out, "{\n  \"threshold\": %.3f,\n  \"benchmarks\": [\n", threshold);
+  for (size_t i = 0; i < results.size(); ++i) {
+    const bench_result &r = results[i];
+    fprintf(out,
+            "    {\"name\": \"%s\", \"ns_per_op\": %.3f, "
+            "\"ops_per_s\": %.0f, \"iterations\": %llu",
+            r.name.c_str(), r.ns_per_op, r.ops_per_s,
+            (unsigned long long)r.iterations);
+    if (r.baseline_ns_per_op > 0) {
+      fprintf(out,
+              ", \"baseline_ns_per_op\": %.3f, \"ratio\": %.3f, "
+              "\"regression\": %s",
+              r.baseline_ns_per_op, r.ns_per_op / r.baseline_ns_per_op,
+              r.regression ? "true" : "false");
+    }
+    fprintf(out, "}%s\n", i + 1 < results.size() ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+}
+
+/**
+ * @brief read the ns/op of each kernel from a JSON file written by
+ * @ref bench_write_json
+ *
+ * @param path
+ * @param baseline output, one entry per kernel (name and ns_per_op)
+ * @return false if the file can't be read
+ */
+static bool bench_read_baseline(const char *const path,
+                                std::vector<bench_result> &baseline) {
+  FILE *const in = fopen(path, "r");
+  if (!in)
+    return false;
+  std::string text;
+  char chunk[4096];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), in)) > 0)
+    text.append(chunk, n);
+  fclose(in);
+
+  const std::string name_key = "\"name\": \"";
+  const std::string ns_key = "\"ns_per_op\": ";
+  for (size_t pos = text.find(name_key); pos != std::string::npos;
+       pos = text.find(name_key, pos)) {
+    pos += name_key.size();
+    const size_t name_end = text.find('"', pos);
+    const size_t ns_pos = text.find(ns_key, name_end);
+    if (name_end == std::string::npos || ns_pos == std::string::npos)
+      break;
+    bench_result r;
+    r.name = text.substr(pos, name_end - pos);
+    r.ns_per_op = atof(text.c_str() + ns_pos + ns_key.size());
+    baseline.push_back(r);
+    pos = ns_pos;
+  }
+  return true;
+}
+
+/**
+ * @brief flag the kernels slower than their baseline by more than
+ * \a threshold (e.g. 0.25 => 25 %)
+ *
+ * @return number of regressions
+ */
+static int bench_compare(std::vector<bench_result> &results,
+                         const std::vector<bench_result> &baseline,
+                         const double threshold) {
+  int regressions = 0;
+  for (bench_result &r : results) {
+    for (const bench_result &b : baseline) {
+      if (b.name != r.name || b.ns_per_op <= 0)
+        continue;
+      r.baseline_ns_per_op = b.ns_per_op;
+      r.regression = r.ns_per_op > b.ns_per_op * (1 + threshold);
+      regressions += r.regression;
+    }
+  }
+  return regressions;
+}
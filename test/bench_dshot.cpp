@@ -0,0 +1,414 @@
+/**
+ * @file bench_dshot.cpp
+ *
+ * Host microbenchmarks of the hot path kernels: the ones run per frame or
+ * per telemetry byte / sample on the pico. Results are printed as JSON
+ * (ns/op and ops/s of each kernel) and, given a baseline written by an
+ * earlier run, compared with it: the run fails if a kernel got slower by
+ * more than the threshold.
+ *
+ * Inputs are drawn from precomputed random tables, so the branches see
+ * realistic data. A new fast path gets one entry in `kernels`.
+ * Kernels that touch the hardware on the pico (e.g. the frame boundary in
+ * src/dshot.c) are benchmarked through a host equivalent that runs the
+ * same headers without the register writes.
+ *
+ *    ./bench_dshot [--filter substr] [--json out.json] [--min-time-ms 20]
+ *                  [--baseline bench_baseline.json] [--threshold 0.25]
+ *                  [--write-baseline bench_baseline.json]
+ *
+ * Baselines are only meaningful on the machine (and build) they were
+ * written on: refresh test/bench_baseline.json with --write-baseline after
+ * a deliberate change, or on a new machine.
+ */
+
+#include <sys/types.h>
+
+#include <random>
+
+#include "bench.hpp"
+#include "dlog.h"
+#include "dshotduty.h"
+#include "dshotspeed.h"
+#include "hostcmd.h"
+#include "kissesctelem.h"
+#include "onewireparse.h"
+#include "packet.h"
+#include "setpoint.h"
+#include "telemdecim.h"
+#include "telemhealth.h"
+#include "telemhistory.h"
+#include "telemlatency.h"
+#include "telemlog.h"
+#include "telemqueue.h"
+#include "telemstats.h"
+
+dlog_t dlog;
+
+constexpr uint32_t table_mask = 1023;
+
+struct bench_kernel {
+  const char *name;
+  uint32_t (*run)(uint32_t i);
+};
+
+static uint16_t codes[table_mask + 1];
+static uint8_t telem_buffers[table_mask + 1][KISS_ESC_TELEM_BUFFER_SIZE];
+static kissesc_telem_t telems[table_mask + 1];
+// Back to back throttle frames, as sent by the host
+static uint8_t host_bytes[table_mask + 1];
+
+static dshot_packet_t packet;
+static setpoint_t sps[4];
+static telem_queue_t queue;
+static telemstats_t stats;
+static hostcmd_t cmd;
+static telemhistory_t history;
+static telemdecim_t decim;
+static telemhealth_t health;
+static onewire_parser_t parser;
+static telemlog_t telem_log;
+
+/**
+ * @brief the fields of @ref dshot_config used at a frame boundary
+ */
+struct bench_motor {
+  uint8_t pending_speed;
+  uint32_t pending_duty;
+  uint16_t pwm_top;
+  dshot_duty_t duty;
+  dshot_packet_t packet;
+  dshot_frame_hook_t frame_hook;
+  void *frame_hook_data;
+  dshot_speed_entry_t speeds[DSHOT_SPEEDS];
+};
+
+static bench_motor motor;
+static setpoint_t motor_sp;
+
+/**
+ * @brief dshot_frame_boundary (src/dshot.c), without the pwm writes of
+ * dshot_apply_speed
+ */
+static void bench_frame_boundary(bench_motor *const m) {
+  const uint8_t speed = m->pending_speed;
+  if (speed < DSHOT_SPEEDS) {
+    const dshot_speed_entry_t *const entry = &m->speeds[speed];
+    m->pwm_top = entry->top;
+    uint16_t pulse_high;
+    uint16_t pulse_low;
+    if (!dshot_duty_pulses(&m->duty, entry->top, &pulse_high, &pulse_low)) {
+      m->duty = dshot_duty_default;
+      pulse_high = entry->pulse_high;
+      pulse_low = entry->pulse_low;
+    }
+    m->packet.pulse_high = pulse_high;
+    m->packet.pulse_low = pulse_low;
+    m->pending_speed = DSHOT_SPEEDS;
+  }
+  const uint32_t duty = m->pending_duty;
+  if (duty) {
+    const dshot_duty_t pending = dshot_duty_unpack(duty);
+    uint16_t pulse_high;
+    uint16_t pulse_low;
+    if (dshot_duty_pulses(&pending, m->pwm_top, &pulse_high, &pulse_low)) {
+      m->duty = pending;
+      m->packet.pulse_high = pulse_high;
+      m->packet.pulse_low = pulse_low;
+    }
+    m->pending_duty = 0;
+  }
+  if (m->frame_hook)
+    m->frame_hook(&m->packet, m->frame_hook_data);
+  dshot_packet_compose(&m->packet);
+}
+
+static void bench_setup(void) {
+  std::mt19937 rng(1);
+  for (uint32_t i = 0; i <= table_mask; ++i) {
+    codes[i] = rng() % 2048;
+    for (auto &byte : telem_buffers[i])
+      byte = (uint8_t)rng();
+    // Mostly good crcs, as on the wire
+    if (rng() % 16)
+      telem_buffers[i][KISS_ESC_TELEM_BUFFER_SIZE - 1] =
+          kissesc_get_crc8(telem_buffers[i], KISS_ESC_TELEM_BUFFER_SIZE - 1);
+    kissesc_buffer_to_telem(telem_buffers[i], &telems[i]);
+  }
+  packet = {};
+  packet.pulse_high = 156;
+  packet.pulse_low = 77;
+  // 4 motors at 8 kHz frames, a 100 Hz host
+  for (auto &sp : sps) {
+    setpoint_init(&sp, 48, setpoint_slew_per_frame(20000, 8000), 0,
+                  4 * 80);
+  }
+  telem_queue_init(&queue);
+  const uint8_t ewma_shift[TELEMSTATS_EWMA_COUNT] = {2, 6};
+  telemstats_init(&stats, ewma_shift);
+
+  hostcmd_init(&cmd);
+  uint8_t frame[2 * ESC_COUNT + HOSTCMD_OVERHEAD];
+  for (uint32_t pos = 0, seq = 0; pos <= table_mask;) {
+    uint8_t payload[2 * ESC_COUNT];
+    for (auto &byte : payload)
+      byte = (uint8_t)rng();
+    const size_t len =
+        hostcmd_encode(HOSTCMD_THROTTLE, (uint8_t)seq++, payload,
+                       sizeof(payload), frame);
+    for (size_t i = 0; i < len && pos <= table_mask; ++i)
+      host_bytes[pos++] = frame[i];
+  }
+  dlog_init(&dlog);
+  telemhistory_init(&history);
+  // 1 record per 16 samples
+  const telemdecim_config_t decim_config = {16, 0};
+  telemdecim_init(&decim, 0, &decim_config);
+  telemhealth_init(&health, 8);
+  onewire_parser_init(&parser);
+  telemlog_init(&telem_log, 0);
+
+  motor = {};
+  dshot_speed_table_init(motor.speeds, 125000, DSHOT_PAUSE_NS_DEFAULT);
+  motor.pending_speed = DSHOT600;
+  motor.duty = dshot_duty_default;
+  setpoint_init(&motor_sp, 48, setpoint_slew_per_frame(20000, 8000), 0,
+                80);
+  motor.frame_hook = setpoint_frame_hook;
+  motor.frame_hook_data = &motor_sp;
+}
+
+static const bench_kernel kernels[] = {
+    {"dshot_cmd_crc",
+     [](uint32_t i) -> uint32_t {
+       return dshot_cmd_crc(codes[i & table_mask] << 1);
+     }},
+    {"dshot_packet_compose",
+     [](uint32_t i) -> uint32_t {
+       packet.throttle_code = codes[i & table_mask];
+       packet.telemetry = i >> 10 & 1;
+       dshot_packet_compose(&packet);
+       return packet.packet_buffer[i & (DSHOT_FRAME_SIZE - 1)];
+     }},
+    {"kissesc_get_crc8",
+     [](uint32_t i) -> uint32_t {
+       return kissesc_get_crc8(telem_buffers[i & table_mask],
+                               KISS_ESC_TELEM_BUFFER_SIZE);
+     }},
+    {"kissesc_buffer_to_telem",
+     [](uint32_t i) -> uint32_t {
+       kissesc_telem_t telem;
+       kissesc_buffer_to_telem(telem_buffers[i & table_mask], &telem);
+       return telem.erpm + telem.crc;
+     }},
+    // One frame of 4 motors: a square wave setpoint every 80 frames, the
+    // worst case for the slew limit
+    {"setpoint_step_x4",
+     [](uint32_t i) -> uint32_t {
+       if (i % 80 == 0) {
+         for (auto &sp : sps)
+           setpoint_set(&sp, (i / 80) % 2 ? 1500 : 200);
+       }
+       uint32_t sum = 0;
+       for (auto &sp : sps)
+         sum += setpoint_step(&sp);
+       return sum;
+     }},
+    // An irq push and a main loop pop
+    {"telem_queue_push_pop",
+     [](uint32_t i) -> uint32_t {
+       telem_sample_t sample = {};
+       sample.timestamp_us = i;
+       sample.telem = telems[i & table_mask];
+       telem_queue_push(&queue, &sample);
+       telem_queue_pop(&queue, &sample);
+       return sample.timestamp_us;
+     }},
+    {"telemstats_update",
+     [](uint32_t i) -> uint32_t {
+       telemstats_update(&stats, &telems[i & table_mask], i);
+       return stats.count;
+     }},
+    // Per byte received from the host
+    {"hostcmd_feed",
+     [](uint32_t i) -> uint32_t {
+       return hostcmd_feed(&cmd, host_bytes[i & table_mask]);
+     }},
+    // Once per uart isr run
+    {"telemlatency_chunk_times",
+     [](uint32_t i) -> uint32_t {
+       uint32_t first_us, last_us;
+       telemlatency_chunk_times(i, 1 + (i & 7), i >> 3 & 1, 115200,
+                                &first_us, &last_us);
+       return first_us + last_us;
+     }},
+    // An isr claims and commits a record, the main loop pops it
+    {"dlog_push_pop",
+     [](uint32_t i) -> uint32_t {
+       DLOG(DLOG_ONEWIRE_OVERFLOW, i);
+       dlog_record_t record;
+       return dlog_pop(&dlog, &record) ? record.args[0] : 0;
+     }},
+    {"telemhistory_push",
+     [](uint32_t i) -> uint32_t {
+       telemhistory_push(&history, &telems[i & table_mask], i);
+       return history.head;
+     }},
+    {"telemdecim_update",
+     [](uint32_t i) -> uint32_t {
+       telem_sample_t sample = {};
+       sample.timestamp_us = i;
+       sample.telem = telems[i & table_mask];
+       telemdecim_record_t record;
+       return telemdecim_update(&decim, &sample, &record);
+     }},
+    // Per reply parsed by the uart isr
+    {"telemhealth_reply",
+     [](uint32_t i) -> uint32_t {
+       telemhealth_reply(&health, telems[i & table_mask].crc == 0, i);
+       return health.slot_valid;
+     }},
+    // Per request slot: one reply from the table, or none 1 time in 8
+    {"telemhealth_slot_end",
+     [](uint32_t i) -> uint32_t {
+       const uint32_t j = i & table_mask;
+       if (codes[j] & 7)
+         telemhealth_reply(&health, telems[j].crc == 0, i);
+       return telemhealth_slot_end(&health, codes[j] >> 10 & 1, true);
+     }},
+    // Per byte read by the uart isr: a reply, then a stray byte that
+    // overflows the buffer
+    {"onewire_parse_byte",
+     [](uint32_t i) -> uint32_t {
+       if (i % (KISS_ESC_TELEM_BUFFER_SIZE + 1) == 0)
+         parser.buffer_idx = 0;
+       return onewire_parse_byte(&parser, (uint8_t)codes[i & table_mask]);
+     }},
+    // Per reply: the isr run that completes it (decode, health, queue),
+    // and the main loop pop
+    {"onewire_parse_chunk",
+     [](uint32_t i) -> uint32_t {
+       const uint8_t *const reply = telem_buffers[i & table_mask];
+       for (size_t b = 0; b < KISS_ESC_TELEM_BUFFER_SIZE; ++b)
+         parser.buffer[b] = reply[b];
+       parser.buffer_idx = KISS_ESC_TELEM_BUFFER_SIZE;
+       const onewire_request_t req = {i, i, codes[i & table_mask]};
+       telem_sample_t sample;
+       onewire_parse_chunk(&parser, 4, i, true, 115200, &req, &health, &queue,
+                           &sample);
+       telem_queue_pop(&queue, &sample);
+       return sample.timestamp_us;
+     }},
+    // Per sample logged, with a new chunk every TELEMLOG_CAPACITY samples
+    {"telemlog_append",
+     [](uint32_t i) -> uint32_t {
+       telem_sample_t sample = {};
+       sample.timestamp_us = i;
+       sample.esc_idx = i & 3;
+       sample.telem = telems[i & table_mask];
+       if (!telemlog_append(&telem_log, &sample)) {
+         telemlog_finish(&telem_log);
+         telemlog_next(&telem_log);
+         telemlog_append(&telem_log, &sample);
+       }
+       return telem_log.header.count;
+     }},
+    // Per motor and frame: a setpoint from the frame hook, a new speed
+    // every 256 frames and a new duty every 64
+    {"dshot_frame_boundary",
+     [](uint32_t i) -> uint32_t {
+       if ((i & 255) == 0) {
+         motor.pending_speed = (i >> 8) & 1 ? DSHOT1200 : DSHOT600;
+         setpoint_set(&motor_sp, codes[i >> 8 & table_mask]);
+       }
+       if ((i & 63) == 32) {
+         const dshot_duty_t duty = {(uint16_t)(700 + (i >> 6 & 3) * 25),
+                                    370};
+         motor.pending_duty = dshot_duty_pack(&duty);
+       }
+       bench_frame_boundary(&motor);
+       return motor.packet.packet_buffer[i & (DSHOT_FRAME_SIZE - 1)];
+     }},
+};
+
+static void usage(const char *const argv0) {
+  fprintf(stderr,
+          "usage: %s [--filter substr] [--json out] [--min-time-ms ms] "
+          "[--baseline file] [--threshold fraction] "
+          "[--write-baseline file]\n",
+          argv0);
+}
+
+int main(int argc, char **argv) {
+  const char *filter = nullptr, *json_path = nullptr;
+  const char *baseline_path = nullptr, *write_baseline_path = nullptr;
+  double threshold = 0.25, min_time_ms = 20;
+  for (int a = 1; a < argc; ++a) {
+    const bool has_value = a + 1 < argc;
+    if (!strcmp(argv[a], "--filter") && has_value)
+      filter = argv[++a];
+    else if (!strcmp(argv[a], "--json") && has_value)
+      json_path = argv[++a];
+    else if (!strcmp(argv[a], "--min-time-ms") && has_value)
+      min_time_ms = atof(argv[++a]);
+    else if (!strcmp(argv[a], "--baseline") && has_value)
+      baseline_path = argv[++a];
+    else if (!strcmp(argv[a], "--threshold") && has_value)
+      threshold = atof(argv[++a]);
+    else if (!strcmp(argv[a], "--write-baseline") && has_value)
+      write_baseline_path = argv[++a];
+    else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  bench_setup();
+  std::vector<bench_result> results;
+  for (const bench_kernel &k : kernels) {
+    if (filter && !strstr(k.name, filter))
+      continue;
+    results.push_back(bench_run(k.name, k.run, min_time_ms * 1e6));
+  }
+
+  int regressions = 0;
+  if (baseline_path) {
+    std::vector<bench_result> baseline;
+    if (!bench_read_baseline(baseline_path, baseline)) {
+      fprintf(stderr, "can't read baseline %s\n", baseline_path);
+      return 2;
+    }
+    regressions = bench_compare(results, baseline, threshold);
+  }
+
+  bench_write_json(stdout, results, threshold);
+  if (json_path) {
+    FILE *const out = fopen(json_path, "w");
+    if (!out) {
+      fprintf(stderr, "can't write %s\n", json_path);
+      return 2;
+    }
+    bench_write_json(out, results, threshold);
+    fclose(out);
+  }
+  if (write_baseline_path) {
+    // Without the comparison fields
+    std::vector<bench_result> baseline = results;
+    for (bench_result &r : baseline)
+      r.baseline_ns_per_op = 0;
+    FILE *const out = fopen(write_baseline_path, "w");
+    if (!out) {
+      fprintf(stderr, "can't write %s\n", write_baseline_path);
+      return 2;
+    }
+    bench_write_json(out, baseline, threshold);
+    fclose(out);
+  }
+
+  for (const bench_result &r : results) {
+    if (r.regression)
+      fprintf(stderr, "REGRESSION %s: %.3f ns/op, baseline %.3f\n",
+              r.name.c_str(), r.ns_per_op, r.baseline_ns_per_op);
+  }
+  return regressions ? 1 : 0;
+}
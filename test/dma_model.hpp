@@ -0,0 +1,285 @@
+/**
+ * @file dma_model.hpp
+ *
+ * Host model of the rp2040 dma engine, enough to run the control block
+ * chains of dmachain.h: channel registers and their aliases, triggers and
+ * null triggers, chaining, read / write increments and rings, 8 / 16 / 32
+ * bit transfers, dreq pacing by pwm wraps, and IRQ_QUIET.
+ *
+ * Memory is a flat array of words at @ref DMA_MODEL_SRAM_BASE. Writes to
+ * pwm counter compare registers are logged per slice instead. A pwm slice
+ * wraps once per tick, all in phase.
+ *
+ * As on the rp2040 bus, narrow data is replicated across the 32 bit word:
+ * a 16 bit transfer of 0x1234 writes 0x12341234. Sram honours the byte
+ * lanes; io registers (the pwm here) take the whole word.
+ */
+
+#pragma once
+#include "dmachain.h"
+#include <stdint.h>
+#include <vector>
+
+#define DMA_MODEL_CHANNELS 12
+#define DMA_MODEL_SRAM_BASE 0x20000000u
+#define DMA_MODEL_SRAM_WORDS 0x1000u
+#define DMA_MODEL_DMA_BASE 0x50000000u
+#define DMA_MODEL_CH_STRIDE 0x40u
+#define DMA_MODEL_PWM_BASE 0x40050000u
+#define DMA_MODEL_PWM_SLICES 8
+#define DMA_MODEL_PWM_STRIDE 0x14u
+#define DMA_MODEL_PWM_CC 0x0cu
+/// DREQ_PWM_WRAP0
+#define DMA_MODEL_DREQ_PWM_WRAP0 24
+
+/// @brief bus address of a channel register
+static inline uint32_t dma_model_reg(const int ch, const uint32_t offset) {
+  return DMA_MODEL_DMA_BASE + ch * DMA_MODEL_CH_STRIDE + offset;
+}
+
+/// @brief bus address of a pwm slice counter compare
+static inline uint32_t dma_model_pwm_cc(const int slice) {
+  return DMA_MODEL_PWM_BASE + slice * DMA_MODEL_PWM_STRIDE +
+         DMA_MODEL_PWM_CC;
+}
+
+/// Register offsets of a channel
+enum dma_model_reg_offset {
+  DMA_MODEL_READ_ADDR = 0x00,
+  DMA_MODEL_WRITE_ADDR = 0x04,
+  DMA_MODEL_TRANS_COUNT = 0x08,
+  DMA_MODEL_CTRL_TRIG = 0x0c,
+  DMA_MODEL_AL1_CTRL = 0x10,
+  DMA_MODEL_AL1_READ_ADDR = 0x14,
+  DMA_MODEL_AL1_WRITE_ADDR = 0x18,
+  DMA_MODEL_AL1_TRANS_COUNT_TRIG = 0x1c,
+  DMA_MODEL_AL3_READ_ADDR_TRIG = 0x3c,
+};
+
+struct dma_model_channel {
+  uint32_t ctrl = 0;
+  uint32_t read_addr = 0;
+  uint32_t write_addr = 0;
+  uint32_t count = 0;  // remaining transfers
+  uint32_t reload = 0; // TRANS_COUNT as written
+  bool busy = false;
+};
+
+/// @brief a write to a pwm counter compare
+struct dma_model_pwm_write {
+  uint32_t tick;
+  uint32_t value;
+};
+
+struct dma_model {
+  dma_model_channel ch[DMA_MODEL_CHANNELS];
+  std::vector<uint32_t> sram = std::vector<uint32_t>(DMA_MODEL_SRAM_WORDS);
+  std::vector<dma_model_pwm_write> pwm[DMA_MODEL_PWM_SLICES];
+  uint32_t irq = 0; // raised channels
+  uint32_t tick = 0;
+  uint32_t transfers = 0;
+  bool fault = false; // access outside the modelled address space
+
+  uint32_t read(const uint32_t addr) {
+    const uint32_t word = (addr - DMA_MODEL_SRAM_BASE) / 4;
+    if (addr < DMA_MODEL_SRAM_BASE || word >= DMA_MODEL_SRAM_WORDS ||
+        addr % 4) {
+      fault = true;
+      return 0;
+    }
+    return sram[word];
+  }
+
+  /// @brief read \a bytes (1, 2 or 4), replicated across the word
+  uint32_t read(const uint32_t addr, const uint32_t bytes) {
+    if (addr % bytes) {
+      fault = true;
+      return 0;
+    }
+    const uint32_t word = read(addr & ~3u);
+    if (bytes == 4)
+      return word;
+    const uint32_t mask = (1u << (8 * bytes)) - 1;
+    const uint32_t lane = (word >> (8 * (addr & 3))) & mask;
+    return bytes == 2 ? lane * 0x00010001u : lane * 0x01010101u;
+  }
+
+  /// @brief write \a bytes (1, 2 or 4): io registers take the whole
+  /// (replicated) word, sram only the lanes of \a addr
+  void write(const uint32_t addr, const uint32_t value, const uint32_t bytes) {
+    const bool in_sram = addr >= DMA_MODEL_SRAM_BASE &&
+                         addr - DMA_MODEL_SRAM_BASE < 4 * DMA_MODEL_SRAM_WORDS;
+    if (bytes == 4 || !in_sram) {
+      if (addr % bytes) {
+        fault = true;
+        return;
+      }
+      write(addr & ~3u, value);
+      return;
+    }
+    // The low bytes of \a value go to the lane of \a addr
+    const uint32_t shift = 8 * (addr & 3);
+    const uint32_t mask = ((1u << (8 * bytes)) - 1) << shift;
+    const uint32_t word = read(addr & ~3u);
+    write(addr & ~3u, (word & ~mask) | ((value << shift) & mask));
+  }
+
+  void write(const uint32_t addr, const uint32_t value) {
+    const uint32_t offset = addr - DMA_MODEL_DMA_BASE;
+    if (addr >= DMA_MODEL_DMA_BASE &&
+        offset < DMA_MODEL_CHANNELS * DMA_MODEL_CH_STRIDE) {
+      write_reg(offset / DMA_MODEL_CH_STRIDE, offset % DMA_MODEL_CH_STRIDE,
+                value);
+      return;
+    }
+    const uint32_t pwm_offset = addr - DMA_MODEL_PWM_BASE;
+    if (addr >= DMA_MODEL_PWM_BASE &&
+        pwm_offset < DMA_MODEL_PWM_SLICES * DMA_MODEL_PWM_STRIDE &&
+        pwm_offset % DMA_MODEL_PWM_STRIDE == DMA_MODEL_PWM_CC) {
+      pwm[pwm_offset / DMA_MODEL_PWM_STRIDE].push_back({tick, value});
+      return;
+    }
+    const uint32_t word = (addr - DMA_MODEL_SRAM_BASE) / 4;
+    if (addr < DMA_MODEL_SRAM_BASE || word >= DMA_MODEL_SRAM_WORDS ||
+        addr % 4) {
+      fault = true;
+      return;
+    }
+    sram[word] = value;
+  }
+
+  void trigger(const int c, const uint32_t trigger_value) {
+    dma_model_channel &chan = ch[c];
+    // A null trigger ends a chain, and raises the irq in quiet mode
+    if (!trigger_value) {
+      if (chan.ctrl & DMACHAIN_CTRL_IRQ_QUIET)
+        irq |= 1u << c;
+      return;
+    }
+    start(c);
+  }
+
+  void start(const int c) {
+    dma_model_channel &chan = ch[c];
+    chan.count = chan.reload;
+    chan.busy = (chan.ctrl & DMACHAIN_CTRL_EN) && chan.count;
+  }
+
+  void write_reg(const int c, const uint32_t offset, const uint32_t value) {
+    dma_model_channel &chan = ch[c];
+    switch (offset) {
+    case DMA_MODEL_READ_ADDR:
+    case DMA_MODEL_AL1_READ_ADDR:
+      chan.read_addr = value;
+      break;
+    case DMA_MODEL_WRITE_ADDR:
+    case DMA_MODEL_AL1_WRITE_ADDR:
+      chan.write_addr = value;
+      break;
+    case DMA_MODEL_TRANS_COUNT:
+      chan.reload = value;
+      break;
+    case DMA_MODEL_AL1_CTRL:
+      chan.ctrl = value;
+      break;
+    case DMA_MODEL_CTRL_TRIG:
+      chan.ctrl = value;
+      trigger(c, value);
+      break;
+    case DMA_MODEL_AL1_TRANS_COUNT_TRIG:
+      chan.reload = value;
+      trigger(c, value);
+      break;
+    case DMA_MODEL_AL3_READ_ADDR_TRIG:
+      chan.read_addr = value;
+      trigger(c, value);
+      break;
+    default:
+      fault = true;
+    }
+  }
+
+  static uint32_t advance(const uint32_t addr, const uint32_t bytes,
+                          const bool ring, const uint32_t ring_bits) {
+    if (!ring || !ring_bits)
+      return addr + bytes;
+    const uint32_t mask = (1u << ring_bits) - 1;
+    return (addr & ~mask) | ((addr + bytes) & mask);
+  }
+
+  /// @brief one transfer of a busy channel
+  void transfer(const int c) {
+    dma_model_channel &chan = ch[c];
+    const uint32_t ctrl = chan.ctrl;
+    const uint32_t ring_bits = (ctrl >> DMACHAIN_CTRL_RING_SIZE_LSB) & 0xf;
+    const bool ring_write = ctrl & DMACHAIN_CTRL_RING_SEL;
+    const uint32_t bytes = 1u << ((ctrl >> DMACHAIN_CTRL_DATA_SIZE_LSB) & 3);
+    const uint32_t read_addr = chan.read_addr;
+    const uint32_t write_addr = chan.write_addr;
+    // Update the addresses first: the write may reprogram this channel
+    if (ctrl & DMACHAIN_CTRL_INCR_READ)
+      chan.read_addr = advance(read_addr, bytes, !ring_write, ring_bits);
+    if (ctrl & DMACHAIN_CTRL_INCR_WRITE)
+      chan.write_addr = advance(write_addr, bytes, ring_write, ring_bits);
+    chan.count--;
+    transfers++;
+    write(write_addr, read(read_addr, bytes), bytes);
+    if (chan.count)
+      return;
+    chan.busy = false;
+    const int chain_to = (ctrl >> DMACHAIN_CTRL_CHAIN_TO_LSB) & 0xf;
+    if (!(ctrl & DMACHAIN_CTRL_IRQ_QUIET))
+      irq |= 1u << c;
+    if (chain_to != c)
+      start(chain_to);
+  }
+
+  static bool paced_by_pwm(const uint32_t ctrl) {
+    const uint32_t treq = (ctrl >> DMACHAIN_CTRL_TREQ_SEL_LSB) & 0x3f;
+    return treq >= DMA_MODEL_DREQ_PWM_WRAP0 &&
+           treq < DMA_MODEL_DREQ_PWM_WRAP0 + DMA_MODEL_PWM_SLICES;
+  }
+
+  bool busy() const {
+    for (const dma_model_channel &chan : ch) {
+      if (chan.busy)
+        return true;
+    }
+    return false;
+  }
+
+  /**
+   * @brief run until every channel is idle
+   *
+   * Unpaced channels run to completion between pwm wraps. Paced channels
+   * move one transfer per wrap of their slice.
+   *
+   * @param max_ticks give up after this many wraps
+   * @return false on a fault or a timeout
+   */
+  bool run(const uint32_t max_ticks) {
+    const uint32_t end = tick + max_ticks;
+    while (busy() && !fault) {
+      bool moved = true;
+      while (moved && !fault) {
+        moved = false;
+        for (int c = 0; c < DMA_MODEL_CHANNELS; ++c) {
+          if (ch[c].busy && !paced_by_pwm(ch[c].ctrl)) {
+            transfer(c);
+            moved = true;
+          }
+        }
+      }
+      if (!busy())
+        break;
+      if (tick == end)
+        return false;
+      tick++;
+      for (int c = 0; c < DMA_MODEL_CHANNELS; ++c) {
+        if (ch[c].busy && paced_by_pwm(ch[c].ctrl))
+          transfer(c);
+      }
+    }
+    return !fault;
+  }
+};
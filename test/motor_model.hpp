@@ -0,0 +1,46 @@
+#pragma once
+#include <math.h>
+#include <stdint.h>
+
+/**
+ * @brief First order model of a motor + ESC, for host simulations
+ *
+ * The steady state rpm rises with throttle, but sags at high throttle as
+ * the load grows: rpm_ss = max_rpm * f * (1 - sag * f) / (1 - sag),
+ * where f is the throttle fraction. The rpm approaches rpm_ss with time
+ * constant tau_s.
+ *
+ * @param rpm current mechanical rpm
+ * @param max_rpm rpm at full throttle
+ * @param sag load sag at full throttle (0 => linear)
+ * @param tau_s time constant in s
+ * @param poles magnet poles, to report erpm
+ */
+typedef struct motor_model {
+  double rpm;
+  double max_rpm;
+  double sag;
+  double tau_s;
+  uint8_t poles;
+} motor_model_t;
+
+static double motor_model_steady_rpm(const motor_model_t *const motor,
+                                     const uint16_t code) {
+  if (code < 48)
+    return 0;
+  const double f = (code - 48) / 1999.0;
+  return motor->max_rpm * f * (1 - motor->sag * f) / (1 - motor->sag);
+}
+
+/// @brief advance the motor by dt_s at a constant throttle code
+static void motor_model_step(motor_model_t *const motor, const uint16_t code,
+                             const double dt_s) {
+  const double rpm_ss = motor_model_steady_rpm(motor, code);
+  motor->rpm += (rpm_ss - motor->rpm) * (1 - exp(-dt_s / motor->tau_s));
+}
+
+/// @brief erpm as reported by KISS telemetry (a multiple of 100)
+static uint32_t motor_model_erpm(const motor_model_t *const motor) {
+  const double erpm = motor->rpm * motor->poles / 2;
+  return erpm <= 0 ? 0 : (uint32_t)(erpm / 100) * 100;
+}
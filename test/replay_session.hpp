@@ -0,0 +1,707 @@
+/**
+ * @file replay_session.hpp
+ *
+ * Recorded sessions of the telemetry data path, and a host pipeline to
+ * replay them (tools/telem_replay.cpp).
+ *
+ * A session is what the onewire saw, with timestamps: the request slots,
+ * the frames that carried the telemetry bit, the uart bytes as each run
+ * of the isr read them, and the host command bytes. It can also hold the
+ * results of the original run: every sample its main loop popped from the
+ * queue, statistics snapshots, and command counters.
+ *
+ * @ref replay_pipeline runs the inputs through the same code as the pico:
+ * the byte and slot logic of onewire_uart_irq() and onewire_repeating_req()
+ * (onewireparse.h, with kissesctelem.h parsing, telemlatency.h byte times
+ * and telemhealth.h), telemqueue.h, telemstats.h, telemlatency.h and
+ * hostcmd.h. Only the uart and timer access of onewire.h is left out. Each
+ * result is compared with the original one, which turns a change of the
+ * data path into a diff.
+ *
+ * Sessions are recorded by `soak_virtual_esc --record`, or captured on the
+ * bench (replaycap.h) and converted by @ref replay_capture.
+ *
+ * File layout (little endian):
+ *
+ * | Byte(s) | Header                                      |
+ * | :-----: | ------------------------------------------- |
+ * | 0 - 3   | magic "DSRS"                                |
+ * | 4 \| 5  | version (@ref REPLAY_VERSION)               |
+ * |    6    | ESC count                                   |
+ * |    7    | flags (@ref REPLAY_HAS_RESULTS)             |
+ * | 8 - 11  | uart baudrate                               |
+ * | 12 \| 13| telemstats EWMA shifts                      |
+ * |   14    | telemhealth stale cycles                    |
+ * |   15    | reserved                                    |
+ *
+ * followed by records of an 8 byte header and a payload:
+ *
+ * | Byte(s) | Record                                      |
+ * | :-----: | ------------------------------------------- |
+ * |    0    | type (@ref replay_record_type)              |
+ * |    1    | ESC idx, or flags                           |
+ * | 2 \| 3  | payload length                              |
+ * | 4 - 7   | time (us, as time_us_32)                    |
+ * | 8 ...   | payload                                     |
+ */
+
+#pragma once
+#include <sys/types.h>
+
+#include "hostcmd.h"
+#include "kissesctelem.h"
+#include "onewireparse.h"
+#include "replaycap.h"
+#include "telemhealth.h"
+#include "telemlatency.h"
+#include "telemqueue.h"
+#include "telemstats.h"
+#include "telemstream.h"
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define REPLAY_MAGIC "DSRS"
+#define REPLAY_VERSION 1
+#define REPLAY_HEADER_SIZE 16
+#define REPLAY_RECORD_HEADER_SIZE 8
+/// Header flag: the session holds the results of the original run
+#define REPLAY_HAS_RESULTS 0x01
+/// UART record flag: the isr was raised by the rx timeout
+#define REPLAY_RX_TIMEOUT 0x01
+/// STATS record flag: the original run started a new window
+#define REPLAY_STATS_RESET 0x01
+
+static_assert(TELEMSTATS_EWMA_COUNT <= 2, "the header holds 2 EWMA shifts");
+static_assert(REPLAYCAP_RX_TIMEOUT == REPLAY_RX_TIMEOUT,
+              "captured uart flags are recorded as they are");
+
+/**
+ * @brief record types
+ *
+ * Inputs:
+ * - @ref REPLAY_SLOT: the request timer armed the telemetry bit of ESC idx
+ *   (onewire_repeating_req), ending the slot of the previous ESC
+ * - @ref REPLAY_REQUEST: ESC idx sent a frame with the telemetry bit.
+ *   u16 throttle code
+ * - @ref REPLAY_UART: one run of the uart isr. Flags
+ *   (@ref REPLAY_RX_TIMEOUT), the bytes it read
+ * - @ref REPLAY_HOSTCMD: bytes received from the host (hostcmd.h)
+ *
+ * Results of the original run:
+ * - @ref REPLAY_SAMPLE: a sample popped from the queue by the main loop,
+ *   as a telemstream.h record
+ * - @ref REPLAY_STATS: a telemstats snapshot of ESC idx. u8 flags
+ *   (@ref REPLAY_STATS_RESET), then @ref REPLAY_STATS_SIZE bytes
+ * - @ref REPLAY_COMMANDS: hostcmd counters. u32 frames, crc errors,
+ *   seq gaps, bad frames
+ */
+enum replay_record_type {
+  REPLAY_SLOT = 1,
+  REPLAY_REQUEST = 2,
+  REPLAY_UART = 3,
+  REPLAY_HOSTCMD = 4,
+  REPLAY_SAMPLE = 5,
+  REPLAY_STATS = 6,
+  REPLAY_COMMANDS = 7,
+};
+
+static_assert((int)REPLAYCAP_SLOT == REPLAY_SLOT &&
+                  (int)REPLAYCAP_REQUEST == REPLAY_REQUEST &&
+                  (int)REPLAYCAP_UART == REPLAY_UART &&
+                  (int)REPLAYCAP_HOSTCMD == REPLAY_HOSTCMD &&
+                  (int)REPLAYCAP_SAMPLE == REPLAY_SAMPLE,
+              "captured events are recorded as they are");
+
+/// count, first / last us, then per channel mean, variance, min, max, EWMAs
+#define REPLAY_STATS_SIZE                                                      \
+  (12 + TELEMSTATS_CHANNELS * (8 + 8 + 4 + 4 + 8 * TELEMSTATS_EWMA_COUNT))
+#define REPLAY_COMMANDS_SIZE 16
+
+struct replay_header {
+  uint8_t escs = 1;
+  uint8_t flags = 0;
+  uint32_t baudrate = 115200;
+  uint8_t ewma_shift[TELEMSTATS_EWMA_COUNT] = {};
+  uint8_t stale_cycles = TELEMHEALTH_STALE_CYCLES;
+};
+
+struct replay_record {
+  uint8_t type;
+  uint8_t esc; // or flags
+  uint16_t length;
+  uint32_t time_us;
+  const uint8_t *payload;
+};
+
+static inline void replay_put(std::vector<uint8_t> &out, const uint64_t value,
+                              const int bytes) {
+  for (int i = 0; i < bytes; ++i)
+    out.push_back((uint8_t)(value >> (8 * i)));
+}
+
+static inline uint64_t replay_get(const uint8_t *const in, const int bytes) {
+  uint64_t value = 0;
+  for (int i = 0; i < bytes; ++i)
+    value |= (uint64_t)in[i] << (8 * i);
+  return value;
+}
+
+/// @brief serialise a telemstats snapshot (@ref REPLAY_STATS_SIZE bytes)
+static inline void replay_put_stats(std::vector<uint8_t> &out,
+                                    const telemstats_result_t &result) {
+  replay_put(out, result.count, 4);
+  replay_put(out, result.first_us, 4);
+  replay_put(out, result.last_us, 4);
+  for (const telemstats_channel_result_t &c : result.channel) {
+    replay_put(out, (uint64_t)c.mean, 8);
+    replay_put(out, c.variance, 8);
+    replay_put(out, (uint32_t)c.min, 4);
+    replay_put(out, (uint32_t)c.max, 4);
+    for (const int64_t ewma : c.ewma)
+      replay_put(out, (uint64_t)ewma, 8);
+  }
+}
+
+static inline void replay_get_stats(const uint8_t *in,
+                                    telemstats_result_t &result) {
+  result.count = (uint32_t)replay_get(in, 4);
+  result.first_us = (uint32_t)replay_get(in + 4, 4);
+  result.last_us = (uint32_t)replay_get(in + 8, 4);
+  in += 12;
+  for (telemstats_channel_result_t &c : result.channel) {
+    c.mean = (int64_t)replay_get(in, 8);
+    c.variance = replay_get(in + 8, 8);
+    c.min = (int32_t)replay_get(in + 16, 4);
+    c.max = (int32_t)replay_get(in + 20, 4);
+    in += 24;
+    for (int64_t &ewma : c.ewma) {
+      ewma = (int64_t)replay_get(in, 8);
+      in += 8;
+    }
+  }
+}
+
+/**
+ * @brief builds a session in memory
+ *
+ * Call @ref replay_writer::header first, then one method per event, in
+ * time order.
+ */
+struct replay_writer {
+  std::vector<uint8_t> data;
+
+  void header(const replay_header &h) {
+    data.clear();
+    data.insert(data.end(), REPLAY_MAGIC, REPLAY_MAGIC + 4);
+    replay_put(data, REPLAY_VERSION, 2);
+    data.push_back(h.escs);
+    data.push_back(h.flags);
+    replay_put(data, h.baudrate, 4);
+    for (int e = 0; e < 2; ++e)
+      data.push_back(e < TELEMSTATS_EWMA_COUNT ? h.ewma_shift[e] : 0);
+    data.push_back(h.stale_cycles);
+    data.push_back(0);
+  }
+
+  void record(const uint8_t type, const uint8_t esc, const uint32_t time_us,
+              const uint8_t *const payload, const uint16_t length) {
+    data.push_back(type);
+    data.push_back(esc);
+    replay_put(data, length, 2);
+    replay_put(data, time_us, 4);
+    data.insert(data.end(), payload, payload + length);
+  }
+
+  void slot(const uint8_t esc, const uint32_t time_us) {
+    record(REPLAY_SLOT, esc, time_us, nullptr, 0);
+  }
+
+  void request(const uint8_t esc, const uint32_t time_us,
+               const uint16_t code) {
+    const uint8_t payload[2] = {(uint8_t)code, (uint8_t)(code >> 8)};
+    record(REPLAY_REQUEST, esc, time_us, payload, 2);
+  }
+
+  void uart(const uint32_t time_us, const uint8_t *const bytes,
+            const uint16_t count, const bool rx_timeout) {
+    record(REPLAY_UART, rx_timeout ? REPLAY_RX_TIMEOUT : 0, time_us, bytes,
+           count);
+  }
+
+  void hostcmd(const uint32_t time_us, const uint8_t *const bytes,
+               const uint16_t count) {
+    record(REPLAY_HOSTCMD, 0, time_us, bytes, count);
+  }
+
+  void sample(const uint32_t time_us, const telem_sample_t &sample) {
+    uint8_t payload[TELEMSTREAM_RECORD_SIZE];
+    telemstream_encode(&sample, sample.seq, payload);
+    record(REPLAY_SAMPLE, sample.esc_idx, time_us, payload,
+           TELEMSTREAM_RECORD_SIZE);
+  }
+
+  void stats(const uint8_t esc, const uint32_t time_us,
+             const telemstats_result_t &result, const bool reset) {
+    std::vector<uint8_t> payload(1, reset ? REPLAY_STATS_RESET : 0);
+    replay_put_stats(payload, result);
+    record(REPLAY_STATS, esc, time_us, payload.data(),
+           (uint16_t)payload.size());
+  }
+
+  void commands(const uint32_t time_us, const hostcmd_t &cmd) {
+    std::vector<uint8_t> payload;
+    replay_put(payload, cmd.frames, 4);
+    replay_put(payload, cmd.crc_errors, 4);
+    replay_put(payload, cmd.seq_gaps, 4);
+    replay_put(payload, cmd.bad_frames, 4);
+    record(REPLAY_COMMANDS, 0, time_us, payload.data(),
+           (uint16_t)payload.size());
+  }
+
+  bool save(const char *const path) const {
+    FILE *const f = fopen(path, "wb");
+    if (!f)
+      return false;
+    const bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+    return fclose(f) == 0 && ok;
+  }
+};
+
+/**
+ * @brief walks the records of a session held in memory
+ */
+struct replay_reader {
+  const uint8_t *data = nullptr;
+  size_t size = 0;
+  size_t pos = 0;
+
+  /// @return false if this isn't a session of a known version
+  bool open(const uint8_t *const bytes, const size_t count,
+            replay_header &h) {
+    data = bytes;
+    size = count;
+    pos = REPLAY_HEADER_SIZE;
+    if (size < REPLAY_HEADER_SIZE || memcmp(data, REPLAY_MAGIC, 4) ||
+        replay_get(data + 4, 2) != REPLAY_VERSION || !data[6])
+      return false;
+    h.escs = data[6];
+    h.flags = data[7];
+    h.baudrate = (uint32_t)replay_get(data + 8, 4);
+    for (int e = 0; e < TELEMSTATS_EWMA_COUNT; ++e)
+      h.ewma_shift[e] = data[12 + e];
+    h.stale_cycles = data[14];
+    return h.baudrate != 0;
+  }
+
+  /// @return false at the end, or on a truncated record
+  bool next(replay_record &r) {
+    if (pos + REPLAY_RECORD_HEADER_SIZE > size)
+      return false;
+    const uint8_t *const p = data + pos;
+    r.type = p[0];
+    r.esc = p[1];
+    r.length = (uint16_t)replay_get(p + 2, 2);
+    r.time_us = (uint32_t)replay_get(p + 4, 4);
+    r.payload = p + REPLAY_RECORD_HEADER_SIZE;
+    if (pos + REPLAY_RECORD_HEADER_SIZE + r.length > size)
+      return false;
+    pos += REPLAY_RECORD_HEADER_SIZE + r.length;
+    return true;
+  }
+
+  bool at_end() const { return pos == size; }
+};
+
+/// @brief differences between the replay and the original results
+struct replay_diff {
+  uint64_t samples = 0;    // pairs compared
+  uint64_t mismatched = 0; // pairs that differ
+  uint64_t missing = 0;    // original samples without a replayed one
+  uint64_t extra = 0;      // replayed samples without an original one
+  uint64_t stats = 0;      // snapshots compared
+  uint64_t stats_mismatched = 0;
+  uint64_t commands_mismatched = 0;
+  std::vector<std::string> details; // the first few, as text
+  size_t max_details = 10;
+
+  uint64_t total() const {
+    return mismatched + missing + extra + stats_mismatched +
+           commands_mismatched;
+  }
+
+  __attribute__((format(printf, 2, 3))) void note(const char *const fmt,
+                                                   ...) {
+    if (details.size() >= max_details)
+      return;
+    char line[256];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    details.push_back(line);
+  }
+};
+
+/**
+ * @brief the onewire data path of the pico, fed from a session
+ *
+ * @ref uart and @ref slot are onewire_uart_irq() and
+ * onewire_repeating_req() without the hardware. The "main loop" pops a
+ * sample for every original one (so that the queue fills as it did on the
+ * pico), or after every uart record if the session has no results.
+ */
+struct replay_pipeline {
+  replay_header h;
+  // onewire_t
+  onewire_parser_t parser;
+  telem_queue_t queue;
+  std::vector<telemhealth_t> health;
+  uint64_t overflows = 0;
+  // dshot_config, per ESC
+  std::vector<uint32_t> telem_requests;
+  std::vector<uint32_t> request_us;
+  std::vector<uint16_t> request_code;
+  // main loop
+  std::vector<telemstats_t> stats;
+  std::vector<telemlatency_t> latency;
+  hostcmd_t cmd;
+  uint64_t samples = 0;
+  uint64_t uart_bytes = 0;
+  uint32_t now_us = 0; // time of the last record
+  replay_diff diff;
+
+  explicit replay_pipeline(const replay_header &header) : h(header) {
+    onewire_parser_init(&parser);
+    telem_queue_init(&queue);
+    health.resize(h.escs);
+    for (telemhealth_t &hl : health)
+      telemhealth_init(&hl, h.stale_cycles);
+    telem_requests.assign(h.escs, 0);
+    request_us.assign(h.escs, 0);
+    request_code.assign(h.escs, 0);
+    stats.resize(h.escs);
+    latency.resize(h.escs);
+    for (int i = 0; i < h.escs; ++i) {
+      telemstats_init(&stats[i], h.ewma_shift);
+      telemlatency_init(&latency[i]);
+    }
+    hostcmd_init(&cmd);
+  }
+
+  /// @brief onewire_repeating_req: end the current slot, arm \a esc
+  void slot(const int esc) {
+    if (parser.slot_open) {
+      const size_t idx = parser.esc_idx;
+      const bool sent = onewire_request_sent(&parser, telem_requests[idx]);
+      if (onewire_slot_end(&parser, &health[idx], sent))
+        parser.buffer_idx = 0; // onewire_resync
+    }
+    onewire_slot_start(&parser, esc, telem_requests[esc]);
+  }
+
+  /// @brief dshot_packet_sent, for a frame with the telemetry bit
+  void request(const int esc, const uint32_t time_us, const uint16_t code) {
+    request_us[esc] = time_us;
+    request_code[esc] = code;
+    telem_requests[esc]++;
+  }
+
+  /// @brief onewire_uart_irq
+  void uart(const uint32_t now_us, const uint8_t *const bytes,
+            const size_t count, const bool rx_timeout) {
+    const size_t idx = parser.esc_idx;
+    const size_t start_idx = parser.buffer_idx;
+    for (size_t b = 0; b < count; ++b) {
+      if (!onewire_parse_byte(&parser, bytes[b]))
+        overflows++;
+    }
+    uart_bytes += count;
+    const onewire_request_t req = {telem_requests[idx], request_us[idx],
+                                   request_code[idx]};
+    telem_sample_t sample = {};
+    onewire_parse_chunk(&parser, start_idx, now_us, rx_timeout, h.baudrate,
+                        &req, &health[idx], &queue, &sample);
+    if (!(h.flags & REPLAY_HAS_RESULTS)) {
+      telem_sample_t sample;
+      while (telem_queue_pop(&queue, &sample))
+        consume(sample);
+    }
+  }
+
+  /// @brief the main loop's processing of one sample
+  void consume(const telem_sample_t &sample) {
+    samples++;
+    if (sample.esc_idx >= h.escs)
+      return;
+    telemlatency_update(&latency[sample.esc_idx], &sample);
+    if (sample.telem.crc == 0)
+      telemstats_update(&stats[sample.esc_idx], &sample.telem,
+                        sample.timestamp_us);
+  }
+
+  /// @brief the original main loop popped a sample: pop ours and compare
+  void original_sample(const uint8_t *const record) {
+    telem_sample_t sample;
+    if (!telem_queue_pop(&queue, &sample)) {
+      diff.missing++;
+      telem_sample_t original = {};
+      uint16_t original_seq = 0;
+      if (telemstream_decode(record, &original, &original_seq))
+        diff.note("missing: original sample %u of ESC %u at %u us",
+                  original_seq, original.esc_idx, original.timestamp_us);
+      return;
+    }
+    consume(sample);
+    uint8_t replayed[TELEMSTREAM_RECORD_SIZE];
+    telemstream_encode(&sample, sample.seq, replayed);
+    diff.samples++;
+    // Skip the sync word. The seq is the queue's, so it must match too
+    if (!memcmp(replayed + 2, record + 2, TELEMSTREAM_RECORD_SIZE - 2))
+      return;
+    diff.mismatched++;
+    telem_sample_t original = {};
+    uint16_t original_seq = 0;
+    telemstream_decode(record, &original, &original_seq);
+    diff.note("sample %u: ESC %u at %u us, %dC %u cV %u cA %u mAh %u erpm "
+              "crc %02x; replayed %u: ESC %u at %u us, %dC %u cV %u cA %u "
+              "mAh %u erpm crc %02x",
+              original_seq, original.esc_idx, original.timestamp_us,
+              original.telem.temperature, original.telem.centi_voltage,
+              original.telem.centi_current, original.telem.consumption,
+              original.telem.erpm, original.telem.crc, sample.seq,
+              sample.esc_idx,
+              sample.timestamp_us, sample.telem.temperature,
+              sample.telem.centi_voltage, sample.telem.centi_current,
+              sample.telem.consumption, sample.telem.erpm / 100 * 100,
+              sample.telem.crc);
+  }
+
+  void original_stats(const int esc, const uint8_t *const payload) {
+    telemstats_result_t original, replayed;
+    replay_get_stats(payload + 1, original);
+    const bool reset = payload[0] & REPLAY_STATS_RESET;
+    telemstats_snapshot(&stats[esc], &replayed, reset);
+    std::vector<uint8_t> a, b;
+    replay_put_stats(a, original);
+    replay_put_stats(b, replayed);
+    diff.stats++;
+    if (a == b)
+      return;
+    diff.stats_mismatched++;
+    diff.note("stats of ESC %d: %u samples, mean erpm %.1f; replayed %u "
+              "samples, mean erpm %.1f",
+              esc, original.count,
+              telemstats_q16_to_float(original.channel[TELEMSTATS_ERPM].mean,
+                                      TELEMSTATS_ERPM),
+              replayed.count,
+              telemstats_q16_to_float(replayed.channel[TELEMSTATS_ERPM].mean,
+                                      TELEMSTATS_ERPM));
+  }
+
+  void original_commands(const uint8_t *const payload) {
+    const uint32_t frames = (uint32_t)replay_get(payload, 4);
+    const uint32_t crc_errors = (uint32_t)replay_get(payload + 4, 4);
+    const uint32_t seq_gaps = (uint32_t)replay_get(payload + 8, 4);
+    const uint32_t bad_frames = (uint32_t)replay_get(payload + 12, 4);
+    if (frames == cmd.frames && crc_errors == cmd.crc_errors &&
+        seq_gaps == cmd.seq_gaps && bad_frames == cmd.bad_frames)
+      return;
+    diff.commands_mismatched++;
+    diff.note("commands: %u frames, %u crc errors, %u seq gaps, %u bad; "
+              "replayed %u, %u, %u, %u",
+              frames, crc_errors, seq_gaps, bad_frames, cmd.frames,
+              cmd.crc_errors, cmd.seq_gaps, cmd.bad_frames);
+  }
+
+  /**
+   * @brief apply one record
+   *
+   * @return false if the record is malformed
+   */
+  bool apply(const replay_record &r) {
+    now_us = r.time_us;
+    switch (r.type) {
+    case REPLAY_SLOT:
+      if (r.esc >= h.escs || r.length)
+        return false;
+      slot(r.esc);
+      return true;
+    case REPLAY_REQUEST:
+      if (r.esc >= h.escs || r.length != 2)
+        return false;
+      request(r.esc, r.time_us, (uint16_t)replay_get(r.payload, 2));
+      return true;
+    case REPLAY_UART:
+      uart(r.time_us, r.payload, r.length, r.esc & REPLAY_RX_TIMEOUT);
+      return true;
+    case REPLAY_HOSTCMD:
+      for (uint16_t b = 0; b < r.length; ++b)
+        hostcmd_feed(&cmd, r.payload[b]);
+      return true;
+    case REPLAY_SAMPLE:
+      if (r.length != TELEMSTREAM_RECORD_SIZE)
+        return false;
+      original_sample(r.payload);
+      return true;
+    case REPLAY_STATS:
+      if (r.esc >= h.escs || r.length != 1 + REPLAY_STATS_SIZE)
+        return false;
+      original_stats(r.esc, r.payload);
+      return true;
+    case REPLAY_COMMANDS:
+      if (r.length != REPLAY_COMMANDS_SIZE)
+        return false;
+      original_commands(r.payload);
+      return true;
+    default:
+      // Unknown types are skipped, so that newer sessions still replay
+      return true;
+    }
+  }
+
+  /// @brief after the last record: the rest of the queue has no original
+  void finish() {
+    telem_sample_t sample;
+    while (telem_queue_pop(&queue, &sample)) {
+      consume(sample);
+      if (h.flags & REPLAY_HAS_RESULTS) {
+        diff.extra++;
+        diff.note("extra: replayed sample of ESC %u at %u us",
+                  sample.esc_idx, sample.timestamp_us);
+      }
+    }
+  }
+};
+
+/**
+ * @brief replay a whole session
+ *
+ * @param bytes session
+ * @param count size in bytes
+ * @param pipeline output: created from the session header
+ * @param max_details differences kept as text
+ * @return false if the session is malformed (pipeline holds what was
+ * replayed up to there)
+ */
+static inline bool replay_session(const uint8_t *const bytes,
+                                  const size_t count,
+                                  std::unique_ptr<replay_pipeline> &pipeline,
+                                  const size_t max_details = 10) {
+  replay_reader reader;
+  replay_header h;
+  if (!reader.open(bytes, count, h))
+    return false;
+  pipeline.reset(new replay_pipeline(h));
+  pipeline->diff.max_details = max_details;
+  replay_record r;
+  while (reader.next(r)) {
+    if (!pipeline->apply(r))
+      return false;
+  }
+  pipeline->finish();
+  return reader.at_end();
+}
+
+/**
+ * @brief turns the capture stream of the pico (replaycap.h) into sessions
+ *
+ * The stream may be fed in pieces. Bytes outside frames (e.g. the configs
+ * printed at boot) and frames with a bad CRC are skipped. Each start of
+ * the capture begins a new session, and events before the first one are
+ * dropped. The session holds the results of the original run if it has
+ * samples, numbered from its start as the replayed queue numbers them.
+ */
+struct replay_capture {
+  std::vector<replay_writer> sessions;
+  uint64_t frames = 0;         // valid frames
+  uint64_t skipped_bytes = 0;  // outside frames, or in a bad frame
+  uint64_t bad_frames = 0;     // bad CRC, or malformed
+  uint64_t dropped_events = 0; // lost on the pico (ring full)
+  uint64_t orphans = 0;        // events before the first start
+  uint16_t start_seq = 0;      // queue seq at the start of the session
+  std::vector<uint8_t> pending;
+
+  void feed(const uint8_t *const bytes, const size_t count) {
+    pending.insert(pending.end(), bytes, bytes + count);
+    size_t pos = 0;
+    while (pending.size() - pos >= REPLAYCAP_FRAME_HEADER_SIZE) {
+      const size_t size = replaycap_frame_size(&pending[pos]);
+      if (!size) {
+        skipped_bytes++;
+        pos++;
+        continue;
+      }
+      if (pending.size() - pos < size)
+        break;
+      replaycap_event_t event;
+      if (!replaycap_decode(&pending[pos], &event)) {
+        // Resync on the next byte
+        bad_frames++;
+        skipped_bytes++;
+        pos++;
+        continue;
+      }
+      pos += size;
+      frames++;
+      apply(event);
+    }
+    pending.erase(pending.begin(), pending.begin() + pos);
+  }
+
+  void apply(const replaycap_event_t &event) {
+    switch (event.type) {
+    case REPLAYCAP_START: {
+      if (event.length != 7 || !event.esc) {
+        bad_frames++;
+        return;
+      }
+      replay_header h;
+      h.escs = event.esc;
+      h.baudrate = (uint32_t)replay_get(event.payload, 4);
+      h.stale_cycles = event.payload[4];
+      start_seq = (uint16_t)replay_get(event.payload + 5, 2);
+      sessions.emplace_back();
+      sessions.back().header(h);
+      return;
+    }
+    case REPLAYCAP_DROPPED:
+      if (event.length == 4)
+        dropped_events += replay_get(event.payload, 4);
+      return;
+    case REPLAYCAP_SLOT:
+    case REPLAYCAP_REQUEST:
+    case REPLAYCAP_UART:
+    case REPLAYCAP_HOSTCMD:
+    case REPLAYCAP_SAMPLE:
+      break;
+    default:
+      bad_frames++;
+      return;
+    }
+    if (sessions.empty()) {
+      orphans++;
+      return;
+    }
+    replay_writer &w = sessions.back();
+    if (event.type != REPLAYCAP_SAMPLE) {
+      w.record(event.type, event.esc, event.time_us, event.payload,
+               event.length);
+      return;
+    }
+    telem_sample_t sample;
+    uint16_t seq;
+    if (event.length != TELEMSTREAM_RECORD_SIZE ||
+        !telemstream_decode(event.payload, &sample, &seq)) {
+      bad_frames++;
+      return;
+    }
+    sample.seq = (uint16_t)(seq - start_seq);
+    w.data[7] |= REPLAY_HAS_RESULTS;
+    w.sample(event.time_us, sample);
+  }
+};
@@ -0,0 +1,104 @@
+#pragma once
+#include "motor_model.hpp"
+#include "rpmctl.h"
+#include "setpoint.h"
+#include <math.h>
+
+/**
+ * @brief closed loop simulation settings
+ *
+ * @param frame_us dshot packet interval
+ * @param telem_interval_us telemetry request interval
+ * @param latency_us delay from a telemetry request to the sample arriving
+ * (transmission + queueing). The sample holds the rpm at request time
+ * @param duration_us simulated time after the target step
+ * @param band settling band, as a fraction of the target
+ */
+typedef struct rpmctl_sim_config {
+  uint32_t frame_us;
+  uint32_t telem_interval_us;
+  uint32_t latency_us;
+  uint32_t duration_us;
+  double band;
+} rpmctl_sim_config_t;
+
+/**
+ * @brief step response of the closed loop
+ *
+ * @param settle_us time after the step until the rpm stays in the band.
+ * duration_us if it never settles
+ * @param overshoot peak overshoot as a fraction of the step
+ * @param final_rpm rpm at the end of the simulation
+ * @param saturated_updates updates where the output was clamped
+ */
+typedef struct rpmctl_sim_result {
+  uint32_t settle_us;
+  double overshoot;
+  double final_rpm;
+  uint32_t saturated_updates;
+} rpmctl_sim_result_t;
+
+/**
+ * @brief simulate a step of the target rpm from a motor at rest
+ *
+ * Every frame the setpoint stage produces a throttle code that drives the
+ * motor model. Telemetry requests latch the rpm, and arrive latency_us
+ * later, at which point the controller runs.
+ *
+ * @param sim
+ * @param config controller configuration
+ * @param motor motor model (rpm is reset to 0)
+ * @param slew_per_frame slew limit of the setpoint stage
+ * @param target_rpm
+ * @param result
+ */
+static void rpmctl_sim_step(const rpmctl_sim_config_t *const sim,
+                            const rpmctl_config_t *const config,
+                            motor_model_t motor,
+                            const uint32_t slew_per_frame,
+                            const int32_t target_rpm,
+                            rpmctl_sim_result_t *const result) {
+  setpoint_t sp;
+  setpoint_init(&sp, config->min_code, slew_per_frame, 1,
+                SETPOINT_MAX_INTERP_FRAMES);
+  rpmctl_t ctl;
+  rpmctl_init(&ctl, config, &sp);
+  rpmctl_set_target(&ctl, target_rpm);
+  motor.rpm = 0;
+
+  // Requests in flight: at most latency / interval + 1
+  enum { MAX_IN_FLIGHT = 64 };
+  uint32_t req_time[MAX_IN_FLIGHT], req_erpm[MAX_IN_FLIGHT];
+  size_t head = 0, tail = 0;
+
+  uint32_t next_req = 0, last_outside = 0, saturated = 0;
+  double peak = 0;
+  for (uint32_t t = 0; t < sim->duration_us; t += sim->frame_us) {
+    // Samples that arrived during the last frame
+    while (tail != head && req_time[tail % MAX_IN_FLIGHT] + sim->latency_us <=
+                               t) {
+      const uint32_t arrival = req_time[tail % MAX_IN_FLIGHT] + sim->latency_us;
+      rpmctl_update(&ctl, req_erpm[tail % MAX_IN_FLIGHT], arrival);
+      saturated += ctl.saturated;
+      tail++;
+    }
+    if (t >= next_req && head - tail < MAX_IN_FLIGHT) {
+      req_time[head % MAX_IN_FLIGHT] = t;
+      req_erpm[head % MAX_IN_FLIGHT] = motor_model_erpm(&motor);
+      head++;
+      next_req += sim->telem_interval_us;
+    }
+
+    motor_model_step(&motor, setpoint_step(&sp), sim->frame_us * 1e-6);
+    if (fabs(motor.rpm - target_rpm) > sim->band * target_rpm)
+      last_outside = t + sim->frame_us;
+    if (motor.rpm > peak)
+      peak = motor.rpm;
+  }
+
+  result->settle_us = last_outside;
+  result->overshoot =
+      peak > target_rpm ? (peak - target_rpm) / (double)target_rpm : 0;
+  result->final_rpm = motor.rpm;
+  result->saturated_updates = saturated;
+}
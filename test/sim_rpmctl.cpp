@@ -0,0 +1,63 @@
+/**
+ * @file sim_rpmctl.cpp
+ *
+ * Host simulation of the closed loop RPM controller (rpmctl.h) against a
+ * first order motor model. Prints the settling time and overshoot of a
+ * target step for increasing telemetry latency, to find the latency
+ * budget of a set of gains.
+ *
+ *    ./sim_rpmctl [target_rpm] [telem_interval_us]
+ */
+
+#include <sys/types.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "rpmctl_sim.hpp"
+
+static const rpmctl_ff_point_t ff[] = {{0, 48}, {15000, 960}, {30000, 2047}};
+
+int main(int argc, char **argv) {
+  const int32_t target_rpm = argc > 1 ? atoi(argv[1]) : 10000;
+  const uint32_t telem_interval_us = argc > 2 ? atoi(argv[2]) : 1000;
+
+  const motor_model_t motor = {
+      .rpm = 0, .max_rpm = 30000, .sag = 0.15, .tau_s = 0.04, .poles = 14};
+  const rpmctl_config_t config = {
+      .kp = (int32_t)(0.08 * RPMCTL_GAIN_ONE),
+      .ki = (int32_t)(2.0 * RPMCTL_GAIN_ONE),
+      .kd = 0,
+      .i_band_rpm = 500,
+      .min_code = 48,
+      .max_code = 2047,
+      .poles = 14,
+      .max_dt_us = 10 * telem_interval_us,
+      .ff = ff,
+      .ff_points = sizeof(ff) / sizeof(ff[0]),
+  };
+
+  printf("target %i rpm, telemetry every %u us, tau %.0f ms\n", target_rpm,
+         telem_interval_us, motor.tau_s * 1e3);
+  printf("latency_us,settle_ms,overshoot_pct,final_rpm,saturated\n");
+
+  const uint32_t latencies_us[] = {0,    500,   1000,  2000,  5000,
+                                   10000, 20000, 40000, 80000};
+  uint32_t budget_us = 0;
+  for (const auto latency_us : latencies_us) {
+    const rpmctl_sim_config_t sim = {.frame_us = 143,
+                                     .telem_interval_us = telem_interval_us,
+                                     .latency_us = latency_us,
+                                     .duration_us = 2000000,
+                                     .band = 0.02};
+    rpmctl_sim_result_t result;
+    rpmctl_sim_step(&sim, &config, motor, 0, target_rpm, &result);
+    printf("%u,%.1f,%.1f,%.0f,%u\n", latency_us, result.settle_us * 1e-3,
+           result.overshoot * 100, result.final_rpm, result.saturated_updates);
+    // Budget: settles within 0.5 s with less than 10 % overshoot
+    if (result.settle_us < 500000 && result.overshoot < 0.1)
+      budget_us = latency_us;
+  }
+  printf("latency budget: %u us\n", budget_us);
+  return 0;
+}
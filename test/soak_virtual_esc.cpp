@@ -0,0 +1,284 @@
+/**
+ * @file soak_virtual_esc.cpp
+ *
+ * Soak test of the frame and telemetry path against virtual ESCs
+ * (virtual_esc.hpp), in simulated time.
+ *
+ * Every ESC gets a frame per packet interval, composed by packet.h from a
+ * setpoint stage (setpoint.h) that follows a random step profile. As in
+ * onewire.h, one ESC at a time has its telemetry bit set, round robin, and
+ * all replies share one uart. The bytes go through the host mirror of the
+ * onewire isr (replay_pipeline, see replay_session.hpp): collected into a
+ * 10 byte buffer that is reset at every request, decoded with
+ * kissesctelem.h and pushed through a telem_queue_t. A "main loop" that
+ * runs every millisecond folds them into telemstats.h.
+ *
+ * Some ESCs have faults injected (corrupt or dropped replies, a late reply
+ * that collides with the next one, noise). The run fails if a frame is
+ * lost, the samples don't add up, or the telemetry of a healthy ESC
+ * drifts from its motor model. It prints how many times faster than real
+ * time it ran.
+ *
+ * With `--record FILE`, the uart bytes, requests and results are saved as
+ * a session for tools/telem_replay.cpp.
+ *
+ *    ./soak_virtual_esc [--record FILE] [escs] [seconds] [seed]
+ */
+
+#include <sys/types.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "replay_session.hpp"
+#include "setpoint.h"
+#include "telemqueue.h"
+#include "telemstats.h"
+#include "virtual_esc.hpp"
+
+constexpr uint32_t sys_khz = 125000;
+constexpr uint16_t speed_khz = 600;
+constexpr uint64_t packet_interval_ns = 1000000000ull / 7000; // 7 kHz
+// onewire_rt_configure: ONEWIRE_MIN_INTERVAL_US per ESC between requests
+constexpr uint64_t telem_interval_per_esc_ns = 1000000;
+constexpr uint64_t main_loop_ns = 1000000;
+constexpr uint64_t profile_step_ns = 250000000; // new setpoint every 250 ms
+
+struct uart_byte {
+  uint64_t t_ns;
+  uint8_t value;
+  int esc;
+};
+
+int main(int argc, char **argv) {
+  const char *record_path = nullptr;
+  std::vector<const char *> args;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--record") && i + 1 < argc)
+      record_path = argv[++i];
+    else
+      args.push_back(argv[i]);
+  }
+  const int escs = args.size() > 0 ? atoi(args[0]) : 8;
+  const double seconds = args.size() > 1 ? atof(args[1]) : 60;
+  const uint32_t seed = args.size() > 2 ? atoi(args[2]) : 1;
+  const uint64_t end_ns = (uint64_t)(seconds * 1e9);
+
+  dshot_speed_entry_t entry;
+  dshot_speed_entry_compute(&entry, sys_khz, speed_khz,
+                            DSHOT_PAUSE_NS_DEFAULT);
+  uint16_t pulse_high, pulse_low;
+  dshot_duty_pulses(&dshot_duty_default, entry.top, &pulse_high, &pulse_low);
+  // The buffer ends with the first pause pulse, the shared tail sends the
+  // rest
+  const int tail_length = entry.pause_pulses - 1;
+
+  const motor_model_t motor = {
+      .rpm = 0, .max_rpm = 30000, .sag = 0.15, .tau_s = 0.04, .poles = 14};
+  std::vector<virtual_esc> esc;
+  std::vector<dshot_packet_t> packets(escs);
+  std::vector<setpoint_t> sps(escs);
+  std::vector<telemstats_t> stats(escs);
+  std::vector<uint64_t> samples(escs), corrupt(escs);
+  const uint8_t ewma_shift[TELEMSTATS_EWMA_COUNT] = {2, 6};
+  for (int i = 0; i < escs; ++i) {
+    esc.emplace_back(speed_khz, motor, seed + i);
+    packets[i] = {};
+    packets[i].pulse_high = pulse_high;
+    packets[i].pulse_low = pulse_low;
+    setpoint_init(&sps[i], 0,
+                  setpoint_slew_per_frame(4000, 1e9 / packet_interval_ns), 1,
+                  SETPOINT_MAX_INTERP_FRAMES);
+    telemstats_init(&stats[i], ewma_shift);
+  }
+  // Faults on the first few ESCs, the rest are healthy
+  if (escs > 1)
+    esc[1].faults.corrupt_reply = 0.01;
+  if (escs > 2)
+    esc[2].faults.drop_reply = 0.02;
+  if (escs > 3) {
+    esc[3].faults.erpm_noise = 500;
+    esc[3].faults.current_noise_a = 0.5;
+  }
+  // Late enough to collide with the reply of the next ESC
+  const uint64_t telem_interval_ns = telem_interval_per_esc_ns * escs;
+  if (escs > 4)
+    esc[4].faults.extra_delay_us = telem_interval_ns / 1000 - 300;
+  // Healthy: no fault injected, and not the next ESC in the round robin,
+  // whose replies the late ones collide with
+  std::vector<bool> healthy(escs);
+  for (int i = 0; i < escs; ++i) {
+    const virtual_esc_faults &f = esc[i].faults;
+    healthy[i] = !f.drop_reply && !f.corrupt_reply && !f.erpm_noise &&
+                 !f.current_noise_a && !f.extra_delay_us && !f.stall &&
+                 !f.mute && !(escs > 4 && i == (4 + 1) % escs);
+  }
+
+  std::mt19937 rng(seed);
+  std::vector<virtual_esc_pulse> pulses;
+  std::vector<uart_byte> rx;
+  replay_header header;
+  header.escs = (uint8_t)escs;
+  header.flags = REPLAY_HAS_RESULTS;
+  header.baudrate = VIRTUAL_ESC_BAUDRATE;
+  memcpy(header.ewma_shift, ewma_shift, sizeof(header.ewma_shift));
+  replay_pipeline onewire(header);
+  replay_writer recording;
+  if (record_path)
+    recording.header(header);
+  int requested = -1;
+  uint64_t frames_sent = 0, collisions = 0;
+  uint64_t max_drift_erpm = 0;
+
+  // Uart rx: merge the bytes on the wire up to now in time order
+  auto uart_rx = [&](const uint64_t now) {
+    rx.clear();
+    virtual_esc_byte byte;
+    for (int i = 0; i < escs; ++i) {
+      while (esc[i].receive(now, &byte))
+        rx.push_back({byte.t_ns, byte.value, i});
+    }
+    std::sort(rx.begin(), rx.end(),
+              [](const uart_byte &a, const uart_byte &b) {
+                return a.t_ns < b.t_ns;
+              });
+    const double byte_ns = esc[0].byte_ns();
+    for (size_t b = 0; b < rx.size(); ++b) {
+      uint8_t value = rx[b].value;
+      // Two ESCs driving the wire at once garble both bytes
+      const bool collided =
+          (b > 0 && rx[b].t_ns - rx[b - 1].t_ns < byte_ns &&
+           rx[b].esc != rx[b - 1].esc) ||
+          (b + 1 < rx.size() && rx[b + 1].t_ns - rx[b].t_ns < byte_ns &&
+           rx[b + 1].esc != rx[b].esc);
+      if (collided) {
+        collisions++;
+        value ^= 0x5a;
+      }
+      // One isr run per byte, raised by the fifo level
+      const uint32_t t_us = (uint32_t)(rx[b].t_ns / 1000);
+      onewire.uart(t_us, &value, 1, false);
+      if (record_path)
+        recording.uart(t_us, &value, 1, false);
+    }
+  };
+  // Main loop: drain the queue into the statistics
+  auto main_loop = [&](const uint64_t t) {
+    telem_sample_t sample;
+    while (telem_queue_pop(&onewire.queue, &sample)) {
+      if (record_path)
+        recording.sample((uint32_t)(t / 1000), sample);
+      const int i = sample.esc_idx;
+      if (sample.telem.crc) {
+        corrupt[i]++;
+        continue;
+      }
+      samples[i]++;
+      telemstats_update(&stats[i], &sample.telem, sample.timestamp_us);
+      // Healthy ESCs report their model, give or take the time since
+      if (healthy[i]) {
+        const int64_t model = motor_model_erpm(&esc[i].motor);
+        const uint64_t drift = llabs(model - (int64_t)sample.telem.erpm);
+        if (drift > max_drift_erpm)
+          max_drift_erpm = drift;
+      }
+    }
+  };
+
+  const auto start = std::chrono::steady_clock::now();
+  uint64_t next_telem = 0, next_main = 0, next_profile = 0;
+  for (uint64_t t = 0; t < end_ns; t += packet_interval_ns) {
+    if (t >= next_profile) {
+      next_profile += profile_step_ns;
+      for (int i = 0; i < escs; ++i)
+        setpoint_set(&sps[i], 48 + rng() % 1500);
+    }
+    // Telemetry request timer: onewire_repeating_req
+    if (t >= next_telem) {
+      next_telem += telem_interval_ns;
+      if (requested >= 0)
+        packets[requested].telemetry = 0;
+      requested = (requested + 1) % escs;
+      packets[requested].telemetry = 1;
+      onewire.slot(requested);
+      if (record_path)
+        recording.slot((uint8_t)requested, (uint32_t)(t / 1000));
+    }
+    // Frame timers, staggered across the interval
+    for (int i = 0; i < escs; ++i) {
+      const uint64_t t_frame = t + i * packet_interval_ns / escs;
+      setpoint_frame_hook(&packets[i], &sps[i]);
+      dshot_packet_compose(&packets[i]);
+      virtual_esc_pulses(packets[i].packet_buffer, DSHOT_PACKET_BUFFER_LENGTH,
+                         tail_length, entry, sys_khz, pulses);
+      esc[i].feed(t_frame, pulses);
+      if (packets[i].telemetry) {
+        onewire.request(i, (uint32_t)(t_frame / 1000),
+                        packets[i].throttle_code);
+        if (record_path)
+          recording.request((uint8_t)i, (uint32_t)(t_frame / 1000),
+                            packets[i].throttle_code);
+      }
+      packets[i].telemetry = 0;
+      frames_sent++;
+    }
+    uart_rx(t + packet_interval_ns);
+    if (t >= next_main) {
+      next_main += main_loop_ns;
+      main_loop(t);
+    }
+  }
+  // The replies still on the wire at the end
+  uart_rx(UINT64_MAX);
+  main_loop(end_ns);
+  const auto stop = std::chrono::steady_clock::now();
+  const double wall_s = std::chrono::duration<double>(stop - start).count();
+
+  printf("%d escs, %.1f s simulated in %.2f s: %.0fx real time\n", escs,
+         seconds, wall_s, seconds / wall_s);
+  printf("esc,frames,bad_timing,bad_crc,requests,replies,dropped,corrupted,"
+         "samples,crc_errors,mean_erpm\n");
+  bool ok = true;
+  uint64_t frames_decoded = 0;
+  for (int i = 0; i < escs; ++i) {
+    const virtual_esc_stats &s = esc[i].stats;
+    telemstats_result_t result;
+    telemstats_snapshot(&stats[i], &result, false);
+    if (record_path)
+      recording.stats((uint8_t)i, (uint32_t)(end_ns / 1000), result, false);
+    printf("%d,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%.0f\n", i,
+           (unsigned long long)s.frames, (unsigned long long)s.bad_timing,
+           (unsigned long long)s.bad_crc,
+           (unsigned long long)s.telem_requests, (unsigned long long)s.replies,
+           (unsigned long long)s.dropped_replies,
+           (unsigned long long)s.corrupted_replies,
+           (unsigned long long)samples[i], (unsigned long long)corrupt[i],
+           telemstats_q16_to_float(result.channel[TELEMSTATS_ERPM].mean,
+                                   TELEMSTATS_ERPM));
+    frames_decoded += s.frames;
+    ok &= !s.bad_timing && !s.bad_crc && !s.short_gap;
+    // Every reply of a healthy ESC is received intact
+    if (healthy[i])
+      ok &= samples[i] == s.replies && !corrupt[i];
+  }
+  printf("collisions %llu bytes, overflows %llu, queue drops %u, "
+         "max erpm drift %llu\n",
+         (unsigned long long)collisions,
+         (unsigned long long)onewire.overflows, onewire.queue.dropped,
+         (unsigned long long)max_drift_erpm);
+  ok &= frames_decoded == frames_sent && !onewire.queue.dropped;
+  // 1 ms of motor response at most between a reply and the check
+  ok &= max_drift_erpm < 3000;
+  if (record_path) {
+    const bool saved = recording.save(record_path);
+    printf("session of %zu bytes %s %s\n", recording.data.size(),
+           saved ? "recorded to" : "NOT recorded to", record_path);
+    ok &= saved;
+  }
+  printf("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
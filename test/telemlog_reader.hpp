@@ -0,0 +1,284 @@
+/**
+ * @file telemlog_reader.hpp
+ *
+ * Host reader of telemlog.h files: memory maps the file, finds the chunks
+ * of a time range through the trailing index, and iterates the columns of
+ * those chunks only.
+ *
+ * @code
+ * telemlog_reader log;
+ * log.open("run.tlog");
+ * std::vector<uint64_t> t_us;
+ * std::vector<int32_t> current;
+ * log.extract(2, TELEMLOG_CURRENT, from_us, to_us, t_us, current);
+ * @endcode
+ *
+ * Without an index (a raw capture), the chunk headers are scanned once on
+ * open instead. @ref telemlog_pack realigns a capture and appends the
+ * index. Columns are read in place, so the host must be little endian.
+ */
+
+#pragma once
+#include "telemlog.h"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "columns are read in place");
+
+/// @brief index entry of a chunk (@ref TELEMLOG_INDEX_ENTRY_SIZE bytes)
+struct telemlog_index_entry {
+  uint64_t first_us;
+  uint64_t last_us;
+  uint32_t esc_mask;
+  uint16_t count;
+  uint16_t reserved;
+};
+static_assert(sizeof(telemlog_index_entry) == TELEMLOG_INDEX_ENTRY_SIZE,
+              "index layout");
+
+static inline telemlog_index_entry
+telemlog_entry(const telemlog_header_t &h) {
+  return {h.first_us, h.last_us, h.esc_mask, h.count, 0};
+}
+
+/**
+ * @brief append the index of \a entries and the footer
+ *
+ * @param f positioned after the last chunk
+ * @param entries one per chunk, in file order
+ * @param index_offset file offset of the index (= chunks x chunk size)
+ * @return false on a write error
+ */
+static inline bool
+telemlog_write_index(FILE *const f,
+                     const std::vector<telemlog_index_entry> &entries,
+                     const uint64_t index_offset) {
+  uint8_t footer[TELEMLOG_FOOTER_SIZE];
+  telemlog_put(footer, TELEMLOG_INDEX_MAGIC, 4);
+  telemlog_put(footer + 4, entries.size(), 4);
+  telemlog_put(footer + 8, index_offset, 8);
+  const size_t bytes = entries.size() * TELEMLOG_INDEX_ENTRY_SIZE;
+  return fwrite(entries.data(), 1, bytes, f) == bytes &&
+         fwrite(footer, 1, sizeof(footer), f) == sizeof(footer);
+}
+
+/**
+ * @brief copy the valid chunks of a raw capture to an aligned, indexed log
+ *
+ * The capture may start or end in the middle of a chunk, or have text
+ * before the first chunk: chunks are found by their header, wherever they
+ * start.
+ *
+ * @param capture
+ * @param size
+ * @param out
+ * @param skipped output: bytes that weren't part of a chunk
+ * @return number of chunks, or -1 on a write error
+ */
+static inline long telemlog_pack(const uint8_t *const capture,
+                                 const size_t size, FILE *const out,
+                                 size_t *const skipped) {
+  std::vector<telemlog_index_entry> entries;
+  *skipped = 0;
+  size_t pos = 0;
+  telemlog_header_t h;
+  while (pos + TELEMLOG_CHUNK_SIZE <= size) {
+    if (!telemlog_decode_header(capture + pos, &h)) {
+      pos++;
+      (*skipped)++;
+      continue;
+    }
+    if (fwrite(capture + pos, 1, TELEMLOG_CHUNK_SIZE, out) !=
+        TELEMLOG_CHUNK_SIZE)
+      return -1;
+    entries.push_back(telemlog_entry(h));
+    pos += TELEMLOG_CHUNK_SIZE;
+  }
+  *skipped += size - pos;
+  if (!telemlog_write_index(out, entries,
+                            entries.size() * (uint64_t)TELEMLOG_CHUNK_SIZE))
+    return -1;
+  return (long)entries.size();
+}
+
+struct telemlog_reader {
+  const uint8_t *map = nullptr;
+  size_t size = 0;
+  size_t chunks = 0;
+  bool indexed = false; // the index was read from the file
+  const telemlog_index_entry *index = nullptr;
+  std::vector<telemlog_index_entry> scanned;
+
+  telemlog_reader() = default;
+  telemlog_reader(const telemlog_reader &) = delete;
+  telemlog_reader &operator=(const telemlog_reader &) = delete;
+  ~telemlog_reader() { close(); }
+
+  void close() {
+    if (map)
+      munmap((void *)map, size);
+    map = nullptr;
+    size = chunks = 0;
+    index = nullptr;
+    scanned.clear();
+  }
+
+  /**
+   * @brief map a log
+   *
+   * @return false if the file can't be mapped, or has a bad chunk
+   */
+  bool open(const char *const path) {
+    close();
+    const int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+      return false;
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size == 0) {
+      ::close(fd);
+      return false;
+    }
+    void *const m = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (m == MAP_FAILED)
+      return false;
+    map = (const uint8_t *)m;
+    size = st.st_size;
+    return read_index() || scan();
+  }
+
+  /// @brief use the trailing index
+  bool read_index() {
+    if (size < TELEMLOG_FOOTER_SIZE)
+      return false;
+    const uint8_t *const footer = map + size - TELEMLOG_FOOTER_SIZE;
+    const uint64_t count = telemlog_get(footer + 4, 4);
+    const uint64_t offset = telemlog_get(footer + 8, 8);
+    if (telemlog_get(footer, 4) != TELEMLOG_INDEX_MAGIC ||
+        offset != count * TELEMLOG_CHUNK_SIZE ||
+        offset + count * TELEMLOG_INDEX_ENTRY_SIZE + TELEMLOG_FOOTER_SIZE !=
+            size)
+      return false;
+    chunks = count;
+    index = (const telemlog_index_entry *)(map + offset);
+    indexed = true;
+    return true;
+  }
+
+  /// @brief no index: read every chunk header
+  bool scan() {
+    telemlog_header_t h;
+    for (size_t pos = 0; pos + TELEMLOG_CHUNK_SIZE <= size;
+         pos += TELEMLOG_CHUNK_SIZE) {
+      if (!telemlog_decode_header(map + pos, &h))
+        return false;
+      scanned.push_back(telemlog_entry(h));
+    }
+    chunks = scanned.size();
+    index = scanned.data();
+    indexed = false;
+    return size % TELEMLOG_CHUNK_SIZE == 0;
+  }
+
+  const uint8_t *chunk(const size_t c) const {
+    return map + c * TELEMLOG_CHUNK_SIZE;
+  }
+
+  /// @brief a column of chunk \a c, of @ref TELEMLOG_CAPACITY entries
+  template <typename T>
+  const T *column(const size_t c, const enum telemlog_field f) const {
+    return (const T *)(chunk(c) + telemlog_column_offset(f));
+  }
+
+  /// @brief first chunk that may hold samples at or after \a t_us
+  size_t find(const uint64_t t_us) const {
+    size_t lo = 0, hi = chunks;
+    while (lo < hi) {
+      const size_t mid = lo + (hi - lo) / 2;
+      if (index[mid].last_us < t_us)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    return lo;
+  }
+
+  /// @brief value of a field of sample \a i of chunk \a c, widened
+  int32_t value(const size_t c, const size_t i,
+                const enum telemlog_field f) const {
+    switch (f) {
+    case TELEMLOG_TIME:
+      return (int32_t)column<uint32_t>(c, f)[i];
+    case TELEMLOG_TEMPERATURE:
+      return column<int8_t>(c, f)[i];
+    case TELEMLOG_ESC:
+    case TELEMLOG_CRC:
+      return column<uint8_t>(c, f)[i];
+    default:
+      return column<uint16_t>(c, f)[i];
+    }
+  }
+
+  /**
+   * @brief visit the samples of one ESC in [from_us, to_us)
+   *
+   * Chunks out of range, or without the ESC, aren't touched.
+   *
+   * @param esc ESC idx
+   * @param from_us
+   * @param to_us
+   * @param visit callable `void (uint64_t t_us, size_t chunk, size_t i)`
+   * @return number of samples visited
+   */
+  template <typename F>
+  size_t scan_range(const int esc, const uint64_t from_us,
+                    const uint64_t to_us, F &&visit) const {
+    const uint32_t bit = 1u << (esc < 31 ? esc : 31);
+    size_t n = 0;
+    for (size_t c = find(from_us); c < chunks && index[c].first_us < to_us;
+         ++c) {
+      if (!(index[c].esc_mask & bit))
+        continue;
+      const uint64_t first = index[c].first_us;
+      const uint32_t *const t = column<uint32_t>(c, TELEMLOG_TIME);
+      const uint8_t *const e = column<uint8_t>(c, TELEMLOG_ESC);
+      for (size_t i = 0; i < index[c].count; ++i) {
+        const uint64_t t_us = first + t[i];
+        if (e[i] == esc && t_us >= from_us && t_us < to_us) {
+          visit(t_us, c, i);
+          n++;
+        }
+      }
+    }
+    return n;
+  }
+
+  /**
+   * @brief extract one field of one ESC in [from_us, to_us)
+   *
+   * @param esc
+   * @param f
+   * @param from_us
+   * @param to_us
+   * @param t_us output: times (appended)
+   * @param values output: values in wire units (appended)
+   * @return number of samples
+   */
+  size_t extract(const int esc, const enum telemlog_field f,
+                 const uint64_t from_us, const uint64_t to_us,
+                 std::vector<uint64_t> &t_us,
+                 std::vector<int32_t> &values) const {
+    return scan_range(esc, from_us, to_us,
+                      [&](const uint64_t t, const size_t c, const size_t i) {
+                        t_us.push_back(t);
+                        values.push_back(value(c, i, f));
+                      });
+  }
+};
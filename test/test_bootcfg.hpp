@@ -0,0 +1,96 @@
+#include "bootcfg.h"
+#include "unity.h"
+
+/**
+ * @brief The CRC is zlib's, so host tools can seal blocks too
+ */
+static void test_bootcfg_crc32(void) {
+  TEST_ASSERT_EQUAL_HEX32(0xcbf43926u, bootcfg_crc32("123456789", 9));
+  TEST_ASSERT_EQUAL_HEX32(0, bootcfg_crc32("", 0));
+}
+
+/**
+ * @brief A built block checks out and holds the table dshot.h would compute
+ */
+static void test_bootcfg_build(void) {
+  const uint8_t gpios[2] = {14, 16};
+  const dshot_duty_t duty[2] = {{760, 380}, {740, 360}};
+  bootcfg_t cfg;
+  TEST_ASSERT_TRUE(bootcfg_build(&cfg, 125000, DSHOT600, 2000, 100, 2, gpios,
+                                 duty));
+  TEST_ASSERT_EQUAL(BOOTCFG_OK, bootcfg_check(&cfg, 125000));
+  TEST_ASSERT_EQUAL(16, cfg.esc_gpio[1]);
+  TEST_ASSERT_EQUAL(740, cfg.duty[1].t1h);
+
+  dshot_speed_entry_t table[DSHOT_SPEEDS];
+  memset(table, 0, sizeof(table));
+  TEST_ASSERT_TRUE(dshot_speed_table_init(table, 125000, 2000));
+  TEST_ASSERT_EQUAL_MEMORY(table, cfg.speeds, sizeof(table));
+
+  // Default duties
+  TEST_ASSERT_TRUE(bootcfg_build(&cfg, 125000, DSHOT300, 2000, 0, 1, gpios,
+                                 NULL));
+  TEST_ASSERT_EQUAL(dshot_duty_default.t0h, cfg.duty[0].t0h);
+  TEST_ASSERT_EQUAL(BOOTCFG_OK, bootcfg_check(&cfg, 125000));
+
+  // A pause too long for DShot2400 only rules it out as the starting speed
+  TEST_ASSERT_TRUE(bootcfg_build(&cfg, 125000, DSHOT600, 4000, 0, 1, gpios,
+                                 NULL));
+  TEST_ASSERT_EQUAL(BOOTCFG_OK, bootcfg_check(&cfg, 125000));
+  TEST_ASSERT_FALSE(dshot_speed_entry_available(&cfg.speeds[DSHOT2400]));
+  TEST_ASSERT_FALSE(bootcfg_build(&cfg, 125000, DSHOT2400, 4000, 0, 1, gpios,
+                                  NULL));
+
+  // Out of range
+  TEST_ASSERT_FALSE(bootcfg_build(&cfg, 125000, DSHOT_SPEEDS, 2000, 100, 1,
+                                  gpios, NULL));
+  TEST_ASSERT_FALSE(bootcfg_build(&cfg, 125000, DSHOT600, 2000, 100, 0,
+                                  gpios, NULL));
+  TEST_ASSERT_FALSE(bootcfg_build(&cfg, 125000, DSHOT600, 2000, 100,
+                                  BOOTCFG_MAX_MOTORS + 1, gpios, NULL));
+}
+
+/**
+ * @brief Erased flash, corruption, layout and clock changes are rejected
+ */
+static void test_bootcfg_check(void) {
+  const uint8_t gpio = 14;
+  bootcfg_t cfg;
+  TEST_ASSERT_TRUE(
+      bootcfg_build(&cfg, 125000, DSHOT600, 2000, 100, 1, &gpio, NULL));
+
+  bootcfg_t bad;
+  memset(&bad, 0xff, sizeof(bad));
+  TEST_ASSERT_EQUAL(BOOTCFG_BAD_MAGIC, bootcfg_check(&bad, 125000));
+
+  bad = cfg;
+  bad.version++;
+  TEST_ASSERT_EQUAL(BOOTCFG_BAD_VERSION, bootcfg_check(&bad, 125000));
+
+  // Every bit is covered, padding included
+  for (size_t byte = 8; byte < offsetof(bootcfg_t, crc); ++byte) {
+    bad = cfg;
+    ((uint8_t *)&bad)[byte] ^= 0x10;
+    TEST_ASSERT_EQUAL(BOOTCFG_BAD_CRC, bootcfg_check(&bad, 125000));
+  }
+
+  TEST_ASSERT_EQUAL(BOOTCFG_BAD_CLOCK, bootcfg_check(&cfg, 120000));
+
+  // A resealed block must still be sane
+  bad = cfg;
+  bad.motors = 0;
+  bootcfg_seal(&bad);
+  TEST_ASSERT_EQUAL(BOOTCFG_BAD_FIELD, bootcfg_check(&bad, 125000));
+  bad = cfg;
+  bad.packet_interval_us = 10; // shorter than a DShot600 packet
+  bootcfg_seal(&bad);
+  TEST_ASSERT_EQUAL(BOOTCFG_BAD_FIELD, bootcfg_check(&bad, 125000));
+}
+
+static int runUnityTests_bootcfg(void) {
+  UnityBegin("BOOTCFG");
+  RUN_TEST(test_bootcfg_crc32);
+  RUN_TEST(test_bootcfg_build);
+  RUN_TEST(test_bootcfg_check);
+  return UNITY_END();
+}
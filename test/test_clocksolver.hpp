@@ -0,0 +1,83 @@
+#include "clocksolver.h"
+#include "unity.h"
+
+/**
+ * @brief At a fixed 125 MHz, DShot2400 is 52.08 counts per bit
+ */
+static void test_clocksolver_divwrap(void) {
+  clocksolver_params_t params;
+  clocksolver_default_params(&params);
+  clocksolver_result_t r;
+  TEST_ASSERT_TRUE(clocksolver_solve_divwrap(125e6, 2400e3, &params, &r));
+  TEST_ASSERT_EQUAL(1 << CLOCKSOLVER_DIV_FRAC_BITS, r.div);
+  TEST_ASSERT_EQUAL(51, r.top);
+  TEST_ASSERT_EQUAL(39, r.cc_high);
+  TEST_ASSERT_EQUAL(19, r.cc_low);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, 416.0, r.bit_ns);
+  // T0H: 152 ns for 154.17 ns
+  TEST_ASSERT_FLOAT_WITHIN(0.01, -2.17, r.t0h_err_ns);
+  TEST_ASSERT_FLOAT_WITHIN(0.01, 2.17, r.error_ns);
+  TEST_ASSERT_EQUAL(0, r.fbdiv);
+
+  // Slow rates need the divider: 125 MHz / 1 khz = 65536 x 1.907
+  TEST_ASSERT_TRUE(clocksolver_solve_divwrap(125e6, 1e3, &params, &r));
+  TEST_ASSERT_TRUE(r.div > 1 << CLOCKSOLVER_DIV_FRAC_BITS);
+  TEST_ASSERT_EQUAL(0, r.div % (1 << CLOCKSOLVER_DIV_FRAC_BITS));
+}
+
+/**
+ * @brief Searching the pll beats the default clock, within the limits
+ */
+static void test_clocksolver_solve(void) {
+  clocksolver_params_t params;
+  clocksolver_default_params(&params);
+  clocksolver_result_t fixed;
+  clocksolver_result_t r;
+  clocksolver_solve_divwrap(125e6, 2400e3, &params, &fixed);
+  TEST_ASSERT_TRUE(clocksolver_solve(2400e3, &params, &r));
+  TEST_ASSERT_TRUE(r.error_ns < fixed.error_ns);
+  TEST_ASSERT_TRUE(r.sys_hz >= params.sys_min_hz);
+  TEST_ASSERT_TRUE(r.sys_hz <= params.sys_max_hz);
+  TEST_ASSERT_TRUE(r.vco_hz >= params.vco_min_hz);
+  TEST_ASSERT_TRUE(r.vco_hz <= params.vco_max_hz);
+  TEST_ASSERT_TRUE(r.postdiv2 <= r.postdiv1);
+  TEST_ASSERT_EQUAL_UINT32(params.xosc_hz * r.fbdiv, r.vco_hz);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3, r.sys_hz,
+                           (double)r.vco_hz / (r.postdiv1 * r.postdiv2));
+
+  // 120 MHz divides DShot1200 exactly (100 counts, 75 and 37 high)
+  TEST_ASSERT_TRUE(clocksolver_solve(1200e3, &params, &r));
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, 0.0, r.error_ns);
+  TEST_ASSERT_EQUAL(0, (uint32_t)lround(r.sys_hz) % 1200000);
+
+  // Nothing reaches 100 MHz within 100 - 133 MHz
+  TEST_ASSERT_FALSE(clocksolver_solve(100e6, &params, &r));
+}
+
+/**
+ * @brief A fractional divider costs one clock period of jitter
+ */
+static void test_clocksolver_frac_div(void) {
+  clocksolver_params_t params;
+  clocksolver_default_params(&params);
+  clocksolver_result_t r;
+  clocksolver_evaluate(125e6, 2400e3, 24, 35, &params, &r);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, 8.0, r.jitter_ns);
+  clocksolver_evaluate(125e6, 2400e3, 16, 52, &params, &r);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, 0.0, r.jitter_ns);
+
+  // Allowing them can't make the best solution worse
+  clocksolver_result_t integer;
+  clocksolver_solve_divwrap(125e6, 2400e3, &params, &integer);
+  params.frac_div = true;
+  TEST_ASSERT_TRUE(clocksolver_solve_divwrap(125e6, 2400e3, &params, &r));
+  TEST_ASSERT_TRUE(r.error_ns <= integer.error_ns);
+}
+
+static int runUnityTests_clocksolver(void) {
+  UnityBegin("CLOCKSOLVER");
+  RUN_TEST(test_clocksolver_divwrap);
+  RUN_TEST(test_clocksolver_solve);
+  RUN_TEST(test_clocksolver_frac_div);
+  return UNITY_END();
+}
@@ -0,0 +1,125 @@
+#include "dlog.h"
+#include "unity.h"
+#include <stdio.h>
+
+// Stand in for the global logger defined in src/dshot.c
+dlog_t dlog;
+
+/**
+ * @brief Records are popped in the order they were pushed,
+ * with their format id, sequence number and arguments intact
+ */
+static void test_dlog_push_pop(void) {
+  dlog_t log;
+  dlog_init(&log);
+
+  TEST_ASSERT_TRUE(dlog_push(&log, DLOG_ONEWIRE_OVERFLOW, 11, 0, 0));
+  TEST_ASSERT_TRUE(dlog_push(&log, DLOG_ONEWIRE_BUFFER_IDX, 3, 0xdead, 0xbeef));
+
+  dlog_record_t record;
+  TEST_ASSERT_TRUE(dlog_pop(&log, &record));
+  TEST_ASSERT_EQUAL(DLOG_ONEWIRE_OVERFLOW, record.id);
+  TEST_ASSERT_EQUAL(0, record.seq);
+  TEST_ASSERT_EQUAL(11, record.args[0]);
+
+  TEST_ASSERT_TRUE(dlog_pop(&log, &record));
+  TEST_ASSERT_EQUAL(DLOG_ONEWIRE_BUFFER_IDX, record.id);
+  TEST_ASSERT_EQUAL(1, record.seq);
+  TEST_ASSERT_EQUAL(3, record.args[0]);
+  TEST_ASSERT_EQUAL(0xdead, record.args[1]);
+  TEST_ASSERT_EQUAL(0xbeef, record.args[2]);
+
+  TEST_ASSERT_FALSE(dlog_pop(&log, &record));
+}
+
+/**
+ * @brief A full ring drops new records and counts them.
+ * The drop count is only reported once.
+ */
+static void test_dlog_dropped(void) {
+  dlog_t log;
+  dlog_init(&log);
+
+  for (uint32_t i = 0; i < DLOG_RING_SIZE; ++i) {
+    TEST_ASSERT_TRUE(dlog_push(&log, DLOG_ONEWIRE_OVERFLOW, i, 0, 0));
+  }
+  TEST_ASSERT_FALSE(dlog_push(&log, DLOG_ONEWIRE_OVERFLOW, 0, 0, 0));
+  TEST_ASSERT_FALSE(dlog_push(&log, DLOG_ONEWIRE_OVERFLOW, 0, 0, 0));
+  TEST_ASSERT_EQUAL(2, dlog_take_dropped(&log));
+  TEST_ASSERT_EQUAL(0, dlog_take_dropped(&log));
+
+  // Popping a record frees a slot
+  dlog_record_t record;
+  TEST_ASSERT_TRUE(dlog_pop(&log, &record));
+  TEST_ASSERT_EQUAL(0, record.args[0]);
+  TEST_ASSERT_TRUE(dlog_push(&log, DLOG_ONEWIRE_OVERFLOW, 99, 0, 0));
+}
+
+/**
+ * @brief A slot that has been claimed but not committed (i.e. the producer
+ * was preempted) blocks the consumer until it is committed
+ */
+static void test_dlog_uncommitted_slot(void) {
+  dlog_t log;
+  dlog_init(&log);
+
+  // Simulate a producer that claimed slot 0 and was preempted
+  log.head = 1;
+  TEST_ASSERT_TRUE(dlog_push(&log, DLOG_DSHOT_TELEM_REQ, 48, 0, 0));
+
+  dlog_record_t record;
+  TEST_ASSERT_FALSE(dlog_pop(&log, &record));
+
+  // Producer resumes and commits slot 0
+  log.ring[0].args[0] = 7;
+  log.ring[0].id = DLOG_ONEWIRE_OVERFLOW;
+  TEST_ASSERT_TRUE(dlog_pop(&log, &record));
+  TEST_ASSERT_EQUAL(DLOG_ONEWIRE_OVERFLOW, record.id);
+  TEST_ASSERT_TRUE(dlog_pop(&log, &record));
+  TEST_ASSERT_EQUAL(DLOG_DSHOT_TELEM_REQ, record.id);
+}
+
+/**
+ * @brief The global DLOG macro pads missing arguments with 0
+ */
+static void test_dlog_macro(void) {
+  dlog_init(&dlog);
+  DLOG(DLOG_DSHOT_TELEM_REQ, 1046);
+  DLOG(DLOG_ONEWIRE_BUFFER_IDX, 1, 2, 3);
+
+  dlog_record_t record;
+  TEST_ASSERT_TRUE(dlog_pop(&dlog, &record));
+  TEST_ASSERT_EQUAL(1046, record.args[0]);
+  TEST_ASSERT_EQUAL(0, record.args[1]);
+  TEST_ASSERT_EQUAL(0, record.args[2]);
+  TEST_ASSERT_TRUE(dlog_pop(&dlog, &record));
+  TEST_ASSERT_EQUAL(3, record.args[2]);
+}
+
+/**
+ * @brief Encoded records are little endian and prefixed with the sync word
+ */
+static void test_dlog_record_encode(void) {
+  const dlog_record_t record = {.id = DLOG_ONEWIRE_OVERFLOW,
+                                .seq = 0x0102,
+                                .timestamp_us = 0x03040506,
+                                .args = {0x0708090a, 0, 0xffffffff}};
+  uint8_t wire[DLOG_WIRE_SIZE];
+  dlog_record_encode(&record, wire);
+
+  const uint8_t expected[DLOG_WIRE_SIZE] = {
+      0x0c, 0xd1, DLOG_ONEWIRE_OVERFLOW, 0x00, 0x02, 0x01, 0x06, 0x05,
+      0x04, 0x03, 0x0a, 0x09, 0x08, 0x07, 0x00, 0x00, 0x00, 0x00,
+      0xff, 0xff, 0xff, 0xff};
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, wire, DLOG_WIRE_SIZE);
+}
+
+static int runUnityTests_dlog(void) {
+  UnityBegin("DLOG");
+  RUN_TEST(test_dlog_push_pop);
+  RUN_TEST(test_dlog_dropped);
+  RUN_TEST(test_dlog_uncommitted_slot);
+  RUN_TEST(test_dlog_macro);
+  RUN_TEST(test_dlog_record_encode);
+  return UNITY_END();
+}
@@ -0,0 +1,192 @@
+#include "dma_model.hpp"
+#include "dmachain.h"
+#include "unity.h"
+
+// Layout of the model's sram
+#define DMACHAIN_TEST_BLOCKS (DMA_MODEL_SRAM_BASE + 0x100)
+#define DMACHAIN_TEST_PACKETS (DMA_MODEL_SRAM_BASE + 0x800)
+#define DMACHAIN_TEST_PACKET_BYTES 0x40
+#define DMACHAIN_TEST_TAIL (DMA_MODEL_SRAM_BASE + 0xc00)
+#define DMACHAIN_TEST_FRAME 16
+
+static const int dmachain_test_slices[] = {3, 0, 6};
+// Packets of 17, 19 and 21 pulses
+static const uint32_t dmachain_test_tails[] = {1, 3, 5};
+
+/// @brief pulse \a i of the frame of motor \a m
+static uint16_t dmachain_test_pulse(const int m, const int i,
+                                    const uint32_t round) {
+  return (uint16_t)(round << 12 | (uint32_t)m << 8 | (uint32_t)i);
+}
+
+/// @brief frames as 16 bit pulses (the shared tail is zeroed sram)
+static void dmachain_test_fill(dma_model &model, const uint32_t round) {
+  for (int m = 0; m < 3; ++m) {
+    for (int i = 0; i < DMACHAIN_TEST_FRAME; ++i) {
+      model.write(DMACHAIN_TEST_PACKETS + m * DMACHAIN_TEST_PACKET_BYTES +
+                      i * 2,
+                  dmachain_test_pulse(m, i, round), 2);
+    }
+  }
+}
+
+/// @brief copy the blocks to the model, as the cpu would build them in sram
+static void dmachain_test_load(dma_model &model, const dmachain_t &chain) {
+  for (int b = 0; b <= DMACHAIN_MOTOR_BLOCKS * chain.motors; ++b) {
+    const dmachain_block_t &block = chain.blocks[b];
+    const uint32_t addr = DMACHAIN_TEST_BLOCKS + b * DMACHAIN_BLOCK_BYTES;
+    model.write(addr + 0, block.ctrl);
+    model.write(addr + 4, block.read_addr);
+    model.write(addr + 8, block.write_addr);
+    model.write(addr + 12, block.count);
+  }
+}
+
+/// @brief program the control channel and start a round (see dshot_chain)
+static void dmachain_test_start(dma_model &model, const dmachain_t &chain) {
+  const int ctrl = chain.ctrl_channel;
+  model.write(dma_model_reg(ctrl, DMA_MODEL_WRITE_ADDR),
+              dma_model_reg(chain.data_channel, DMA_MODEL_AL1_CTRL));
+  model.write(dma_model_reg(ctrl, DMA_MODEL_TRANS_COUNT),
+              dmachain_ctrl_count());
+  model.write(dma_model_reg(ctrl, DMA_MODEL_AL1_CTRL),
+              dmachain_ctrl_ctrl(&chain));
+  model.write(dma_model_reg(ctrl, DMA_MODEL_AL3_READ_ADDR_TRIG),
+              DMACHAIN_TEST_BLOCKS);
+}
+
+static void dmachain_test_build(dmachain_t &chain) {
+  dmachain_init(&chain, 5, 9);
+  for (int m = 0; m < 3; ++m) {
+    TEST_ASSERT_EQUAL(
+        m, dmachain_add(&chain,
+                        DMACHAIN_TEST_PACKETS + m * DMACHAIN_TEST_PACKET_BYTES,
+                        dma_model_pwm_cc(dmachain_test_slices[m]),
+                        DMACHAIN_TEST_FRAME, DMACHAIN_TEST_TAIL,
+                        dmachain_test_tails[m],
+                        DMA_MODEL_DREQ_PWM_WRAP0 + dmachain_test_slices[m]));
+  }
+}
+
+/**
+ * @brief every motor got its frame then its pause, in order, one pulse per
+ * wrap. Each 16 bit pulse fills both halves of the counter compare, so
+ * it reaches the motor's channel whether it is A or B
+ */
+static void dmachain_test_check(const dma_model &model, const uint32_t round,
+                                const uint32_t first_tick) {
+  uint32_t tick = first_tick;
+  for (int m = 0; m < 3; ++m) {
+    const std::vector<dma_model_pwm_write> &log =
+        model.pwm[dmachain_test_slices[m]];
+    const uint32_t count = DMACHAIN_TEST_FRAME + dmachain_test_tails[m];
+    TEST_ASSERT_TRUE(log.size() >= count);
+    const size_t start = log.size() - count;
+    for (uint32_t i = 0; i < count; ++i) {
+      const uint32_t pulse =
+          i < DMACHAIN_TEST_FRAME ? dmachain_test_pulse(m, i, round) : 0;
+      TEST_ASSERT_EQUAL_HEX32(pulse << 16 | pulse, log[start + i].value);
+      TEST_ASSERT_EQUAL(++tick, log[start + i].tick);
+    }
+  }
+}
+
+/**
+ * @brief Two channels send the packets of all motors, and a null block
+ * ends the chain with an irq
+ */
+static void test_dmachain_round(void) {
+  dmachain_t chain;
+  dmachain_test_build(chain);
+  TEST_ASSERT_EQUAL(3, chain.motors);
+  TEST_ASSERT_EQUAL(57, dmachain_pulses(&chain));
+  TEST_ASSERT_EQUAL(0, chain.blocks[3 * DMACHAIN_MOTOR_BLOCKS].count);
+
+  dma_model model;
+  dmachain_test_load(model, chain);
+  dmachain_test_fill(model, 1);
+  dmachain_test_start(model, chain);
+  TEST_ASSERT_TRUE(model.run(1000));
+  TEST_ASSERT_FALSE(model.fault);
+  dmachain_test_check(model, 1, 0);
+  TEST_ASSERT_EQUAL(57, model.tick);
+  // Only the end of the chain raises the irq
+  TEST_ASSERT_EQUAL_HEX32(1u << chain.data_channel, model.irq);
+  // 57 pulses + 7 control blocks (frame and pause per motor, null) of 4
+  // words
+  TEST_ASSERT_EQUAL(57 + 7 * 4, model.transfers);
+  // Every motor read the same tail, which stays zero
+  TEST_ASSERT_EQUAL_HEX32(0, model.read(DMACHAIN_TEST_TAIL));
+  // The control channel's write ring is back at the start of alias 1
+  TEST_ASSERT_EQUAL_HEX32(
+      dma_model_reg(chain.data_channel, DMA_MODEL_AL1_CTRL),
+      model.ch[chain.ctrl_channel].write_addr);
+}
+
+/**
+ * @brief Per frame, only the packet data (and counts) change: restarting
+ * the control channel at the first block sends the next round
+ */
+static void test_dmachain_next_round(void) {
+  dmachain_t chain;
+  dmachain_test_build(chain);
+  dma_model model;
+  dmachain_test_load(model, chain);
+  dmachain_test_fill(model, 1);
+  dmachain_test_start(model, chain);
+  TEST_ASSERT_TRUE(model.run(1000));
+
+  dmachain_test_fill(model, 2);
+  model.irq = 0;
+  const uint32_t first_tick = model.tick;
+  model.write(dma_model_reg(chain.ctrl_channel, DMA_MODEL_AL3_READ_ADDR_TRIG),
+              DMACHAIN_TEST_BLOCKS);
+  TEST_ASSERT_TRUE(model.run(1000));
+  dmachain_test_check(model, 2, first_tick);
+  TEST_ASSERT_EQUAL_HEX32(1u << chain.data_channel, model.irq);
+
+  // A shorter pause (e.g. a speed change) only updates its tail block
+  dmachain_set_tail(&chain, 1, 2);
+  TEST_ASSERT_EQUAL(56, dmachain_pulses(&chain));
+  dmachain_test_load(model, chain);
+  model.write(dma_model_reg(chain.ctrl_channel, DMA_MODEL_AL3_READ_ADDR_TRIG),
+              DMACHAIN_TEST_BLOCKS);
+  const size_t slice_writes = model.pwm[dmachain_test_slices[1]].size();
+  TEST_ASSERT_TRUE(model.run(1000));
+  TEST_ASSERT_EQUAL(slice_writes + 18,
+                    model.pwm[dmachain_test_slices[1]].size());
+}
+
+/**
+ * @brief A full chain rejects motors, and an empty chain is only the null
+ * block
+ */
+static void test_dmachain_limits(void) {
+  dmachain_t chain;
+  dmachain_init(&chain, 0, 1);
+  TEST_ASSERT_EQUAL(0, dmachain_pulses(&chain));
+  dma_model model;
+  dmachain_test_load(model, chain);
+  dmachain_test_start(model, chain);
+  TEST_ASSERT_TRUE(model.run(10));
+  TEST_ASSERT_EQUAL(0, model.tick);
+  TEST_ASSERT_EQUAL_HEX32(1u << chain.data_channel, model.irq);
+
+  // An empty frame or pause would be a null trigger, ending the chain
+  TEST_ASSERT_EQUAL(-1, dmachain_add(&chain, 0, 0, 16, 0, 0, 0));
+  TEST_ASSERT_EQUAL(-1, dmachain_add(&chain, 0, 0, 0, 0, 1, 0));
+  for (int m = 0; m < DMACHAIN_MAX_MOTORS; ++m) {
+    TEST_ASSERT_EQUAL(m, dmachain_add(&chain, 0, 0, 16, 0, 1, 0));
+  }
+  TEST_ASSERT_EQUAL(-1, dmachain_add(&chain, 0, 0, 16, 0, 1, 0));
+  TEST_ASSERT_EQUAL(0, (uintptr_t)chain.blocks % DMACHAIN_BLOCK_BYTES);
+  TEST_ASSERT_EQUAL(DMACHAIN_BLOCK_BYTES, sizeof(dmachain_block_t));
+}
+
+static int runUnityTests_dmachain(void) {
+  UnityBegin("DMACHAIN");
+  RUN_TEST(test_dmachain_round);
+  RUN_TEST(test_dmachain_next_round);
+  RUN_TEST(test_dmachain_limits);
+  return UNITY_END();
+}
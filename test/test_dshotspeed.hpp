@@ -0,0 +1,102 @@
+#include "dshotspeed.h"
+#include "unity.h"
+#include <stdio.h>
+
+/**
+ * @brief The table matches the float computation of dshot_config_init
+ * at the default 125 MHz clock
+ */
+static void test_dshotspeed_table(void) {
+  dshot_speed_entry_t table[DSHOT_SPEEDS];
+  dshot_speed_table_init(table, 125000, DSHOT_PAUSE_NS_DEFAULT);
+
+  for (int s = 0; s < DSHOT_SPEEDS; ++s) {
+    const float period = 125000.0f / dshot_speed_khz_table[s];
+    const uint16_t top = (uint16_t)(period + 0.5f) - 1;
+    TEST_ASSERT_EQUAL(dshot_speed_khz_table[s], table[s].speed_khz);
+    TEST_ASSERT_EQUAL(top, table[s].top);
+    TEST_ASSERT_EQUAL(1 << DSHOT_SPEED_DIV_FRAC_BITS, table[s].div);
+    TEST_ASSERT_EQUAL((uint16_t)(0.75 * (top + 1) + 0.5),
+                      table[s].pulse_high);
+    TEST_ASSERT_EQUAL((uint16_t)(0.37 * (top + 1) + 0.5), table[s].pulse_low);
+  }
+  // 833.3 and 104.2 counts per bit: the period is top + 1 counts
+  TEST_ASSERT_EQUAL(832, table[DSHOT150].top);
+  TEST_ASSERT_EQUAL(103, table[DSHOT1200].top);
+  // 52.08 counts: 52 x 8 ns = 416 ns, 39 (312 ns) and 19 (152 ns) high
+  TEST_ASSERT_EQUAL(51, table[DSHOT2400].top);
+  TEST_ASSERT_EQUAL(39, table[DSHOT2400].pulse_high);
+  TEST_ASSERT_EQUAL(19, table[DSHOT2400].pulse_low);
+}
+
+/**
+ * @brief Periods longer than 16 bits max out the wrap and divide the clock
+ */
+static void test_dshotspeed_divider(void) {
+  dshot_speed_entry_t entry;
+  // 200 MHz / 1 khz = 200000 counts = 65536 x 3.0518
+  dshot_speed_entry_compute(&entry, 200000, 1, DSHOT_PAUSE_NS_DEFAULT);
+  TEST_ASSERT_EQUAL(65535, entry.top);
+  // 3.0518 in 8.4 fixed point, rounded down (like pwm_config_set_clkdiv)
+  TEST_ASSERT_EQUAL(48, entry.div);
+}
+
+/**
+ * @brief The packet interval must fit the frame and the pause
+ */
+static void test_dshotspeed_interval(void) {
+  dshot_speed_entry_t entry;
+  // The original 4 bit pause: 20 bits / 150 khz = 133.3 us
+  TEST_ASSERT_TRUE(dshot_speed_entry_compute(&entry, 125000, 150, 26666));
+  TEST_ASSERT_EQUAL(4, entry.pause_pulses);
+  TEST_ASSERT_EQUAL(134, entry.min_interval_us);
+  TEST_ASSERT_FALSE(dshot_speed_interval_valid(&entry, 133));
+  TEST_ASSERT_TRUE(dshot_speed_interval_valid(&entry, 134));
+
+  TEST_ASSERT_EQUAL(DSHOT600, dshot_speed_from_khz(600.0f));
+  TEST_ASSERT_EQUAL(DSHOT_SPEEDS, dshot_speed_from_khz(450.0f));
+}
+
+/**
+ * @brief A 2 us pause is rounded up to whole pulses at each speed
+ */
+static void test_dshotspeed_pause(void) {
+  dshot_speed_entry_t table[DSHOT_SPEEDS];
+  TEST_ASSERT_TRUE(
+      dshot_speed_table_init(table, 125000, DSHOT_PAUSE_NS_DEFAULT));
+  // 0.3 bits, but the line must return low: 17 bits / 150 khz = 113.3 us
+  TEST_ASSERT_EQUAL(1, table[DSHOT150].pause_pulses);
+  TEST_ASSERT_EQUAL(114, table[DSHOT150].min_interval_us);
+  TEST_ASSERT_EQUAL(8823, table[DSHOT150].max_rate_hz);
+  // 2.4 bits: 19 bits / 1200 khz = 15.8 us
+  TEST_ASSERT_EQUAL(3, table[DSHOT1200].pause_pulses);
+  TEST_ASSERT_EQUAL(16, table[DSHOT1200].min_interval_us);
+  TEST_ASSERT_EQUAL(63157, table[DSHOT1200].max_rate_hz);
+  // 4.8 bits: more than the original 4 pulses (1.67 us) at DShot2400
+  TEST_ASSERT_EQUAL(5, table[DSHOT2400].pause_pulses);
+  TEST_ASSERT_EQUAL(9, table[DSHOT2400].min_interval_us);
+  TEST_ASSERT_EQUAL(114285, table[DSHOT2400].max_rate_hz);
+
+  TEST_ASSERT_EQUAL(1, dshot_pause_pulses(0, 600));
+  // 9.6 pulses at DShot2400 don't fit the packet buffer: that speed is
+  // unavailable, the slower ones still hold the pause
+  TEST_ASSERT_FALSE(dshot_speed_table_init(table, 125000, 4000));
+  TEST_ASSERT_FALSE(dshot_speed_entry_available(&table[DSHOT2400]));
+  TEST_ASSERT_FALSE(dshot_speed_interval_valid(&table[DSHOT2400], 1000));
+  TEST_ASSERT_TRUE(dshot_speed_entry_available(&table[DSHOT1200]));
+  TEST_ASSERT_EQUAL(5, table[DSHOT1200].pause_pulses);
+  // Until the pause is shortened again
+  TEST_ASSERT_TRUE(
+      dshot_speed_entry_set_pause(&table[DSHOT2400], DSHOT_PAUSE_NS_DEFAULT));
+  TEST_ASSERT_TRUE(dshot_speed_entry_available(&table[DSHOT2400]));
+  TEST_ASSERT_EQUAL(5, table[DSHOT2400].pause_pulses);
+}
+
+static int runUnityTests_dshotspeed(void) {
+  UnityBegin("DSHOTSPEED");
+  RUN_TEST(test_dshotspeed_table);
+  RUN_TEST(test_dshotspeed_divider);
+  RUN_TEST(test_dshotspeed_interval);
+  RUN_TEST(test_dshotspeed_pause);
+  return UNITY_END();
+}
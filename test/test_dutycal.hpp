@@ -0,0 +1,189 @@
+#include "dutycal.h"
+#include "unity.h"
+
+/**
+ * @brief Duties convert from ns and round to pwm counts
+ */
+static void test_dshotduty_pulses(void) {
+  dshot_duty_t duty;
+  // DShot1200: 625 ns and 308 ns of 833 ns
+  TEST_ASSERT_TRUE(dshot_duty_from_ns(&duty, 625, 308, 1200));
+  TEST_ASSERT_EQUAL(750, duty.t1h);
+  TEST_ASSERT_EQUAL(370, duty.t0h);
+  TEST_ASSERT_EQUAL(625, dshot_duty_to_ns(duty.t1h, 1200));
+  TEST_ASSERT_FALSE(dshot_duty_from_ns(&duty, 900, 308, 1200));
+
+  uint16_t high;
+  uint16_t low;
+  // 104 counts
+  TEST_ASSERT_TRUE(dshot_duty_pulses(&dshot_duty_default, 103, &high, &low));
+  TEST_ASSERT_EQUAL(78, high);
+  TEST_ASSERT_EQUAL(38, low);
+  // 8 counts: 4 and 3.6 round to the same pulse
+  const dshot_duty_t close = {500, 450};
+  TEST_ASSERT_FALSE(dshot_duty_pulses(&close, 7, &high, &low));
+  // 1 count: a 1 would never go low
+  TEST_ASSERT_FALSE(dshot_duty_pulses(&dshot_duty_default, 0, &high, &low));
+
+  const dshot_duty_t unpacked =
+      dshot_duty_unpack(dshot_duty_pack(&dshot_duty_default));
+  TEST_ASSERT_EQUAL(750, unpacked.t1h);
+  TEST_ASSERT_EQUAL(370, unpacked.t0h);
+  TEST_ASSERT_TRUE(dshot_duty_pack(&dshot_duty_default) != 0);
+}
+
+/**
+ * @brief simulated ESC: decodes DShot600 and slower within a duty window
+ */
+static bool dutycal_test_esc(const enum dshot_speed speed,
+                             const dshot_duty_t duty) {
+  return speed <= DSHOT600 && duty.t1h >= 650 && duty.t1h <= 800 &&
+         duty.t0h >= 300 && duty.t0h <= 400;
+}
+
+/**
+ * @brief run a calibration against the simulated ESC
+ *
+ * @return true if no requests were spent at DShot2400
+ */
+static bool dutycal_test_run(dutycal_t *const cal) {
+  bool dshot2400_skipped = true;
+  uint32_t requests = 0;
+  for (int i = 0; i < 100000 && !dutycal_done(cal); ++i) {
+    const enum dshot_speed speed = dutycal_speed(cal);
+    const dshot_duty_t duty = dutycal_duty(cal);
+    dshot2400_skipped &= speed != DSHOT2400;
+    requests++;
+    if (dutycal_test_esc(speed, duty)) {
+      telem_sample_t sample = {};
+      dutycal_reply(cal, &sample);
+    }
+    dutycal_poll(cal, requests);
+  }
+  return dshot2400_skipped;
+}
+
+static const uint8_t dutycal_test_speeds[] = {DSHOT2400, DSHOT1200,
+                                              DSHOT600, DSHOT300};
+
+static dutycal_config_t dutycal_test_config(void) {
+  dutycal_config_t config = {};
+  config.speeds = dutycal_test_speeds;
+  config.speed_count = 4;
+  config.t1h_min = 600;
+  config.t1h_max = 850;
+  config.t1h_step = 50;
+  config.t0h_min = 250;
+  config.t0h_max = 450;
+  config.t0h_step = 50;
+  config.settle_requests = 2;
+  config.requests = 20;
+  config.accept_permille = 900;
+  return config;
+}
+
+/**
+ * @brief The fastest accepted speed wins, at the point with most margin
+ */
+static void test_dutycal_calibrate(void) {
+  const dutycal_config_t config = dutycal_test_config();
+  dshot_speed_entry_t table[DSHOT_SPEEDS];
+  dshot_speed_table_init(table, 125000, DSHOT_PAUSE_NS_DEFAULT);
+  dutycal_t cal;
+  TEST_ASSERT_TRUE(dutycal_start(&cal, &config, table, 0));
+  TEST_ASSERT_EQUAL(DSHOT2400, dutycal_speed(&cal));
+  TEST_ASSERT_EQUAL(600, dutycal_duty(&cal).t1h);
+  TEST_ASSERT_EQUAL(250, dutycal_duty(&cal).t0h);
+
+  dutycal_test_run(&cal);
+  TEST_ASSERT_TRUE(dutycal_done(&cal));
+  TEST_ASSERT_TRUE(cal.found);
+  TEST_ASSERT_EQUAL(DSHOT600, dutycal_speed(&cal));
+  // 4 x 3 accepted; 700 and 750 x 350 are fully surrounded, 750 is closer
+  // to the default
+  TEST_ASSERT_EQUAL(12, cal.accepted);
+  TEST_ASSERT_EQUAL(8, cal.margin);
+  TEST_ASSERT_EQUAL(750, dutycal_duty(&cal).t1h);
+  TEST_ASSERT_EQUAL(350, dutycal_duty(&cal).t0h);
+  // Valid replies per 1000 requests: 600 / 250 is outside the window
+  TEST_ASSERT_EQUAL(0, cal.rate[0]);
+  TEST_ASSERT_EQUAL(1000, cal.rate[3 * 5 + 2]);
+}
+
+/**
+ * @brief Points that don't resolve are skipped, and a calibration that
+ * accepts nothing falls back to the defaults
+ */
+static void test_dutycal_skip_and_fail(void) {
+  dutycal_config_t config = dutycal_test_config();
+  dshot_speed_entry_t table[DSHOT_SPEEDS];
+  // 4.8 MHz: DShot2400 is 2 counts per bit, so no duty resolves
+  dshot_speed_table_init(table, 4800, DSHOT_PAUSE_NS_DEFAULT);
+  dutycal_t cal;
+  TEST_ASSERT_TRUE(dutycal_start(&cal, &config, table, 0));
+  TEST_ASSERT_EQUAL(DSHOT1200, dutycal_speed(&cal));
+  TEST_ASSERT_TRUE(dutycal_test_run(&cal));
+  TEST_ASSERT_TRUE(cal.found);
+  TEST_ASSERT_EQUAL(DSHOT600, dutycal_speed(&cal));
+
+  // Nothing faster than DShot600 decodes
+  config.speed_count = 2;
+  TEST_ASSERT_TRUE(dutycal_start(&cal, &config, table, 0));
+  dutycal_test_run(&cal);
+  TEST_ASSERT_TRUE(dutycal_done(&cal));
+  TEST_ASSERT_FALSE(cal.found);
+  TEST_ASSERT_EQUAL(DSHOT1200, dutycal_speed(&cal));
+  TEST_ASSERT_EQUAL(dshot_duty_default.t1h, dutycal_duty(&cal).t1h);
+
+  // Grids larger than DUTYCAL_MAX_POINTS are rejected
+  config.t0h_step = 10;
+  TEST_ASSERT_FALSE(dutycal_start(&cal, &config, table, 0));
+}
+
+/**
+ * @brief Unavailable speeds and refused speeds or points are skipped
+ * without being measured
+ */
+static void test_dutycal_unavailable(void) {
+  const dutycal_config_t config = dutycal_test_config();
+  dshot_speed_entry_t table[DSHOT_SPEEDS];
+  dshot_speed_table_init(table, 125000, DSHOT_PAUSE_NS_DEFAULT);
+  // A pause too long for DShot2400 and DShot1200 to hold
+  dshot_speed_entry_set_pause(&table[DSHOT2400], 1000000);
+  dshot_speed_entry_set_pause(&table[DSHOT1200], 1000000);
+  dutycal_t cal;
+  TEST_ASSERT_TRUE(dutycal_start(&cal, &config, table, 0));
+  TEST_ASSERT_EQUAL(DSHOT600, dutycal_speed(&cal));
+  TEST_ASSERT_TRUE(dutycal_speed_skipped(&cal, DSHOT2400));
+  TEST_ASSERT_TRUE(dutycal_speed_skipped(&cal, DSHOT1200));
+  TEST_ASSERT_FALSE(dutycal_speed_skipped(&cal, DSHOT600));
+
+  // The motor refuses the first point, then the whole speed
+  dutycal_skip_point(&cal, 0);
+  TEST_ASSERT_EQUAL(DUTYCAL_RATE_INVALID, cal.rate[0]);
+  TEST_ASSERT_EQUAL(1, cal.point);
+  TEST_ASSERT_EQUAL(DSHOT600, dutycal_speed(&cal));
+  dutycal_skip_speed(&cal, 0);
+  TEST_ASSERT_TRUE(dutycal_speed_skipped(&cal, DSHOT600));
+  TEST_ASSERT_EQUAL(DSHOT300, dutycal_speed(&cal));
+  TEST_ASSERT_EQUAL(0, cal.point);
+
+  dutycal_test_run(&cal);
+  TEST_ASSERT_TRUE(cal.found);
+  TEST_ASSERT_EQUAL(DSHOT300, dutycal_speed(&cal));
+
+  // No speed of the config is available
+  dutycal_config_t fast = config;
+  fast.speed_count = 2;
+  TEST_ASSERT_FALSE(dutycal_config_valid(&fast, table));
+  TEST_ASSERT_FALSE(dutycal_start(&cal, &fast, table, 0));
+}
+
+static int runUnityTests_dutycal(void) {
+  UnityBegin("DUTYCAL");
+  RUN_TEST(test_dshotduty_pulses);
+  RUN_TEST(test_dutycal_calibrate);
+  RUN_TEST(test_dutycal_skip_and_fail);
+  RUN_TEST(test_dutycal_unavailable);
+  return UNITY_END();
+}
@@ -0,0 +1,94 @@
+#include "energy.h"
+#include "unity.h"
+#include <stdio.h>
+
+/**
+ * @brief Constant power over irregular intervals, and a linear current
+ * ramp, are integrated exactly by the trapezoidal rule
+ */
+static void test_energy_trapezoid(void) {
+  energy_integrator_t integ;
+  energy_init(&integ, 10000);
+
+  // 12 V, 10 A = 120 W for 1 ms + 2.5 ms
+  energy_update_raw(&integ, 1200, 1000, 1000);
+  energy_update_raw(&integ, 1200, 1000, 2000);
+  energy_update_raw(&integ, 1200, 1000, 4500);
+  TEST_ASSERT_EQUAL(420, energy_to_mj(integ.energy)); // 120 W x 3.5 ms
+  TEST_ASSERT_EQUAL(35, charge_to_mc(integ.charge));  // 10 A x 3.5 ms
+  TEST_ASSERT_EQUAL(3500, integ.covered_us);
+
+  // 10 A -> 30 A at 10 V over 5 ms = 20 A mean: 1000 mJ, 100 mC
+  energy_init(&integ, 10000);
+  energy_update_raw(&integ, 1000, 1000, 0);
+  energy_update_raw(&integ, 1000, 3000, 5000);
+  TEST_ASSERT_EQUAL(1000 * ENERGY_UNITS_PER_MJ, integ.energy);
+  TEST_ASSERT_EQUAL(100 * CHARGE_UNITS_PER_MC, integ.charge);
+}
+
+/**
+ * @brief Intervals across the u32 timer wrap around are integrated, while
+ * gaps and backwards timestamps are skipped and counted
+ */
+static void test_energy_wrap_and_gaps(void) {
+  energy_integrator_t integ;
+  energy_init(&integ, 2000);
+
+  // 1 V, 1 A = 1 W
+  energy_update_raw(&integ, 100, 100, UINT32_MAX - 499);
+  energy_update_raw(&integ, 100, 100, 500);
+  TEST_ASSERT_EQUAL(1000, integ.covered_us);
+  TEST_ASSERT_EQUAL(10000000, integ.energy); // 1 W x 1 ms = 1 mJ
+
+  // Dropped samples: 5 ms since the last sample
+  energy_update_raw(&integ, 100, 100, 5500);
+  TEST_ASSERT_EQUAL(1, integ.gaps);
+  TEST_ASSERT_EQUAL(5000, integ.gap_us);
+  TEST_ASSERT_EQUAL(1000, integ.covered_us);
+
+  // Backwards, then integration resumes from the new sample
+  energy_update_raw(&integ, 100, 100, 5000);
+  TEST_ASSERT_EQUAL(2, integ.gaps);
+  TEST_ASSERT_EQUAL(5000, integ.gap_us);
+  energy_update_raw(&integ, 100, 100, 6000);
+  TEST_ASSERT_EQUAL(2000, integ.covered_us);
+  TEST_ASSERT_EQUAL(5, integ.samples);
+}
+
+/**
+ * @brief Energy of a step is read between two marks
+ */
+static void test_energy_step(void) {
+  energy_integrator_t integ;
+  energy_init(&integ, 2000);
+
+  kissesc_telem_t telem = {};
+  telem.centi_voltage = 1600;
+  telem.centi_current = 250;
+  energy_update(&integ, &telem, 0);
+  energy_update(&integ, &telem, 1000);
+
+  energy_mark_t mark;
+  energy_mark(&integ, &mark);
+
+  // 16 V: 2.5 A -> 5 A (60 W mean) for 1 ms, then 5 A (80 W) for 1 ms
+  telem.centi_current = 500;
+  for (uint32_t t = 2000; t <= 3000; t += 1000) {
+    energy_update(&integ, &telem, t);
+  }
+  energy_step_t step;
+  energy_since(&integ, &mark, &step);
+  TEST_ASSERT_EQUAL(2000, step.covered_us);
+  TEST_ASSERT_EQUAL(0, step.gap_us);
+  TEST_ASSERT_EQUAL(140, energy_to_mj(step.energy));
+  TEST_ASSERT_EQUAL(875 * CHARGE_UNITS_PER_MC / 100, step.charge);
+  TEST_ASSERT_EQUAL(70000, energy_step_mean_power_mw(&step));
+}
+
+static int runUnityTests_energy(void) {
+  UnityBegin("ENERGY");
+  RUN_TEST(test_energy_trapezoid);
+  RUN_TEST(test_energy_wrap_and_gaps);
+  RUN_TEST(test_energy_step);
+  return UNITY_END();
+}
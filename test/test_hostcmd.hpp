@@ -0,0 +1,184 @@
+#include "hostcmd.h"
+#include "unity.h"
+#include <stdio.h>
+
+/// @brief feed a buffer to the parser, return the number of valid frames
+static size_t hostcmd_feed_all(hostcmd_t *const cmd, const uint8_t bytes[],
+                               const size_t len) {
+  size_t frames = 0;
+  for (size_t i = 0; i < len; ++i) {
+    frames += hostcmd_feed(cmd, bytes[i]);
+  }
+  return frames;
+}
+
+/**
+ * @brief A throttle frame, preceded by noise, is applied to the packet at
+ * the next frame hook. Packets are left untouched before any vector arrives
+ */
+static void test_hostcmd_throttle(void) {
+  hostcmd_t cmd;
+  hostcmd_init(&cmd);
+
+  dshot_packet_t packet = {.throttle_code = 1, .telemetry = 0};
+  hostcmd_frame_hook(&packet, &cmd.motors[0]);
+  TEST_ASSERT_EQUAL(1, packet.throttle_code);
+
+  uint8_t frame[HOSTCMD_MAX_PAYLOAD + HOSTCMD_OVERHEAD + 3] = {0x00, 0xA5,
+                                                               0x13};
+  const uint8_t payload[] = {0x16, 0x04}; // 1046
+  const size_t len =
+      hostcmd_encode(HOSTCMD_THROTTLE, 0, payload, sizeof(payload), &frame[3]);
+  TEST_ASSERT_EQUAL(1, hostcmd_feed_all(&cmd, frame, len + 3));
+
+  hostcmd_frame_hook(&packet, &cmd.motors[0]);
+  TEST_ASSERT_EQUAL(1046, packet.throttle_code);
+  TEST_ASSERT_EQUAL(0, packet.telemetry);
+  TEST_ASSERT_EQUAL(1, cmd.frames);
+  TEST_ASSERT_EQUAL(0, cmd.crc_errors);
+}
+
+/**
+ * @brief Corrupt frames are dropped and counted, and the parser resyncs
+ * on the next frame
+ */
+static void test_hostcmd_crc_error(void) {
+  hostcmd_t cmd;
+  hostcmd_init(&cmd);
+
+  uint8_t frame[HOSTCMD_MAX_PAYLOAD + HOSTCMD_OVERHEAD];
+  const uint8_t payload[] = {100, 0};
+  const size_t len =
+      hostcmd_encode(HOSTCMD_THROTTLE, 0, payload, sizeof(payload), frame);
+
+  frame[5] ^= 0x01;
+  TEST_ASSERT_EQUAL(0, hostcmd_feed_all(&cmd, frame, len));
+  TEST_ASSERT_EQUAL(1, cmd.crc_errors);
+  TEST_ASSERT_FALSE(cmd.valid);
+
+  frame[5] ^= 0x01;
+  TEST_ASSERT_EQUAL(1, hostcmd_feed_all(&cmd, frame, len));
+  TEST_ASSERT_TRUE(cmd.valid);
+
+  // Oversized frames are rejected as soon as the length is read
+  const uint8_t oversize[] = {HOSTCMD_SYNC0, HOSTCMD_SYNC1,
+                              HOSTCMD_MAX_PAYLOAD + 1};
+  TEST_ASSERT_EQUAL(0, hostcmd_feed_all(&cmd, oversize, sizeof(oversize)));
+  TEST_ASSERT_EQUAL(1, cmd.bad_frames);
+  TEST_ASSERT_EQUAL(1, hostcmd_feed_all(&cmd, frame, len));
+}
+
+/**
+ * @brief Missing sequence numbers are counted as gaps
+ */
+static void test_hostcmd_seq_gaps(void) {
+  hostcmd_t cmd;
+  hostcmd_init(&cmd);
+
+  uint8_t frame[HOSTCMD_MAX_PAYLOAD + HOSTCMD_OVERHEAD];
+  const uint8_t payload[] = {48, 0};
+  const uint8_t seqs[] = {254, 255, 2, 3};
+  for (const auto seq : seqs) {
+    const size_t len =
+        hostcmd_encode(HOSTCMD_THROTTLE, seq, payload, sizeof(payload), frame);
+    hostcmd_feed_all(&cmd, frame, len);
+  }
+  TEST_ASSERT_EQUAL(4, cmd.frames);
+  TEST_ASSERT_EQUAL(2, cmd.seq_gaps);
+}
+
+/**
+ * @brief A special command is sent with the telemetry bit, repeat times,
+ * then the motor resumes its throttle code
+ */
+static void test_hostcmd_special(void) {
+  hostcmd_t cmd;
+  hostcmd_init(&cmd);
+
+  uint8_t frame[HOSTCMD_MAX_PAYLOAD + HOSTCMD_OVERHEAD];
+  const uint8_t throttle[] = {200, 0};
+  size_t len =
+      hostcmd_encode(HOSTCMD_THROTTLE, 0, throttle, sizeof(throttle), frame);
+  hostcmd_feed_all(&cmd, frame, len);
+
+  const uint8_t special[] = {HOSTCMD_ALL_ESCS, 1, 2}; // beep twice
+  len = hostcmd_encode(HOSTCMD_SPECIAL, 1, special, sizeof(special), frame);
+  TEST_ASSERT_EQUAL(1, hostcmd_feed_all(&cmd, frame, len));
+
+  dshot_packet_t packet = {.throttle_code = 0, .telemetry = 0};
+  for (int i = 0; i < 2; ++i) {
+    hostcmd_frame_hook(&packet, &cmd.motors[0]);
+    TEST_ASSERT_EQUAL(1, packet.throttle_code);
+    TEST_ASSERT_EQUAL(1, packet.telemetry);
+    packet.telemetry = 0; // reset by dshot_send_packet
+  }
+  hostcmd_frame_hook(&packet, &cmd.motors[0]);
+  TEST_ASSERT_EQUAL(200, packet.throttle_code);
+  TEST_ASSERT_EQUAL(0, packet.telemetry);
+
+  // Throttle codes are not special commands
+  const uint8_t invalid[] = {0, HOSTCMD_SPECIAL_CMD_LIMIT, 1};
+  len = hostcmd_encode(HOSTCMD_SPECIAL, 2, invalid, sizeof(invalid), frame);
+  TEST_ASSERT_EQUAL(0, hostcmd_feed_all(&cmd, frame, len));
+  TEST_ASSERT_EQUAL(1, cmd.bad_frames);
+}
+
+/**
+ * @brief The telemetry configuration is handed to the application once
+ */
+static void test_hostcmd_telem_config(void) {
+  hostcmd_t cmd;
+  hostcmd_init(&cmd);
+
+  uint8_t frame[HOSTCMD_MAX_PAYLOAD + HOSTCMD_OVERHEAD];
+  const uint8_t payload[] = {1, 0xe8, 0x03, 0x00, 0x00}; // 1000 us
+  const size_t len =
+      hostcmd_encode(HOSTCMD_TELEM_CONFIG, 0, payload, sizeof(payload), frame);
+  TEST_ASSERT_EQUAL(1, hostcmd_feed_all(&cmd, frame, len));
+
+  hostcmd_telem_config_t config;
+  TEST_ASSERT_TRUE(hostcmd_take_telem_config(&cmd, &config));
+  TEST_ASSERT_TRUE(config.enable);
+  TEST_ASSERT_EQUAL(1000, config.interval_us);
+  TEST_ASSERT_FALSE(hostcmd_take_telem_config(&cmd, &config));
+}
+
+/**
+ * @brief The decimation configuration is handed to the application once,
+ * and an unknown ESC is rejected
+ */
+static void test_hostcmd_decim_config(void) {
+  hostcmd_t cmd;
+  hostcmd_init(&cmd);
+
+  uint8_t frame[HOSTCMD_MAX_PAYLOAD + HOSTCMD_OVERHEAD];
+  // All ESCs, 10 samples, 20000 us
+  const uint8_t payload[] = {HOSTCMD_ALL_ESCS, 10, 0, 0x20, 0x4e, 0, 0};
+  size_t len =
+      hostcmd_encode(HOSTCMD_DECIM_CONFIG, 0, payload, sizeof(payload), frame);
+  TEST_ASSERT_EQUAL(1, hostcmd_feed_all(&cmd, frame, len));
+
+  hostcmd_decim_config_t config;
+  TEST_ASSERT_TRUE(hostcmd_take_decim_config(&cmd, &config));
+  TEST_ASSERT_EQUAL(HOSTCMD_ALL_ESCS, config.esc);
+  TEST_ASSERT_EQUAL(10, config.samples);
+  TEST_ASSERT_EQUAL(20000, config.window_us);
+  TEST_ASSERT_FALSE(hostcmd_take_decim_config(&cmd, &config));
+
+  const uint8_t bad_esc[] = {ESC_COUNT, 10, 0, 0, 0, 0, 0};
+  len = hostcmd_encode(HOSTCMD_DECIM_CONFIG, 1, bad_esc, sizeof(bad_esc),
+                       frame);
+  TEST_ASSERT_EQUAL(0, hostcmd_feed_all(&cmd, frame, len));
+  TEST_ASSERT_EQUAL(1, cmd.bad_frames);
+}
+
+static int runUnityTests_hostcmd(void) {
+  UnityBegin("HOSTCMD");
+  RUN_TEST(test_hostcmd_throttle);
+  RUN_TEST(test_hostcmd_crc_error);
+  RUN_TEST(test_hostcmd_seq_gaps);
+  RUN_TEST(test_hostcmd_special);
+  RUN_TEST(test_hostcmd_telem_config);
+  RUN_TEST(test_hostcmd_decim_config);
+  return UNITY_END();
+}
@@ -0,0 +1,104 @@
+#include "onewireparse.h"
+#include "unity.h"
+#include <stdio.h>
+
+/// @brief a KISS reply with a valid crc
+static void onewireparse_test_reply(uint8_t reply[KISS_ESC_TELEM_BUFFER_SIZE]) {
+  const uint8_t bytes[KISS_ESC_TELEM_BUFFER_SIZE - 1] = {40, 6, 144, 0, 250,
+                                                          0,  12, 0,   200};
+  memcpy(reply, bytes, sizeof(bytes));
+  reply[KISS_ESC_TELEM_BUFFER_SIZE - 1] =
+      kissesc_get_crc8(reply, KISS_ESC_TELEM_BUFFER_SIZE - 1);
+}
+
+/**
+ * @brief A reply split over two isr runs becomes one sample, stamped with
+ * its first and last byte and the request of the slot
+ */
+static void test_onewireparse_reply(void) {
+  onewire_parser_t parser;
+  onewire_parser_init(&parser);
+  telemhealth_t health;
+  telemhealth_init(&health, 3);
+  telem_queue_t queue;
+  telem_queue_init(&queue);
+  uint8_t reply[KISS_ESC_TELEM_BUFFER_SIZE];
+  onewireparse_test_reply(reply);
+
+  onewire_slot_start(&parser, 2, 7);
+  // Frame sent after the slot started
+  const onewire_request_t req = {8, 1000, 300};
+  telem_sample_t sample = {};
+  for (int i = 0; i < 6; ++i)
+    TEST_ASSERT_TRUE(onewire_parse_byte(&parser, reply[i]));
+  TEST_ASSERT_FALSE(onewire_parse_chunk(&parser, 0, 2000, false, 115200,
+                                        &req, &health, &queue, &sample));
+  for (int i = 6; i < KISS_ESC_TELEM_BUFFER_SIZE; ++i)
+    TEST_ASSERT_TRUE(onewire_parse_byte(&parser, reply[i]));
+  TEST_ASSERT_TRUE(onewire_parse_chunk(&parser, 6, 2400, true, 115200, &req,
+                                       &health, &queue, &sample));
+  TEST_ASSERT_EQUAL(0, parser.buffer_idx);
+
+  uint32_t first_us, last_us;
+  telemlatency_chunk_times(2000, 6, false, 115200, &first_us, &last_us);
+  TEST_ASSERT_EQUAL(first_us, sample.first_byte_us);
+  telemlatency_chunk_times(2400, 4, true, 115200, &first_us, &last_us);
+  TEST_ASSERT_EQUAL(last_us, sample.timestamp_us);
+  TEST_ASSERT_EQUAL(2, sample.esc_idx);
+  TEST_ASSERT_EQUAL(0, sample.telem.crc);
+  TEST_ASSERT_EQUAL(40, sample.telem.temperature);
+  TEST_ASSERT_EQUAL(1000, sample.request_us);
+  TEST_ASSERT_EQUAL(300, sample.request_code);
+  TEST_ASSERT_TRUE(sample.request_valid);
+  TEST_ASSERT_EQUAL(1, health.slot_valid);
+
+  telem_sample_t queued;
+  TEST_ASSERT_TRUE(telem_queue_pop(&queue, &queued));
+  TEST_ASSERT_EQUAL(sample.timestamp_us, queued.timestamp_us);
+
+  // The slot ends with the request sent and a valid reply
+  TEST_ASSERT_TRUE(onewire_request_sent(&parser, req.count));
+  TEST_ASSERT_FALSE(onewire_slot_end(&parser, &health, true));
+  TEST_ASSERT_EQUAL(TELEMHEALTH_SLOT_VALID, health.last_slot);
+}
+
+/**
+ * @brief Bytes past a full buffer are dropped, and the left over bytes of
+ * an incomplete reply resync the parser at the end of the slot
+ */
+static void test_onewireparse_resync(void) {
+  onewire_parser_t parser;
+  onewire_parser_init(&parser);
+  telemhealth_t health;
+  telemhealth_init(&health, 3);
+  telem_queue_t queue;
+  telem_queue_init(&queue);
+  const onewire_request_t req = {1, 0, 0};
+  telem_sample_t sample = {};
+
+  onewire_slot_start(&parser, 0, 0);
+  TEST_ASSERT_TRUE(parser.slot_open);
+  // More than a reply in one run: the buffer overflows, nothing is parsed
+  for (int i = 0; i < KISS_ESC_TELEM_BUFFER_SIZE; ++i)
+    TEST_ASSERT_TRUE(onewire_parse_byte(&parser, 0));
+  TEST_ASSERT_FALSE(onewire_parse_byte(&parser, 0));
+  TEST_ASSERT_EQUAL(KISS_ESC_TELEM_BUFFER_SIZE + 1, parser.buffer_idx);
+  TEST_ASSERT_FALSE(onewire_parse_chunk(&parser, 0, 1000, false, 115200,
+                                        &req, &health, &queue, &sample));
+  TEST_ASSERT_TRUE(onewire_slot_end(&parser, &health, true));
+  TEST_ASSERT_EQUAL(TELEMHEALTH_SLOT_PARTIAL, health.last_slot);
+
+  // The next slot starts from an empty buffer
+  onewire_slot_start(&parser, 1, 5);
+  TEST_ASSERT_EQUAL(0, parser.buffer_idx);
+  TEST_ASSERT_EQUAL(1, parser.esc_idx);
+  TEST_ASSERT_FALSE(onewire_request_sent(&parser, 5));
+  TEST_ASSERT_EQUAL(0, queue.head);
+}
+
+static int runUnityTests_onewireparse(void) {
+  UnityBegin("ONEWIREPARSE");
+  RUN_TEST(test_onewireparse_reply);
+  RUN_TEST(test_onewireparse_resync);
+  return UNITY_END();
+}
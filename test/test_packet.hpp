@@ -60,19 +60,19 @@ static void test_dshot_cmd_to_frame(void)
  * Test with these cases:
  *    frame = 0, high = 75, low = 33
  *    frame = 1, high = 75, low = 33
- *    frame = 1, high = 75 << 16, low = 33 << 16
+ *    frame = 1, high = 0xffff, low = 0x8000 (no truncation or shift: the
+ *    16 bit values suit either pwm channel)
  */
 static void test_dshot_frame_to_packet(void)
 {
   // Frame is any 16 bit number
   uint16_t frame;
-  uint32_t packet[16] = {0};
-  uint32_t expected_packet[16];
+  uint16_t packet[16] = {0};
+  uint16_t expected_packet[16];
   // const uint32_t dshot_frame_length = 16;
 
-  // pwm channel = 0 (i.e. there is no bit shift in packet values)
-  uint32_t pulse_high = 75;
-  uint32_t pulse_low = 33;
+  uint16_t pulse_high = 75;
+  uint16_t pulse_low = 33;
 
   // frame = 0
   frame = 0b0;
@@ -81,7 +81,7 @@ static void test_dshot_frame_to_packet(void)
     expected_packet[i] = pulse_low;
   }
   dshot_frame_to_packet(frame, packet, pulse_high, pulse_low);
-  TEST_ASSERT_EQUAL_HEX32_ARRAY_MESSAGE(expected_packet, packet, 16, "frame = 0b0, Channel 0");
+  TEST_ASSERT_EQUAL_HEX16_ARRAY_MESSAGE(expected_packet, packet, 16, "frame = 0b0");
 
   // frame = 1
   frame = 0b1;
@@ -91,13 +91,13 @@ static void test_dshot_frame_to_packet(void)
   }
   expected_packet[16 - 1] = pulse_high;
   dshot_frame_to_packet(frame, packet, pulse_high, pulse_low);
-  TEST_ASSERT_EQUAL_HEX32_ARRAY_MESSAGE(expected_packet, packet, 16, "frame = 0b1, Channel 0");
+  TEST_ASSERT_EQUAL_HEX16_ARRAY_MESSAGE(expected_packet, packet, 16, "frame = 0b1");
 
-  // frame = 1, with bit shifted values for pulse_high and pulse_low
+  // frame = 1, with the largest counter compare values
   frame = 0b1;
 
-  pulse_high = 75 << 16;
-  pulse_low = 33 << 16;
+  pulse_high = 0xffff;
+  pulse_low = 0x8000;
 
   for (int i = 0; i < 16; ++i)
   {
@@ -105,7 +105,7 @@ static void test_dshot_frame_to_packet(void)
   }
   expected_packet[16 - 1] = pulse_high;
   dshot_frame_to_packet(frame, packet, pulse_high, pulse_low);
-  TEST_ASSERT_EQUAL_HEX32_ARRAY_MESSAGE(expected_packet, packet, 16, "frame = 0b1, channel 1");
+  TEST_ASSERT_EQUAL_HEX16_ARRAY_MESSAGE(expected_packet, packet, 16, "frame = 0b1, 16 bit values");
 }
 
 /**
@@ -114,20 +114,26 @@ static void test_dshot_frame_to_packet(void)
  * Test parameters:
  *    code = 1, telemetry = 1
  *    --> expected frame = 0x0033
- *    expected packet = LLLL LLLL LLHH LLHH 0000
+ *    expected packet = LLLL LLLL LLHH LLHH 0
+ *
+ * The buffer starts dirty: compose always ends it with the zero pulse
  */
 static void test_dshot_packet_compose(void)
 {
-  uint32_t pulse_high = 75, pulse_low = 33;
+  uint16_t pulse_high = 75, pulse_low = 33;
 
   dshot_packet_t dshot_pckt = {
       .throttle_code = 1,
       .telemetry = 1,
       .pulse_high = pulse_high,
       .pulse_low = pulse_low};
+  for (int i = 0; i < DSHOT_PACKET_BUFFER_LENGTH; ++i)
+  {
+    dshot_pckt.packet_buffer[i] = 0xdead;
+  }
 
   // Construct expected packet:
-  uint32_t expected_packet[] = {
+  uint16_t expected_packet[] = {
       // LLLL
       pulse_low, pulse_low, pulse_low, pulse_low,
       // LLLL
@@ -136,12 +142,23 @@ static void test_dshot_packet_compose(void)
       pulse_low, pulse_low, pulse_high, pulse_high,
       // LLHH
       pulse_low, pulse_low, pulse_high, pulse_high,
-      // 0000
-      0, 0, 0, 0};
+      // 0 (the rest of the pause is the shared tail)
+      0};
+  TEST_ASSERT_EQUAL(DSHOT_PACKET_BUFFER_LENGTH, sizeof(expected_packet) / sizeof(expected_packet[0]));
 
   dshot_packet_compose(&dshot_pckt);
 
-  TEST_ASSERT_EQUAL_HEX32_ARRAY_MESSAGE(expected_packet, dshot_pckt.packet_buffer, dshot_packet_length, "Code = 1, Telemetry = 1, Channel 0, Array idx: 0");
+  TEST_ASSERT_EQUAL_HEX16_ARRAY_MESSAGE(expected_packet, dshot_pckt.packet_buffer, DSHOT_PACKET_BUFFER_LENGTH, "Code = 1, Telemetry = 1, Array idx: 0");
+}
+
+/**
+ * @brief the packet is half the size of one with 32 bit pulses and a
+ * pause per motor
+ */
+static void test_dshot_packet_size(void)
+{
+  TEST_ASSERT_EQUAL(2 * DSHOT_PACKET_BUFFER_LENGTH + 4 * 2, sizeof(dshot_packet_t));
+  TEST_ASSERT_TRUE(2 * sizeof(dshot_packet_t) < 4 * DSHOT_PACKET_MAX_LENGTH + 12);
 }
 
 static int runUnityTests_packet(void)
@@ -152,6 +169,7 @@ static int runUnityTests_packet(void)
   RUN_TEST(test_dshot_cmd_to_frame);
   RUN_TEST(test_dshot_frame_to_packet);
   RUN_TEST(test_dshot_packet_compose);
+  RUN_TEST(test_dshot_packet_size);
   return UNITY_END();
 }
 
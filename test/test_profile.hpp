@@ -0,0 +1,109 @@
+#include "profile.h"
+#include "unity.h"
+#include <stdio.h>
+
+/**
+ * @brief Single track profile:
+ *    ABS 48 | +2 | -1 | HOLD 2 | RAMP +10 x 3 | END
+ *    --> 48, 50, 49, 49, 49, 59, 69, 79, 79 (held) ...
+ */
+static const uint8_t profile_single_track[] = {
+    0x54, 0x50, PROFILE_VERSION, 1,         // header
+    8,    0,    0,               0,         // track 0 offset
+    PROFILE_ABS, 48, 0,                     // 48
+    0x02,                                   // +2
+    0x7f,                                   // -1
+    PROFILE_HOLD, 2, 0,                     // hold x 2
+    PROFILE_RAMP, 10, 3, 0,                 // +10 x 3
+    PROFILE_END};
+
+/**
+ * @brief Two tracks, where track 1 loops twice:
+ *    track 0: ABS 100 | END
+ *    track 1: LOOP 2 | ABS 200 | +1 | LOOP_END | END
+ */
+static const uint8_t profile_two_tracks[] = {
+    0x54, 0x50, PROFILE_VERSION, 2,                           // header
+    12,   0,    0,               0,                           // track 0
+    16,   0,    0,               0,                           // track 1
+    PROFILE_ABS, 100, 0, PROFILE_END,                         // track 0
+    PROFILE_LOOP, 2, 0, PROFILE_ABS, 200, 0, 0x01,            // track 1
+    PROFILE_LOOP_END, PROFILE_END};
+
+static void test_profile_deltas_hold_ramp(void) {
+  profile_track_t track = {.pc = &profile_single_track[8]};
+  const uint16_t expected[] = {48, 50, 49, 49, 49, 59, 69, 79, 79, 79};
+  for (const auto code : expected) {
+    TEST_ASSERT_EQUAL(code, profile_track_step(&track));
+  }
+  TEST_ASSERT_TRUE(track.done);
+}
+
+static void test_profile_player_loop(void) {
+  // The player only has ESC_COUNT tracks, so track 1 is played standalone
+  profile_player_t player;
+  TEST_ASSERT_TRUE(profile_player_load(&player, profile_two_tracks));
+  TEST_ASSERT_EQUAL(2, profile_track_count(profile_two_tracks));
+  profile_track_t track = {.pc = &profile_two_tracks[16]};
+
+  const uint16_t expected_1[] = {200, 201, 200, 201, 201};
+  for (const auto code : expected_1) {
+    TEST_ASSERT_EQUAL(code, profile_track_step(&track));
+  }
+  TEST_ASSERT_TRUE(track.done);
+  TEST_ASSERT_FALSE(profile_player_done(&player));
+  TEST_ASSERT_EQUAL(100, profile_track_step(&player.tracks[0]));
+  TEST_ASSERT_EQUAL(100, profile_track_step(&player.tracks[0]));
+  TEST_ASSERT_TRUE(profile_player_done(&player));
+}
+
+/**
+ * @brief The frame hook only updates the packet while the player runs,
+ * and keeps the last code once the track ends
+ */
+static void test_profile_frame_hook(void) {
+  profile_player_t player;
+  TEST_ASSERT_TRUE(profile_player_load(&player, profile_single_track));
+
+  dshot_packet_t packet = {.throttle_code = 0, .telemetry = 0};
+  profile_frame_hook(&packet, &player.tracks[0]);
+  TEST_ASSERT_EQUAL(0, packet.throttle_code);
+
+  profile_player_start(&player);
+  profile_frame_hook(&packet, &player.tracks[0]);
+  TEST_ASSERT_EQUAL(48, packet.throttle_code);
+
+  for (int i = 0; i < 20; ++i) {
+    profile_frame_hook(&packet, &player.tracks[0]);
+  }
+  TEST_ASSERT_EQUAL(79, packet.throttle_code);
+  TEST_ASSERT_FALSE(player.tracks[0].active);
+}
+
+/**
+ * @brief Invalid headers are rejected, and a track made only of loop
+ * markers ends instead of spinning forever
+ */
+static void test_profile_invalid(void) {
+  profile_player_t player;
+  uint8_t bad_magic[sizeof(profile_single_track)];
+  for (size_t i = 0; i < sizeof(bad_magic); ++i) {
+    bad_magic[i] = profile_single_track[i];
+  }
+  bad_magic[0] = 0;
+  TEST_ASSERT_FALSE(profile_player_load(&player, bad_magic));
+
+  const uint8_t empty_loop[] = {PROFILE_LOOP, 0, 0, PROFILE_LOOP_END};
+  profile_track_t track = {.pc = empty_loop};
+  profile_track_step(&track);
+  TEST_ASSERT_TRUE(track.done);
+}
+
+static int runUnityTests_profile(void) {
+  UnityBegin("PROFILE");
+  RUN_TEST(test_profile_deltas_hold_ramp);
+  RUN_TEST(test_profile_player_loop);
+  RUN_TEST(test_profile_frame_hook);
+  RUN_TEST(test_profile_invalid);
+  return UNITY_END();
+}
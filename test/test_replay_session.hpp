@@ -0,0 +1,152 @@
+#include "replay_session.hpp"
+#include "unity.h"
+#include <stdio.h>
+
+/// @brief a KISS reply with a valid crc
+static void replay_test_reply(uint8_t reply[KISS_ESC_TELEM_BUFFER_SIZE]) {
+  const uint8_t bytes[] = {0x1c, 0x04, 0xd6, 0x00, 0x13,
+                           0x00, 0x17, 0x03, 0x83};
+  memcpy(reply, bytes, sizeof(bytes));
+  reply[9] = kissesc_get_crc8(bytes, sizeof(bytes));
+}
+
+/**
+ * @brief record a session: a request, its reply in two isr runs and a host
+ * command, with the results of a live run of the same pipeline
+ *
+ * @param with_results also record the samples, statistics and commands
+ * @param uart_offset output: offset of the first uart payload
+ */
+static replay_writer replay_test_session(const bool with_results,
+                                         size_t *const uart_offset) {
+  replay_header h;
+  h.escs = 2;
+  h.flags = with_results ? REPLAY_HAS_RESULTS : 0;
+  h.ewma_shift[0] = 2;
+  replay_writer w;
+  w.header(h);
+  replay_pipeline live(h);
+
+  uint8_t reply[KISS_ESC_TELEM_BUFFER_SIZE];
+  replay_test_reply(reply);
+  live.slot(1);
+  w.slot(1, 0);
+  live.request(1, 100, 1048);
+  w.request(1, 100, 1048);
+  // 4 bytes at the fifo level, the rest after the rx timeout
+  live.uart(1000, reply, 4, false);
+  *uart_offset = w.data.size() + REPLAY_RECORD_HEADER_SIZE;
+  w.uart(1000, reply, 4, false);
+  live.uart(2000, reply + 4, 6, true);
+  w.uart(2000, reply + 4, 6, true);
+
+  uint8_t frame[HOSTCMD_MAX_PAYLOAD + HOSTCMD_OVERHEAD];
+  const uint8_t codes[2] = {0x18, 0x04};
+  const size_t len = hostcmd_encode(HOSTCMD_THROTTLE, 0, codes, 2, frame);
+  for (size_t b = 0; b < len; ++b)
+    hostcmd_feed(&live.cmd, frame[b]);
+  w.hostcmd(2500, frame, (uint16_t)len);
+
+  telem_sample_t sample;
+  if (with_results && telem_queue_pop(&live.queue, &sample)) {
+    live.consume(sample);
+    w.sample(3000, sample);
+    telemstats_result_t result;
+    telemstats_snapshot(&live.stats[1], &result, true);
+    w.stats(1, 3000, result, true);
+    w.commands(3000, live.cmd);
+  }
+  return w;
+}
+
+/**
+ * @brief A session replays through the data path with the same results
+ */
+static void test_replay_session_match(void) {
+  size_t uart_offset;
+  const replay_writer w = replay_test_session(true, &uart_offset);
+  std::unique_ptr<replay_pipeline> p;
+  TEST_ASSERT_TRUE(replay_session(w.data.data(), w.data.size(), p));
+  TEST_ASSERT_EQUAL(2, p->h.escs);
+  TEST_ASSERT_EQUAL(2, p->h.ewma_shift[0]);
+  TEST_ASSERT_EQUAL(0, p->diff.total());
+  TEST_ASSERT_EQUAL(1, p->diff.samples);
+  TEST_ASSERT_EQUAL(1, p->diff.stats);
+  TEST_ASSERT_EQUAL(1, p->samples);
+  TEST_ASSERT_EQUAL(10, p->uart_bytes);
+  TEST_ASSERT_EQUAL(1, p->cmd.frames);
+
+  // Byte times as in onewire_uart_irq: 87 us per byte, 278 us of timeout
+  TEST_ASSERT_EQUAL(1, p->latency[1].count);
+  TEST_ASSERT_EQUAL(1000 - 3 * 87 - 100, p->latency[1].reply.last);
+  TEST_ASSERT_EQUAL(2000 - 278 - 100, p->latency[1].total.last);
+  TEST_ASSERT_EQUAL(2000 - 278, p->health[1].last_valid_us);
+  TEST_ASSERT_TRUE(p->health[1].has_valid);
+  TEST_ASSERT_FALSE(p->health[0].has_valid);
+
+  // Without results, every sample is consumed as it is parsed
+  const replay_writer raw = replay_test_session(false, &uart_offset);
+  TEST_ASSERT_TRUE(replay_session(raw.data.data(), raw.data.size(), p));
+  TEST_ASSERT_EQUAL(1, p->samples);
+  TEST_ASSERT_EQUAL(1, p->stats[1].count);
+  TEST_ASSERT_EQUAL(0, p->diff.total());
+}
+
+/**
+ * @brief A change of the data path shows up as differences, and broken
+ * sessions are rejected
+ */
+static void test_replay_session_diff(void) {
+  size_t uart_offset;
+  replay_writer w = replay_test_session(true, &uart_offset);
+  std::unique_ptr<replay_pipeline> p;
+
+  // A different temperature byte: the sample, its crc and the (now empty)
+  // statistics differ
+  w.data[uart_offset] ^= 0x01;
+  TEST_ASSERT_TRUE(replay_session(w.data.data(), w.data.size(), p));
+  TEST_ASSERT_EQUAL(1, p->diff.mismatched);
+  TEST_ASSERT_EQUAL(1, p->diff.stats_mismatched);
+  TEST_ASSERT_EQUAL(2, p->diff.details.size());
+  TEST_ASSERT_EQUAL(1, p->health[1].slot_bad);
+  w.data[uart_offset] ^= 0x01;
+
+  // A record length running into the next record
+  w.data[uart_offset - REPLAY_RECORD_HEADER_SIZE + 2] = 5;
+  TEST_ASSERT_FALSE(replay_session(w.data.data(), w.data.size(), p));
+  w.data[uart_offset - REPLAY_RECORD_HEADER_SIZE + 2] = 4;
+
+  // Truncated, or not a session
+  TEST_ASSERT_FALSE(replay_session(w.data.data(), w.data.size() - 1, p));
+  w.data[0] = 'X';
+  TEST_ASSERT_FALSE(replay_session(w.data.data(), w.data.size(), p));
+  w.data[0] = 'D';
+  TEST_ASSERT_TRUE(replay_session(w.data.data(), w.data.size(), p));
+
+  // Inputs without their results: the replayed sample is extra
+  replay_writer raw = replay_test_session(false, &uart_offset);
+  raw.data[7] = REPLAY_HAS_RESULTS;
+  TEST_ASSERT_TRUE(replay_session(raw.data.data(), raw.data.size(), p));
+  TEST_ASSERT_EQUAL(1, p->diff.extra);
+  TEST_ASSERT_EQUAL(1, p->diff.total());
+
+  // Results without their inputs: the original sample is missing
+  replay_header h;
+  h.escs = 2;
+  h.flags = REPLAY_HAS_RESULTS;
+  replay_writer results;
+  results.header(h);
+  telem_sample_t sample = {};
+  results.sample(10, sample);
+  TEST_ASSERT_TRUE(
+      replay_session(results.data.data(), results.data.size(), p));
+  TEST_ASSERT_EQUAL(1, p->diff.missing);
+  TEST_ASSERT_EQUAL(1, p->diff.total());
+}
+
+static int runUnityTests_replay_session(void) {
+  UnityBegin("REPLAY_SESSION");
+  RUN_TEST(test_replay_session_match);
+  RUN_TEST(test_replay_session_diff);
+  return UNITY_END();
+}
@@ -0,0 +1,212 @@
+#include "replaycap.h"
+#include "replay_session.hpp"
+#include "unity.h"
+#include <stdio.h>
+
+/// @brief append the frame of an event to a capture stream
+static void replaycap_test_append(std::vector<uint8_t> &stream,
+                                  const replaycap_event_t &event) {
+  uint8_t frame[REPLAYCAP_FRAME_MAX_SIZE];
+  const size_t size = replaycap_encode(&event, frame);
+  stream.insert(stream.end(), frame, frame + size);
+}
+
+/**
+ * @brief The ring keeps its events in order, and counts the ones it drops
+ */
+static void test_replaycap_ring(void) {
+  replaycap_t cap;
+  replaycap_init(&cap);
+  replaycap_event_t event;
+  TEST_ASSERT_FALSE(replaycap_pop(&cap, &event));
+
+  // Nothing is captured before the first request slot
+  const uint8_t bytes[40] = {1, 2, 3};
+  replaycap_start(&cap);
+  replaycap_hostcmd(&cap, bytes, 3, 0);
+  TEST_ASSERT_FALSE(replaycap_pop(&cap, &event));
+  replaycap_slot(&cap, 0, 7, 10, 1, 115200, 5, 0);
+  TEST_ASSERT_TRUE(replaycap_running(&cap));
+  TEST_ASSERT_TRUE(replaycap_pop(&cap, &event));
+  TEST_ASSERT_EQUAL(REPLAYCAP_START, event.type);
+  TEST_ASSERT_EQUAL(1, event.esc);
+  TEST_ASSERT_TRUE(replaycap_pop(&cap, &event));
+  TEST_ASSERT_EQUAL(REPLAYCAP_SLOT, event.type);
+
+  // The first count of an ESC is its baseline
+  replaycap_requests(&cap, 0, 9, 20, 1048);
+  for (int i = 0; i < 2; ++i) {
+    TEST_ASSERT_TRUE(replaycap_pop(&cap, &event));
+    TEST_ASSERT_EQUAL(REPLAYCAP_REQUEST, event.type);
+    TEST_ASSERT_EQUAL(20, event.time_us);
+    TEST_ASSERT_EQUAL(1048, event.payload[0] | event.payload[1] << 8);
+  }
+  TEST_ASSERT_FALSE(replaycap_pop(&cap, &event));
+
+  // Host bytes are split into payloads
+  replaycap_hostcmd(&cap, bytes, sizeof(bytes), 30);
+  TEST_ASSERT_TRUE(replaycap_pop(&cap, &event));
+  TEST_ASSERT_EQUAL(REPLAYCAP_MAX_PAYLOAD, event.length);
+  TEST_ASSERT_TRUE(replaycap_pop(&cap, &event));
+  TEST_ASSERT_EQUAL(sizeof(bytes) - REPLAYCAP_MAX_PAYLOAD, event.length);
+
+  for (uint32_t i = 0; i < REPLAYCAP_RING_SIZE + 3; ++i)
+    replaycap_push(&cap, REPLAYCAP_SLOT, 0, i, NULL, 0);
+  TEST_ASSERT_EQUAL(3, cap.dropped);
+  TEST_ASSERT_TRUE(replaycap_pop(&cap, &event));
+  TEST_ASSERT_EQUAL(0, event.time_us);
+
+  // Frames round trip, and a corrupted one is rejected
+  event.type = REPLAYCAP_UART;
+  event.esc = REPLAYCAP_RX_TIMEOUT;
+  event.length = 3;
+  event.time_us = 0x12345678;
+  memcpy(event.payload, bytes, 3);
+  uint8_t frame[REPLAYCAP_FRAME_MAX_SIZE];
+  const size_t size = replaycap_encode(&event, frame);
+  TEST_ASSERT_EQUAL(REPLAYCAP_FRAME_HEADER_SIZE + 3 + 1, size);
+  TEST_ASSERT_EQUAL(size, replaycap_frame_size(frame));
+  replaycap_event_t decoded;
+  TEST_ASSERT_TRUE(replaycap_decode(frame, &decoded));
+  TEST_ASSERT_EQUAL(0x12345678, decoded.time_us);
+  TEST_ASSERT_EQUAL(REPLAYCAP_RX_TIMEOUT, decoded.esc);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(bytes, decoded.payload, 3);
+  frame[REPLAYCAP_FRAME_HEADER_SIZE] ^= 0x01;
+  TEST_ASSERT_FALSE(replaycap_decode(frame, &decoded));
+  frame[4] = REPLAYCAP_MAX_PAYLOAD + 1;
+  TEST_ASSERT_EQUAL(0, replaycap_frame_size(frame));
+}
+
+/**
+ * @brief A captured stream converts to a session that replays with the
+ * results of the capture
+ *
+ * The pico is played by a pipeline, with the capture hooks where
+ * onewire.h has them. The stream has text before the capture, noise and a
+ * corrupted frame, and is converted in pieces.
+ */
+static void test_replaycap_round_trip(void) {
+  replay_header h;
+  h.escs = 2;
+  // The samples stay queued for the main loop, as on the pico
+  h.flags = REPLAY_HAS_RESULTS;
+  replay_pipeline pico(h);
+  // Samples were queued before the capture started
+  pico.queue.seq = 40;
+  replaycap_t cap;
+  replaycap_init(&cap);
+  replaycap_start(&cap);
+
+  uint8_t reply[KISS_ESC_TELEM_BUFFER_SIZE];
+  replay_test_reply(reply);
+  // Request timer: the slot of ESC 1 starts the capture
+  replaycap_slot(&cap, 1, pico.telem_requests[1], 0, h.escs, h.baudrate,
+                 h.stale_cycles, pico.queue.seq);
+  pico.slot(1);
+  // Frame timer: the request goes out
+  pico.request(1, 100, 1048);
+  // Uart isr: 4 bytes at the fifo level, the rest after the rx timeout
+  replaycap_requests(&cap, 1, pico.telem_requests[1], pico.request_us[1],
+                     pico.request_code[1]);
+  replaycap_push(&cap, REPLAYCAP_UART, 0, 1000, reply, 4);
+  pico.uart(1000, reply, 4, false);
+  replaycap_requests(&cap, 1, pico.telem_requests[1], pico.request_us[1],
+                     pico.request_code[1]);
+  replaycap_push(&cap, REPLAYCAP_UART, REPLAYCAP_RX_TIMEOUT, 2000, reply + 4,
+                 6);
+  pico.uart(2000, reply + 4, 6, true);
+  // Main loop: a host command, and the sample
+  uint8_t frame[HOSTCMD_MAX_PAYLOAD + HOSTCMD_OVERHEAD];
+  const uint8_t codes[2] = {0x18, 0x04};
+  const size_t len = hostcmd_encode(HOSTCMD_THROTTLE, 0, codes, 2, frame);
+  replaycap_hostcmd(&cap, frame, len, 2500);
+  for (size_t b = 0; b < len; ++b)
+    hostcmd_feed(&pico.cmd, frame[b]);
+  telem_sample_t sample;
+  TEST_ASSERT_TRUE(telem_queue_pop(&pico.queue, &sample));
+  TEST_ASSERT_EQUAL(40, sample.seq);
+  replaycap_sample(&cap, &sample, 3000);
+  // Request timer: the next slot
+  replaycap_requests(&cap, 1, pico.telem_requests[1], pico.request_us[1],
+                     pico.request_code[1]);
+  replaycap_slot(&cap, 0, pico.telem_requests[0], 4000, h.escs, h.baudrate,
+                 h.stale_cycles, pico.queue.seq);
+  pico.slot(0);
+
+  const char boot[] = "dshot config...\n";
+  std::vector<uint8_t> stream(boot, boot + sizeof(boot) - 1);
+  replaycap_event_t event;
+  size_t events = 0;
+  while (replaycap_pop(&cap, &event)) {
+    replaycap_test_append(stream, event);
+    if (++events == 3) {
+      // A corrupted copy of the request, and noise with a sync word
+      const size_t start = stream.size();
+      replaycap_test_append(stream, event);
+      stream[start + REPLAYCAP_FRAME_HEADER_SIZE] ^= 0x01;
+      const uint8_t noise[] = {0x7c, 0x5a, 0x7c, 0x00};
+      stream.insert(stream.end(), noise, noise + sizeof(noise));
+    }
+  }
+  TEST_ASSERT_EQUAL(8, events);
+  event.type = REPLAYCAP_DROPPED;
+  event.length = 4;
+  const uint8_t dropped[4] = {2, 0, 0, 0};
+  memcpy(event.payload, dropped, 4);
+  replaycap_test_append(stream, event);
+
+  replay_capture capture;
+  for (size_t b = 0; b < stream.size(); b += 7)
+    capture.feed(&stream[b], std::min<size_t>(7, stream.size() - b));
+  TEST_ASSERT_EQUAL(1, capture.sessions.size());
+  TEST_ASSERT_EQUAL(9, capture.frames);
+  TEST_ASSERT_EQUAL(1, capture.bad_frames);
+  TEST_ASSERT_EQUAL(2, capture.dropped_events);
+  TEST_ASSERT_EQUAL(0, capture.orphans);
+
+  const replay_writer &w = capture.sessions[0];
+  std::unique_ptr<replay_pipeline> p;
+  TEST_ASSERT_TRUE(replay_session(w.data.data(), w.data.size(), p));
+  TEST_ASSERT_EQUAL(2, p->h.escs);
+  TEST_ASSERT_EQUAL(0, p->diff.total());
+  TEST_ASSERT_EQUAL(1, p->diff.samples);
+  TEST_ASSERT_EQUAL(10, p->uart_bytes);
+  TEST_ASSERT_EQUAL(1, p->cmd.frames);
+  TEST_ASSERT_TRUE(p->health[1].has_valid);
+  TEST_ASSERT_EQUAL(2000 - 278 - 100, p->latency[1].total.last);
+
+  // A different temperature byte shows up against the capture
+  std::vector<uint8_t> data = w.data;
+  replay_reader reader;
+  replay_header read;
+  replay_record r;
+  TEST_ASSERT_TRUE(reader.open(data.data(), data.size(), read));
+  while (reader.next(r) && r.type != REPLAY_UART) {
+  }
+  TEST_ASSERT_EQUAL(REPLAY_UART, r.type);
+  data[r.payload - data.data()] ^= 0x01;
+  TEST_ASSERT_TRUE(replay_session(data.data(), data.size(), p));
+  TEST_ASSERT_EQUAL(1, p->diff.mismatched);
+
+  // Events before the start are dropped, and each start is a session
+  replay_capture restarted;
+  event.type = REPLAYCAP_SLOT;
+  event.length = 0;
+  std::vector<uint8_t> orphan;
+  replaycap_test_append(orphan, event);
+  restarted.feed(orphan.data(), orphan.size());
+  restarted.feed(stream.data(), stream.size());
+  restarted.feed(stream.data(), stream.size());
+  TEST_ASSERT_EQUAL(1, restarted.orphans);
+  TEST_ASSERT_EQUAL(2, restarted.sessions.size());
+  TEST_ASSERT_TRUE(replay_session(restarted.sessions[1].data.data(),
+                                  restarted.sessions[1].data.size(), p));
+  TEST_ASSERT_EQUAL(0, p->diff.total());
+}
+
+static int runUnityTests_replaycap(void) {
+  UnityBegin("REPLAYCAP");
+  RUN_TEST(test_replaycap_ring);
+  RUN_TEST(test_replaycap_round_trip);
+  return UNITY_END();
+}
@@ -0,0 +1,87 @@
+#include "rpmctl.h"
+#include "rpmctl_sim.hpp"
+#include "unity.h"
+#include <stdio.h>
+
+/// @brief coarse feed-forward map of the test motor (misses the sag)
+static const rpmctl_ff_point_t rpmctl_test_ff[] = {
+    {0, 48}, {15000, 960}, {30000, 2047}};
+
+static const rpmctl_config_t rpmctl_test_config = {
+    .kp = (int32_t)(0.08 * RPMCTL_GAIN_ONE),
+    .ki = (int32_t)(2.0 * RPMCTL_GAIN_ONE),
+    .kd = 0,
+    .i_band_rpm = 500,
+    .min_code = 48,
+    .max_code = 2047,
+    .poles = 14,
+    .max_dt_us = 10000,
+    .ff = rpmctl_test_ff,
+    .ff_points = 3,
+};
+
+static const motor_model_t rpmctl_test_motor = {
+    .rpm = 0, .max_rpm = 30000, .sag = 0.15, .tau_s = 0.04, .poles = 14};
+
+static void test_rpmctl_feedforward(void) {
+  TEST_ASSERT_EQUAL(48, rpmctl_feedforward(&rpmctl_test_config, -10));
+  TEST_ASSERT_EQUAL(504, rpmctl_feedforward(&rpmctl_test_config, 7500));
+  TEST_ASSERT_EQUAL(960, rpmctl_feedforward(&rpmctl_test_config, 15000));
+  TEST_ASSERT_EQUAL(2047, rpmctl_feedforward(&rpmctl_test_config, 40000));
+  TEST_ASSERT_EQUAL(1000, rpmctl_erpm_to_rpm(7000, 14));
+}
+
+/**
+ * @brief An unreachable target saturates the output without winding up
+ * the integral, so the loop responds at once when the target drops
+ */
+static void test_rpmctl_anti_windup(void) {
+  rpmctl_config_t config = rpmctl_test_config;
+  config.max_code = 1048;
+  rpmctl_t ctl;
+  rpmctl_init(&ctl, &config, NULL);
+
+  // Disabled: samples are tracked, but nothing is output
+  TEST_ASSERT_EQUAL(48, rpmctl_update(&ctl, 0, 0));
+  TEST_ASSERT_EQUAL(0, ctl.updates);
+
+  rpmctl_set_target(&ctl, 25000);
+  const uint32_t stuck_erpm = 10000 * 7;
+  for (uint32_t t = 1000; t < 2000000; t += 1000) {
+    TEST_ASSERT_EQUAL(1048, rpmctl_update(&ctl, stuck_erpm, t));
+  }
+  TEST_ASSERT_TRUE(ctl.saturated);
+  TEST_ASSERT_EQUAL(0, ctl.integral);
+
+  // Target below the measured rpm => out of saturation on the next sample
+  rpmctl_set_target(&ctl, 9000);
+  const uint16_t code = rpmctl_update(&ctl, stuck_erpm, 2000000);
+  TEST_ASSERT_FALSE(ctl.saturated);
+  TEST_ASSERT_LESS_THAN(1048, code);
+}
+
+/**
+ * @brief The closed loop settles on the target despite the model error of
+ * the feed-forward map, with 1 kHz telemetry and 1 ms latency
+ */
+static void test_rpmctl_closed_loop(void) {
+  const rpmctl_sim_config_t sim = {.frame_us = 143,
+                                   .telem_interval_us = 1000,
+                                   .latency_us = 1000,
+                                   .duration_us = 1000000,
+                                   .band = 0.02};
+  rpmctl_sim_result_t result;
+  rpmctl_sim_step(&sim, &rpmctl_test_config, rpmctl_test_motor, 0, 10000,
+                  &result);
+  TEST_ASSERT_LESS_THAN(100000, result.settle_us);
+  TEST_ASSERT_LESS_THAN(50, result.overshoot * 1000); // 5 %
+  TEST_ASSERT_FLOAT_WITHIN(0.01 * 10000, 10000, result.final_rpm);
+}
+
+static int runUnityTests_rpmctl(void) {
+  UnityBegin("RPMCTL");
+  RUN_TEST(test_rpmctl_feedforward);
+  RUN_TEST(test_rpmctl_anti_windup);
+  RUN_TEST(test_rpmctl_closed_loop);
+  return UNITY_END();
+}
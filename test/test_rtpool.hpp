@@ -0,0 +1,65 @@
+#include "rtpool.h"
+#include "unity.h"
+#include <stdio.h>
+
+/**
+ * @brief Entry latencies land in power of two bins, 64+ us in the last
+ */
+static void test_rtpool_bins(void) {
+  TEST_ASSERT_EQUAL(0, rtpool_latency_bin(0));
+  TEST_ASSERT_EQUAL(1, rtpool_latency_bin(1));
+  TEST_ASSERT_EQUAL(2, rtpool_latency_bin(2));
+  TEST_ASSERT_EQUAL(2, rtpool_latency_bin(3));
+  TEST_ASSERT_EQUAL(3, rtpool_latency_bin(4));
+  TEST_ASSERT_EQUAL(6, rtpool_latency_bin(63));
+  TEST_ASSERT_EQUAL(RTPOOL_LATENCY_BINS - 1, rtpool_latency_bin(64));
+  TEST_ASSERT_EQUAL(RTPOOL_LATENCY_BINS - 1, rtpool_latency_bin(UINT32_MAX));
+}
+
+/**
+ * @brief Late entries are folded into min / max / mean, and entries after
+ * a re-arm of the alarm are counted apart
+ */
+static void test_rtpool_latency(void) {
+  rtpool_latency_t lat;
+  rtpool_latency_init(&lat);
+  TEST_ASSERT_EQUAL(0, rtpool_latency_mean_us(&lat));
+
+  const int32_t deltas[] = {2, 3, 1, 10, -5};
+  for (const int32_t d : deltas)
+    rtpool_latency_record(&lat, d);
+  TEST_ASSERT_EQUAL(4, lat.count);
+  TEST_ASSERT_EQUAL(1, lat.rearmed);
+  TEST_ASSERT_EQUAL(1, lat.min_us);
+  TEST_ASSERT_EQUAL(10, lat.max_us);
+  TEST_ASSERT_EQUAL(4, rtpool_latency_mean_us(&lat));
+  TEST_ASSERT_EQUAL(1, lat.bins[1]);
+  TEST_ASSERT_EQUAL(2, lat.bins[2]);
+  TEST_ASSERT_EQUAL(1, lat.bins[4]);
+
+  // timerawl - alarm across the 32 bit wrap around
+  rtpool_latency_record(&lat, (int32_t)(0x00000003u - 0xfffffffeu));
+  TEST_ASSERT_EQUAL(5, lat.count);
+  TEST_ASSERT_EQUAL(10, lat.max_us);
+}
+
+/**
+ * @brief The frame timer, dma and uart irqs share the most urgent level, so
+ * that none preempts another, above the application's default
+ */
+static void test_rtpool_priorities(void) {
+  TEST_ASSERT_EQUAL(RTPOOL_TIMER_PRIORITY, RTPOOL_DMA_PRIORITY);
+  TEST_ASSERT_EQUAL(RTPOOL_TIMER_PRIORITY, RTPOOL_UART_PRIORITY);
+  TEST_ASSERT_TRUE(RTPOOL_UART_PRIORITY < 0x80);
+  // The M0+ only implements the top two bits
+  TEST_ASSERT_EQUAL(0, RTPOOL_TIMER_PRIORITY & 0x3f);
+  TEST_ASSERT_EQUAL(0, RTPOOL_UART_PRIORITY & 0x3f);
+}
+
+static int runUnityTests_rtpool(void) {
+  UnityBegin("RTPOOL");
+  RUN_TEST(test_rtpool_bins);
+  RUN_TEST(test_rtpool_latency);
+  RUN_TEST(test_rtpool_priorities);
+  return UNITY_END();
+}
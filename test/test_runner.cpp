@@ -2,6 +2,30 @@
 #include <stdio.h>
 #include "test_packet.hpp"
 #include "test_kissesctelem.hpp"
+#include "test_dlog.hpp"
+#include "test_telemstream.hpp"
+#include "test_hostcmd.hpp"
+#include "test_profile.hpp"
+#include "test_setpoint.hpp"
+#include "test_telemstats.hpp"
+#include "test_energy.hpp"
+#include "test_rpmctl.hpp"
+#include "test_sweep.hpp"
+#include "test_telemlatency.hpp"
+#include "test_telemhistory.hpp"
+#include "test_telemdecim.hpp"
+#include "test_dshotspeed.hpp"
+#include "test_clocksolver.hpp"
+#include "test_dutycal.hpp"
+#include "test_dmachain.hpp"
+#include "test_bootcfg.hpp"
+#include "test_virtual_esc.hpp"
+#include "test_telemhealth.hpp"
+#include "test_replay_session.hpp"
+#include "test_telemlog.hpp"
+#include "test_rtpool.hpp"
+#include "test_onewireparse.hpp"
+#include "test_replaycap.hpp"
 
 void setUp(void)
 {
@@ -22,5 +46,29 @@ int main(void)
   int retval = 0;
   retval += runUnityTests_packet();
   retval += runUnityTests_kissesctelem();
+  retval += runUnityTests_dlog();
+  retval += runUnityTests_telemstream();
+  retval += runUnityTests_hostcmd();
+  retval += runUnityTests_profile();
+  retval += runUnityTests_setpoint();
+  retval += runUnityTests_telemstats();
+  retval += runUnityTests_energy();
+  retval += runUnityTests_rpmctl();
+  retval += runUnityTests_sweep();
+  retval += runUnityTests_telemlatency();
+  retval += runUnityTests_telemhistory();
+  retval += runUnityTests_telemdecim();
+  retval += runUnityTests_dshotspeed();
+  retval += runUnityTests_clocksolver();
+  retval += runUnityTests_dutycal();
+  retval += runUnityTests_dmachain();
+  retval += runUnityTests_bootcfg();
+  retval += runUnityTests_virtual_esc();
+  retval += runUnityTests_telemhealth();
+  retval += runUnityTests_replay_session();
+  retval += runUnityTests_telemlog();
+  retval += runUnityTests_rtpool();
+  retval += runUnityTests_onewireparse();
+  retval += runUnityTests_replaycap();
   return retval;
 }
\ No newline at end of file
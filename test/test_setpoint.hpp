@@ -0,0 +1,82 @@
+#include "setpoint.h"
+#include "unity.h"
+#include <stdio.h>
+
+/**
+ * @brief With a fixed span, the output ramps linearly and lands exactly
+ * on the setpoint
+ */
+static void test_setpoint_interpolation(void) {
+  setpoint_t sp;
+  setpoint_init(&sp, 100, 0, 4, SETPOINT_MAX_INTERP_FRAMES);
+  TEST_ASSERT_EQUAL(100, setpoint_step(&sp));
+
+  setpoint_set(&sp, 200);
+  const uint16_t expected[] = {125, 150, 175, 200, 200};
+  for (const auto code : expected) {
+    TEST_ASSERT_EQUAL(code, setpoint_step(&sp));
+  }
+
+  // Uneven steps still end on the setpoint
+  setpoint_set(&sp, 101);
+  for (int i = 0; i < 3; ++i) {
+    setpoint_step(&sp);
+  }
+  TEST_ASSERT_EQUAL(101, setpoint_step(&sp));
+}
+
+/**
+ * @brief With a measured span, the reference arrives at the setpoint as
+ * the next one is expected
+ */
+static void test_setpoint_measured_span(void) {
+  setpoint_t sp;
+  setpoint_init(&sp, 100, 0, 0, 1000);
+  setpoint_set(&sp, 100);
+  setpoint_step(&sp);
+  for (int i = 0; i < 9; ++i) {
+    setpoint_step(&sp);
+  }
+
+  // 10 frames between setpoints
+  setpoint_set(&sp, 200);
+  uint16_t code = 0;
+  for (int i = 1; i <= 10; ++i) {
+    code = setpoint_step(&sp);
+    TEST_ASSERT_EQUAL(100 + 10 * i, code);
+  }
+}
+
+/**
+ * @brief The slew limit bounds the change per frame, and a special
+ * command is sent at once. Throttle resumes from zero throttle
+ */
+static void test_setpoint_slew_and_commands(void) {
+  setpoint_t sp;
+  setpoint_init(&sp, 0, 10 << SETPOINT_FRAC_BITS, 1,
+                SETPOINT_MAX_INTERP_FRAMES);
+  TEST_ASSERT_EQUAL(0, setpoint_step(&sp));
+
+  setpoint_set(&sp, 98);
+  for (int i = 1; i <= 5; ++i) {
+    TEST_ASSERT_EQUAL(48 + 10 * i, setpoint_step(&sp));
+  }
+  TEST_ASSERT_EQUAL(98, setpoint_step(&sp));
+
+  setpoint_set(&sp, 1); // beep
+  TEST_ASSERT_EQUAL(1, setpoint_step(&sp));
+  setpoint_set(&sp, 1000);
+  TEST_ASSERT_EQUAL(58, setpoint_step(&sp));
+
+  // 1000 codes/s at 8 kHz is 0.125 codes per frame
+  TEST_ASSERT_EQUAL(SETPOINT_ONE / 8, setpoint_slew_per_frame(1000, 8000));
+  TEST_ASSERT_EQUAL(0, setpoint_slew_per_frame(0, 8000));
+}
+
+static int runUnityTests_setpoint(void) {
+  UnityBegin("SETPOINT");
+  RUN_TEST(test_setpoint_interpolation);
+  RUN_TEST(test_setpoint_measured_span);
+  RUN_TEST(test_setpoint_slew_and_commands);
+  return UNITY_END();
+}
@@ -0,0 +1,147 @@
+#include "motor_model.hpp"
+#include "sweep.h"
+#include "unity.h"
+#include <stdio.h>
+
+static const uint16_t sweep_test_codes[] = {448, 848, 1248};
+
+static const sweep_config_t sweep_test_config = {
+    .codes = sweep_test_codes,
+    .steps = 3,
+    .end_code = 48,
+    .min_settle_us = 20000,
+    .max_settle_us = 2000000,
+    .erpm_std_max = 100,
+    .current_std_max = 20,
+    .measure_samples = 100,
+};
+
+/**
+ * @brief run a sweep against the motor model, with telemetry every 1 ms
+ *
+ * @param sweep
+ * @param noise peak to peak erpm / 100 noise added to each sample
+ * @param results output, one per step
+ * @param duration_us give up after this
+ * @return number of results
+ */
+static size_t sweep_test_run(sweep_t *const sweep, const uint32_t noise,
+                             sweep_result_t results[],
+                             const uint32_t duration_us) {
+  setpoint_t *const sp = sweep->setpoint;
+  motor_model_t motor = {
+      .rpm = 0, .max_rpm = 30000, .sag = 0.15, .tau_s = 0.04, .poles = 14};
+  size_t count = 0;
+  uint32_t state = 1;
+
+  sweep_start(sweep, 0);
+  for (uint32_t t = 0; t < duration_us && sweep->state != SWEEP_DONE;
+       t += 1000) {
+    for (int frame = 0; frame < 7; ++frame) {
+      motor_model_step(&motor, setpoint_step(sp), 1000e-6 / 7);
+    }
+    state = state * 1664525u + 1013904223u;
+    kissesc_telem_t telem = {};
+    telem.temperature = 30 + t / 100000;
+    telem.centi_voltage = 1600;
+    telem.centi_current = (uint16_t)(motor.rpm / 20);
+    telem.erpm =
+        motor_model_erpm(&motor) + (noise ? 100 * ((state >> 8) % noise) : 0);
+    if (sweep_update(sweep, &telem, t))
+      results[count++] = sweep->result;
+  }
+  return count;
+}
+
+/**
+ * @brief Each step ends once the motor has settled, and its aggregate
+ * matches the steady state of the motor
+ */
+static void test_sweep_settle(void) {
+  setpoint_t sp;
+  setpoint_init(&sp, 48, 0, 1, SETPOINT_MAX_INTERP_FRAMES);
+  sweep_t sweep;
+  sweep_init(&sweep, &sweep_test_config, &sp);
+
+  sweep_result_t results[3];
+  TEST_ASSERT_EQUAL(3, sweep_test_run(&sweep, 0, results, 10000000));
+  TEST_ASSERT_EQUAL(SWEEP_DONE, sweep.state);
+  TEST_ASSERT_EQUAL(48, sp.pending_code);
+
+  const motor_model_t motor = {
+      .rpm = 0, .max_rpm = 30000, .sag = 0.15, .tau_s = 0.04, .poles = 14};
+  for (size_t i = 0; i < 3; ++i) {
+    const sweep_result_t *const r = &results[i];
+    TEST_ASSERT_EQUAL(i, r->step);
+    TEST_ASSERT_EQUAL(sweep_test_codes[i], r->code);
+    TEST_ASSERT_EQUAL(SWEEP_FLAG_SETTLED | (i == 2 ? SWEEP_FLAG_LAST : 0),
+                      r->flags);
+    TEST_ASSERT_EQUAL(100, r->samples);
+    // Settled within a few time constants, far sooner than the timeout
+    TEST_ASSERT_LESS_THAN(300, r->settle_ms);
+    const double erpm = motor_model_steady_rpm(&motor, r->code) * 7;
+    TEST_ASSERT_FLOAT_WITHIN(0.01 * erpm, erpm, r->erpm_mean);
+    TEST_ASSERT_LESS_THAN(300, r->erpm_std);
+    TEST_ASSERT_EQUAL(1600, r->voltage_mean);
+  }
+}
+
+/**
+ * @brief A step that never gets quiet enough is measured after the
+ * timeout, and flagged
+ */
+static void test_sweep_timeout(void) {
+  setpoint_t sp;
+  setpoint_init(&sp, 48, 0, 1, SETPOINT_MAX_INTERP_FRAMES);
+  sweep_config_t config = sweep_test_config;
+  config.steps = 1;
+  config.max_settle_us = 500000;
+  sweep_t sweep;
+  sweep_init(&sweep, &config, &sp);
+
+  // 0 - 4000 erpm of noise
+  sweep_result_t result;
+  TEST_ASSERT_EQUAL(1, sweep_test_run(&sweep, 40, &result, 10000000));
+  TEST_ASSERT_EQUAL(SWEEP_FLAG_TIMEOUT | SWEEP_FLAG_LAST, result.flags);
+  TEST_ASSERT_EQUAL(500, result.settle_ms);
+  TEST_ASSERT_GREATER_THAN(300, result.erpm_std);
+}
+
+static void test_sweep_record(void) {
+  const sweep_result_t result = {.step = 3,
+                                 .flags = SWEEP_FLAG_SETTLED,
+                                 .code = 1048,
+                                 .settle_ms = 123,
+                                 .samples = 200,
+                                 .erpm_mean = 123456,
+                                 .erpm_std = 250,
+                                 .current_mean = 1234,
+                                 .current_std = 5,
+                                 .voltage_mean = 1580,
+                                 .temperature_max = -5};
+  uint8_t record[SWEEP_RECORD_SIZE];
+  sweep_encode(&result, record);
+
+  sweep_result_t decoded;
+  TEST_ASSERT_TRUE(sweep_decode(record, &decoded));
+  TEST_ASSERT_EQUAL(3, decoded.step);
+  TEST_ASSERT_EQUAL(1048, decoded.code);
+  TEST_ASSERT_EQUAL(123456, decoded.erpm_mean);
+  TEST_ASSERT_EQUAL(1580, decoded.voltage_mean);
+  TEST_ASSERT_EQUAL(-5, decoded.temperature_max);
+
+  record[10] ^= 1;
+  TEST_ASSERT_FALSE(sweep_decode(record, &decoded));
+
+  TEST_ASSERT_EQUAL(0, sweep_isqrt(0));
+  TEST_ASSERT_EQUAL(3, sweep_isqrt(15));
+  TEST_ASSERT_EQUAL(65535, sweep_isqrt(0xffffffffull));
+}
+
+static int runUnityTests_sweep(void) {
+  UnityBegin("SWEEP");
+  RUN_TEST(test_sweep_settle);
+  RUN_TEST(test_sweep_timeout);
+  RUN_TEST(test_sweep_record);
+  return UNITY_END();
+}
@@ -0,0 +1,137 @@
+#include "telemdecim.h"
+#include "unity.h"
+#include <stdio.h>
+
+static telem_sample_t telemdecim_sample(const uint32_t timestamp_us,
+                                        const uint16_t centi_current,
+                                        const uint32_t erpm) {
+  telem_sample_t sample = {};
+  sample.timestamp_us = timestamp_us;
+  sample.telem.temperature = 25;
+  sample.telem.centi_voltage = 1600;
+  sample.telem.centi_current = centi_current;
+  sample.telem.consumption = 12;
+  sample.telem.erpm = erpm;
+  return sample;
+}
+
+/**
+ * @brief One record per N samples keeps the peak of a one sample spike,
+ * and corrupt samples are only counted
+ */
+static void test_telemdecim_samples(void) {
+  const telemdecim_config_t config = {.samples = 4, .window_us = 0};
+  telemdecim_t decim;
+  telemdecim_init(&decim, 2, &config);
+  telemdecim_record_t record;
+
+  const uint16_t currents[] = {100, 900, 102, 103};
+  for (int i = 0; i < 3; ++i) {
+    telem_sample_t sample = telemdecim_sample(1000 * i, currents[i], 50000);
+    TEST_ASSERT_FALSE(telemdecim_update(&decim, &sample, &record));
+  }
+  telem_sample_t corrupt = telemdecim_sample(3000, 5000, 0);
+  corrupt.telem.crc = 0x42;
+  TEST_ASSERT_FALSE(telemdecim_update(&decim, &corrupt, &record));
+  telem_sample_t sample = telemdecim_sample(4000, currents[3], 50100);
+  TEST_ASSERT_TRUE(telemdecim_update(&decim, &sample, &record));
+
+  TEST_ASSERT_EQUAL(2, record.esc_idx);
+  TEST_ASSERT_EQUAL(4, record.count);
+  TEST_ASSERT_EQUAL(1, record.bad);
+  TEST_ASSERT_EQUAL(0, record.first_us);
+  TEST_ASSERT_EQUAL(4000, record.last_us);
+  TEST_ASSERT_EQUAL(100, record.min[TELEMDECIM_CURRENT]);
+  TEST_ASSERT_EQUAL(900, record.max[TELEMDECIM_CURRENT]);
+  // (100 + 900 + 102 + 103) / 4 = 301.25
+  TEST_ASSERT_EQUAL(301, record.mean[TELEMDECIM_CURRENT]);
+  TEST_ASSERT_EQUAL(103, record.last[TELEMDECIM_CURRENT]);
+  TEST_ASSERT_EQUAL(501, record.max[TELEMDECIM_ERPM]);
+  TEST_ASSERT_EQUAL(25, record.mean[TELEMDECIM_TEMPERATURE]);
+
+  // The next window starts empty
+  TEST_ASSERT_FALSE(telemdecim_flush(&decim, &record));
+}
+
+/**
+ * @brief A time window closes once it spans window_us, and the ratio can
+ * be changed at runtime
+ */
+static void test_telemdecim_window(void) {
+  const telemdecim_config_t config = {.samples = 0, .window_us = 10000};
+  telemdecim_t decim;
+  telemdecim_init(&decim, 0, &config);
+  telemdecim_record_t record;
+
+  int records = 0;
+  // Start just before the timer wraps around
+  const uint32_t start_us = UINT32_MAX - 4000;
+  for (uint32_t t = 0; t <= 30000; t += 1000) {
+    telem_sample_t sample = telemdecim_sample(start_us + t, 100, 10000);
+    if (telemdecim_update(&decim, &sample, &record)) {
+      TEST_ASSERT_EQUAL(11, record.count);
+      TEST_ASSERT_EQUAL(10000, record.last_us - record.first_us);
+      records++;
+    }
+  }
+  // [0, 10], [11, 21], then [22, 30] is still open
+  TEST_ASSERT_EQUAL(2, records);
+  TEST_ASSERT_TRUE(telemdecim_flush(&decim, &record));
+  TEST_ASSERT_EQUAL(9, record.count);
+
+  // Pass through
+  const telemdecim_config_t every = {.samples = 0, .window_us = 0};
+  telemdecim_set_config(&decim, &every);
+  telem_sample_t sample = telemdecim_sample(0, 100, 10000);
+  TEST_ASSERT_TRUE(telemdecim_update(&decim, &sample, &record));
+  TEST_ASSERT_EQUAL(1, record.count);
+}
+
+/**
+ * @brief Records survive an encode / decode round trip, and a corrupt
+ * record is rejected
+ */
+static void test_telemdecim_record(void) {
+  telemdecim_record_t record = {};
+  record.esc_idx = 7;
+  record.bad = 3;
+  record.count = 500;
+  record.first_us = 0x01020304;
+  record.last_us = 0x05060708;
+  for (int f = 0; f < TELEMDECIM_FIELDS; ++f) {
+    record.min[f] = f == TELEMDECIM_TEMPERATURE ? -5 : 1000 + f;
+    record.max[f] = 60000 + f;
+    record.mean[f] = 30000 + f;
+    record.last[f] = 40000 + f;
+  }
+  record.max[TELEMDECIM_TEMPERATURE] = 80;
+  record.mean[TELEMDECIM_TEMPERATURE] = 40;
+  record.last[TELEMDECIM_TEMPERATURE] = 41;
+
+  uint8_t bytes[TELEMDECIM_RECORD_SIZE];
+  telemdecim_encode(&record, 0xabcd, bytes);
+  telemdecim_record_t decoded;
+  uint16_t seq;
+  TEST_ASSERT_TRUE(telemdecim_decode(bytes, &decoded, &seq));
+  TEST_ASSERT_EQUAL(0xabcd, seq);
+  TEST_ASSERT_EQUAL(7, decoded.esc_idx);
+  TEST_ASSERT_EQUAL(3, decoded.bad);
+  TEST_ASSERT_EQUAL(500, decoded.count);
+  TEST_ASSERT_EQUAL_HEX32(0x01020304, decoded.first_us);
+  TEST_ASSERT_EQUAL_HEX32(0x05060708, decoded.last_us);
+  TEST_ASSERT_EQUAL_INT32_ARRAY(record.min, decoded.min, TELEMDECIM_FIELDS);
+  TEST_ASSERT_EQUAL_INT32_ARRAY(record.max, decoded.max, TELEMDECIM_FIELDS);
+  TEST_ASSERT_EQUAL_INT32_ARRAY(record.mean, decoded.mean, TELEMDECIM_FIELDS);
+  TEST_ASSERT_EQUAL_INT32_ARRAY(record.last, decoded.last, TELEMDECIM_FIELDS);
+
+  bytes[30] ^= 0x10;
+  TEST_ASSERT_FALSE(telemdecim_decode(bytes, &decoded, &seq));
+}
+
+static int runUnityTests_telemdecim(void) {
+  UnityBegin("TELEMDECIM");
+  RUN_TEST(test_telemdecim_samples);
+  RUN_TEST(test_telemdecim_window);
+  RUN_TEST(test_telemdecim_record);
+  return UNITY_END();
+}
@@ -0,0 +1,93 @@
+#include "telemhealth.h"
+#include "unity.h"
+#include <stdio.h>
+
+/**
+ * @brief Each slot is classified once, and the per slot counts are reset
+ */
+static void test_telemhealth_slots(void) {
+  telemhealth_t health;
+  telemhealth_init(&health, 3);
+  TEST_ASSERT_EQUAL(UINT32_MAX, telemhealth_age_us(&health, 100));
+
+  // Valid reply
+  telemhealth_reply(&health, true, 1000);
+  TEST_ASSERT_FALSE(telemhealth_slot_end(&health, 0, true));
+  TEST_ASSERT_EQUAL(TELEMHEALTH_SLOT_VALID, health.last_slot);
+  TEST_ASSERT_EQUAL(250, telemhealth_age_us(&health, 1250));
+
+  // A bad crc, and bytes left over: both resync the parser
+  telemhealth_reply(&health, false, 2000);
+  TEST_ASSERT_TRUE(telemhealth_slot_end(&health, 0, true));
+  TEST_ASSERT_EQUAL(TELEMHEALTH_SLOT_BAD, health.last_slot);
+  TEST_ASSERT_TRUE(telemhealth_slot_end(&health, 4, true));
+  TEST_ASSERT_EQUAL(TELEMHEALTH_SLOT_PARTIAL, health.last_slot);
+
+  // Nothing came back, or nothing was asked
+  TEST_ASSERT_TRUE(telemhealth_slot_end(&health, 0, true));
+  TEST_ASSERT_EQUAL(TELEMHEALTH_SLOT_MISSING, health.last_slot);
+  TEST_ASSERT_FALSE(telemhealth_slot_end(&health, 0, false));
+  TEST_ASSERT_EQUAL(TELEMHEALTH_SLOT_UNSENT, health.last_slot);
+
+  TEST_ASSERT_EQUAL(1, health.valid);
+  TEST_ASSERT_EQUAL(1, health.bad);
+  TEST_ASSERT_EQUAL(1, health.partial);
+  TEST_ASSERT_EQUAL(1, health.missing);
+  TEST_ASSERT_EQUAL(1, health.unsent);
+  TEST_ASSERT_EQUAL(4, health.consecutive);
+  // The bad, partial and stale (3rd) slots
+  TEST_ASSERT_EQUAL(3, health.recoveries);
+  // The age is from the last valid reply, modulo 2^32
+  TEST_ASSERT_EQUAL(100, telemhealth_age_us(&health, 1100));
+  TEST_ASSERT_EQUAL(UINT32_MAX - 99, telemhealth_age_us(&health, 900));
+}
+
+/**
+ * @brief A dead ESC goes stale after exactly stale_cycles slots, and
+ * recovers on the first valid reply
+ */
+static void test_telemhealth_stale(void) {
+  const uint16_t stale_cycles[] = {1, 2, 5};
+  for (const auto cycles : stale_cycles) {
+    telemhealth_t health;
+    telemhealth_init(&health, cycles);
+    telemhealth_reply(&health, true, 0);
+    telemhealth_slot_end(&health, 0, true);
+
+    for (int slot = 1; slot <= cycles; ++slot) {
+      const bool resync = telemhealth_slot_end(&health, 0, true);
+      TEST_ASSERT_EQUAL(slot == cycles, health.stale);
+      // Resynced once, when it goes stale
+      TEST_ASSERT_EQUAL(slot == cycles, resync);
+    }
+    // Still stale, without resyncing at every slot
+    TEST_ASSERT_FALSE(telemhealth_slot_end(&health, 0, true));
+    TEST_ASSERT_TRUE(health.stale);
+    TEST_ASSERT_EQUAL(cycles + 1, health.consecutive);
+
+    // A corrupt reply doesn't clear it, a valid one does
+    telemhealth_reply(&health, false, 0);
+    telemhealth_slot_end(&health, 0, true);
+    TEST_ASSERT_TRUE(health.stale);
+    telemhealth_reply(&health, false, 0);
+    telemhealth_reply(&health, true, 500);
+    TEST_ASSERT_FALSE(telemhealth_slot_end(&health, 0, true));
+    TEST_ASSERT_FALSE(health.stale);
+    TEST_ASSERT_EQUAL(0, health.consecutive);
+  }
+  // 0 is taken as 1
+  telemhealth_t health;
+  telemhealth_init(&health, 0);
+  TEST_ASSERT_TRUE(telemhealth_slot_end(&health, 0, true));
+  TEST_ASSERT_TRUE(health.stale);
+
+  // 3 slots of 1 ms, shared by 4 ESCs
+  TEST_ASSERT_EQUAL(12000, telemhealth_detect_us(3, 1000, 4));
+}
+
+static int runUnityTests_telemhealth(void) {
+  UnityBegin("TELEMHEALTH");
+  RUN_TEST(test_telemhealth_slots);
+  RUN_TEST(test_telemhealth_stale);
+  return UNITY_END();
+}
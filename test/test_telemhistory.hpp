@@ -0,0 +1,109 @@
+#include "telemhistory.h"
+#include "unity.h"
+#include <stdio.h>
+
+static telemhistory_t telemhistory_test_hist;
+
+/**
+ * @brief push \a n samples, 1 ms apart from \a start_us. erpm counts the
+ * samples pushed so far
+ */
+static void telemhistory_fill(telemhistory_t *const hist, const uint32_t n,
+                              const uint32_t start_us) {
+  kissesc_telem_t telem = {};
+  for (uint32_t i = 0; i < n; ++i) {
+    telem.erpm = 100 * (i & 0xffff);
+    telem.centi_voltage = 1600;
+    telem.centi_current = (uint16_t)i;
+    telem.temperature = 30;
+    telemhistory_push(hist, &telem, start_us + 1000 * i);
+  }
+}
+
+/**
+ * @brief Once full, the ring keeps the newest samples, with their
+ * sequence numbers
+ */
+static void test_telemhistory_wrap_around(void) {
+  telemhistory_t *const hist = &telemhistory_test_hist;
+  telemhistory_init(hist);
+  telemhistory_sample_t sample;
+  TEST_ASSERT_EQUAL(0, telemhistory_count(hist));
+  TEST_ASSERT_FALSE(telemhistory_get(hist, 0, &sample));
+
+  const uint32_t n = TELEMHISTORY_CAPACITY + 100;
+  telemhistory_fill(hist, n, 0);
+  TEST_ASSERT_EQUAL(TELEMHISTORY_CAPACITY, telemhistory_count(hist));
+  TEST_ASSERT_EQUAL(100, telemhistory_oldest(hist));
+  TEST_ASSERT_FALSE(telemhistory_get(hist, 99, &sample));
+  TEST_ASSERT_FALSE(telemhistory_get(hist, n, &sample));
+
+  TEST_ASSERT_TRUE(telemhistory_get(hist, n - 1, &sample));
+  TEST_ASSERT_EQUAL(1000 * (n - 1), sample.timestamp_us);
+  TEST_ASSERT_EQUAL(n - 1, sample.erpm);
+  TEST_ASSERT_EQUAL(1600, sample.centi_voltage);
+  TEST_ASSERT_EQUAL(30, sample.temperature);
+}
+
+/**
+ * @brief Range queries find [from, to), also across the timer wrap around
+ */
+static void test_telemhistory_range(void) {
+  telemhistory_t *const hist = &telemhistory_test_hist;
+  telemhistory_init(hist);
+  // Sample 500 is the first one after the timer wraps around
+  const uint32_t start_us = (uint32_t)(0 - 500 * 1000);
+  telemhistory_fill(hist, 1000, start_us);
+
+  uint32_t begin, end;
+  TEST_ASSERT_EQUAL(20, telemhistory_range(hist, start_us + 490 * 1000,
+                                           start_us + 510 * 1000, &begin,
+                                           &end));
+  TEST_ASSERT_EQUAL(490, begin);
+  TEST_ASSERT_EQUAL(510, end);
+
+  // Between samples
+  TEST_ASSERT_EQUAL(1, telemhistory_range(hist, start_us + 499 * 1000 + 1,
+                                          start_us + 500 * 1000 + 1, &begin,
+                                          &end));
+  TEST_ASSERT_EQUAL(500, begin);
+
+  // Before the oldest sample, and after the newest
+  TEST_ASSERT_EQUAL(10, telemhistory_range(hist, start_us - 5000,
+                                           start_us + 10 * 1000, &begin,
+                                           &end));
+  TEST_ASSERT_EQUAL(0, begin);
+  TEST_ASSERT_EQUAL(0, telemhistory_range(hist, start_us + 1000 * 1000,
+                                          start_us + 2000 * 1000, &begin,
+                                          &end));
+  TEST_ASSERT_EQUAL(1000, begin);
+}
+
+/**
+ * @brief Decimated readout picks every stride th sample, clamped to the
+ * range and to the output
+ */
+static void test_telemhistory_decimated_read(void) {
+  telemhistory_t *const hist = &telemhistory_test_hist;
+  telemhistory_init(hist);
+  telemhistory_fill(hist, TELEMHISTORY_CAPACITY + 10, 0);
+
+  telemhistory_sample_t out[8];
+  // Starts from the oldest sample still held
+  size_t n = telemhistory_read(hist, 0, 40, 10, out, 8);
+  TEST_ASSERT_EQUAL(3, n);
+  TEST_ASSERT_EQUAL(10, out[0].erpm);
+  TEST_ASSERT_EQUAL(30, out[2].erpm);
+
+  n = telemhistory_read(hist, 100, hist->head, 100, out, 8);
+  TEST_ASSERT_EQUAL(8, n);
+  TEST_ASSERT_EQUAL(800, out[7].erpm);
+}
+
+static int runUnityTests_telemhistory(void) {
+  UnityBegin("TELEMHISTORY");
+  RUN_TEST(test_telemhistory_wrap_around);
+  RUN_TEST(test_telemhistory_range);
+  RUN_TEST(test_telemhistory_decimated_read);
+  return UNITY_END();
+}
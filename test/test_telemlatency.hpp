@@ -0,0 +1,76 @@
+#include "telemlatency.h"
+#include "unity.h"
+#include <stdio.h>
+
+/**
+ * @brief Byte arrival times are worked back from the isr time: one byte
+ * period apart, and 32 bit periods earlier after an rx timeout
+ */
+static void test_telemlatency_chunk_times(void) {
+  // 10 bits at 115200 baud = 86.8 us, 32 bits = 277.8 us
+  TEST_ASSERT_EQUAL(87, telemlatency_bits_us(10, 115200));
+  TEST_ASSERT_EQUAL(278, telemlatency_bits_us(32, 115200));
+
+  uint32_t first_us, last_us;
+  telemlatency_chunk_times(10000, 4, false, 115200, &first_us, &last_us);
+  TEST_ASSERT_EQUAL(10000, last_us);
+  TEST_ASSERT_EQUAL(10000 - 3 * 87, first_us);
+
+  telemlatency_chunk_times(10000, 2, true, 115200, &first_us, &last_us);
+  TEST_ASSERT_EQUAL(10000 - 278, last_us);
+  TEST_ASSERT_EQUAL(10000 - 278 - 87, first_us);
+
+  // Across the timer wrap around
+  telemlatency_chunk_times(100, 4, true, 115200, &first_us, &last_us);
+  TEST_ASSERT_EQUAL(100 - 278 - 3 * 87, (int32_t)first_us);
+}
+
+/**
+ * @brief Statistics of matched samples, and unmatched ones are counted
+ */
+static void test_telemlatency_update(void) {
+  telemlatency_t lat;
+  telemlatency_init(&lat);
+  TEST_ASSERT_EQUAL(0, telemlatency_mean_us(&lat, &lat.reply));
+
+  telem_sample_t sample = {.timestamp_us = 0,
+                           .esc_idx = 0,
+                           .telem = {},
+                           .first_byte_us = 0,
+                           .request_us = 0,
+                           .request_code = 1048,
+                           .request_valid = true};
+  const uint32_t replies[] = {150, 250, 200};
+  // Start just before the timer wraps around
+  uint32_t t = UINT32_MAX - 1000;
+  for (const auto reply : replies) {
+    sample.request_us = t;
+    sample.first_byte_us = t + reply;
+    sample.timestamp_us = t + reply + 800;
+    TEST_ASSERT_TRUE(telemlatency_update(&lat, &sample));
+    t += 1000;
+  }
+  TEST_ASSERT_EQUAL(3, lat.count);
+  TEST_ASSERT_EQUAL(150, lat.reply.min);
+  TEST_ASSERT_EQUAL(250, lat.reply.max);
+  TEST_ASSERT_EQUAL(200, lat.reply.last);
+  TEST_ASSERT_EQUAL(200, telemlatency_mean_us(&lat, &lat.reply));
+  TEST_ASSERT_EQUAL(1000, telemlatency_mean_us(&lat, &lat.total));
+
+  // The request frame hadn't been sent
+  sample.request_valid = false;
+  TEST_ASSERT_FALSE(telemlatency_update(&lat, &sample));
+  // A reply before its request
+  sample.request_valid = true;
+  sample.request_us = sample.first_byte_us + 10;
+  TEST_ASSERT_FALSE(telemlatency_update(&lat, &sample));
+  TEST_ASSERT_EQUAL(3, lat.count);
+  TEST_ASSERT_EQUAL(2, lat.unmatched);
+}
+
+static int runUnityTests_telemlatency(void) {
+  UnityBegin("TELEMLATENCY");
+  RUN_TEST(test_telemlatency_chunk_times);
+  RUN_TEST(test_telemlatency_update);
+  return UNITY_END();
+}
@@ -0,0 +1,171 @@
+#include "telemlog_reader.hpp"
+#include "unity.h"
+#include <stdio.h>
+
+static telem_sample_t telemlog_test_sample(const uint32_t t_us,
+                                           const uint8_t esc) {
+  telem_sample_t sample = {};
+  sample.timestamp_us = t_us;
+  sample.esc_idx = esc;
+  sample.telem.temperature = -5;
+  sample.telem.centi_voltage = 1680;
+  sample.telem.centi_current = (uint16_t)(t_us / 1000);
+  sample.telem.consumption = 7;
+  sample.telem.erpm = 123400;
+  return sample;
+}
+
+/**
+ * @brief Columns are aligned and fit in a chunk, and the header round trips
+ */
+static void test_telemlog_layout(void) {
+  TEST_ASSERT_EQUAL(270, TELEMLOG_CAPACITY);
+  for (int f = 0; f < TELEMLOG_FIELDS; ++f)
+    TEST_ASSERT_EQUAL(0, telemlog_column_offset((enum telemlog_field)f) %
+                            telemlog_field_size[f]);
+  TEST_ASSERT_TRUE(telemlog_column_offset(TELEMLOG_CRC) + TELEMLOG_CAPACITY <=
+                   TELEMLOG_CHUNK_SIZE);
+
+  telemlog_header_t h = {7, 1ull << 33, (1ull << 33) + 5, 0x80000005, 12};
+  uint8_t bytes[TELEMLOG_HEADER_SIZE];
+  telemlog_encode_header(&h, bytes);
+  telemlog_header_t out;
+  TEST_ASSERT_TRUE(telemlog_decode_header(bytes, &out));
+  TEST_ASSERT_EQUAL(7, out.seq);
+  TEST_ASSERT_TRUE(out.first_us == h.first_us && out.last_us == h.last_us);
+  TEST_ASSERT_EQUAL_HEX32(0x80000005, out.esc_mask);
+  TEST_ASSERT_EQUAL(12, out.count);
+  bytes[20] ^= 1;
+  TEST_ASSERT_FALSE(telemlog_decode_header(bytes, &out));
+
+  // 32 bit timestamps extend across the wrap around, both ways
+  TEST_ASSERT_TRUE(telemlog_extend_us(0xfffffff0ull, 0x10) == 0x100000010ull);
+  TEST_ASSERT_TRUE(telemlog_extend_us(0x100000010ull, 0xfffffff0u) ==
+                   0xfffffff0ull);
+}
+
+/**
+ * @brief Samples are appended until the chunk is full, and their times
+ * extended to 64 bit across the wrap around of time_us_32()
+ */
+static void test_telemlog_append(void) {
+  static telemlog_t log;
+  telemlog_init(&log, 0xffff0000ull);
+  uint32_t t = 0xffff0000u;
+  for (int i = 0; i < TELEMLOG_CAPACITY; ++i, t += 1000) {
+    const telem_sample_t sample = telemlog_test_sample(t, i % 3);
+    TEST_ASSERT_TRUE(telemlog_append(&log, &sample));
+  }
+  const telem_sample_t sample = telemlog_test_sample(t, 0);
+  TEST_ASSERT_FALSE(telemlog_append(&log, &sample));
+  TEST_ASSERT_EQUAL(TELEMLOG_CAPACITY, log.header.count);
+  TEST_ASSERT_EQUAL_HEX32(0x7, log.header.esc_mask);
+  TEST_ASSERT_TRUE(log.header.first_us == 0xffff0000ull);
+  TEST_ASSERT_TRUE(log.header.last_us ==
+                   0xffff0000ull + (TELEMLOG_CAPACITY - 1) * 1000ull);
+
+  const uint8_t *const chunk = telemlog_finish(&log);
+  telemlog_header_t h;
+  TEST_ASSERT_TRUE(telemlog_decode_header(chunk, &h));
+  TEST_ASSERT_EQUAL(TELEMLOG_CAPACITY, h.count);
+  const uint8_t *const time = chunk + telemlog_column_offset(TELEMLOG_TIME);
+  TEST_ASSERT_EQUAL(1000, telemlog_get(time + 4, 4));
+  TEST_ASSERT_EQUAL(
+      -5, (int8_t)chunk[telemlog_column_offset(TELEMLOG_TEMPERATURE) + 1]);
+  TEST_ASSERT_EQUAL(
+      1234, telemlog_get(chunk + telemlog_column_offset(TELEMLOG_ERPM), 2));
+
+  // The next chunk starts empty, and takes the sample
+  telemlog_next(&log);
+  TEST_ASSERT_EQUAL(1, log.header.seq);
+  TEST_ASSERT_TRUE(telemlog_append(&log, &sample));
+  TEST_ASSERT_TRUE(log.header.first_us == 0x100000000ull +
+                                              (uint32_t)(t - 0x100000000ull));
+
+  // A sample from before the first one doesn't fit
+  const telem_sample_t late = telemlog_test_sample(t - 10, 0);
+  TEST_ASSERT_FALSE(telemlog_append(&log, &late));
+}
+
+/**
+ * @brief A packed capture is read back through the index: a time range
+ * of one ESC returns exactly its samples, and the index matches a scan
+ */
+static void test_telemlog_reader(void) {
+  // A capture with a partial line of text before the chunks
+  std::vector<uint8_t> capture = {'b', 'o', 'o', 't', '\n'};
+  static telemlog_t log;
+  telemlog_init(&log, 0);
+  int samples = 0;
+  for (uint32_t t = 0; t < 2000000; t += 500) {
+    const telem_sample_t sample = telemlog_test_sample(t, (t / 500) % 4);
+    if (!telemlog_append(&log, &sample)) {
+      const uint8_t *const chunk = telemlog_finish(&log);
+      capture.insert(capture.end(), chunk, chunk + TELEMLOG_CHUNK_SIZE);
+      telemlog_next(&log);
+      telemlog_append(&log, &sample);
+    }
+    samples++;
+  }
+  const uint8_t *const chunk = telemlog_finish(&log);
+  capture.insert(capture.end(), chunk, chunk + TELEMLOG_CHUNK_SIZE);
+
+  char path[] = "/tmp/test_telemlog_XXXXXX";
+  const int fd = mkstemp(path);
+  TEST_ASSERT_TRUE(fd >= 0);
+  ::close(fd);
+  FILE *const f = fopen(path, "wb");
+  size_t skipped;
+  const long chunks =
+      telemlog_pack(capture.data(), capture.size(), f, &skipped);
+  fclose(f);
+  TEST_ASSERT_EQUAL(5, skipped);
+  TEST_ASSERT_EQUAL((samples + TELEMLOG_CAPACITY - 1) / TELEMLOG_CAPACITY,
+                    chunks);
+
+  telemlog_reader reader;
+  TEST_ASSERT_TRUE(reader.open(path));
+  TEST_ASSERT_TRUE(reader.indexed);
+  TEST_ASSERT_EQUAL(chunks, reader.chunks);
+
+  // ESC 2 has a sample at 1000 + 2000 k us
+  std::vector<uint64_t> t_us;
+  std::vector<int32_t> current;
+  const size_t n =
+      reader.extract(2, TELEMLOG_CURRENT, 1000000, 1500000, t_us, current);
+  TEST_ASSERT_EQUAL(250, n);
+  TEST_ASSERT_TRUE(t_us.front() == 1001000 && t_us.back() == 1499000);
+  TEST_ASSERT_EQUAL(1001, current.front());
+  TEST_ASSERT_EQUAL(1499, current.back());
+  for (size_t i = 1; i < n; ++i)
+    TEST_ASSERT_TRUE(t_us[i] == t_us[i - 1] + 2000);
+
+  // Out of range, or an ESC that isn't logged
+  TEST_ASSERT_EQUAL(0, reader.extract(2, TELEMLOG_CURRENT, 3000000, 4000000,
+                                      t_us, current));
+  TEST_ASSERT_EQUAL(0, reader.extract(5, TELEMLOG_CURRENT, 0, UINT64_MAX,
+                                      t_us, current));
+
+  // Without the index, the chunks are scanned: same answer
+  FILE *const raw = fopen(path, "wb");
+  fwrite(capture.data() + 5, 1, capture.size() - 5, raw);
+  fclose(raw);
+  telemlog_reader scanned;
+  TEST_ASSERT_TRUE(scanned.open(path));
+  TEST_ASSERT_FALSE(scanned.indexed);
+  TEST_ASSERT_EQUAL(chunks, scanned.chunks);
+  t_us.clear();
+  current.clear();
+  TEST_ASSERT_EQUAL(250, scanned.extract(2, TELEMLOG_CURRENT, 1000000,
+                                         1500000, t_us, current));
+  TEST_ASSERT_EQUAL(1001, current.front());
+  remove(path);
+}
+
+static int runUnityTests_telemlog(void) {
+  UnityBegin("TELEMLOG");
+  RUN_TEST(test_telemlog_layout);
+  RUN_TEST(test_telemlog_append);
+  RUN_TEST(test_telemlog_reader);
+  return UNITY_END();
+}
@@ -0,0 +1,125 @@
+#include "telemstats.h"
+#include "unity.h"
+#include <math.h>
+#include <stdio.h>
+
+static const uint8_t telemstats_test_shifts[TELEMSTATS_EWMA_COUNT] = {2, 6};
+
+/// @brief double precision reference of one channel
+typedef struct telemstats_ref {
+  double n, mean, m2, min, max, ewma[TELEMSTATS_EWMA_COUNT];
+} telemstats_ref_t;
+
+static void telemstats_ref_update(telemstats_ref_t *const ref,
+                                  const double x) {
+  ref->n++;
+  const double delta = x - ref->mean;
+  ref->mean += delta / ref->n;
+  ref->m2 += delta * (x - ref->mean);
+  ref->min = ref->n == 1 ? x : fmin(ref->min, x);
+  ref->max = ref->n == 1 ? x : fmax(ref->max, x);
+  for (int e = 0; e < TELEMSTATS_EWMA_COUNT; ++e) {
+    const double alpha = 1.0 / (1 << telemstats_test_shifts[e]);
+    ref->ewma[e] = ref->n == 1 ? x : ref->ewma[e] + alpha * (x - ref->ewma[e]);
+  }
+}
+
+/// @brief deterministic pseudo random numbers in [0, range)
+static uint32_t telemstats_rand(uint32_t *const state, const uint32_t range) {
+  *state = *state * 1664525u + 1013904223u;
+  return (*state >> 8) % range;
+}
+
+static void telemstats_check(const telemstats_channel_result_t *const ch,
+                             const telemstats_ref_t *const ref) {
+  const double mean = (double)ch->mean / (1 << TELEMSTATS_MEAN_FRAC_BITS);
+  const double var = (double)ch->variance / (1 << TELEMSTATS_M2_FRAC_BITS);
+  const double ref_var = ref->m2 / (ref->n - 1);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3 * fabs(ref->mean) + 1e-3, ref->mean, mean);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3 * ref_var + 0.05, ref_var, var);
+  TEST_ASSERT_EQUAL(ref->min, ch->min);
+  TEST_ASSERT_EQUAL(ref->max, ch->max);
+  for (int e = 0; e < TELEMSTATS_EWMA_COUNT; ++e) {
+    TEST_ASSERT_FLOAT_WITHIN(1e-2 + 1e-4 * fabs(ref->ewma[e]), ref->ewma[e],
+                              (double)ch->ewma[e] /
+                                  (1 << TELEMSTATS_MEAN_FRAC_BITS));
+  }
+}
+
+/**
+ * @brief Fixed point statistics match a double precision reference,
+ * over the full 16 bit range of the wire units
+ */
+static void test_telemstats_reference(void) {
+  telemstats_t stats;
+  telemstats_init(&stats, telemstats_test_shifts);
+  telemstats_ref_t ref[TELEMSTATS_CHANNELS] = {};
+
+  uint32_t state = 1;
+  for (uint32_t i = 0; i < 10000; ++i) {
+    kissesc_telem_t telem = {};
+    telem.temperature = 20 + telemstats_rand(&state, 60);
+    telem.centi_voltage = 1500 + telemstats_rand(&state, 200);
+    telem.centi_current = telemstats_rand(&state, 65536);
+    telem.erpm = 100 * (30000 + telemstats_rand(&state, 20));
+    telemstats_update(&stats, &telem, 1000 + i);
+
+    telemstats_ref_update(&ref[TELEMSTATS_TEMPERATURE], telem.temperature);
+    telemstats_ref_update(&ref[TELEMSTATS_VOLTAGE], telem.centi_voltage);
+    telemstats_ref_update(&ref[TELEMSTATS_CURRENT], telem.centi_current);
+    telemstats_ref_update(&ref[TELEMSTATS_ERPM], telem.erpm / 100);
+  }
+
+  telemstats_result_t result;
+  telemstats_snapshot(&stats, &result, false);
+  TEST_ASSERT_EQUAL(10000, result.count);
+  TEST_ASSERT_EQUAL(1000, result.first_us);
+  TEST_ASSERT_EQUAL(10999, result.last_us);
+  for (int c = 0; c < TELEMSTATS_CHANNELS; ++c) {
+    telemstats_check(&result.channel[c], &ref[c]);
+  }
+}
+
+/**
+ * @brief A snapshot with reset starts a new window, but keeps the EWMAs
+ */
+static void test_telemstats_window(void) {
+  telemstats_t stats;
+  telemstats_init(&stats, telemstats_test_shifts);
+  kissesc_telem_t telem = {};
+
+  telem.temperature = 30;
+  telemstats_update(&stats, &telem, 0);
+  telem.temperature = 40;
+  telemstats_update(&stats, &telem, 10);
+
+  telemstats_result_t result;
+  telemstats_snapshot(&stats, &result, true);
+  TEST_ASSERT_EQUAL(2, result.count);
+  TEST_ASSERT_EQUAL(35 << 16, result.channel[TELEMSTATS_TEMPERATURE].mean);
+  TEST_ASSERT_EQUAL(50 << 8, result.channel[TELEMSTATS_TEMPERATURE].variance);
+
+  telem.temperature = 50;
+  telemstats_update(&stats, &telem, 20);
+  telemstats_snapshot(&stats, &result, true);
+  const telemstats_channel_result_t *const temp =
+      &result.channel[TELEMSTATS_TEMPERATURE];
+  TEST_ASSERT_EQUAL(1, result.count);
+  TEST_ASSERT_EQUAL(20, result.first_us);
+  TEST_ASSERT_EQUAL(50 << 16, temp->mean);
+  TEST_ASSERT_EQUAL(0, temp->variance);
+  TEST_ASSERT_EQUAL(50, temp->min);
+  TEST_ASSERT_EQUAL(50, temp->max);
+  // 30 -> 32.5 -> 36.875 with alpha = 1/4
+  TEST_ASSERT_EQUAL((int64_t)(36.875 * (1 << 16)), temp->ewma[0]);
+
+  telemstats_snapshot(&stats, &result, false);
+  TEST_ASSERT_EQUAL(0, result.count);
+}
+
+static int runUnityTests_telemstats(void) {
+  UnityBegin("TELEMSTATS");
+  RUN_TEST(test_telemstats_reference);
+  RUN_TEST(test_telemstats_window);
+  return UNITY_END();
+}
@@ -0,0 +1,127 @@
+#include "telemqueue.h"
+#include "telemstream.h"
+#include "unity.h"
+#include <stdio.h>
+
+static const telem_sample_t telemstream_sample = {.timestamp_us = 0x01020304,
+                                                  .esc_idx = 3,
+                                                  .telem = {.temperature = -5,
+                                                            .centi_voltage = 1280,
+                                                            .centi_current = 19,
+                                                            .consumption = 4,
+                                                            .erpm = 89900,
+                                                            .crc = 0}};
+
+/**
+ * @brief Samples are popped in order and numbered, and a full queue drops
+ * new samples but still numbers them
+ */
+static void test_telem_queue(void) {
+  telem_queue_t queue;
+  telem_queue_init(&queue);
+
+  telem_sample_t sample = telemstream_sample;
+  for (uint32_t i = 0; i < TELEM_QUEUE_SIZE; ++i) {
+    sample.timestamp_us = i;
+    TEST_ASSERT_TRUE(telem_queue_push(&queue, &sample));
+  }
+  TEST_ASSERT_FALSE(telem_queue_push(&queue, &sample));
+  TEST_ASSERT_EQUAL(TELEM_QUEUE_SIZE, sample.seq);
+  TEST_ASSERT_EQUAL(1, queue.dropped);
+  TEST_ASSERT_EQUAL(1, telem_queue_take_dropped(&queue));
+  TEST_ASSERT_EQUAL(0, telem_queue_take_dropped(&queue));
+  TEST_ASSERT_EQUAL(TELEM_QUEUE_SIZE, telem_queue_count(&queue));
+
+  for (uint32_t i = 0; i < TELEM_QUEUE_SIZE; ++i) {
+    TEST_ASSERT_TRUE(telem_queue_pop(&queue, &sample));
+    TEST_ASSERT_EQUAL(i, sample.timestamp_us);
+    TEST_ASSERT_EQUAL(i, sample.seq);
+  }
+  TEST_ASSERT_FALSE(telem_queue_pop(&queue, &sample));
+
+  // The dropped sample leaves a gap
+  TEST_ASSERT_TRUE(telem_queue_push(&queue, &sample));
+  TEST_ASSERT_TRUE(telem_queue_pop(&queue, &sample));
+  TEST_ASSERT_EQUAL(TELEM_QUEUE_SIZE + 1, sample.seq);
+}
+
+/**
+ * @brief A record decodes back to the sample it was encoded from,
+ * and its CRC covers every byte
+ */
+static void test_telemstream_encode_decode(void) {
+  uint8_t record[TELEMSTREAM_RECORD_SIZE];
+  telemstream_encode(&telemstream_sample, 0xbeef, record);
+
+  TEST_ASSERT_EQUAL_HEX8(0x7e, record[0]);
+  TEST_ASSERT_EQUAL_HEX8(0x5a, record[1]);
+  TEST_ASSERT_EQUAL(0, kissesc_get_crc8(record, TELEMSTREAM_RECORD_SIZE));
+
+  telem_sample_t sample;
+  uint16_t seq;
+  TEST_ASSERT_TRUE(telemstream_decode(record, &sample, &seq));
+  TEST_ASSERT_EQUAL(0xbeef, seq);
+  TEST_ASSERT_EQUAL(0xbeef, sample.seq);
+  TEST_ASSERT_EQUAL(telemstream_sample.timestamp_us, sample.timestamp_us);
+  TEST_ASSERT_EQUAL(telemstream_sample.esc_idx, sample.esc_idx);
+  TEST_ASSERT_EQUAL(-5, sample.telem.temperature);
+  TEST_ASSERT_EQUAL(1280, sample.telem.centi_voltage);
+  TEST_ASSERT_EQUAL(19, sample.telem.centi_current);
+  TEST_ASSERT_EQUAL(4, sample.telem.consumption);
+  TEST_ASSERT_EQUAL(89900, sample.telem.erpm);
+
+  for (size_t i = 0; i < TELEMSTREAM_RECORD_SIZE; ++i) {
+    record[i] ^= 0x10;
+    TEST_ASSERT_FALSE(telemstream_decode(record, &sample, &seq));
+    record[i] ^= 0x10;
+  }
+}
+
+/**
+ * @brief Records are packed back to back until the block is full, and
+ * carry the sequence number of the queue, so dropped samples show as a gap
+ */
+static void test_telemstream_block(void) {
+  telemstream_t stream;
+  telemstream_init(&stream);
+  telem_queue_t queue;
+  telem_queue_init(&queue);
+
+  // Fill the queue, and drop a sample
+  telem_sample_t sample = telemstream_sample;
+  for (uint32_t i = 0; i < TELEM_QUEUE_SIZE + 1; ++i) {
+    telem_queue_push(&queue, &sample);
+  }
+  telem_queue_pop(&queue, &sample);
+  telem_queue_push(&queue, &sample);
+
+  const size_t records_per_block =
+      TELEMSTREAM_BLOCK_SIZE / TELEMSTREAM_RECORD_SIZE;
+  for (size_t i = 0; i < records_per_block; ++i) {
+    telem_queue_pop(&queue, &sample);
+    TEST_ASSERT_TRUE(telemstream_append(&stream, &sample));
+  }
+  TEST_ASSERT_TRUE(telemstream_is_full(&stream));
+  TEST_ASSERT_FALSE(telemstream_append(&stream, &telemstream_sample));
+  TEST_ASSERT_EQUAL(records_per_block * TELEMSTREAM_RECORD_SIZE, stream.len);
+
+  // Sequence numbers increment per record
+  uint16_t seq;
+  TEST_ASSERT_TRUE(telemstream_decode(
+      &stream.block[(records_per_block - 1) * TELEMSTREAM_RECORD_SIZE],
+      &sample, &seq));
+  TEST_ASSERT_EQUAL(records_per_block, seq);
+
+  // The sample pushed after the drop is numbered after the dropped one
+  while (telem_queue_pop(&queue, &sample)) {
+  }
+  TEST_ASSERT_EQUAL(TELEM_QUEUE_SIZE + 1, sample.seq);
+}
+
+static int runUnityTests_telemstream(void) {
+  UnityBegin("TELEMSTREAM");
+  RUN_TEST(test_telem_queue);
+  RUN_TEST(test_telemstream_encode_decode);
+  RUN_TEST(test_telemstream_block);
+  return UNITY_END();
+}
@@ -0,0 +1,168 @@
+#include "virtual_esc.hpp"
+#include "unity.h"
+
+/// @brief DShot600 at 125 MHz, as dshot_speed_table_init computes it
+static dshot_speed_entry_t virtual_esc_test_entry(void) {
+  dshot_speed_entry_t entry;
+  dshot_speed_entry_compute(&entry, 125000, 600, DSHOT_PAUSE_NS_DEFAULT);
+  return entry;
+}
+
+static std::vector<virtual_esc_pulse>
+virtual_esc_test_packet(const uint16_t code, const bool telemetry,
+                        const dshot_duty_t &duty) {
+  const dshot_speed_entry_t entry = virtual_esc_test_entry();
+  uint16_t high, low;
+  dshot_duty_pulses(&duty, entry.top, &high, &low);
+  dshot_packet_t packet = {};
+  packet.throttle_code = code;
+  packet.telemetry = telemetry;
+  packet.pulse_high = high;
+  packet.pulse_low = low;
+  dshot_packet_compose(&packet);
+  std::vector<virtual_esc_pulse> pulses;
+  virtual_esc_pulses(packet.packet_buffer, DSHOT_PACKET_BUFFER_LENGTH,
+                     entry.pause_pulses - 1, entry, 125000, pulses);
+  return pulses;
+}
+
+static const motor_model_t virtual_esc_test_motor = {
+    .rpm = 0, .max_rpm = 30000, .sag = 0.15, .tau_s = 0.04, .poles = 14};
+
+/**
+ * @brief Frames composed by packet.h decode, back to back or not
+ */
+static void test_virtual_esc_decode(void) {
+  virtual_esc esc(600, virtual_esc_test_motor);
+  const auto packet = virtual_esc_test_packet(1048, false, dshot_duty_default);
+  uint64_t t = 0;
+  for (int i = 0; i < 10; ++i) {
+    esc.feed(t, packet);
+    // Back to back (the pause is the only gap), then spaced out
+    t += i < 5 ? packet.size() * 1667 : 100000;
+  }
+  TEST_ASSERT_EQUAL(10, esc.stats.frames);
+  TEST_ASSERT_EQUAL(1048, esc.code);
+  TEST_ASSERT_EQUAL(0, esc.stats.bad_timing + esc.stats.bad_crc);
+
+  // Commands stop the motor
+  esc.feed(t, virtual_esc_test_packet(0, false, dshot_duty_default));
+  TEST_ASSERT_EQUAL(1, esc.stats.commands);
+  TEST_ASSERT_EQUAL(0, esc.throttle);
+
+  // A 0 bit at 55 % is outside the T0H window
+  const dshot_duty_t wide = {750, 550};
+  esc.feed(t + 200000, virtual_esc_test_packet(1048, false, wide));
+  TEST_ASSERT_EQUAL(1, esc.stats.bad_timing);
+  TEST_ASSERT_EQUAL(11, esc.stats.frames);
+
+  // A frame straight after another, without the pause
+  std::vector<virtual_esc_pulse> frame = packet;
+  frame.resize(DSHOT_FRAME_SIZE);
+  esc.feed(t + 300000, frame);
+  esc.feed(t + 300000 + DSHOT_FRAME_SIZE * 1667, frame);
+  TEST_ASSERT_EQUAL(1, esc.stats.short_gap);
+  TEST_ASSERT_EQUAL(12, esc.stats.frames);
+
+  // A flipped bit fails the crc
+  std::vector<virtual_esc_pulse> flipped = packet;
+  const double period = packet[3].period_ns;
+  flipped[3].high_ns =
+      packet[3].high_ns > 0.56 * period ? 0.37 * period : 0.75 * period;
+  esc.feed(t + 400000, flipped);
+  TEST_ASSERT_EQUAL(1, esc.stats.bad_crc);
+}
+
+/**
+ * @brief Telemetry frames get a KISS reply at the onewire baud rate, that
+ * kissesctelem.h decodes with a valid crc
+ */
+static void test_virtual_esc_telemetry(void) {
+  virtual_esc esc(600, virtual_esc_test_motor);
+  const auto run = virtual_esc_test_packet(1048, false, dshot_duty_default);
+  uint64_t t = 0;
+  for (; t < 500000000; t += 1000000)
+    esc.feed(t, run);
+  esc.feed(t, virtual_esc_test_packet(1048, true, dshot_duty_default));
+  const uint64_t frame_end = t + DSHOT_FRAME_SIZE * llround(run[0].period_ns);
+
+  virtual_esc_byte byte;
+  TEST_ASSERT_FALSE(esc.receive(frame_end + 50000, &byte));
+  uint8_t buffer[KISS_ESC_TELEM_BUFFER_SIZE];
+  uint64_t last = 0;
+  for (int i = 0; i < KISS_ESC_TELEM_BUFFER_SIZE; ++i) {
+    TEST_ASSERT_TRUE(esc.receive(frame_end + 2000000, &byte));
+    buffer[i] = byte.value;
+    last = byte.t_ns;
+  }
+  TEST_ASSERT_FALSE(esc.receive(UINT64_MAX, &byte));
+  // 10 bytes of 10 bits at 115200 baud: 868 us
+  TEST_ASSERT_UINT32_WITHIN(2000, 50000 + 868056, last - frame_end);
+
+  kissesc_telem_t telem;
+  kissesc_buffer_to_telem(buffer, &telem);
+  TEST_ASSERT_EQUAL(0, telem.crc);
+  TEST_ASSERT_EQUAL(motor_model_erpm(&esc.motor), telem.erpm);
+  TEST_ASSERT_TRUE(telem.erpm > 0);
+  TEST_ASSERT_TRUE(telem.centi_voltage < 1680);
+  TEST_ASSERT_TRUE(telem.centi_current > 30);
+  TEST_ASSERT_TRUE(telem.temperature >= 25);
+  TEST_ASSERT_EQUAL(1, esc.stats.replies);
+}
+
+/**
+ * @brief Injected faults show up in the replies
+ */
+static void test_virtual_esc_faults(void) {
+  virtual_esc esc(600, virtual_esc_test_motor);
+  const auto request = virtual_esc_test_packet(548, true, dshot_duty_default);
+  virtual_esc_byte byte;
+  uint64_t t = 0;
+
+  esc.faults.mute = true;
+  esc.feed(t, request);
+  TEST_ASSERT_FALSE(esc.receive(UINT64_MAX, &byte));
+  TEST_ASSERT_EQUAL(1, esc.stats.dropped_replies);
+
+  // A request while the previous reply is being sent is dropped
+  esc.faults.mute = false;
+  t += 1000000;
+  esc.feed(t, request);
+  esc.feed(t + 100000, request);
+  TEST_ASSERT_EQUAL(2, esc.stats.dropped_replies);
+  while (esc.receive(UINT64_MAX, &byte))
+    ;
+
+  esc.faults.corrupt_reply = 1;
+  t += 2000000;
+  esc.feed(t, request);
+  uint8_t buffer[KISS_ESC_TELEM_BUFFER_SIZE];
+  for (int i = 0; i < KISS_ESC_TELEM_BUFFER_SIZE; ++i) {
+    TEST_ASSERT_TRUE(esc.receive(UINT64_MAX, &byte));
+    buffer[i] = byte.value;
+  }
+  TEST_ASSERT_TRUE(kissesc_get_crc8(buffer, KISS_ESC_TELEM_BUFFER_SIZE) != 0);
+
+  // A locked rotor draws current without turning
+  esc.faults.corrupt_reply = 0;
+  esc.faults.stall = true;
+  t += 2000000;
+  esc.feed(t, request);
+  for (int i = 0; i < KISS_ESC_TELEM_BUFFER_SIZE; ++i) {
+    TEST_ASSERT_TRUE(esc.receive(UINT64_MAX, &byte));
+    buffer[i] = byte.value;
+  }
+  kissesc_telem_t telem;
+  kissesc_buffer_to_telem(buffer, &telem);
+  TEST_ASSERT_EQUAL(0, telem.crc);
+  TEST_ASSERT_EQUAL(0, telem.erpm);
+  TEST_ASSERT_TRUE(telem.centi_current > 700);
+}
+
+static int runUnityTests_virtual_esc(void) {
+  UnityBegin("VIRTUAL_ESC");
+  RUN_TEST(test_virtual_esc_decode);
+  RUN_TEST(test_virtual_esc_telemetry);
+  RUN_TEST(test_virtual_esc_faults);
+  return UNITY_END();
+}
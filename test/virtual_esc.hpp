@@ -0,0 +1,375 @@
+/**
+ * @file virtual_esc.hpp
+ *
+ * Host model of a DShot ESC with KISS onewire telemetry, for closed loop
+ * tests without hardware.
+ *
+ * The ESC is fed the pwm waveform the dma produces from a packet buffer,
+ * one bit period at a time (@ref virtual_esc_pulses converts a buffer):
+ *
+ * - each bit is classified from its high time, as a permille of the bit
+ *   period, against the T0H / T1H windows of @ref virtual_esc_timing.
+ *   A period off the nominal bit rate, or a high time outside both
+ *   windows, drops the frame
+ * - a frame needs a low gap of at least `min_gap_ns` before it
+ * - 16 bits make a frame, checked with dshot_cmd_crc()
+ * - codes >= 48 set the throttle of a first order motor model
+ *   (motor_model.hpp); lower codes are commands, and stop the motor
+ * - frames with the telemetry bit queue a 10 byte KISS reply (CRC8 as
+ *   kissesctelem.h), sent `reply_delay_us` later, one byte every
+ *   10 bits at `baudrate`
+ *
+ * Replies come from the motor model: erpm, a current that rises with the
+ * cube of the speed, the battery voltage sagging with it, a temperature
+ * that follows the current, and the integrated consumption. Noise and
+ * faults (@ref virtual_esc_faults) are injected from a seeded generator,
+ * so runs are reproducible.
+ *
+ * Times are in ns of simulated time, so any number of ESCs can run in one
+ * process, as fast as the host allows.
+ */
+
+#pragma once
+#include <sys/types.h>
+
+#include "dshotspeed.h"
+#include "kissesctelem.h"
+#include "motor_model.hpp"
+#include "packet.h"
+#include <math.h>
+#include <random>
+#include <stdint.h>
+#include <vector>
+
+/// ONEWIRE_BAUDRATE (onewire.h needs the sdk)
+#define VIRTUAL_ESC_BAUDRATE 115200
+/// Start, 8 data and stop bit
+#define VIRTUAL_ESC_BITS_PER_BYTE 10
+/// Codes below this are commands (= DSHOT_ZERO_THROTTLE)
+#define VIRTUAL_ESC_ZERO_THROTTLE 48
+
+/**
+ * @brief decoder tolerances, in permille of a bit
+ *
+ * @param t0h_min, t0h_max window of a 0 bit's high time
+ * @param t1h_min, t1h_max window of a 1 bit's high time
+ * @param bit_tol largest deviation of a bit period from the nominal rate
+ * @param min_gap_ns low time needed between frames
+ */
+struct virtual_esc_timing {
+  uint16_t t0h_min = 250;
+  uint16_t t0h_max = 500;
+  uint16_t t1h_min = 625;
+  uint16_t t1h_max = 875;
+  uint16_t bit_tol = 50;
+  uint32_t min_gap_ns = 1000;
+};
+
+/**
+ * @brief noise and faults
+ *
+ * @param drop_reply probability that a requested reply isn't sent
+ * @param corrupt_reply probability that a reply has a bit flipped
+ * @param erpm_noise std of the reported erpm
+ * @param current_noise_a std of the reported current
+ * @param extra_delay_us added to the reply delay
+ * @param stall the rotor is locked: no rpm, stall current
+ * @param mute no replies at all (e.g. a broken telemetry wire)
+ */
+struct virtual_esc_faults {
+  double drop_reply = 0;
+  double corrupt_reply = 0;
+  double erpm_noise = 0;
+  double current_noise_a = 0;
+  uint32_t extra_delay_us = 0;
+  bool stall = false;
+  bool mute = false;
+};
+
+/**
+ * @brief what the ESC saw
+ *
+ * @param frames valid frames
+ * @param bad_timing frames dropped for a bit outside the tolerances
+ * @param bad_crc
+ * @param short_gap frames dropped for starting too soon after the last one
+ * @param commands valid frames with a code < 48
+ * @param telem_requests
+ * @param replies sent
+ * @param dropped_replies not sent (fault, or the previous reply was still
+ * being sent)
+ * @param corrupted_replies sent with a flipped bit
+ */
+struct virtual_esc_stats {
+  uint64_t frames = 0;
+  uint64_t bad_timing = 0;
+  uint64_t bad_crc = 0;
+  uint64_t short_gap = 0;
+  uint64_t commands = 0;
+  uint64_t telem_requests = 0;
+  uint64_t replies = 0;
+  uint64_t dropped_replies = 0;
+  uint64_t corrupted_replies = 0;
+};
+
+/// @brief one bit period of the line
+struct virtual_esc_pulse {
+  double high_ns;
+  double period_ns;
+};
+
+/// @brief a reply byte, and the time its stop bit ends
+struct virtual_esc_byte {
+  uint64_t t_ns;
+  uint8_t value;
+};
+
+/**
+ * @brief waveform of a packet, as the dma writes it to the counter compare
+ * of a pwm slice: the packet buffer, then the shared zero tail
+ *
+ * @param buffer packet buffer (16 bit counter compares)
+ * @param count pulses read from the buffer (frame + its zero pulse)
+ * @param tail zero pulses read from the shared tail (rest of the pause)
+ * @param entry pwm settings of the speed
+ * @param sys_khz
+ * @param pulses output, resized to \a count + \a tail (reuse it to avoid
+ * allocations)
+ */
+static inline void virtual_esc_pulses(const volatile uint16_t *const buffer,
+                                      const int count, const int tail,
+                                      const dshot_speed_entry_t &entry,
+                                      const uint32_t sys_khz,
+                                      std::vector<virtual_esc_pulse> &pulses) {
+  const double count_ns = 1e6 * entry.div /
+                          (1 << DSHOT_SPEED_DIV_FRAC_BITS) / sys_khz;
+  const double period_ns = (entry.top + 1) * count_ns;
+  pulses.resize(count + tail);
+  for (int i = 0; i < count; ++i)
+    pulses[i] = {buffer[i] * count_ns, period_ns};
+  for (int i = count; i < count + tail; ++i)
+    pulses[i] = {0, period_ns};
+}
+
+struct virtual_esc {
+  // Configuration
+  uint16_t speed_khz;
+  virtual_esc_timing timing;
+  virtual_esc_faults faults;
+  motor_model_t motor;
+  uint32_t reply_delay_us = 50;
+  uint32_t baudrate = VIRTUAL_ESC_BAUDRATE;
+  double battery_v = 16.8;
+  double resistance_ohm = 0.05;
+  double idle_current_a = 0.3;
+  double max_current_a = 30;
+  double ambient_c = 25;
+  double heat_c_per_a = 1.5;
+  double heat_tau_s = 20;
+
+  // State
+  virtual_esc_stats stats;
+  uint16_t code = 0;        // last valid code
+  uint16_t throttle = 0;    // code driving the motor (0 => stopped)
+  double current_a = 0;
+  double temperature_c = 0;
+  double consumption_mah = 0;
+  uint64_t motor_t_ns = 0;  // the motor model has been run up to here
+  uint64_t line_t_ns = 0;   // end of the last pulse fed
+  double low_ns = 0;        // low time since the last frame
+  bool seen_frame = false;
+  uint16_t frame = 0;
+  int bits = 0;
+  bool frame_bad = false;
+  std::vector<virtual_esc_byte> tx;
+  size_t tx_head = 0;
+  std::mt19937 rng;
+
+  virtual_esc(const uint16_t speed_khz, const motor_model_t &motor,
+              const uint32_t seed = 1)
+      : speed_khz(speed_khz), motor(motor), temperature_c(ambient_c),
+        rng(seed) {}
+
+  double chance() {
+    return std::uniform_real_distribution<double>(0, 1)(rng);
+  }
+  double gauss(const double std) {
+    return std > 0 ? std::normal_distribution<double>(0, std)(rng) : 0;
+  }
+
+  // exp() of the last step, as frames usually come at a fixed interval
+  double decay_dt_s = -1;
+  double motor_decay = 0;
+  double heat_decay = 0;
+
+  /// @brief run the motor, current and temperature models up to t_ns
+  void advance(const uint64_t t_ns) {
+    if (t_ns <= motor_t_ns)
+      return;
+    const double dt_s = (t_ns - motor_t_ns) * 1e-9;
+    motor_t_ns = t_ns;
+    if (dt_s != decay_dt_s) {
+      decay_dt_s = dt_s;
+      motor_decay = exp(-dt_s / motor.tau_s);
+      heat_decay = exp(-dt_s / heat_tau_s);
+    }
+    if (faults.stall) {
+      motor.rpm = 0;
+      const double f =
+          throttle ? (throttle - VIRTUAL_ESC_ZERO_THROTTLE) / 1999.0 : 0;
+      current_a = idle_current_a + f * max_current_a;
+    } else {
+      // motor_model_step, with the cached decay
+      const double rpm_ss = motor_model_steady_rpm(&motor, throttle);
+      motor.rpm += (rpm_ss - motor.rpm) * (1 - motor_decay);
+      const double f = motor.rpm / motor.max_rpm;
+      current_a = idle_current_a + max_current_a * f * f * f;
+    }
+    consumption_mah += current_a * dt_s / 3.6;
+    const double target_c = ambient_c + heat_c_per_a * current_a;
+    temperature_c += (target_c - temperature_c) * (1 - heat_decay);
+  }
+
+  /// @brief the reply the ESC would send now (CRC included)
+  void reply(uint8_t buffer[KISS_ESC_TELEM_BUFFER_SIZE]) {
+    const double erpm = fmax(0, motor_model_erpm(&motor) +
+                                    gauss(faults.erpm_noise));
+    const double current = fmax(0, current_a + gauss(faults.current_noise_a));
+    const double volts = battery_v - resistance_ohm * current;
+    const uint16_t fields[4] = {(uint16_t)lround(volts * 100),
+                                (uint16_t)lround(current * 100),
+                                (uint16_t)consumption_mah,
+                                (uint16_t)fmin(erpm / 100, 0xffff)};
+    buffer[0] = (uint8_t)(int8_t)lround(temperature_c);
+    for (int i = 0; i < 4; ++i) {
+      buffer[1 + 2 * i] = fields[i] >> 8;
+      buffer[2 + 2 * i] = fields[i] & 0xff;
+    }
+    buffer[9] = kissesc_get_crc8(buffer, KISS_ESC_TELEM_BUFFER_SIZE - 1);
+  }
+
+  /// @brief ns per byte on the telemetry wire
+  double byte_ns() const {
+    return 1e9 * VIRTUAL_ESC_BITS_PER_BYTE / baudrate;
+  }
+
+  /// @brief the last byte of the current reply hasn't been sent by t_ns
+  bool sending(const uint64_t t_ns) const {
+    return tx_head < tx.size() && tx.back().t_ns > t_ns;
+  }
+
+  void request_telemetry(const uint64_t t_ns) {
+    stats.telem_requests++;
+    if (faults.mute || chance() < faults.drop_reply || sending(t_ns)) {
+      stats.dropped_replies++;
+      return;
+    }
+    uint8_t buffer[KISS_ESC_TELEM_BUFFER_SIZE];
+    reply(buffer);
+    if (chance() < faults.corrupt_reply) {
+      buffer[rng() % KISS_ESC_TELEM_BUFFER_SIZE] ^= 1u << (rng() % 8);
+      stats.corrupted_replies++;
+    }
+    stats.replies++;
+    const uint64_t start =
+        t_ns + 1000ull * (reply_delay_us + faults.extra_delay_us);
+    for (int i = 0; i < KISS_ESC_TELEM_BUFFER_SIZE; ++i) {
+      tx.push_back({start + (uint64_t)((i + 1) * byte_ns()), buffer[i]});
+    }
+  }
+
+  void end_frame(const uint64_t t_ns) {
+    const uint16_t cmd = frame >> 4;
+    if (dshot_cmd_crc(cmd) != (frame & 0xf)) {
+      stats.bad_crc++;
+      return;
+    }
+    stats.frames++;
+    advance(t_ns);
+    code = cmd >> 1;
+    if (code < VIRTUAL_ESC_ZERO_THROTTLE) {
+      stats.commands++;
+      throttle = 0;
+    } else {
+      throttle = code;
+    }
+    if (cmd & 1)
+      request_telemetry(t_ns);
+  }
+
+  /// @brief count a frame with a bad bit once
+  void bad_bit() {
+    if (!frame_bad)
+      stats.bad_timing++;
+    frame_bad = true;
+  }
+
+  /// @brief feed one bit period starting at t_ns
+  void pulse(const uint64_t t_ns, const virtual_esc_pulse &p) {
+    // Idle line between feeds
+    if (t_ns > line_t_ns)
+      low_ns += t_ns - line_t_ns;
+    line_t_ns = t_ns + (uint64_t)(p.period_ns + 0.5);
+    if (p.high_ns <= 0) {
+      // A low bit period inside a frame breaks it
+      if (bits) {
+        stats.bad_timing++;
+        bits = 0;
+      }
+      low_ns += p.period_ns;
+      return;
+    }
+    if (!bits) {
+      frame_bad = seen_frame && low_ns < timing.min_gap_ns;
+      if (frame_bad)
+        stats.short_gap++;
+      frame = 0;
+    }
+    const double bit_ns = 1e6 / speed_khz;
+    // Permille windows, compared without dividing by the period
+    const double high = 1000 * p.high_ns;
+    const double period = p.period_ns;
+    bool one = false;
+    if (fabs(period - bit_ns) * 1000 > timing.bit_tol * bit_ns) {
+      bad_bit();
+    } else if (high >= timing.t1h_min * period &&
+               high <= timing.t1h_max * period) {
+      one = true;
+    } else if (!(high >= timing.t0h_min * period &&
+                 high <= timing.t0h_max * period)) {
+      bad_bit();
+    }
+    frame = (uint16_t)(frame << 1 | one);
+    if (++bits < (int)DSHOT_FRAME_SIZE)
+      return;
+    bits = 0;
+    low_ns = 0;
+    seen_frame = true;
+    if (!frame_bad)
+      end_frame(line_t_ns);
+  }
+
+  /// @brief feed a packet's waveform, starting at t_ns
+  void feed(uint64_t t_ns, const std::vector<virtual_esc_pulse> &pulses) {
+    for (const virtual_esc_pulse &p : pulses) {
+      pulse(t_ns, p);
+      t_ns += (uint64_t)(p.period_ns + 0.5);
+    }
+  }
+
+  /**
+   * @brief pop the next reply byte received by t_ns
+   *
+   * @return false if there is none yet
+   */
+  bool receive(const uint64_t t_ns, virtual_esc_byte *const byte) {
+    if (tx_head >= tx.size() || tx[tx_head].t_ns > t_ns)
+      return false;
+    *byte = tx[tx_head++];
+    if (tx_head == tx.size()) {
+      tx.clear();
+      tx_head = 0;
+    }
+    return true;
+  }
+};
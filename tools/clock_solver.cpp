@@ -0,0 +1,102 @@
+/**
+ * @file clock_solver.cpp
+ *
+ * Host tool to pick the sys clock, pwm divider and wrap with the smallest
+ * DShot timing error (see clocksolver.h), e.g.:
+ *
+ *     clock_solver 150 300 600 1200 2400
+ *     clock_solver --max-mhz 200 --frac 2400 4800
+ *     clock_solver --sys-mhz 125 2400
+ *
+ * Build it with the host tests (`clock_solver` target in `test/`).
+ */
+
+#include "clocksolver.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void usage(const char *const name) {
+  printf("usage: %s [--max-mhz MHZ] [--min-mhz MHZ] [--sys-mhz MHZ] [--frac]"
+         " KHZ...\n",
+         name);
+  printf("  KHZ         target bit rates, e.g. 1200 2400\n");
+  printf("  --max-mhz   highest sys clock to search (default 133)\n");
+  printf("  --min-mhz   lowest sys clock to search (default 100)\n");
+  printf("  --sys-mhz   only solve the divider and wrap at this sys clock\n");
+  printf("  --frac      allow fractional dividers (adds 1 clock of jitter)\n");
+}
+
+static void print_result(const double rate_khz,
+                         const clocksolver_result_t *const r) {
+  printf("DShot%-5.0f sys %9.4f MHz", rate_khz, r->sys_hz / 1e6);
+  if (r->fbdiv) {
+    printf(" (vco %4u MHz = 12 MHz x %3u, postdiv %u x %u)",
+           r->vco_hz / 1000000, r->fbdiv, r->postdiv1, r->postdiv2);
+  }
+  printf("\n  div %3u.%-2u top %5u  cc 1: %5u  0: %5u\n",
+         r->div >> CLOCKSOLVER_DIV_FRAC_BITS,
+         (r->div & ((1 << CLOCKSOLVER_DIV_FRAC_BITS) - 1)) * 10000 /
+             (1 << CLOCKSOLVER_DIV_FRAC_BITS),
+         r->top, r->cc_high, r->cc_low);
+  const double bit_ppm = 1e6 * r->bit_err_ns / (r->bit_ns - r->bit_err_ns);
+  printf("  bit %8.2f ns (%+6.2f, %+5.0f ppm)  T1H %8.2f ns (%+6.2f)  "
+         "T0H %8.2f ns (%+6.2f)\n",
+         r->bit_ns, r->bit_err_ns, bit_ppm, r->t1h_ns, r->t1h_err_ns,
+         r->t0h_ns, r->t0h_err_ns);
+  printf("  jitter %.2f ns  => error %.2f ns\n", r->jitter_ns, r->error_ns);
+  if (r->fbdiv) {
+    printf("  set_sys_clock_pll(%u, %u, %u);\n", r->vco_hz, r->postdiv1,
+           r->postdiv2);
+  }
+}
+
+int main(int argc, char **argv) {
+  clocksolver_params_t params;
+  clocksolver_default_params(&params);
+  double sys_mhz = 0;
+  int rates = 0;
+  int failed = 0;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--frac")) {
+      params.frac_div = true;
+    } else if (!strcmp(argv[i], "--max-mhz") && i + 1 < argc) {
+      params.sys_max_hz = (uint32_t)(atof(argv[++i]) * 1e6);
+    } else if (!strcmp(argv[i], "--min-mhz") && i + 1 < argc) {
+      params.sys_min_hz = (uint32_t)(atof(argv[++i]) * 1e6);
+    } else if (!strcmp(argv[i], "--sys-mhz") && i + 1 < argc) {
+      sys_mhz = atof(argv[++i]);
+    } else if (argv[i][0] == '-') {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  for (int i = 1; i < argc; ++i) {
+    if (argv[i][0] == '-') {
+      // Skip the option and its value
+      i += strcmp(argv[i], "--frac") != 0;
+      continue;
+    }
+    const double rate_khz = atof(argv[i]);
+    clocksolver_result_t result;
+    const bool found =
+        sys_mhz > 0 ? clocksolver_solve_divwrap(sys_mhz * 1e6, rate_khz * 1e3,
+                                                &params, &result)
+                    : clocksolver_solve(rate_khz * 1e3, &params, &result);
+    if (found) {
+      print_result(rate_khz, &result);
+    } else {
+      printf("DShot%-5.0f no setting within the limits\n", rate_khz);
+      failed++;
+    }
+    rates++;
+  }
+
+  if (!rates) {
+    usage(argv[0]);
+    return 1;
+  }
+  return failed ? 2 : 0;
+}
@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+"""Expand a binary dlog stream (see include/dlog.h) back into text.
+
+The format ids are read from the DLOG_FORMATS table in dlog.h, so the
+header must match the firmware that produced the stream.
+
+Usage:
+    dlog_expand.py capture.bin
+    dlog_expand.py /dev/ttyACM0          # read a serial port until Ctrl-C
+    cat capture.bin | dlog_expand.py -
+"""
+
+import argparse
+import re
+import struct
+import sys
+from pathlib import Path
+
+DEFAULT_HEADER = Path(__file__).resolve().parent.parent / "include" / "dlog.h"
+
+SYNC = b"\x0c\xd1"  # DLOG_WIRE_SYNC, little endian
+RECORD = struct.Struct("<HHHI3I")  # sync, id, seq, timestamp_us, args
+
+
+def load_formats(header):
+    """Return {id: format} parsed from the DLOG_FORMATS X-macro."""
+    text = Path(header).read_text()
+    table = re.search(r"#define DLOG_FORMATS\(X\)(.*?)\n\s*\n", text, re.S)
+    if not table:
+        sys.exit(f"DLOG_FORMATS not found in {header}")
+    body = table.group(1).replace("\\\n", "\n")
+    entries = re.findall(r'X\(\s*(\w+)\s*,\s*((?:"(?:[^"\\]|\\.)*"\s*)+)\)', body)
+    formats = {}
+    for idx, (name, literal) in enumerate(entries, start=1):
+        fmt = "".join(re.findall(r'"((?:[^"\\]|\\.)*)"', literal))
+        fmt = fmt.encode().decode("unicode_escape")
+        formats[idx] = (name, fmt)
+    return formats
+
+
+def to_python_format(fmt):
+    """Translate C integer conversions to python % formatting."""
+    return re.sub(r"%([-+ 0#]*\d*(?:\.\d+)?)(?:hh|h|ll|l|z)?([uid])", r"%\1d", fmt)
+
+
+def expand(stream, formats, out):
+    buffer = b""
+    expected_seq = None
+    stats = {"records": 0, "gaps": 0, "dropped": 0}
+    while True:
+        chunk = stream.read(4096)
+        if not chunk:
+            break
+        buffer += chunk
+        while True:
+            start = buffer.find(SYNC)
+            if start < 0:
+                buffer = buffer[-1:]
+                break
+            if len(buffer) - start < RECORD.size:
+                buffer = buffer[start:]
+                break
+            _, fmt_id, seq, timestamp_us, *args = RECORD.unpack_from(buffer, start)
+            buffer = buffer[start + RECORD.size:]
+
+            if fmt_id not in formats:
+                out.write(f"[{timestamp_us:>10} us] dlog: unknown id {fmt_id}\n")
+                continue
+            name, fmt = formats[fmt_id]
+            if name == "DLOG_DROPPED":
+                stats["dropped"] += args[0]
+            else:
+                stats["records"] += 1
+                if expected_seq is not None and seq != expected_seq:
+                    stats["gaps"] += 1
+                expected_seq = (seq + 1) & 0xFFFF
+
+            conversions = len(re.findall(r"%[^%]", fmt.replace("%%", "")))
+            text = to_python_format(fmt) % tuple(args[:conversions])
+            out.write(f"[{timestamp_us:>10} us] {text}")
+            if not text.endswith("\n"):
+                out.write("\n")
+    return stats
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input", help="binary capture, serial device, or - for stdin")
+    parser.add_argument("--header", default=DEFAULT_HEADER, help="path to dlog.h")
+    args = parser.parse_args()
+
+    formats = load_formats(args.header)
+    stream = sys.stdin.buffer if args.input == "-" else open(args.input, "rb", buffering=0)
+    try:
+        stats = expand(stream, formats, sys.stdout)
+    except KeyboardInterrupt:
+        return
+    finally:
+        if stream is not sys.stdin.buffer:
+            stream.close()
+    print(f"--- {stats['records']} records, {stats['dropped']} dropped on device, "
+          f"{stats['gaps']} sequence gaps ---", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+"""Send binary host commands (see include/hostcmd.h) to the pico.
+
+Usage:
+    hostcmd.py /dev/ttyACM0 throttle 48 48 48 48
+    hostcmd.py /dev/ttyACM0 special 1 --esc 0 --repeat 10
+    hostcmd.py /dev/ttyACM0 telem on --interval 1000
+    hostcmd.py /dev/ttyACM0 decim --samples 10 --window 20000
+    hostcmd.py /dev/ttyACM0 ramp --start 48 --stop 548 --duration 5 --rate 1000
+
+The module can also be imported to drive the pico from another script:
+
+    with open("/dev/ttyACM0", "wb", buffering=0) as port:
+        channel = HostCmd(port)
+        channel.throttle([48, 48])
+"""
+
+import argparse
+import struct
+import time
+
+SYNC = b"\xa5\x5a"
+MAX_PAYLOAD = 64
+ALL_ESCS = 0xFF
+SPECIAL_CMD_LIMIT = 48
+
+THROTTLE = 0x01
+SPECIAL = 0x02
+TELEM_CONFIG = 0x03
+DECIM_CONFIG = 0x04
+
+
+def kiss_crc8(data):
+    """CRC8 from the KISS telemetry datasheet (see kissesc_update_crc)."""
+    crc = 0
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x7) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def encode(cmd_type, seq, payload):
+    if len(payload) > MAX_PAYLOAD:
+        raise ValueError(f"payload of {len(payload)} bytes exceeds {MAX_PAYLOAD}")
+    body = bytes([len(payload), seq & 0xFF, cmd_type]) + payload
+    return SYNC + body + bytes([kiss_crc8(body)])
+
+
+class HostCmd:
+    """Frame commands with an incrementing sequence number."""
+
+    def __init__(self, port):
+        self.port = port
+        self.seq = 0
+
+    def send(self, cmd_type, payload):
+        self.port.write(encode(cmd_type, self.seq, payload))
+        self.seq = (self.seq + 1) & 0xFF
+
+    def throttle(self, codes):
+        if any(not 0 <= c <= 2047 for c in codes):
+            raise ValueError("throttle codes must be 0 - 2047")
+        self.send(THROTTLE, struct.pack(f"<{len(codes)}H", *codes))
+
+    def special(self, code, esc=ALL_ESCS, repeat=10):
+        if not 0 <= code < SPECIAL_CMD_LIMIT:
+            raise ValueError(f"special commands must be < {SPECIAL_CMD_LIMIT}")
+        self.send(SPECIAL, struct.pack("<BBB", esc, code, repeat))
+
+    def telem(self, enable, interval_us=1000):
+        self.send(TELEM_CONFIG, struct.pack("<BI", int(enable), interval_us))
+
+    def decim(self, samples, window_us=0, esc=ALL_ESCS):
+        """Ask for one record per samples / window_us (both 0 => off)."""
+        self.send(DECIM_CONFIG, struct.pack("<BHI", esc, samples, window_us))
+
+
+def ramp(channel, start, stop, duration, rate, motors):
+    """Linearly ramp every motor from start to stop, sending at rate Hz."""
+    steps = max(1, int(duration * rate))
+    period = 1.0 / rate
+    deadline = time.perf_counter()
+    for step in range(steps + 1):
+        code = round(start + (stop - start) * step / steps)
+        channel.throttle([code] * motors)
+        deadline += period
+        while time.perf_counter() < deadline:
+            pass
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("port", help="serial device of the pico (or a file)")
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    p = sub.add_parser("throttle", help="set a throttle code per motor")
+    p.add_argument("codes", type=int, nargs="+")
+
+    p = sub.add_parser("special", help="send a special command")
+    p.add_argument("code", type=int)
+    p.add_argument("--esc", type=int, default=ALL_ESCS)
+    p.add_argument("--repeat", type=int, default=10)
+
+    p = sub.add_parser("telem", help="configure telemetry requests")
+    p.add_argument("state", choices=["on", "off"])
+    p.add_argument("--interval", type=int, default=1000, help="us")
+
+    p = sub.add_parser("decim", help="configure telemetry decimation")
+    p.add_argument("--samples", type=int, default=0, help="samples per record")
+    p.add_argument("--window", type=int, default=0, help="us per record")
+    p.add_argument("--esc", type=int, default=ALL_ESCS)
+
+    p = sub.add_parser("ramp", help="ramp throttle on every motor")
+    p.add_argument("--start", type=int, default=48)
+    p.add_argument("--stop", type=int, default=548)
+    p.add_argument("--duration", type=float, default=5.0, help="s")
+    p.add_argument("--rate", type=float, default=1000.0, help="Hz")
+    p.add_argument("--motors", type=int, default=1)
+
+    args = parser.parse_args()
+    with open(args.port, "wb", buffering=0) as port:
+        channel = HostCmd(port)
+        if args.command == "throttle":
+            channel.throttle(args.codes)
+        elif args.command == "special":
+            channel.special(args.code, args.esc, args.repeat)
+        elif args.command == "telem":
+            channel.telem(args.state == "on", args.interval)
+        elif args.command == "decim":
+            channel.decim(args.samples, args.window, args.esc)
+        elif args.command == "ramp":
+            ramp(channel, args.start, args.stop, args.duration, args.rate, args.motors)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+"""Compile a csv throttle profile into the flash format of include/profile.h.
+
+The csv has one column per motor track, and one row per dshot frame.
+If the first column is named "t" (seconds), the rows are resampled at
+--frame-rate instead, with linear interpolation between rows.
+
+    t,motor0,motor1
+    0.0,48,48
+    0.5,48,548
+    1.0,548,548
+
+Usage:
+    profile_compile.py step.csv -o step_profile.h --name step_profile
+    profile_compile.py chirp.csv -o chirp.bin --frame-rate 7000 --loop 3
+
+The header output declares the profile as a const array placed in flash,
+so that it is read in place through XIP.
+"""
+
+import argparse
+import csv
+import struct
+import sys
+from pathlib import Path
+
+MAGIC = 0x5054
+VERSION = 1
+
+ABS, HOLD, RAMP, LOOP, LOOP_END, END = 0x80, 0x81, 0x82, 0x83, 0x84, 0x85
+MAX_RUN = 0xFFFF
+MIN_RUN = 3  # shorter runs are cheaper as plain deltas
+
+
+def read_tracks(path, frame_rate):
+    with open(path, newline="") as f:
+        rows = [row for row in csv.reader(f) if row and not row[0].startswith("#")]
+    header, rows = rows[0], [[float(v) for v in row] for row in rows[1:]]
+    if header[0].strip().lower() != "t":
+        return [[round(row[i]) for row in rows] for i in range(len(header))]
+
+    if frame_rate is None:
+        sys.exit("--frame-rate is required when the csv has a time column")
+    times = [row[0] for row in rows]
+    frames = int(round((times[-1] - times[0]) * frame_rate)) + 1
+    tracks = []
+    for col in range(1, len(header)):
+        samples, j = [], 0
+        for n in range(frames):
+            t = times[0] + n / frame_rate
+            while j + 1 < len(times) - 1 and times[j + 1] <= t:
+                j += 1
+            t0, t1 = times[j], times[min(j + 1, len(times) - 1)]
+            v0, v1 = rows[j][col], rows[min(j + 1, len(rows) - 1)][col]
+            alpha = 0 if t1 == t0 else min(max((t - t0) / (t1 - t0), 0), 1)
+            samples.append(round(v0 + alpha * (v1 - v0)))
+        tracks.append(samples)
+    return tracks
+
+
+def encode_track(samples, loop):
+    """Greedy encoding: runs of equal deltas become HOLD / RAMP opcodes."""
+    for code in samples:
+        if not 0 <= code <= 2047:
+            sys.exit(f"throttle code {code} is outside 0 - 2047")
+    out = bytearray()
+    if loop is not None:
+        out += struct.pack("<BH", LOOP, loop)
+
+    # The first frame is always absolute, so that loops restart cleanly
+    out += struct.pack("<BH", ABS, samples[0])
+    prev, i = samples[0], 1
+    while i < len(samples):
+        delta = samples[i] - prev
+        run = 1
+        while (i + run < len(samples) and run < MAX_RUN
+               and samples[i + run] - samples[i + run - 1] == delta):
+            run += 1
+        if run >= MIN_RUN and -128 <= delta <= 127:
+            if delta == 0:
+                out += struct.pack("<BH", HOLD, run)
+            else:
+                out += struct.pack("<BbH", RAMP, delta, run)
+            prev += delta * run
+            i += run
+            continue
+        if -64 <= delta <= 63:
+            out.append(delta & 0x7F)
+        else:
+            out += struct.pack("<BH", ABS, samples[i])
+        prev = samples[i]
+        i += 1
+
+    if loop is not None:
+        out.append(LOOP_END)
+    out.append(END)
+    return bytes(out)
+
+
+def build_profile(tracks, loop):
+    encoded = [encode_track(t, loop) for t in tracks]
+    offset = 4 + 4 * len(encoded)
+    header = struct.pack("<HBB", MAGIC, VERSION, len(encoded))
+    offsets = b""
+    for track in encoded:
+        offsets += struct.pack("<I", offset)
+        offset += len(track)
+    return header + offsets + b"".join(encoded)
+
+
+def to_c_header(profile, name, source, frames):
+    lines = [
+        f"// Generated by tools/profile_compile.py from {source}",
+        f"// {frames} frames, {len(profile)} bytes. Do not edit.",
+        "#pragma once",
+        '#include "pico/platform.h"',
+        '#include "stdint.h"',
+        "",
+        f'static const uint8_t {name}[] __in_flash("profile") = {{',
+    ]
+    for i in range(0, len(profile), 12):
+        lines.append("    " + ", ".join(f"0x{b:02x}" for b in profile[i:i + 12]) + ",")
+    lines.append("};")
+    return "\n".join(lines) + "\n"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("csv")
+    parser.add_argument("-o", "--output", required=True, help=".h or .bin")
+    parser.add_argument("--name", default="throttle_profile", help="C array name")
+    parser.add_argument("--frame-rate", type=float, help="Hz, for csvs with a t column")
+    parser.add_argument("--loop", type=int, help="repeat each track N times (0 = forever)")
+    args = parser.parse_args()
+
+    tracks = read_tracks(args.csv, args.frame_rate)
+    profile = build_profile(tracks, args.loop)
+    frames = max(len(t) for t in tracks)
+    output = Path(args.output)
+    if output.suffix == ".h":
+        output.write_text(to_c_header(profile, args.name, Path(args.csv).name, frames))
+    else:
+        output.write_bytes(profile)
+    print(f"{len(tracks)} tracks, {frames} frames -> {len(profile)} bytes "
+          f"({len(profile) / max(1, frames * len(tracks)):.2f} bytes/sample)",
+          file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
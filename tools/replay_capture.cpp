@@ -0,0 +1,65 @@
+/**
+ * @file replay_capture.cpp
+ *
+ * Host tool to turn a capture of the pico (see replaycap.h and
+ * examples/telemetry_capture) into sessions for `telem_replay`, e.g.:
+ *
+ *     cat /dev/ttyACM0 > bench.cap
+ *     replay_capture bench.cap bench.dsrs && telem_replay bench.dsrs
+ *
+ * The capture restarts each time the telemetry is turned on, so one file
+ * may hold several sessions: they are written to OUT, OUT.1, OUT.2, ...
+ * It exits with 1 if there is no session, or if events were lost (the
+ * ring of the pico was full, or frames were corrupted), since such a
+ * session can't be replayed faithfully.
+ *
+ * Build it with the host tests (`replay_capture` target in `test/`).
+ */
+
+#include "replay_session.hpp"
+#include <cstdio>
+#include <string>
+
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    printf("usage: %s CAPTURE OUT.dsrs\n", argv[0]);
+    return 2;
+  }
+  FILE *const f = fopen(argv[1], "rb");
+  if (!f) {
+    printf("%s: can't open\n", argv[1]);
+    return 2;
+  }
+  replay_capture capture;
+  uint8_t chunk[4096];
+  size_t count;
+  while ((count = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+    capture.feed(chunk, count);
+  }
+  fclose(f);
+
+  for (size_t s = 0; s < capture.sessions.size(); ++s) {
+    std::string path = argv[2];
+    if (s)
+      path += "." + std::to_string(s);
+    const replay_writer &w = capture.sessions[s];
+    if (!w.save(path.c_str())) {
+      printf("%s: can't write\n", path.c_str());
+      return 2;
+    }
+    printf("%s: %zu bytes%s\n", path.c_str(), w.data.size(),
+           w.data[7] & REPLAY_HAS_RESULTS ? "" : ", no samples");
+  }
+  printf("%s: %llu frames, %zu sessions, %llu dropped events, %llu bad "
+         "frames, %llu skipped bytes, %llu events before the start\n",
+         argv[1], (unsigned long long)capture.frames,
+         capture.sessions.size(), (unsigned long long)capture.dropped_events,
+         (unsigned long long)capture.bad_frames,
+         (unsigned long long)capture.skipped_bytes,
+         (unsigned long long)capture.orphans);
+  if (capture.sessions.empty()) {
+    printf("no session: was the telemetry turned on?\n");
+    return 1;
+  }
+  return capture.dropped_events || capture.bad_frames ? 1 : 0;
+}
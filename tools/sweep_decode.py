@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""Decode the per step result records of a throttle sweep (see include/sweep.h).
+
+Text printed by the pico (e.g. its configs) is skipped: records are found
+by their sync word and CRC. Decoding stops after the last step of the
+sweep, unless --follow is given.
+
+Usage:
+    sweep_decode.py /dev/ttyACM0 --csv sweep.csv
+    sweep_decode.py capture.bin --follow
+"""
+
+import argparse
+import csv
+import struct
+import sys
+
+SYNC = b"\x57\x5e"  # SWEEP_SYNC, little endian
+RECORD = struct.Struct("<HBBHHHIHHHHbB")
+assert RECORD.size == 24  # SWEEP_RECORD_SIZE
+
+FLAG_SETTLED, FLAG_TIMEOUT, FLAG_LAST = 1, 2, 4
+
+FIELDS = ["step", "code", "settled", "timeout", "settle_ms", "samples",
+          "erpm_mean", "erpm_std", "current_a", "current_std_a", "voltage_v",
+          "temperature_max_c"]
+
+
+def kiss_crc8(data):
+    """CRC8 from the KISS telemetry datasheet (see kissesc_update_crc)."""
+    crc = 0
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x7) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def results(stream):
+    """Yield (row, last) for every valid record in the stream."""
+    buffer = b""
+    while True:
+        chunk = stream.read(1)
+        if not chunk:
+            return
+        buffer += chunk
+        start = buffer.find(SYNC)
+        if start < 0:
+            buffer = buffer[-1:]
+            continue
+        buffer = buffer[start:]
+        if len(buffer) < RECORD.size:
+            continue
+        raw = buffer[:RECORD.size]
+        if kiss_crc8(raw) != 0:
+            buffer = buffer[1:]
+            continue
+        buffer = buffer[RECORD.size:]
+        (_, step, flags, code, settle_ms, samples, erpm_mean, erpm_std,
+         current, current_std, voltage, temperature, _) = RECORD.unpack(raw)
+        row = [step, code, int(bool(flags & FLAG_SETTLED)),
+               int(bool(flags & FLAG_TIMEOUT)), settle_ms, samples, erpm_mean,
+               erpm_std, current / 100, current_std / 100, voltage / 100,
+               temperature]
+        yield row, bool(flags & FLAG_LAST)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input", help="serial device of the pico, or a capture")
+    parser.add_argument("--csv", help="output file (default: stdout)")
+    parser.add_argument("--follow", action="store_true",
+                        help="keep decoding after the last step")
+    args = parser.parse_args()
+
+    out = open(args.csv, "w", newline="") if args.csv else sys.stdout
+    writer = csv.writer(out)
+    writer.writerow(FIELDS)
+    with open(args.input, "rb", buffering=0) as stream:
+        for row, last in results(stream):
+            writer.writerow(row)
+            out.flush()
+            if last and not args.follow:
+                break
+    if args.csv:
+        out.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,147 @@
+/**
+ * @file telem_replay.cpp
+ *
+ * Host tool to replay recorded sessions (see test/replay_session.hpp)
+ * through the telemetry data path, as fast as possible, e.g.:
+ *
+ *     telem_replay monday.dsrs tuesday.dsrs
+ *     telem_replay --verbose --max-diffs 50 run.dsrs
+ *
+ * For each session it reports the samples replayed per second, and the
+ * differences with the results of the original run. It exits with 1 if
+ * any session differs, so that a change of the parsing, queue or
+ * statistics code can be checked against old sessions in one batch.
+ * `soak_virtual_esc --record FILE` records a session, and
+ * `replay_capture` converts one captured on the bench.
+ *
+ * Build it with the host tests (`telem_replay` target in `test/`).
+ */
+
+#include <sys/types.h>
+
+#include "replay_session.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static void usage(const char *const name) {
+  printf("usage: %s [--verbose] [--max-diffs N] SESSION...\n", name);
+  printf("  --verbose     print the health, latency and statistics of each "
+         "ESC\n");
+  printf("  --max-diffs   differences printed per session (default 10)\n");
+}
+
+static bool read_file(const char *const path, std::vector<uint8_t> &data) {
+  FILE *const f = fopen(path, "rb");
+  if (!f)
+    return false;
+  fseek(f, 0, SEEK_END);
+  const long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  data.resize(size > 0 ? size : 0);
+  const bool ok = fread(data.data(), 1, data.size(), f) == data.size();
+  fclose(f);
+  return ok;
+}
+
+static void print_escs(const replay_pipeline &p) {
+  for (int i = 0; i < p.h.escs; ++i) {
+    telemhealth_print(&p.health[i], i, p.now_us);
+    telemlatency_print(&p.latency[i], i);
+    telemstats_t stats = p.stats[i];
+    telemstats_result_t result;
+    telemstats_snapshot(&stats, &result, false);
+    telemstats_print_result(&result, i);
+  }
+  printf("commands: %u frames, %u crc errors, %u seq gaps, %u bad\n",
+         p.cmd.frames, p.cmd.crc_errors, p.cmd.seq_gaps, p.cmd.bad_frames);
+}
+
+int main(int argc, char **argv) {
+  bool verbose = false;
+  size_t max_diffs = 10;
+  std::vector<const char *> paths;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--verbose")) {
+      verbose = true;
+    } else if (!strcmp(argv[i], "--max-diffs") && i + 1 < argc) {
+      max_diffs = strtoul(argv[++i], nullptr, 10);
+    } else if (argv[i][0] == '-') {
+      usage(argv[0]);
+      return 2;
+    } else {
+      paths.push_back(argv[i]);
+    }
+  }
+  if (paths.empty()) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  int failed = 0, differ = 0;
+  uint64_t total_samples = 0, total_bytes = 0;
+  double total_s = 0;
+  std::vector<uint8_t> data;
+  for (const char *const path : paths) {
+    if (!read_file(path, data)) {
+      fprintf(stderr, "%s: cannot read\n", path);
+      failed++;
+      continue;
+    }
+    std::unique_ptr<replay_pipeline> pipeline;
+    const auto start = std::chrono::steady_clock::now();
+    const bool ok =
+        replay_session(data.data(), data.size(), pipeline, max_diffs);
+    const auto stop = std::chrono::steady_clock::now();
+    const double s = std::chrono::duration<double>(stop - start).count();
+    if (!pipeline) {
+      fprintf(stderr, "%s: not a session\n", path);
+      failed++;
+      continue;
+    }
+    const replay_pipeline &p = *pipeline;
+    const replay_diff &diff = p.diff;
+    printf("%s: %d escs, %llu samples from %llu uart bytes in %.3f s: "
+           "%.0f samples/s, %.1f MB/s\n",
+           path, p.h.escs, (unsigned long long)p.samples,
+           (unsigned long long)p.uart_bytes, s, p.samples / s,
+           data.size() / s / 1e6);
+    if (!ok) {
+      fprintf(stderr, "%s: malformed or truncated\n", path);
+      failed++;
+    }
+    if (p.h.flags & REPLAY_HAS_RESULTS) {
+      printf("  %llu samples compared: %llu differ, %llu missing, %llu "
+             "extra; %llu snapshots: %llu differ; commands %s\n",
+             (unsigned long long)diff.samples,
+             (unsigned long long)diff.mismatched,
+             (unsigned long long)diff.missing,
+             (unsigned long long)diff.extra, (unsigned long long)diff.stats,
+             (unsigned long long)diff.stats_mismatched,
+             diff.commands_mismatched ? "differ" : "match");
+      for (const std::string &line : diff.details)
+        printf("  %s\n", line.c_str());
+      if (diff.total())
+        differ++;
+    } else {
+      printf("  no original results to compare with\n");
+    }
+    if (verbose)
+      print_escs(p);
+    total_samples += p.samples;
+    total_bytes += data.size();
+    total_s += s;
+  }
+  if (paths.size() > 1 && total_s > 0) {
+    printf("%zu sessions, %llu samples in %.3f s: %.0f samples/s, "
+           "%.1f MB/s; %d differ, %d failed\n",
+           paths.size(), (unsigned long long)total_samples, total_s,
+           total_samples / total_s, total_bytes / total_s / 1e6, differ,
+           failed);
+  }
+  if (failed)
+    return 2;
+  return differ ? 1 : 0;
+}
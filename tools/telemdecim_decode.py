@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+"""Decode decimated telemetry records (see include/telemdecim.h) to csv.
+
+Each row holds min, max, mean and last of every field over one window.
+Other data in the stream (e.g. raw telemstream records) is skipped: records
+are found by their sync word and CRC.
+
+Usage:
+    telemdecim_decode.py /dev/ttyACM0 --csv decim.csv
+    telemdecim_decode.py capture.bin
+"""
+
+import argparse
+import csv
+import struct
+import sys
+
+SYNC = b"\x7d\x5a"  # TELEMDECIM_SYNC, little endian
+RECORD = struct.Struct("<HHBBHII4b16HB")
+assert RECORD.size == 53  # TELEMDECIM_RECORD_SIZE
+
+FIELDS = ["temperature", "centi_voltage", "centi_current", "consumption",
+          "erpm"]
+STATS = ["min", "max", "mean", "last"]
+COLUMNS = (["seq", "esc", "bad", "samples", "first_us", "last_us"] +
+           [f"{field}_{stat}" for field in FIELDS for stat in STATS])
+
+
+def kiss_crc8(data):
+    """CRC8 from the KISS telemetry datasheet (see kissesc_update_crc)."""
+    crc = 0
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x7) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def records(stream, stats):
+    """Yield decoded records as lists ordered like COLUMNS."""
+    buffer = b""
+    while True:
+        chunk = stream.read(4096)
+        if not chunk:
+            return
+        buffer += chunk
+        while True:
+            start = buffer.find(SYNC)
+            if start < 0:
+                buffer = buffer[-1:]
+                break
+            if len(buffer) - start < RECORD.size:
+                buffer = buffer[start:]
+                break
+            raw = buffer[start:start + RECORD.size]
+            if kiss_crc8(raw) != 0:
+                stats["bad_crc"] += 1
+                buffer = buffer[start + 1:]
+                continue
+            buffer = buffer[start + RECORD.size:]
+            # Drop the sync word and the record crc
+            row = list(RECORD.unpack(raw)[1:-1])
+            # erpm is transmitted in units of 100 erpm
+            for i in range(-4, 0):
+                row[i] *= 100
+            yield row
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input", help="binary capture, serial device, or - for stdin")
+    parser.add_argument("--csv", help="output file (default: stdout)")
+    args = parser.parse_args()
+
+    stream = sys.stdin.buffer if args.input == "-" else open(args.input, "rb", buffering=0)
+    out = open(args.csv, "w", newline="") if args.csv else sys.stdout
+    writer = csv.writer(out)
+    writer.writerow(COLUMNS)
+
+    stats = {"records": 0, "lost": 0, "bad_crc": 0}
+    expected_seq = None
+    try:
+        for row in records(stream, stats):
+            seq = row[0]
+            if expected_seq is not None:
+                stats["lost"] += (seq - expected_seq) & 0xFFFF
+            expected_seq = (seq + 1) & 0xFFFF
+            stats["records"] += 1
+            writer.writerow(row)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if args.csv:
+            out.close()
+        if stream is not sys.stdin.buffer:
+            stream.close()
+
+    print(f"--- {stats['records']} records, {stats['lost']} lost, "
+          f"{stats['bad_crc']} crc failures ---", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,243 @@
+/**
+ * @file telemlog.cpp
+ *
+ * Host tool for telemlog.h logs (reader in test/telemlog_reader.hpp):
+ *
+ *     telemlog pack capture.bin run.tlog
+ *     telemlog info run.tlog
+ *     telemlog extract run.tlog --esc 2 --field current --from 3600 --to 3660
+ *     telemlog synth big.tlog --hours 10 --escs 4 --rate 1000
+ *
+ * - pack: realign the chunks of a raw capture of the pico's output, and
+ *   append the index
+ * - info: chunks, samples, time span and ESCs of a log
+ * - extract: one field of one ESC over [from, to) s, as csv with --csv,
+ *   else a summary and the time taken
+ * - synth: write a log of made up samples, to benchmark extract
+ *
+ * Build it with the host tests (`telemlog` target in `test/`).
+ */
+
+#include <sys/types.h>
+
+#include "telemlog_reader.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static const char *const field_names[TELEMLOG_FIELDS] = {
+    "time", "voltage", "current", "consumption",
+    "erpm", "esc",     "temperature", "crc"};
+
+static void usage(const char *const name) {
+  printf("usage: %s pack CAPTURE OUT\n", name);
+  printf("       %s info LOG\n", name);
+  printf("       %s extract LOG --esc N --field F [--from S] [--to S] "
+         "[--csv]\n",
+         name);
+  printf("       %s synth OUT [--hours H] [--escs N] [--rate HZ]\n", name);
+  printf("  fields: voltage current consumption erpm temperature crc\n");
+}
+
+static bool read_file(const char *const path, std::vector<uint8_t> &data) {
+  FILE *const f = fopen(path, "rb");
+  if (!f)
+    return false;
+  fseek(f, 0, SEEK_END);
+  const long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  data.resize(size > 0 ? size : 0);
+  const bool ok = fread(data.data(), 1, data.size(), f) == data.size();
+  fclose(f);
+  return ok;
+}
+
+/// @brief value of option \a name, or \a def
+static const char *option(int argc, char **argv, const char *const name,
+                          const char *const def) {
+  for (int i = 3; i < argc; ++i)
+    if (!strcmp(argv[i], name))
+      return i + 1 < argc ? argv[i + 1] : def;
+  return def;
+}
+
+static bool flag(int argc, char **argv, const char *const name) {
+  for (int i = 3; i < argc; ++i)
+    if (!strcmp(argv[i], name))
+      return true;
+  return false;
+}
+
+static int pack(const char *const in, const char *const out) {
+  std::vector<uint8_t> capture;
+  if (!read_file(in, capture)) {
+    fprintf(stderr, "%s: cannot read\n", in);
+    return 2;
+  }
+  FILE *const f = fopen(out, "wb");
+  if (!f) {
+    fprintf(stderr, "%s: cannot write\n", out);
+    return 2;
+  }
+  size_t skipped;
+  const long chunks =
+      telemlog_pack(capture.data(), capture.size(), f, &skipped);
+  if (fclose(f) || chunks < 0) {
+    fprintf(stderr, "%s: write error\n", out);
+    return 2;
+  }
+  printf("%s: %ld chunks, %zu bytes skipped\n", out, chunks, skipped);
+  return 0;
+}
+
+static int info(const char *const path) {
+  telemlog_reader log;
+  if (!log.open(path)) {
+    fprintf(stderr, "%s: not a telemlog\n", path);
+    return 2;
+  }
+  uint64_t samples = 0;
+  uint32_t mask = 0;
+  for (size_t c = 0; c < log.chunks; ++c) {
+    samples += log.index[c].count;
+    mask |= log.index[c].esc_mask;
+  }
+  printf("%s: %zu chunks, %llu samples, %s\n", path, log.chunks,
+         (unsigned long long)samples,
+         log.indexed ? "indexed" : "no index (scanned)");
+  if (log.chunks) {
+    const double from = log.index[0].first_us / 1e6;
+    const double to = log.index[log.chunks - 1].last_us / 1e6;
+    printf("  %.3f s - %.3f s (%.1f s)\n", from, to, to - from);
+  }
+  printf("  escs:");
+  for (int i = 0; i < 32; ++i)
+    if (mask & (1u << i))
+      printf(" %d", i);
+  printf("\n");
+  return 0;
+}
+
+static int extract(int argc, char **argv) {
+  const char *const path = argv[2];
+  const char *const name = option(argc, argv, "--field", "current");
+  int field = -1;
+  for (int i = 0; i < TELEMLOG_FIELDS; ++i)
+    if (!strcmp(name, field_names[i]))
+      field = i;
+  if (field < 0) {
+    fprintf(stderr, "unknown field %s\n", name);
+    return 2;
+  }
+  const int esc = atoi(option(argc, argv, "--esc", "0"));
+  const uint64_t from_us =
+      (uint64_t)(atof(option(argc, argv, "--from", "0")) * 1e6);
+  const char *const to = option(argc, argv, "--to", nullptr);
+  const uint64_t to_us = to ? (uint64_t)(atof(to) * 1e6) : UINT64_MAX;
+
+  const auto start = std::chrono::steady_clock::now();
+  telemlog_reader log;
+  if (!log.open(path)) {
+    fprintf(stderr, "%s: not a telemlog\n", path);
+    return 2;
+  }
+  std::vector<uint64_t> t_us;
+  std::vector<int32_t> values;
+  const size_t n = log.extract(esc, (enum telemlog_field)field, from_us,
+                               to_us, t_us, values);
+  const auto stop = std::chrono::steady_clock::now();
+  const double ms = std::chrono::duration<double>(stop - start).count() * 1e3;
+
+  if (flag(argc, argv, "--csv")) {
+    printf("time_us,%s\n", name);
+    for (size_t i = 0; i < n; ++i)
+      printf("%llu,%d\n", (unsigned long long)t_us[i], values[i]);
+    return 0;
+  }
+  int64_t sum = 0;
+  int32_t lo = INT32_MAX, hi = INT32_MIN;
+  for (const int32_t v : values) {
+    sum += v;
+    lo = v < lo ? v : lo;
+    hi = v > hi ? v : hi;
+  }
+  printf("%s: ESC %d %s: %zu samples", path, esc, name, n);
+  if (n)
+    printf(", min %d, mean %.2f, max %d", lo, (double)sum / n, hi);
+  printf(" in %.3f ms\n", ms);
+  return 0;
+}
+
+static int synth(int argc, char **argv) {
+  const char *const path = argv[2];
+  const double hours = atof(option(argc, argv, "--hours", "1"));
+  const int escs = atoi(option(argc, argv, "--escs", "4"));
+  const double rate = atof(option(argc, argv, "--rate", "1000"));
+  if (escs < 1 || escs > 32 || rate <= 0 || hours <= 0) {
+    usage(argv[0]);
+    return 2;
+  }
+  FILE *const f = fopen(path, "wb");
+  if (!f) {
+    fprintf(stderr, "%s: cannot write\n", path);
+    return 2;
+  }
+  // Samples come round robin, rate per second in total, as on the onewire
+  const uint64_t period_us = (uint64_t)(1e6 / rate);
+  const uint64_t end_us = (uint64_t)(hours * 3600e6);
+  static telemlog_t log;
+  telemlog_init(&log, 0);
+  std::vector<telemlog_index_entry> entries;
+  bool ok = true;
+  uint64_t samples = 0;
+  telem_sample_t sample = {};
+  for (uint64_t t = 0; t < end_us && ok; t += period_us, ++samples) {
+    const int esc = samples % escs;
+    const double phase = t / 1e6 * 0.1 + esc;
+    sample.timestamp_us = (uint32_t)t;
+    sample.esc_idx = esc;
+    sample.telem.centi_voltage = 1600 - (uint16_t)(t / 10000000);
+    sample.telem.centi_current = (uint16_t)(1000 + 800 * sin(phase));
+    sample.telem.consumption = (uint16_t)(t / 1000000);
+    sample.telem.erpm = (uint32_t)(20000 + 15000 * sin(phase)) * 100;
+    sample.telem.temperature = 40 + esc;
+    if (!telemlog_append(&log, &sample)) {
+      ok = fwrite(telemlog_finish(&log), 1, TELEMLOG_CHUNK_SIZE, f) ==
+           TELEMLOG_CHUNK_SIZE;
+      entries.push_back(telemlog_entry(log.header));
+      telemlog_next(&log);
+      telemlog_append(&log, &sample);
+    }
+  }
+  if (ok && log.header.count) {
+    ok = fwrite(telemlog_finish(&log), 1, TELEMLOG_CHUNK_SIZE, f) ==
+         TELEMLOG_CHUNK_SIZE;
+    entries.push_back(telemlog_entry(log.header));
+  }
+  ok = ok && telemlog_write_index(
+                 f, entries, entries.size() * (uint64_t)TELEMLOG_CHUNK_SIZE);
+  if (fclose(f) || !ok) {
+    fprintf(stderr, "%s: write error\n", path);
+    return 2;
+  }
+  printf("%s: %llu samples in %zu chunks (%.1f MB)\n", path,
+         (unsigned long long)samples, entries.size(),
+         (entries.size() * (double)TELEMLOG_CHUNK_SIZE) / 1e6);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc >= 4 && !strcmp(argv[1], "pack"))
+    return pack(argv[2], argv[3]);
+  if (argc >= 3 && !strcmp(argv[1], "info"))
+    return info(argv[2]);
+  if (argc >= 3 && !strcmp(argv[1], "extract"))
+    return extract(argc, argv);
+  if (argc >= 3 && !strcmp(argv[1], "synth"))
+    return synth(argc, argv);
+  usage(argv[0]);
+  return 2;
+}
@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+"""Decode a binary telemetry stream (see include/telemstream.h).
+
+Records are decoded as they arrive, so this can run on a serial port for
+as long as the test lasts. Output can be written as csv and/or as columnar
+files: one raw little endian array per field plus a schema.json, which can
+be loaded with e.g. numpy.fromfile(path, dtype).
+
+Usage:
+    telemstream_decode.py /dev/ttyACM0 --csv telem.csv
+    telemstream_decode.py capture.bin --columns telem_columns/
+"""
+
+import argparse
+import csv
+import json
+import struct
+import sys
+from array import array
+from pathlib import Path
+
+SYNC = b"\x7e\x5a"  # TELEMSTREAM_SYNC, little endian
+RECORD = struct.Struct("<HHIBbHHHHBB")
+assert RECORD.size == 20  # TELEMSTREAM_RECORD_SIZE
+
+# (name, array typecode, numpy dtype)
+COLUMNS = [
+    ("seq", "H", "<u2"),
+    ("timestamp_us", "I", "<u4"),
+    ("esc", "B", "u1"),
+    ("temperature", "b", "i1"),
+    ("centi_voltage", "H", "<u2"),
+    ("centi_current", "H", "<u2"),
+    ("consumption", "H", "<u2"),
+    ("erpm", "I", "<u4"),
+    ("kiss_crc", "B", "u1"),
+]
+
+
+def kiss_crc8(data):
+    """CRC8 from the KISS telemetry datasheet (see kissesc_update_crc)."""
+    crc = 0
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x7) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def records(stream, stats):
+    """Yield decoded records as tuples ordered like COLUMNS."""
+    buffer = b""
+    while True:
+        chunk = stream.read(4096)
+        if not chunk:
+            return
+        buffer += chunk
+        while True:
+            start = buffer.find(SYNC)
+            if start < 0:
+                buffer = buffer[-1:]
+                break
+            if len(buffer) - start < RECORD.size:
+                buffer = buffer[start:]
+                break
+            raw = buffer[start:start + RECORD.size]
+            if kiss_crc8(raw) != 0:
+                # Not a record (or corrupt): resync on the next byte
+                stats["bad_crc"] += 1
+                buffer = buffer[start + 1:]
+                continue
+            stats["skipped_bytes"] += start
+            buffer = buffer[start + RECORD.size:]
+            (_, seq, timestamp_us, esc, temperature, voltage, current,
+             consumption, erpm_hundreds, kiss_crc, _) = RECORD.unpack(raw)
+            yield (seq, timestamp_us, esc, temperature, voltage, current,
+                   consumption, erpm_hundreds * 100, kiss_crc)
+
+
+class ColumnWriter:
+    """Append each field to its own raw binary file."""
+
+    def __init__(self, directory, flush_every=4096):
+        self.directory = Path(directory)
+        self.directory.mkdir(parents=True, exist_ok=True)
+        self.files = [open(self.directory / f"{name}.bin", "wb") for name, _, _ in COLUMNS]
+        self.pending = [array(code) for _, code, _ in COLUMNS]
+        self.flush_every = flush_every
+        self.count = 0
+
+    def write(self, record):
+        for column, value in zip(self.pending, record):
+            column.append(value)
+        self.count += 1
+        if len(self.pending[0]) >= self.flush_every:
+            self.flush()
+
+    def flush(self):
+        for f, column in zip(self.files, self.pending):
+            if sys.byteorder != "little":
+                column.byteswap()
+            column.tofile(f)
+            del column[:]
+
+    def close(self):
+        self.flush()
+        for f in self.files:
+            f.close()
+        schema = {
+            "rows": self.count,
+            "columns": [{"name": n, "file": f"{n}.bin", "dtype": d} for n, _, d in COLUMNS],
+        }
+        (self.directory / "schema.json").write_text(json.dumps(schema, indent=2))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input", help="binary capture, serial device, or - for stdin")
+    parser.add_argument("--csv", help="write records to this csv file")
+    parser.add_argument("--columns", help="write columnar files to this directory")
+    args = parser.parse_args()
+
+    stream = sys.stdin.buffer if args.input == "-" else open(args.input, "rb", buffering=0)
+    csv_file = open(args.csv, "w", newline="") if args.csv else None
+    csv_writer = csv.writer(csv_file) if csv_file else None
+    if csv_writer:
+        csv_writer.writerow([name for name, _, _ in COLUMNS])
+    columns = ColumnWriter(args.columns) if args.columns else None
+
+    stats = {"records": 0, "seq_gaps": 0, "lost": 0, "bad_crc": 0, "skipped_bytes": 0}
+    expected_seq = None
+    try:
+        for record in records(stream, stats):
+            seq = record[0]
+            if expected_seq is not None and seq != expected_seq:
+                stats["seq_gaps"] += 1
+                stats["lost"] += (seq - expected_seq) & 0xFFFF
+            expected_seq = (seq + 1) & 0xFFFF
+            stats["records"] += 1
+            if csv_writer:
+                csv_writer.writerow(record)
+            if columns:
+                columns.write(record)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if columns:
+            columns.close()
+        if csv_file:
+            csv_file.close()
+        if stream is not sys.stdin.buffer:
+            stream.close()
+
+    print(f"--- {stats['records']} records, {stats['lost']} lost in "
+          f"{stats['seq_gaps']} sequence gaps, {stats['bad_crc']} crc failures, "
+          f"{stats['skipped_bytes']} bytes skipped ---", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()